@@ -0,0 +1,526 @@
+#include "Autotune.h"
+#include "MedialProximity.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+// simplification targets tried per input vertex
+static const double autotune_fractions[] = {0.002, 0.005, 0.01, 0.02, 0.05, 0.1};
+static const unsigned autotune_num_fractions = sizeof(autotune_fractions) / sizeof(autotune_fractions[0]);
+// relative differences below this are timer noise or reordering
+static const double autotune_tie = 0.02;
+
+AutotuneConfig::AutotuneConfig()
+{
+	hyperbolic_weight_type = 3;
+	preserve_boundary_method = 0;
+	prevent_inversion = false;
+	reorder = true;
+	powercrust = false;
+	threads = 1;
+	simplify_fraction = 0.05;
+}
+
+void AutotuneModel::Fit(const AutotuneTrial & small, const AutotuneTrial & large)
+{
+	exponent = 1.2;
+	if(small.time_ms <= 0. || large.time_ms <= 0. || large.vertices <= small.vertices || small.vertices == 0)
+		return;
+	// between linear and quadratic, anything else is noise of the short runs
+	double e = log(large.time_ms / small.time_ms) / log((double)large.vertices / small.vertices);
+	exponent = std::min(2., std::max(1., e));
+}
+
+double AutotuneModel::PredictTime(const AutotuneTrial & trial, unsigned vertices) const
+{
+	if(trial.vertices == 0)
+		return trial.time_ms;
+	return trial.time_ms * pow((double)vertices / trial.vertices, exponent);
+}
+
+bool AutotuneBudget::Fits(double time, double err) const
+{
+	return (time_ms <= 0. || time <= time_ms) && (error <= 0. || err <= error);
+}
+
+double AutotuneBudget::Overshoot(double time, double err) const
+{
+	double r = 0.;
+	if(time_ms > 0.)
+		r = std::max(r, time / time_ms);
+	if(error > 0.)
+		r = std::max(r, err / error);
+	return r;
+}
+
+// a below b by more than the tie tolerance, 0 when they tie
+static int AutotuneCompare(double a, double b)
+{
+	double m = std::max(fabs(a), fabs(b));
+	if(fabs(a - b) <= autotune_tie * m)
+		return 0;
+	return a < b ? -1 : 1;
+}
+
+bool AutotuneBetter(double time_a, double error_a, double time_b, double error_b, const AutotuneBudget & budget)
+{
+	bool fa = budget.Fits(time_a, error_a);
+	bool fb = budget.Fits(time_b, error_b);
+	if(fa != fb)
+		return fa;
+	if(!fa)
+	{
+		int c = AutotuneCompare(budget.Overshoot(time_a, error_a), budget.Overshoot(time_b, error_b));
+		if(c != 0)
+			return c < 0;
+	}
+
+	int c_time = AutotuneCompare(time_a, time_b);
+	int c_error = AutotuneCompare(error_a, error_b);
+	if(budget.error > 0.)
+		return c_time < 0 || (c_time == 0 && c_error < 0);
+	return c_error < 0 || (c_error == 0 && c_time < 0);
+}
+
+const char * AutotuneAxisName(unsigned axis)
+{
+	static const char * names[AUTOTUNE_AXES] = {"target", "hyperbolic_weight", "boundary_method", "prevent_inversion",
+												"labeling", "reorder", "threads"};
+	return axis < AUTOTUNE_AXES ? names[axis] : "";
+}
+
+std::string AutotuneAxisValue(const AutotuneConfig & config, unsigned axis)
+{
+	std::ostringstream out;
+	switch(axis)
+	{
+	case AUTOTUNE_TARGET: out << config.simplify_fraction; break;
+	case AUTOTUNE_WEIGHT: out << config.hyperbolic_weight_type; break;
+	case AUTOTUNE_BOUNDARY: out << config.preserve_boundary_method; break;
+	case AUTOTUNE_INVERSION: out << (config.prevent_inversion ? "on" : "off"); break;
+	case AUTOTUNE_LABELING: out << (config.powercrust ? "powercrust" : "exact"); break;
+	case AUTOTUNE_REORDER: out << (config.reorder ? "on" : "off"); break;
+	case AUTOTUNE_THREADS: out << config.threads; break;
+	default: break;
+	}
+	return out.str();
+}
+
+void AutotuneVariants(const AutotuneConfig & base, unsigned axis, int max_threads, std::vector<AutotuneConfig> & variants)
+{
+	variants.clear();
+	AutotuneConfig v = base;
+	switch(axis)
+	{
+	case AUTOTUNE_TARGET:
+		for(unsigned i = 0; i < autotune_num_fractions; i ++)
+			if(AutotuneCompare(autotune_fractions[i], base.simplify_fraction) != 0)
+			{
+				v.simplify_fraction = autotune_fractions[i];
+				variants.push_back(v);
+			}
+		break;
+	case AUTOTUNE_WEIGHT:
+		for(int w = 0; w <= 3; w ++)
+			if(w != base.hyperbolic_weight_type)
+			{
+				v.hyperbolic_weight_type = w;
+				variants.push_back(v);
+			}
+		break;
+	case AUTOTUNE_BOUNDARY:
+		// method two is disabled in ThreeDimensionalShape::LoadSlabMesh
+		for(int m = 0; m <= 3; m ++)
+			if(m != 2 && m != base.preserve_boundary_method)
+			{
+				v.preserve_boundary_method = m;
+				variants.push_back(v);
+			}
+		break;
+	case AUTOTUNE_INVERSION:
+		v.prevent_inversion = !base.prevent_inversion;
+		variants.push_back(v);
+		break;
+	case AUTOTUNE_LABELING:
+		v.powercrust = !base.powercrust;
+		variants.push_back(v);
+		break;
+	case AUTOTUNE_REORDER:
+		v.reorder = !base.reorder;
+		variants.push_back(v);
+		break;
+	case AUTOTUNE_THREADS:
+		{
+			int counts[3] = {max_threads, max_threads / 2, 1};
+			for(int i = 0; i < 3; i ++)
+			{
+				bool seen = counts[i] < 1 || counts[i] == base.threads;
+				for(int j = 0; j < i; j ++)
+					seen = seen || counts[j] == counts[i];
+				if(!seen)
+				{
+					v.threads = counts[i];
+					variants.push_back(v);
+				}
+			}
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+bool AutotuneProfile::Save(const std::string & filename, std::string & error) const
+{
+	std::ofstream out(filename.c_str());
+	if(!out)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	out << std::setprecision(9);
+	out << "# qmat_cli autotune profile, apply with --profile" << std::endl;
+	out << "hyperbolic_weight_type=" << config.hyperbolic_weight_type << std::endl;
+	out << "preserve_boundary_method=" << config.preserve_boundary_method << std::endl;
+	out << "prevent_inversion=" << (config.prevent_inversion ? 1 : 0) << std::endl;
+	out << "reorder=" << (config.reorder ? 1 : 0) << std::endl;
+	out << "powercrust=" << (config.powercrust ? 1 : 0) << std::endl;
+	out << "threads=" << config.threads << std::endl;
+	out << "simplify_fraction=" << config.simplify_fraction << std::endl;
+	out << "# prediction for the tuned input" << std::endl;
+	out << "input_vertices=" << input_vertices << std::endl;
+	out << "predicted_time_ms=" << predicted_time_ms << std::endl;
+	out << "predicted_error=" << predicted_error << std::endl;
+	out << "exponent=" << exponent << std::endl;
+	out << "trials=" << trials << std::endl;
+
+	if(!out)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool AutotuneProfile::Load(const std::string & filename, std::string & error)
+{
+	std::ifstream in(filename.c_str());
+	if(!in)
+	{
+		error = "Could not open profile " + filename;
+		return false;
+	}
+
+	*this = AutotuneProfile();
+	std::string line;
+	while(std::getline(in, line))
+	{
+		size_t pos = line.find('=');
+		if(pos == std::string::npos || line[0] == '#')
+			continue;
+		std::string key = line.substr(0, pos);
+		double value;
+		std::istringstream vs(line.substr(pos + 1));
+		if(!(vs >> value))
+			continue;
+
+		if(key == "hyperbolic_weight_type") config.hyperbolic_weight_type = (int)value;
+		else if(key == "preserve_boundary_method") config.preserve_boundary_method = (int)value;
+		else if(key == "prevent_inversion") config.prevent_inversion = value != 0.;
+		else if(key == "reorder") config.reorder = value != 0.;
+		else if(key == "powercrust") config.powercrust = value != 0.;
+		else if(key == "threads") config.threads = (int)value;
+		else if(key == "simplify_fraction") config.simplify_fraction = value;
+		else if(key == "input_vertices") input_vertices = (unsigned)value;
+		else if(key == "predicted_time_ms") predicted_time_ms = value;
+		else if(key == "predicted_error") predicted_error = value;
+		else if(key == "exponent") exponent = value;
+		else if(key == "trials") trials = (unsigned)value;
+	}
+
+	if(config.hyperbolic_weight_type < 0 || config.hyperbolic_weight_type > 3
+	   || config.preserve_boundary_method < 0 || config.preserve_boundary_method > 3
+	   || config.preserve_boundary_method == 2 || config.threads < 1 || !(config.simplify_fraction > 0.))
+	{
+		error = "Invalid settings in profile " + filename;
+		return false;
+	}
+	return true;
+}
+
+static unsigned long long ClusterKey(long long x, long long y, long long z)
+{
+	return ((unsigned long long)(x & 0x1fffff) << 42) | ((unsigned long long)(y & 0x1fffff) << 21) | (unsigned long long)(z & 0x1fffff);
+}
+
+// cluster of every vertex on a grid of resolution cells along the longest side
+static unsigned ClusterVertices(const IndexedMesh & mesh, const double box_min[3], double extent, unsigned resolution,
+								std::vector<unsigned> & cluster)
+{
+	unsigned nv = mesh.NumVertices();
+	double cell = extent / resolution;
+	std::vector<unsigned long long> keys(nv);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		long long c[3];
+		for(int k = 0; k < 3; k ++)
+			c[k] = std::min((long long)resolution - 1, (long long)((mesh.positions[3 * i + k] - box_min[k]) / cell));
+		keys[i] = ClusterKey(c[0], c[1], c[2]);
+	}
+	std::vector<unsigned long long> cells = keys;
+	std::sort(cells.begin(), cells.end());
+	cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+	cluster.resize(nv);
+	for(unsigned i = 0; i < nv; i ++)
+		cluster[i] = (unsigned)(std::lower_bound(cells.begin(), cells.end(), keys[i]) - cells.begin());
+	return (unsigned)cells.size();
+}
+
+// sorted vertices of a triangle, and whether sorting took an odd permutation
+static void SortTriangle(const unsigned t[3], unsigned s[3], bool & odd)
+{
+	s[0] = t[0];
+	s[1] = t[1];
+	s[2] = t[2];
+	odd = false;
+	if(s[0] > s[1]) { std::swap(s[0], s[1]); odd = !odd; }
+	if(s[1] > s[2]) { std::swap(s[1], s[2]); odd = !odd; }
+	if(s[0] > s[1]) { std::swap(s[0], s[1]); odd = !odd; }
+}
+
+static unsigned FanRoot(std::vector<unsigned> & parent, unsigned i)
+{
+	while(parent[i] != i)
+		i = parent[i] = parent[parent[i]];
+	return i;
+}
+
+// The triangles around a vertex have to form one fan, joined by the edges through
+// the vertex. Clustering can pinch surfaces together at a vertex, every fan but the
+// first gets its own copy of it.
+static void SplitNonManifoldVertices(IndexedMesh & mesh)
+{
+	unsigned nv = mesh.NumVertices();
+	unsigned nc = (unsigned)mesh.face_index.size();
+	std::vector<unsigned> offset(nv + 1, 0);
+	for(unsigned c = 0; c < nc; c ++)
+		offset[mesh.face_index[c] + 1] ++;
+	for(unsigned v = 0; v < nv; v ++)
+		offset[v + 1] += offset[v];
+	std::vector<unsigned> corner(nc);
+	std::vector<unsigned> fill(offset.begin(), offset.end() - 1);
+	for(unsigned c = 0; c < nc; c ++)
+		corner[fill[mesh.face_index[c]] ++] = c;
+
+	std::vector<unsigned> parent, copy;
+	for(unsigned v = 0; v < nv; v ++)
+	{
+		unsigned first = offset[v], n = offset[v + 1] - offset[v];
+		if(n < 2)
+			continue;
+		// two triangles at v share an edge through v when they share another vertex
+		parent.resize(n);
+		for(unsigned i = 0; i < n; i ++)
+			parent[i] = i;
+		for(unsigned i = 0; i < n; i ++)
+		{
+			const unsigned * a = &mesh.face_index[corner[first + i] / 3 * 3];
+			for(unsigned j = i + 1; j < n; j ++)
+			{
+				const unsigned * b = &mesh.face_index[corner[first + j] / 3 * 3];
+				bool shared = false;
+				for(int k = 0; k < 3 && !shared; k ++)
+					shared = a[k] != v && (a[k] == b[0] || a[k] == b[1] || a[k] == b[2]);
+				if(shared)
+					parent[FanRoot(parent, i)] = FanRoot(parent, j);
+			}
+		}
+
+		unsigned root = FanRoot(parent, 0);
+		copy.assign(n, 0xffffffffu);
+		for(unsigned i = 0; i < n; i ++)
+		{
+			unsigned r = FanRoot(parent, i);
+			if(r == root)
+				continue;
+			if(copy[r] == 0xffffffffu)
+			{
+				copy[r] = mesh.NumVertices();
+				mesh.AddVertex(mesh.positions[3 * v], mesh.positions[3 * v + 1], mesh.positions[3 * v + 2]);
+			}
+			mesh.face_index[corner[first + i]] = copy[r];
+		}
+	}
+}
+
+void DecimateMesh(const IndexedMesh & mesh, unsigned max_vertices, IndexedMesh & decimated)
+{
+	decimated.clear();
+	unsigned nv = mesh.NumVertices();
+	if(nv <= max_vertices)
+	{
+		decimated.positions = mesh.positions;
+		decimated.face_offset = mesh.face_offset;
+		decimated.face_index = mesh.face_index;
+		return;
+	}
+
+	double box_min[3], box_max[3];
+	for(int k = 0; k < 3; k ++)
+	{
+		box_min[k] = mesh.positions[k];
+		box_max[k] = mesh.positions[k];
+	}
+	for(unsigned i = 1; i < nv; i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			box_min[k] = std::min(box_min[k], mesh.positions[3 * i + k]);
+			box_max[k] = std::max(box_max[k], mesh.positions[3 * i + k]);
+		}
+	double extent = std::max(box_max[0] - box_min[0], std::max(box_max[1] - box_min[1], box_max[2] - box_min[2]));
+	if(!(extent > 0.))
+		extent = 1.;
+	// slightly larger, the far side lands inside the last cell
+	extent *= 1. + 1e-9;
+
+	// the occupied cells grow with the resolution, take the finest one within budget
+	std::vector<unsigned> cluster;
+	unsigned lo = 1, hi = 0x1fffff;
+	while(lo < hi)
+	{
+		unsigned mid = lo + (hi - lo + 1) / 2;
+		if(ClusterVertices(mesh, box_min, extent, mid, cluster) <= max_vertices)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+	unsigned nc = ClusterVertices(mesh, box_min, extent, lo, cluster);
+
+	// triangles between three clusters
+	std::vector<unsigned> triangles;
+	for(unsigned f = 0; f < mesh.NumFaces(); f ++)
+	{
+		const unsigned * idx = &mesh.face_index[mesh.face_offset[f]];
+		unsigned degree = mesh.FaceDegree(f);
+		for(unsigned j = 1; j + 1 < degree; j ++)
+		{
+			unsigned t[3] = {cluster[idx[0]], cluster[idx[j]], cluster[idx[j + 1]]};
+			if(t[0] != t[1] && t[1] != t[2] && t[0] != t[2])
+				triangles.insert(triangles.end(), t, t + 3);
+		}
+	}
+
+	// Clustering maps the closed surface to a closed chain of triangles: copies of a
+	// triangle in opposite directions cancel, the net direction is kept once
+	unsigned nt = (unsigned)triangles.size() / 3;
+	std::vector<std::pair<std::pair<unsigned long long, unsigned>, unsigned> > order(nt);
+	std::vector<char> odd(nt);
+	for(unsigned t = 0; t < nt; t ++)
+	{
+		unsigned s[3];
+		bool o;
+		SortTriangle(&triangles[3 * t], s, o);
+		odd[t] = o;
+		order[t] = std::make_pair(std::make_pair(((unsigned long long)s[0] << 32) | s[1], s[2]), t);
+	}
+	std::sort(order.begin(), order.end());
+	std::vector<char> keep(nt, 0);
+	for(unsigned i = 0; i < nt; )
+	{
+		unsigned j = i;
+		int net = 0;
+		for(; j < nt && order[j].first == order[i].first; j ++)
+			net += odd[order[j].second] ? -1 : 1;
+		for(unsigned k = i; k < j && net != 0; k ++)
+			if((net > 0) != (odd[order[k].second] != 0))
+			{
+				keep[order[k].second] = 1;
+				break;
+			}
+		i = j;
+	}
+
+	std::vector<double> sum(3 * nc, 0.);
+	std::vector<unsigned> count(nc, 0);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		for(int k = 0; k < 3; k ++)
+			sum[3 * cluster[i] + k] += mesh.positions[3 * i + k];
+		count[cluster[i]] ++;
+	}
+
+	// triangles of zero area between the cluster means are dropped
+	double area_tolerance = 1e-12 * extent * extent;
+	for(unsigned t = 0; t < nt; t ++)
+	{
+		if(!keep[t])
+			continue;
+		Wm4::Vector3d p[3];
+		for(int k = 0; k < 3; k ++)
+		{
+			unsigned c = triangles[3 * t + k];
+			p[k] = Wm4::Vector3d(sum[3 * c], sum[3 * c + 1], sum[3 * c + 2]) / (double)count[c];
+		}
+		if((p[1] - p[0]).Cross(p[2] - p[0]).Length() <= area_tolerance)
+			keep[t] = 0;
+	}
+
+	// clusters left without a triangle are dropped as well
+	const unsigned unused = 0xffffffffu;
+	std::vector<unsigned> index(nc, unused);
+	for(unsigned t = 0; t < nt; t ++)
+		if(keep[t])
+			for(int k = 0; k < 3; k ++)
+				index[triangles[3 * t + k]] = 0;
+	for(unsigned c = 0; c < nc; c ++)
+		if(index[c] != unused)
+		{
+			index[c] = decimated.NumVertices();
+			decimated.AddVertex(sum[3 * c] / count[c], sum[3 * c + 1] / count[c], sum[3 * c + 2] / count[c]);
+		}
+	for(unsigned t = 0; t < nt; t ++)
+		if(keep[t])
+		{
+			unsigned idx[3] = {index[triangles[3 * t]], index[triangles[3 * t + 1]], index[triangles[3 * t + 2]]};
+			decimated.AddFace(idx, 3);
+		}
+	SplitNonManifoldVertices(decimated);
+}
+
+double MedialSurfaceDeviation(const MedialMeshData & ma, const IndexedMesh & mesh)
+{
+	unsigned nv = mesh.NumVertices();
+	if(nv == 0)
+		return 0.;
+	MedialPrimitiveTree tree;
+	tree.Build(ma);
+	if(tree.nodes.empty())
+		return 1.;
+
+	double box_min[3], box_max[3];
+	for(int k = 0; k < 3; k ++)
+	{
+		box_min[k] = mesh.positions[k];
+		box_max[k] = mesh.positions[k];
+	}
+	for(unsigned i = 1; i < nv; i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			box_min[k] = std::min(box_min[k], mesh.positions[3 * i + k]);
+			box_max[k] = std::max(box_max[k], mesh.positions[3 * i + k]);
+		}
+	double diagonal = sqrt((box_max[0] - box_min[0]) * (box_max[0] - box_min[0]) + (box_max[1] - box_min[1]) * (box_max[1] - box_min[1])
+						   + (box_max[2] - box_min[2]) * (box_max[2] - box_min[2]));
+	if(!(diagonal > 0.))
+		return 0.;
+
+	std::vector<double> distance(nv);
+#pragma omp parallel for schedule(dynamic, 256)
+	for(int i = 0; i < (int)nv; i ++)
+		distance[i] = fabs(MedialPointDistance(tree, mesh.Position(i)));
+	return *std::max_element(distance.begin(), distance.end()) / diagonal;
+}
@@ -0,0 +1,125 @@
+#ifndef _AUTOTUNE_H
+#define _AUTOTUNE_H
+
+#include <string>
+#include <vector>
+#include "IndexedMesh.h"
+#include "MedialChunks.h"
+
+// The settings of a run that the autotuner chooses between
+class AutotuneConfig
+{
+public:
+	int hyperbolic_weight_type;		// SlabMesh::hyperbolic_weight_type, 0 to 3
+	int preserve_boundary_method;	// 1 or 3, 0 is PreservBoundaryMethodFour
+	bool prevent_inversion;
+	bool reorder;
+	bool powercrust;
+	int threads;
+	double simplify_fraction;		// simplification target per input vertex
+
+public:
+	AutotuneConfig();
+};
+
+// one run on a decimated copy of the input
+class AutotuneTrial
+{
+public:
+	unsigned vertices;	// of the copy
+	double time_ms;		// wall time of the DT, the MA and the simplification
+	double error;		// MedialSurfaceDeviation of the simplified MA
+
+public:
+	AutotuneTrial() : vertices(0), time_ms(0.), error(0.) {}
+};
+
+// Run time t = c * n^exponent of n input vertices. The exponent is shared by all
+// configurations and fitted on two sizes of the copy, c comes from the trial of
+// each configuration. The error relative to the diagonal is taken as independent
+// of the size.
+class AutotuneModel
+{
+public:
+	double exponent;
+
+public:
+	AutotuneModel() : exponent(1.2) {}
+	void Fit(const AutotuneTrial & small, const AutotuneTrial & large);
+	double PredictTime(const AutotuneTrial & trial, unsigned vertices) const;
+};
+
+// limits of the full run, <= 0 for none
+class AutotuneBudget
+{
+public:
+	double time_ms;
+	double error;
+
+public:
+	AutotuneBudget() : time_ms(0.), error(0.) {}
+	bool Fits(double time, double err) const;
+	// largest ratio of a prediction to its limit, 1 at the limit
+	double Overshoot(double time, double err) const;
+};
+
+// True when the prediction a is the better choice under the budget. Fitting ones
+// come first. Among them, with an error budget the faster one wins, with a time
+// budget only the more accurate one; near ties (timer noise) go to the other
+// measure. Among the rest, the one closer to the budget wins.
+bool AutotuneBetter(double time_a, double error_a, double time_b, double error_b, const AutotuneBudget & budget);
+
+// the settings varied one at a time, in this order
+enum AutotuneAxis
+{
+	AUTOTUNE_TARGET,
+	AUTOTUNE_WEIGHT,
+	AUTOTUNE_BOUNDARY,
+	AUTOTUNE_INVERSION,
+	AUTOTUNE_LABELING,
+	AUTOTUNE_REORDER,
+	AUTOTUNE_THREADS,
+	AUTOTUNE_AXES
+};
+
+const char * AutotuneAxisName(unsigned axis);
+// the setting of config on that axis as text
+std::string AutotuneAxisValue(const AutotuneConfig & config, unsigned axis);
+
+// the configurations that differ from base in the setting of axis, base excluded;
+// the targets in increasing order
+void AutotuneVariants(const AutotuneConfig & base, unsigned axis, int max_threads, std::vector<AutotuneConfig> & variants);
+
+// Tuned configuration with its predictions, reusable with --profile
+// key=value lines, unknown keys are ignored
+class AutotuneProfile
+{
+public:
+	AutotuneConfig config;
+	unsigned input_vertices;
+	double predicted_time_ms;
+	double predicted_error;
+	double exponent;
+	unsigned trials;
+
+public:
+	AutotuneProfile() : input_vertices(0), predicted_time_ms(0.), predicted_error(0.), exponent(0.), trials(0) {}
+
+	bool Save(const std::string & filename, std::string & error) const;
+	bool Load(const std::string & filename, std::string & error);
+};
+
+// Vertex clustering on a regular grid, the finest one with at most max_vertices
+// occupied cells. A cell becomes the mean of its vertices, the faces are split
+// into triangles, the collapsed and zero area ones go away and copies of a
+// triangle cancel down to their net direction, so no face is left twice. A vertex
+// pinched between separate fans of triangles is split, one copy per fan. A copy
+// of the mesh when it is small enough.
+void DecimateMesh(const IndexedMesh & mesh, unsigned max_vertices, IndexedMesh & decimated);
+
+// Largest distance of the surface vertices to the envelope of the MA, relative to
+// the bounding box diagonal of the surface. Inside the envelope the depth of the
+// deepest element is taken, like the Hausdorff distance of the slab mesh.
+double MedialSurfaceDeviation(const MedialMeshData & ma, const IndexedMesh & mesh);
+
+#endif // _AUTOTUNE_H
@@ -0,0 +1,27 @@
+#ifndef _CGALPRECOMPILED_H
+#define _CGALPRECOMPILED_H
+
+// precompiled header (QMAT_USE_PCH) of the files that include Mesh.h,
+// the heavy third-party headers they all parse
+#include <CGAL/Cartesian.h>
+#include <CGAL/Polyhedron_3.h>
+#include <CGAL/Polyhedron_incremental_builder_3.h>
+#include <CGAL/IO/Polyhedron_iostream.h>
+#include <CGAL/convex_hull_2.h>
+#include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
+#include <CGAL/Delaunay_triangulation_3.h>
+#include <CGAL/Triangulation_vertex_base_with_info_3.h>
+#include <CGAL/Triangulation_cell_base_with_info_3.h>
+#include <CGAL/Delaunay_triangulation_cell_base_with_circumcenter_3.h>
+
+#include <Eigen/Dense>
+
+#include <vector>
+#include <list>
+#include <set>
+#include <map>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+#endif // _CGALPRECOMPILED_H
@@ -0,0 +1,127 @@
+#include "CollapseTrace.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+static const char trace_magic[8] = {'Q', 'M', 'A', 'T', 'T', 'R', 'C', '1'};
+
+void CollapseTrace::Add(unsigned v1, unsigned v2, unsigned vid, const double center[3], double radius, double cost)
+{
+	CollapseRecord rec;
+	rec.v1 = v1;
+	rec.v2 = v2;
+	rec.vid = vid;
+	rec.center[0] = center[0];
+	rec.center[1] = center[1];
+	rec.center[2] = center[2];
+	rec.radius = radius;
+	rec.cost = cost;
+	records.push_back(rec);
+}
+
+static bool SameRecord(const CollapseRecord & r1, const CollapseRecord & r2)
+{
+	return r1.v1 == r2.v1 && r1.v2 == r2.v2 && r1.vid == r2.vid
+		&& memcmp(r1.center, r2.center, 3 * sizeof(double)) == 0
+		&& memcmp(&r1.radius, &r2.radius, sizeof(double)) == 0
+		&& memcmp(&r1.cost, &r2.cost, sizeof(double)) == 0;
+}
+
+long long CollapseTrace::FirstDifference(const CollapseTrace & other) const
+{
+	size_t n = std::min(records.size(), other.records.size());
+	for(size_t i = 0; i < n; i ++)
+		if(!SameRecord(records[i], other.records[i]))
+			return (long long)i;
+	if(records.size() != other.records.size())
+		return (long long)n;
+	return -1;
+}
+
+// fields are written one by one, the file does not depend on struct padding
+bool CollapseTrace::Save(const std::string & filename, std::string & error) const
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if(!out)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	unsigned count = (unsigned)records.size();
+	out.write(trace_magic, 8);
+	out.write((const char *)&flags, sizeof(unsigned));
+	out.write((const char *)&count, sizeof(unsigned));
+	for(unsigned i = 0; i < count; i ++)
+	{
+		const CollapseRecord & rec = records[i];
+		out.write((const char *)&rec.v1, sizeof(unsigned));
+		out.write((const char *)&rec.v2, sizeof(unsigned));
+		out.write((const char *)&rec.vid, sizeof(unsigned));
+		out.write((const char *)rec.center, 3 * sizeof(double));
+		out.write((const char *)&rec.radius, sizeof(double));
+		out.write((const char *)&rec.cost, sizeof(double));
+	}
+
+	if(!out)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool CollapseTrace::Load(const std::string & filename, std::string & error)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if(!in)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	clear();
+
+	char magic[8];
+	unsigned count(0);
+	in.read(magic, 8);
+	in.read((char *)&flags, sizeof(unsigned));
+	in.read((char *)&count, sizeof(unsigned));
+	if(!in || memcmp(magic, trace_magic, 8) != 0)
+	{
+		error = "Not a collapse trace: " + filename;
+		return false;
+	}
+
+	// the count is checked against the file size before anything is allocated
+	const std::streamoff record_size = 3 * sizeof(unsigned) + 5 * sizeof(double);
+	std::streamoff start = in.tellg();
+	in.seekg(0, std::ios::end);
+	std::streamoff remaining = in.tellg() - start;
+	in.seekg(start);
+	if(!in || remaining < (std::streamoff)count * record_size)
+	{
+		error = "Truncated collapse trace: " + filename;
+		return false;
+	}
+
+	records.resize(count);
+	for(unsigned i = 0; i < count; i ++)
+	{
+		CollapseRecord & rec = records[i];
+		in.read((char *)&rec.v1, sizeof(unsigned));
+		in.read((char *)&rec.v2, sizeof(unsigned));
+		in.read((char *)&rec.vid, sizeof(unsigned));
+		in.read((char *)rec.center, 3 * sizeof(double));
+		in.read((char *)&rec.radius, sizeof(double));
+		in.read((char *)&rec.cost, sizeof(double));
+		if(!in)
+		{
+			error = "Truncated collapse trace: " + filename;
+			records.resize(i);
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,46 @@
+#ifndef _COLLAPSETRACE_H
+#define _COLLAPSETRACE_H
+
+#include <string>
+#include <vector>
+
+// one edge collapse of SlabMesh::Simplify
+// v1, v2 are the merged vertices, vid the vertex created by the merge
+class CollapseRecord
+{
+public:
+	unsigned v1;
+	unsigned v2;
+	unsigned vid;
+	double center[3];
+	double radius;
+	double cost;
+};
+
+// in-memory collapse sequence with a binary file format:
+//   8 bytes  magic "QMATTRC1"
+//   uint32   flags (bit 0: the mesh was spatially reordered after loading)
+//   uint32   number of records
+//   records  3 x uint32, 5 x double, native byte order
+class CollapseTrace
+{
+public:
+	enum { SPATIAL_ORDER = 1 };
+
+	unsigned flags;
+	std::vector<CollapseRecord> records;
+
+public:
+	CollapseTrace() : flags(0) {}
+
+	void clear() { flags = 0; records.clear(); }
+	void Add(unsigned v1, unsigned v2, unsigned vid, const double center[3], double radius, double cost);
+
+	// index of the first record that differs bit for bit, -1 if the traces are identical
+	long long FirstDifference(const CollapseTrace & other) const;
+
+	bool Save(const std::string & filename, std::string & error) const;
+	bool Load(const std::string & filename, std::string & error);
+};
+
+#endif // _COLLAPSETRACE_H
@@ -0,0 +1,607 @@
+#include "CollisionProxy.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <algorithm>
+
+static const char proxy_magic[8] = {'Q', 'M', 'A', 'T', 'C', 'V', 'X', '1'};
+
+// a prism lists its top triangle, then the bottom one, split into the two caps
+// and two triangles per side
+static const unsigned prism_points = 6;
+static const int prism_triangles[8][3] = {{0, 1, 2}, {3, 4, 5}, {0, 1, 4}, {0, 4, 3}, {1, 2, 5}, {1, 5, 4}, {2, 0, 3}, {2, 3, 5}};
+
+void CollisionProxy::clear()
+{
+	points.clear();
+	pieces.clear();
+	indices.clear();
+	spheres_in_cones = 0;
+	slabs_degenerate = 0;
+	points_merged = 0;
+}
+
+template <class T>
+static void WriteValue(std::ofstream & out, const T & v)
+{
+	out.write((const char *)&v, sizeof(T));
+}
+
+template <class T>
+static void ReadValue(std::ifstream & in, T & v)
+{
+	in.read((char *)&v, sizeof(T));
+}
+
+static float RoundUp(double v)
+{
+	float f = (float)v;
+	if(f < v)
+		f = nextafterf(f, HUGE_VALF);
+	return f;
+}
+
+static float RoundDown(double v)
+{
+	float f = (float)v;
+	if(f > v)
+		f = nextafterf(f, -HUGE_VALF);
+	return f;
+}
+
+// distance to a triangle, a degenerate one is measured by its edges
+static double TriangleDistance(const Vector3d & p, const Vector3d & a, const Vector3d & b, const Vector3d & c)
+{
+	Vector3d fp;
+	double dist;
+	double area2 = (b - a).Cross(c - a).SquaredLength();
+	double scale = std::max((b - a).SquaredLength(), std::max((c - b).SquaredLength(), (a - c).SquaredLength()));
+	if(area2 > 1e-20 * scale * scale)
+	{
+		ProjectOntoTriangle(p, a, b, c, fp, dist);
+		return dist;
+	}
+	double d0, d1, d2;
+	ProjectOntoLineSegment(p, a, b, fp, d0);
+	ProjectOntoLineSegment(p, b, c, fp, d1);
+	ProjectOntoLineSegment(p, c, a, fp, d2);
+	return std::min(d0, std::min(d1, d2));
+}
+
+// signed distance to the convex hull of the six prism points
+static double PrismDistance(const Vector3d v[6], const Vector3d & p)
+{
+	Vector3d inside(0., 0., 0.);
+	for(int k = 0; k < 6; k ++)
+		inside += v[k];
+	inside /= 6.;
+
+	double dist = 1e300;
+	bool outside = false;
+	for(int t = 0; t < 8; t ++)
+	{
+		const Vector3d & a = v[prism_triangles[t][0]];
+		const Vector3d & b = v[prism_triangles[t][1]];
+		const Vector3d & c = v[prism_triangles[t][2]];
+		Vector3d n = (b - a).Cross(c - a);
+		if(n.Dot(inside - a) > 0.)
+			n = -n;
+		if(n.Dot(p - a) > 0.)
+			outside = true;
+		dist = std::min(dist, TriangleDistance(p, a, b, c));
+	}
+	return outside ? dist : -dist;
+}
+
+double CollisionProxy::PieceDistance(unsigned piece, const Vector3d & p) const
+{
+	const CollisionPiece & pc = pieces[piece];
+	Vector3d v[prism_points];
+	double r[prism_points];
+	for(unsigned k = 0; k < pc.count && k < prism_points; k ++)
+	{
+		const float * q = &points[4 * indices[pc.first + k]];
+		v[k] = Vector3d(q[0], q[1], q[2]);
+		r[k] = q[3];
+	}
+	if(pc.type == CollisionPiece::SPHERE)
+		return (p - v[0]).Length() - r[0];
+	if(pc.type == CollisionPiece::CONE)
+		return ConeDistance(p, v[0], r[0], v[1], r[1]);
+	return PrismDistance(v, p);
+}
+
+class CollisionPointKey
+{
+public:
+	float p[4];
+	bool operator<(const CollisionPointKey & k) const
+	{
+		for(int d = 0; d < 4; d ++)
+			if(p[d] != k.p[d])
+				return p[d] < k.p[d];
+		return false;
+	}
+};
+
+// support points of one element before merging
+class CollisionCandidate
+{
+public:
+	unsigned type;
+	unsigned count;
+	unsigned vertices[3];
+	double points[4 * prism_points];
+};
+
+void BuildCollisionProxy(const MedialMeshData & ma, CollisionProxy & proxy)
+{
+	proxy.clear();
+	unsigned nv = ma.NumVertices();
+	std::vector<unsigned> edges;
+	MedialConeEdges(ma, edges);
+	unsigned ne = (unsigned)edges.size() / 2;
+	unsigned nf = ma.NumFaces();
+
+	// a cone contains both of its spheres, a sphere without volume adds nothing
+	std::vector<char> in_cone(nv, 0);
+	for(size_t i = 0; i < edges.size(); i ++)
+		in_cone[edges[i]] = 1;
+	std::vector<unsigned> sphere_ids;
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		if(in_cone[i])
+			proxy.spheres_in_cones ++;
+		else if(ma.spheres[4 * i + 3] > 0.)
+			sphere_ids.push_back(i);
+	}
+	unsigned ns = (unsigned)sphere_ids.size();
+
+	// spheres, then cones, then slabs
+	int num_elements = (int)(ns + ne + nf);
+	std::vector<CollisionCandidate> candidates(num_elements);
+
+#pragma omp parallel for schedule(dynamic, 256)
+	for(int e = 0; e < num_elements; e ++)
+	{
+		CollisionCandidate & cand = candidates[e];
+		cand.vertices[0] = cand.vertices[1] = cand.vertices[2] = collision_no_vertex;
+		if((unsigned)e < ns)
+		{
+			cand.type = CollisionPiece::SPHERE;
+			cand.count = 1;
+			cand.vertices[0] = sphere_ids[e];
+		}
+		else if((unsigned)e < ns + ne)
+		{
+			cand.type = CollisionPiece::CONE;
+			cand.count = 2;
+			cand.vertices[0] = edges[2 * (e - ns)];
+			cand.vertices[1] = edges[2 * (e - ns) + 1];
+		}
+		else
+		{
+			cand.type = CollisionPiece::PRISM;
+			cand.count = 0;
+			Vector3d c[3];
+			double r[3];
+			for(int k = 0; k < 3; k ++)
+			{
+				cand.vertices[k] = ma.faces[3 * (e - ns - ne) + k];
+				const double * s = &ma.spheres[4 * cand.vertices[k]];
+				c[k] = Vector3d(s[0], s[1], s[2]);
+				r[k] = s[3];
+			}
+			// without tangent planes the slab is covered by its cones
+			SimpleTriangle st[2];
+			if(!TriangleFromThreeSpheres(c[0], r[0], c[1], r[1], c[2], r[2], st[0], st[1]))
+				continue;
+			if(st[0].normal == Vector3d(0., 0., 0.) || st[1].normal == Vector3d(0., 0., 0.))
+				continue;
+			for(int s = 0; s < 2; s ++)
+				for(int k = 0; k < 3; k ++)
+				{
+					double * q = &cand.points[4 * (3 * s + k)];
+					q[0] = st[s].v[k][0];
+					q[1] = st[s].v[k][1];
+					q[2] = st[s].v[k][2];
+					q[3] = 0.;
+				}
+			cand.count = prism_points;
+			continue;
+		}
+		for(unsigned k = 0; k < cand.count; k ++)
+			for(int d = 0; d < 4; d ++)
+				cand.points[4 * k + d] = ma.spheres[4 * cand.vertices[k] + d];
+	}
+
+	// merge in element order, the ids do not depend on the schedule
+	std::map<CollisionPointKey, unsigned> point_ids;
+	for(int e = 0; e < num_elements; e ++)
+	{
+		const CollisionCandidate & cand = candidates[e];
+		if(cand.count == 0)
+		{
+			proxy.slabs_degenerate ++;
+			continue;
+		}
+		CollisionPiece piece;
+		piece.type = cand.type;
+		piece.first = (unsigned)proxy.indices.size();
+		piece.count = cand.count;
+		for(int k = 0; k < 3; k ++)
+			piece.vertices[k] = cand.vertices[k];
+		for(unsigned k = 0; k < cand.count; k ++)
+		{
+			CollisionPointKey key;
+			for(int d = 0; d < 4; d ++)
+				key.p[d] = (float)cand.points[4 * k + d];
+			std::map<CollisionPointKey, unsigned>::iterator pi = point_ids.find(key);
+			if(pi == point_ids.end())
+			{
+				pi = point_ids.insert(std::make_pair(key, proxy.NumPoints())).first;
+				proxy.points.insert(proxy.points.end(), key.p, key.p + 4);
+			}
+			else
+				proxy.points_merged ++;
+			proxy.indices.push_back(pi->second);
+		}
+		proxy.pieces.push_back(piece);
+	}
+
+	// bounding volumes of the stored float points
+	int np = (int)proxy.pieces.size();
+#pragma omp parallel for schedule(static)
+	for(int i = 0; i < np; i ++)
+	{
+		CollisionPiece & piece = proxy.pieces[i];
+		double mn[3] = {1e300, 1e300, 1e300}, mx[3] = {-1e300, -1e300, -1e300};
+		for(unsigned k = 0; k < piece.count; k ++)
+		{
+			const float * q = &proxy.points[4 * proxy.indices[piece.first + k]];
+			for(int d = 0; d < 3; d ++)
+			{
+				mn[d] = std::min(mn[d], (double)q[d] - q[3]);
+				mx[d] = std::max(mx[d], (double)q[d] + q[3]);
+			}
+		}
+		for(int d = 0; d < 3; d ++)
+		{
+			piece.box_min[d] = RoundDown(mn[d]);
+			piece.box_max[d] = RoundUp(mx[d]);
+			piece.sphere[d] = (float)(0.5 * (mn[d] + mx[d]));
+		}
+		double radius = 0.;
+		for(unsigned k = 0; k < piece.count; k ++)
+		{
+			const float * q = &proxy.points[4 * proxy.indices[piece.first + k]];
+			Vector3d dq((double)q[0] - piece.sphere[0], (double)q[1] - piece.sphere[1], (double)q[2] - piece.sphere[2]);
+			radius = std::max(radius, dq.Length() + q[3]);
+		}
+		piece.sphere[3] = RoundUp(radius);
+	}
+}
+
+// fields are written one by one, the file does not depend on struct padding
+bool CollisionProxy::Save(const std::string & filename, std::string & error) const
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if(!out)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	unsigned np = NumPoints();
+	unsigned npieces = NumPieces();
+	unsigned nindices = (unsigned)indices.size();
+	out.write(proxy_magic, 8);
+	WriteValue(out, np);
+	WriteValue(out, npieces);
+	WriteValue(out, nindices);
+	if(np > 0)
+		out.write((const char *)&points[0], points.size() * sizeof(float));
+	for(unsigned i = 0; i < npieces; i ++)
+	{
+		const CollisionPiece & piece = pieces[i];
+		WriteValue(out, piece.type);
+		WriteValue(out, piece.first);
+		WriteValue(out, piece.count);
+		out.write((const char *)piece.vertices, 3 * sizeof(unsigned));
+		out.write((const char *)piece.box_min, 3 * sizeof(float));
+		out.write((const char *)piece.box_max, 3 * sizeof(float));
+		out.write((const char *)piece.sphere, 4 * sizeof(float));
+	}
+	if(nindices > 0)
+		out.write((const char *)&indices[0], nindices * sizeof(unsigned));
+
+	if(!out)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool CollisionProxy::Load(const std::string & filename, std::string & error)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if(!in)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	clear();
+
+	char magic[8];
+	unsigned np(0), npieces(0), nindices(0);
+	in.read(magic, 8);
+	ReadValue(in, np);
+	ReadValue(in, npieces);
+	ReadValue(in, nindices);
+	if(!in || memcmp(magic, proxy_magic, 8) != 0)
+	{
+		error = "Not a collision proxy: " + filename;
+		return false;
+	}
+
+	points.resize(4 * (size_t)np);
+	if(np > 0)
+		in.read((char *)&points[0], points.size() * sizeof(float));
+	pieces.resize(npieces);
+	for(unsigned i = 0; i < npieces && in; i ++)
+	{
+		CollisionPiece & piece = pieces[i];
+		ReadValue(in, piece.type);
+		ReadValue(in, piece.first);
+		ReadValue(in, piece.count);
+		in.read((char *)piece.vertices, 3 * sizeof(unsigned));
+		in.read((char *)piece.box_min, 3 * sizeof(float));
+		in.read((char *)piece.box_max, 3 * sizeof(float));
+		in.read((char *)piece.sphere, 4 * sizeof(float));
+	}
+	indices.resize(nindices);
+	if(nindices > 0 && in)
+		in.read((char *)&indices[0], nindices * sizeof(unsigned));
+	if(!in)
+	{
+		error = "Truncated collision proxy: " + filename;
+		clear();
+		return false;
+	}
+
+	static const unsigned piece_points[3] = {1, 2, prism_points};
+	for(unsigned i = 0; i < npieces; i ++)
+	{
+		const CollisionPiece & piece = pieces[i];
+		bool valid = piece.type <= CollisionPiece::PRISM && piece.count == piece_points[piece.type]
+			&& piece.first <= nindices && piece.count <= nindices - piece.first;
+		for(unsigned k = 0; k < piece.count && valid; k ++)
+			valid = indices[piece.first + k] < np;
+		if(!valid)
+		{
+			error = "Invalid piece in collision proxy " + filename;
+			clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+static unsigned GridCoordinate(double offset, double cell, unsigned size)
+{
+	return (unsigned)std::min(size - 1., std::max(0., offset / cell));
+}
+
+bool CheckProxyContainment(const MedialMeshData & ma, const CollisionProxy & proxy, const EnvelopeMesh & envelope,
+						   double tolerance, ProxyContainment & result)
+{
+	result = ProxyContainment();
+	int npieces = (int)proxy.NumPieces();
+
+	// pieces inside their element: the balls of the support points, and for a
+	// prism also its center
+	std::vector<double> piece_excess(npieces, 0.);
+	std::vector<unsigned> piece_outside(npieces, 0), piece_checked(npieces, 0);
+#pragma omp parallel for schedule(dynamic, 256)
+	for(int i = 0; i < npieces; i ++)
+	{
+		const CollisionPiece & piece = proxy.pieces[i];
+		Vector3d c[3];
+		double r[3];
+		for(unsigned k = 0; k < 3; k ++)
+		{
+			if(piece.vertices[k] == collision_no_vertex)
+				continue;
+			const double * s = &ma.spheres[4 * piece.vertices[k]];
+			c[k] = Vector3d(s[0], s[1], s[2]);
+			r[k] = s[3];
+		}
+
+		Vector3d center(0., 0., 0.);
+		for(unsigned k = 0; k <= piece.count; k ++)
+		{
+			if(k == piece.count && piece.type != CollisionPiece::PRISM)
+				break;
+			Vector3d p;
+			double pr = 0.;
+			if(k < piece.count)
+			{
+				const float * q = &proxy.points[4 * proxy.indices[piece.first + k]];
+				p = Vector3d(q[0], q[1], q[2]);
+				pr = q[3];
+				center += p / (double)piece.count;
+			}
+			else
+				p = center;
+
+			double d;
+			if(piece.type == CollisionPiece::SPHERE)
+				d = (p - c[0]).Length() - r[0];
+			else if(piece.type == CollisionPiece::CONE)
+				d = ConeDistance(p, c[0], r[0], c[1], r[1]);
+			else
+				d = SlabDistance(p, c, r);
+			d += pr;
+			piece_checked[i] ++;
+			if(d > tolerance)
+				piece_outside[i] ++;
+			piece_excess[i] = std::max(piece_excess[i], d);
+		}
+	}
+	for(int i = 0; i < npieces; i ++)
+	{
+		result.points_checked += piece_checked[i];
+		result.points_outside += piece_outside[i];
+		result.max_outside = std::max(result.max_outside, piece_excess[i]);
+	}
+
+	// envelope vertices inside a piece, the candidates come from a grid of the piece boxes
+	unsigned ns = envelope.NumVertices();
+	if(npieces == 0 || ns == 0)
+	{
+		result.samples_checked = ns;
+		result.samples_uncovered = ns;
+		return ns == 0 && result.points_outside == 0;
+	}
+
+	double mn[3], mx[3], mean_extent = 0.;
+	for(int d = 0; d < 3; d ++)
+	{
+		mn[d] = 1e300;
+		mx[d] = -1e300;
+	}
+	for(int i = 0; i < npieces; i ++)
+	{
+		const CollisionPiece & piece = proxy.pieces[i];
+		for(int d = 0; d < 3; d ++)
+		{
+			mn[d] = std::min(mn[d], (double)piece.box_min[d]);
+			mx[d] = std::max(mx[d], (double)piece.box_max[d]);
+			mean_extent += (piece.box_max[d] - piece.box_min[d]) / (3. * npieces);
+		}
+	}
+	double cell = std::max(mean_extent, std::max(mx[0] - mn[0], std::max(mx[1] - mn[1], mx[2] - mn[2])) / 64.);
+	if(!(cell > 0.))
+		cell = 1.;
+	unsigned grid[3];
+	for(int d = 0; d < 3; d ++)
+		grid[d] = std::max(1u, std::min(64u, (unsigned)ceil((mx[d] - mn[d]) / cell)));
+
+	// (cell, piece) pairs sorted by cell
+	std::vector<unsigned long long> cell_pieces;
+	for(int i = 0; i < npieces; i ++)
+	{
+		const CollisionPiece & piece = proxy.pieces[i];
+		unsigned lo[3], hi[3];
+		for(int d = 0; d < 3; d ++)
+		{
+			lo[d] = GridCoordinate(piece.box_min[d] - tolerance - mn[d], cell, grid[d]);
+			hi[d] = GridCoordinate(piece.box_max[d] + tolerance - mn[d], cell, grid[d]);
+		}
+		for(unsigned z = lo[2]; z <= hi[2]; z ++)
+			for(unsigned y = lo[1]; y <= hi[1]; y ++)
+				for(unsigned x = lo[0]; x <= hi[0]; x ++)
+					cell_pieces.push_back((unsigned long long)((z * grid[1] + y) * grid[0] + x) << 32 | (unsigned)i);
+	}
+	std::sort(cell_pieces.begin(), cell_pieces.end());
+
+	std::vector<double> sample_dist(ns);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(int s = 0; s < (int)ns; s ++)
+	{
+		Vector3d p(envelope.vertices[3 * s], envelope.vertices[3 * s + 1], envelope.vertices[3 * s + 2]);
+		unsigned c[3];
+		for(int d = 0; d < 3; d ++)
+			c[d] = GridCoordinate(p[d] - mn[d], cell, grid[d]);
+		unsigned long long key = (unsigned long long)((c[2] * grid[1] + c[1]) * grid[0] + c[0]);
+		std::vector<unsigned long long>::const_iterator it = std::lower_bound(cell_pieces.begin(), cell_pieces.end(), key << 32);
+		double dist = 1e300;
+		for(; it != cell_pieces.end() && (*it >> 32) == key && dist > tolerance; it ++)
+		{
+			const CollisionPiece & piece = proxy.pieces[(unsigned)(*it & 0xffffffffULL)];
+			bool in_box = true;
+			for(int d = 0; d < 3 && in_box; d ++)
+				in_box = p[d] >= piece.box_min[d] - tolerance && p[d] <= piece.box_max[d] + tolerance;
+			if(in_box)
+				dist = std::min(dist, proxy.PieceDistance((unsigned)(*it & 0xffffffffULL), p));
+		}
+		// the exact distance of an uncovered vertex
+		for(int i = 0; i < npieces && dist > tolerance; i ++)
+			dist = std::min(dist, proxy.PieceDistance(i, p));
+		sample_dist[s] = dist;
+	}
+
+	result.samples_checked = ns;
+	for(unsigned s = 0; s < ns; s ++)
+		if(sample_dist[s] > tolerance)
+		{
+			result.samples_uncovered ++;
+			result.max_uncovered = std::max(result.max_uncovered, sample_dist[s]);
+		}
+	return result.points_outside == 0 && result.samples_uncovered == 0;
+}
+
+void CapsuleSkeleton::clear()
+{
+	joints.clear();
+	capsules.clear();
+	degrees.clear();
+	slabs_dropped = 0;
+}
+
+void BuildCapsuleSkeleton(const MedialMeshData & ma, CapsuleSkeleton & skeleton)
+{
+	skeleton.clear();
+	unsigned nv = ma.NumVertices();
+	std::vector<unsigned> edges;
+	MedialConeEdges(ma, edges);
+	skeleton.slabs_dropped = ma.NumFaces();
+
+	// joints in vertex order, a sphere without volume and capsule adds nothing
+	std::vector<unsigned> degree(nv, 0);
+	for(size_t i = 0; i < edges.size(); i ++)
+		degree[edges[i]] ++;
+	std::vector<unsigned> joint(nv, collision_no_vertex);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		if(degree[i] == 0 && !(ma.spheres[4 * i + 3] > 0.))
+			continue;
+		joint[i] = skeleton.NumJoints();
+		skeleton.joints.insert(skeleton.joints.end(), &ma.spheres[4 * i], &ma.spheres[4 * i] + 4);
+		skeleton.degrees.push_back(degree[i]);
+	}
+	skeleton.capsules.resize(edges.size());
+	for(size_t i = 0; i < edges.size(); i ++)
+		skeleton.capsules[i] = joint[edges[i]];
+}
+
+bool CapsuleSkeleton::Save(const std::string & filename, std::string & error) const
+{
+	std::ofstream fout(filename.c_str());
+	if(!fout)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	fout << NumJoints() << " " << NumCapsules() << std::endl;
+	for(unsigned i = 0; i < NumJoints(); i ++)
+		fout << "j " << std::setiosflags(std::ios::fixed) << std::setprecision(15) << joints[4 * i] << " "
+			<< joints[4 * i + 1] << " " << joints[4 * i + 2] << " " << joints[4 * i + 3] << " " << degrees[i] << std::endl;
+	for(unsigned i = 0; i < NumCapsules(); i ++)
+		fout << "c " << capsules[2 * i] << " " << capsules[2 * i + 1] << " "
+			<< joints[4 * capsules[2 * i] + 3] << " " << joints[4 * capsules[2 * i + 1] + 3] << std::endl;
+
+	if(!fout)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
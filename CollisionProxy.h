@@ -0,0 +1,121 @@
+#ifndef _COLLISIONPROXY_H
+#define _COLLISIONPROXY_H
+
+#include <string>
+#include <vector>
+#include "MedialChunks.h"
+#include "EnvelopeExport.h"
+
+// One convex piece, the convex hull of its support points. A support point
+// carries a radius, so a piece is the hull of a few spheres: a sphere, a cone
+// (two spheres) or the prism between the two tangent triangles of a slab (six
+// points of radius zero). vertices are the medial vertices it was built from.
+class CollisionPiece
+{
+public:
+	enum Type { SPHERE = 0, CONE = 1, PRISM = 2 };
+
+	unsigned type;
+	unsigned first;		// into CollisionProxy::indices
+	unsigned count;
+	unsigned vertices[3];	// unused ones are collision_no_vertex
+	float box_min[3];
+	float box_max[3];
+	float sphere[4];	// bounding sphere, center and radius
+};
+
+const unsigned collision_no_vertex = 0xffffffffu;
+
+// Convex collision proxy of a medial mesh (.qcp)
+// Spheres, edge cones and slab prisms are convex, their union is the envelope.
+// A sphere gets its own piece only when no cone contains it, every slab border
+// gets a cone. Support points that round to the same float are stored once.
+//
+// layout, native byte order, 4 byte aligned:
+//   header   magic "QMATCVX1", point/piece/index counts
+//   points   x, y, z, r as float
+//   pieces   type, first index, index count, three medial vertex ids,
+//            bounding box and bounding sphere (float, rounded outwards)
+//   indices  support points of the pieces, unsigned
+class CollisionProxy
+{
+public:
+	std::vector<float> points;
+	std::vector<CollisionPiece> pieces;
+	std::vector<unsigned> indices;
+
+	// statistics of the last BuildCollisionProxy
+	unsigned spheres_in_cones;
+	unsigned slabs_degenerate;
+	unsigned points_merged;
+
+public:
+	CollisionProxy() : spheres_in_cones(0), slabs_degenerate(0), points_merged(0) {}
+
+	unsigned NumPoints() const { return (unsigned)points.size() / 4; }
+	unsigned NumPieces() const { return (unsigned)pieces.size(); }
+	void clear();
+
+	// signed distance of p to a piece, negative inside
+	double PieceDistance(unsigned piece, const Wm4::Vector3d & p) const;
+
+	bool Save(const std::string & filename, std::string & error) const;
+	bool Load(const std::string & filename, std::string & error);
+};
+
+// Builds the pieces and their bounding volumes in parallel, the result does not
+// depend on the number of threads.
+void BuildCollisionProxy(const MedialMeshData & ma, CollisionProxy & proxy);
+
+// result of CheckProxyContainment, distances are the largest violations
+class ProxyContainment
+{
+public:
+	unsigned long long points_checked;	// support points and prism centers against their medial element
+	unsigned long long points_outside;
+	double max_outside;
+	unsigned long long samples_checked;	// envelope vertices against the pieces
+	unsigned long long samples_uncovered;
+	double max_uncovered;
+
+public:
+	ProxyContainment() : points_checked(0), points_outside(0), max_outside(0.),
+		samples_checked(0), samples_uncovered(0), max_uncovered(0.) {}
+};
+
+// Tests the proxy against the envelope in both directions: every piece must lie
+// inside the medial element it was built from and every envelope vertex must lie
+// inside a piece, both up to tolerance. True when nothing exceeds it.
+bool CheckProxyContainment(const MedialMeshData & ma, const CollisionProxy & proxy, const EnvelopeMesh & envelope,
+						   double tolerance, ProxyContainment & result);
+
+// Capsule skeleton of a medial mesh, for consumers of spheres and capsules only.
+// The joints are the spheres, a capsule is a cone given by its two joints and
+// their radii, joints shared by capsules are stored once. Slabs are dropped,
+// their borders are capsules. Joints without a capsule stay as spheres.
+//
+// text layout:
+//   <joints> <capsules>
+//   j x y z r degree     degree is the number of capsules at the joint
+//   c j0 j1 r0 r1
+class CapsuleSkeleton
+{
+public:
+	std::vector<double> joints;
+	std::vector<unsigned> capsules;
+	std::vector<unsigned> degrees;
+	unsigned slabs_dropped;
+
+public:
+	CapsuleSkeleton() : slabs_dropped(0) {}
+
+	unsigned NumJoints() const { return (unsigned)joints.size() / 4; }
+	unsigned NumCapsules() const { return (unsigned)capsules.size() / 2; }
+	void clear();
+
+	bool Save(const std::string & filename, std::string & error) const;
+};
+
+void BuildCapsuleSkeleton(const MedialMeshData & ma, CapsuleSkeleton & skeleton);
+
+#endif // _COLLISIONPROXY_H
@@ -0,0 +1,561 @@
+#include "Congruence.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <Eigen/Dense>
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+// bins of the distance histogram of a component
+static const int congruence_bins = 32;
+// relative gap below which two principal moments count as equal
+static const double congruence_moment_gap = 1e-6;
+static const unsigned congruence_none = 0xffffffffu;
+
+void ComponentInstance::Apply(const double p[3], double q[3]) const
+{
+	for(int r = 0; r < 3; r ++)
+		q[r] = rotation[3 * r] * p[0] + rotation[3 * r + 1] * p[1] + rotation[3 * r + 2] * p[2] + translation[r];
+}
+
+void CongruenceClasses::clear()
+{
+	vertex_component.clear();
+	component_faces.clear();
+	component_offset.clear();
+	representative.clear();
+	class_hash.clear();
+	instances.clear();
+}
+
+bool CongruenceClasses::Save(const std::string & filename, const std::vector<unsigned> & first_vertex, std::string & error) const
+{
+	std::ofstream fout(filename.c_str());
+	if(!fout)
+	{
+		error = "cannot open " + filename;
+		return false;
+	}
+	fout << NumClasses() << " " << NumComponents() << "\n";
+	for(unsigned c = 0; c < NumClasses(); c ++)
+		fout << "class " << c << " " << std::hex << std::setw(16) << std::setfill('0') << class_hash[c]
+			 << std::dec << std::setfill(' ') << " " << representative[c] << "\n";
+	fout << std::setprecision(17);
+	for(unsigned i = 0; i < NumComponents(); i ++)
+	{
+		const ComponentInstance & inst = instances[i];
+		fout << "copy " << inst.cls << " " << inst.component << " " << first_vertex[i];
+		for(int k = 0; k < 9; k ++)
+			fout << " " << inst.rotation[k];
+		for(int k = 0; k < 3; k ++)
+			fout << " " << inst.translation[k];
+		fout << "\n";
+	}
+	fout.close();
+	if(!fout)
+	{
+		error = "cannot write " + filename;
+		return false;
+	}
+	return true;
+}
+
+static unsigned FindRoot(std::vector<unsigned> & parent, unsigned i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+// one component in local vertex numbering
+class ComponentShape
+{
+public:
+	std::vector<unsigned> vertices;		// global ids, sorted
+	std::vector<unsigned> degrees;
+	std::vector<unsigned> corners;		// local ids, faces in mesh order
+	Vector3d centroid;
+	Matrix3d frame;						// principal axes in the columns, proper
+	bool frame_unique;
+	unsigned long long hash;
+};
+
+static void BuildShape(const IndexedMesh & mesh, const CongruenceClasses & classes, unsigned c, ComponentShape & shape)
+{
+	std::vector<unsigned> faces(classes.component_faces.begin() + classes.component_offset[c],
+								classes.component_faces.begin() + classes.component_offset[c + 1]);
+	for(size_t i = 0; i < faces.size(); i ++)
+		for(unsigned k = mesh.face_offset[faces[i]]; k < mesh.face_offset[faces[i] + 1]; k ++)
+			shape.vertices.push_back(mesh.face_index[k]);
+	std::sort(shape.vertices.begin(), shape.vertices.end());
+	shape.vertices.erase(std::unique(shape.vertices.begin(), shape.vertices.end()), shape.vertices.end());
+	for(size_t i = 0; i < faces.size(); i ++)
+	{
+		shape.degrees.push_back(mesh.FaceDegree(faces[i]));
+		for(unsigned k = mesh.face_offset[faces[i]]; k < mesh.face_offset[faces[i] + 1]; k ++)
+			shape.corners.push_back((unsigned)(std::lower_bound(shape.vertices.begin(), shape.vertices.end(), mesh.face_index[k]) - shape.vertices.begin()));
+	}
+
+	double area;
+	Matrix3d covariance, diag;
+	mesh.SurfaceMoments(faces, area, shape.centroid, covariance);
+	covariance.EigenDecomposition(shape.frame, diag);
+	if(shape.frame.Determinant() < 0.)
+		for(int r = 0; r < 3; r ++)
+			shape.frame[r][2] = -shape.frame[r][2];
+	double scale = std::max(fabs(diag[2][2]), 1e-300);
+	shape.frame_unique = diag[1][1] - diag[0][0] > congruence_moment_gap * scale && diag[2][2] - diag[1][1] > congruence_moment_gap * scale;
+
+	// FNV-1a over the counts and the distance histogram
+	std::vector<double> dist(shape.vertices.size());
+	double dmax = 0.;
+	for(size_t i = 0; i < shape.vertices.size(); i ++)
+	{
+		dist[i] = (mesh.Position(shape.vertices[i]) - shape.centroid).Length();
+		dmax = std::max(dmax, dist[i]);
+	}
+	unsigned hist[congruence_bins] = { 0 };
+	for(size_t i = 0; i < dist.size(); i ++)
+		hist[dmax > 0. ? std::min(congruence_bins - 1, (int)(congruence_bins * dist[i] / dmax)) : 0] ++;
+	unsigned long long h = 1469598103934665603ULL;
+	unsigned words[2] = { (unsigned)shape.vertices.size(), (unsigned)faces.size() };
+	for(int i = 0; i < 2 + congruence_bins; i ++)
+	{
+		h ^= i < 2 ? words[i] : hist[i - 2];
+		h *= 1099511628211ULL;
+	}
+	shape.hash = h;
+}
+
+// least squares rotation of the corresponding vertices of a onto b
+static void FitRotation(const IndexedMesh & mesh, const ComponentShape & a, const ComponentShape & b, ComponentInstance & inst)
+{
+	Eigen::Vector3d ca(0., 0., 0.), cb(0., 0., 0.);
+	for(size_t i = 0; i < a.vertices.size(); i ++)
+	{
+		ca += Eigen::Map<const Eigen::Vector3d>(&mesh.positions[3 * a.vertices[i]]);
+		cb += Eigen::Map<const Eigen::Vector3d>(&mesh.positions[3 * b.vertices[i]]);
+	}
+	ca /= (double)a.vertices.size();
+	cb /= (double)b.vertices.size();
+	Eigen::Matrix3d h = Eigen::Matrix3d::Zero();
+	for(size_t i = 0; i < a.vertices.size(); i ++)
+		h += (Eigen::Map<const Eigen::Vector3d>(&mesh.positions[3 * a.vertices[i]]) - ca)
+			* (Eigen::Map<const Eigen::Vector3d>(&mesh.positions[3 * b.vertices[i]]) - cb).transpose();
+	Eigen::JacobiSVD<Eigen::Matrix3d> svd(h, Eigen::ComputeFullU | Eigen::ComputeFullV);
+	Eigen::Matrix3d d = Eigen::Matrix3d::Identity();
+	d(2, 2) = (svd.matrixV() * svd.matrixU().transpose()).determinant() < 0. ? -1. : 1.;
+	Eigen::Matrix3d r = svd.matrixV() * d * svd.matrixU().transpose();
+	Eigen::Vector3d t = cb - r * ca;
+	for(int i = 0; i < 3; i ++)
+	{
+		for(int j = 0; j < 3; j ++)
+			inst.rotation[3 * i + j] = r(i, j);
+		inst.translation[i] = t[i];
+	}
+}
+
+// exact check of a motion of a onto b, corresponding tells whether the local
+// vertex ids of a and b match
+static bool VerifyMotion(const IndexedMesh & mesh, const ComponentShape & a, const ComponentShape & b,
+						 const ComponentInstance & inst, double tolerance, bool corresponding)
+{
+	size_t n = a.vertices.size();
+	std::vector<unsigned> match(n);
+	if(corresponding)
+	{
+		for(size_t i = 0; i < n; i ++)
+		{
+			double q[3];
+			inst.Apply(&mesh.positions[3 * a.vertices[i]], q);
+			if((Vector3d(q[0], q[1], q[2]) - mesh.Position(b.vertices[i])).Length() > tolerance)
+				return false;
+		}
+		return true;
+	}
+
+	// nearest unused vertex of b in a window of the x sorted vertices
+	std::vector<std::pair<double, unsigned> > sorted(n);
+	for(size_t i = 0; i < n; i ++)
+		sorted[i] = std::make_pair(mesh.positions[3 * b.vertices[i]], (unsigned)i);
+	std::sort(sorted.begin(), sorted.end());
+	std::vector<char> used(n, 0);
+	for(size_t i = 0; i < n; i ++)
+	{
+		double q[3];
+		inst.Apply(&mesh.positions[3 * a.vertices[i]], q);
+		std::vector<std::pair<double, unsigned> >::const_iterator it =
+			std::lower_bound(sorted.begin(), sorted.end(), std::make_pair(q[0] - tolerance, 0u));
+		double best = tolerance;
+		unsigned found = congruence_none;
+		for(; it != sorted.end() && it->first <= q[0] + tolerance; ++ it)
+		{
+			double d = (Vector3d(q[0], q[1], q[2]) - mesh.Position(b.vertices[it->second])).Length();
+			if(!used[it->second] && d <= best)
+			{
+				best = d;
+				found = it->second;
+			}
+		}
+		if(found == congruence_none)
+			return false;
+		used[found] = 1;
+		match[i] = found;
+	}
+
+	// the faces of a map onto the faces of b, compared as vertex sets
+	std::set<std::vector<unsigned> > faces;
+	for(size_t f = 0, k = 0; f < b.degrees.size(); k += b.degrees[f], f ++)
+	{
+		std::vector<unsigned> key(b.corners.begin() + k, b.corners.begin() + k + b.degrees[f]);
+		std::sort(key.begin(), key.end());
+		faces.insert(key);
+	}
+	for(size_t f = 0, k = 0; f < a.degrees.size(); k += a.degrees[f], f ++)
+	{
+		std::vector<unsigned> key;
+		for(unsigned j = 0; j < a.degrees[f]; j ++)
+			key.push_back(match[a.corners[k + j]]);
+		std::sort(key.begin(), key.end());
+		if(faces.find(key) == faces.end())
+			return false;
+	}
+	return true;
+}
+
+static bool MatchShapes(const IndexedMesh & mesh, const ComponentShape & a, const ComponentShape & b,
+						double tolerance, ComponentInstance & inst)
+{
+	if(a.hash != b.hash || a.vertices.size() != b.vertices.size() || a.degrees.size() != b.degrees.size())
+		return false;
+
+	if(a.degrees == b.degrees && a.corners == b.corners)
+	{
+		FitRotation(mesh, a, b, inst);
+		if(VerifyMotion(mesh, a, b, inst, tolerance, true))
+			return true;
+	}
+
+	// b frame * s * a frame^T for the four proper sign choices
+	if(!a.frame_unique || !b.frame_unique)
+		return false;
+	static const double signs[4][3] = { { 1., 1., 1. }, { 1., -1., -1. }, { -1., 1., -1. }, { -1., -1., 1. } };
+	for(int s = 0; s < 4; s ++)
+	{
+		Matrix3d r;
+		for(int i = 0; i < 3; i ++)
+			for(int j = 0; j < 3; j ++)
+			{
+				r[i][j] = 0.;
+				for(int k = 0; k < 3; k ++)
+					r[i][j] += b.frame[i][k] * signs[s][k] * a.frame[j][k];
+			}
+		Vector3d t = b.centroid - r * a.centroid;
+		for(int i = 0; i < 3; i ++)
+		{
+			for(int j = 0; j < 3; j ++)
+				inst.rotation[3 * i + j] = r[i][j];
+			inst.translation[i] = t[i];
+		}
+		if(VerifyMotion(mesh, a, b, inst, tolerance, false))
+			return true;
+	}
+	return false;
+}
+
+void FindCongruentComponents(const IndexedMesh & mesh, double tolerance, CongruenceClasses & classes)
+{
+	classes.clear();
+	unsigned nv = mesh.NumVertices();
+	unsigned nf = mesh.NumFaces();
+
+	std::vector<unsigned> parent(nv);
+	for(unsigned i = 0; i < nv; i ++)
+		parent[i] = i;
+	for(unsigned f = 0; f < nf; f ++)
+		for(unsigned k = mesh.face_offset[f] + 1; k < mesh.face_offset[f + 1]; k ++)
+		{
+			unsigned a = FindRoot(parent, mesh.face_index[mesh.face_offset[f]]);
+			unsigned b = FindRoot(parent, mesh.face_index[k]);
+			if(a != b)
+				parent[std::max(a, b)] = std::min(a, b);
+		}
+
+	// components numbered by their first face, vertices without faces belong to none
+	std::vector<unsigned> root_component(nv, congruence_none);
+	std::vector<unsigned> face_component(nf);
+	unsigned nc = 0;
+	for(unsigned f = 0; f < nf; f ++)
+	{
+		unsigned r = FindRoot(parent, mesh.face_index[mesh.face_offset[f]]);
+		if(root_component[r] == congruence_none)
+			root_component[r] = nc ++;
+		face_component[f] = root_component[r];
+	}
+	classes.vertex_component.assign(nv, congruence_none);
+	for(unsigned f = 0; f < nf; f ++)
+		for(unsigned k = mesh.face_offset[f]; k < mesh.face_offset[f + 1]; k ++)
+			classes.vertex_component[mesh.face_index[k]] = face_component[f];
+	classes.component_offset.assign(nc + 1, 0);
+	for(unsigned f = 0; f < nf; f ++)
+		classes.component_offset[face_component[f] + 1] ++;
+	for(unsigned c = 0; c < nc; c ++)
+		classes.component_offset[c + 1] += classes.component_offset[c];
+	classes.component_faces.resize(nf);
+	std::vector<unsigned> fill(classes.component_offset.begin(), classes.component_offset.end() - 1);
+	for(unsigned f = 0; f < nf; f ++)
+		classes.component_faces[fill[face_component[f]] ++] = f;
+
+	std::vector<ComponentShape> shapes(nc);
+#pragma omp parallel for schedule(dynamic)
+	for(int c = 0; c < (int)nc; c ++)
+		BuildShape(mesh, classes, c, shapes[c]);
+
+	double mn[3] = { 1e300, 1e300, 1e300 }, mx[3] = { -1e300, -1e300, -1e300 };
+	for(unsigned i = 0; i < nv; i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			mn[k] = std::min(mn[k], mesh.positions[3 * i + k]);
+			mx[k] = std::max(mx[k], mesh.positions[3 * i + k]);
+		}
+	double diagonal = nv > 0 ? sqrt((mx[0] - mn[0]) * (mx[0] - mn[0]) + (mx[1] - mn[1]) * (mx[1] - mn[1]) + (mx[2] - mn[2]) * (mx[2] - mn[2])) : 0.;
+
+	std::unordered_map<unsigned long long, std::vector<unsigned> > buckets;
+	classes.instances.resize(nc);
+	for(unsigned c = 0; c < nc; c ++)
+	{
+		ComponentInstance & inst = classes.instances[c];
+		inst.component = c;
+		inst.cls = congruence_none;
+		std::vector<unsigned> & bucket = buckets[shapes[c].hash];
+		for(size_t i = 0; i < bucket.size() && inst.cls == congruence_none; i ++)
+			if(MatchShapes(mesh, shapes[classes.representative[bucket[i]]], shapes[c], tolerance * diagonal, inst))
+				inst.cls = bucket[i];
+		if(inst.cls != congruence_none)
+			continue;
+
+		inst.cls = classes.NumClasses();
+		for(int k = 0; k < 9; k ++)
+			inst.rotation[k] = k % 4 == 0 ? 1. : 0.;
+		inst.translation[0] = inst.translation[1] = inst.translation[2] = 0.;
+		bucket.push_back(inst.cls);
+		classes.representative.push_back(c);
+		classes.class_hash.push_back(shapes[c].hash);
+	}
+}
+
+void ExtractRepresentatives(const IndexedMesh & mesh, const CongruenceClasses & classes,
+							IndexedMesh & reduced, std::vector<unsigned> & vertex_class)
+{
+	reduced.clear();
+	vertex_class.clear();
+	std::vector<unsigned> map(mesh.NumVertices(), congruence_none);
+	std::vector<unsigned> idx;
+	for(unsigned cls = 0; cls < classes.NumClasses(); cls ++)
+	{
+		unsigned c = classes.representative[cls];
+		for(unsigned i = classes.component_offset[c]; i < classes.component_offset[c + 1]; i ++)
+		{
+			unsigned f = classes.component_faces[i];
+			idx.clear();
+			for(unsigned k = mesh.face_offset[f]; k < mesh.face_offset[f + 1]; k ++)
+			{
+				unsigned v = mesh.face_index[k];
+				if(map[v] == congruence_none)
+				{
+					map[v] = reduced.NumVertices();
+					reduced.AddVertex(mesh.positions[3 * v], mesh.positions[3 * v + 1], mesh.positions[3 * v + 2]);
+					vertex_class.push_back(cls);
+				}
+				idx.push_back(map[v]);
+			}
+			reduced.AddFace(&idx[0], (unsigned)idx.size());
+		}
+	}
+}
+
+// nearest vertex search on a uniform grid, rings of cells are searched until
+// the best distance is inside the searched box
+class CongruenceGrid
+{
+public:
+	double origin[3];
+	double cell;
+	int dims[3];
+	std::vector<std::pair<unsigned, unsigned> > entries;	// cell, vertex, sorted
+
+	void Build(const IndexedMesh & mesh)
+	{
+		unsigned n = mesh.NumVertices();
+		double mn[3] = { 1e300, 1e300, 1e300 }, mx[3] = { -1e300, -1e300, -1e300 };
+		for(unsigned i = 0; i < n; i ++)
+			for(int k = 0; k < 3; k ++)
+			{
+				mn[k] = std::min(mn[k], mesh.positions[3 * i + k]);
+				mx[k] = std::max(mx[k], mesh.positions[3 * i + k]);
+			}
+		double extent = std::max(mx[0] - mn[0], std::max(mx[1] - mn[1], mx[2] - mn[2]));
+		cell = std::max(extent / std::max(1., cbrt((double)n)), 1e-300);
+		for(int k = 0; k < 3; k ++)
+		{
+			origin[k] = mn[k];
+			dims[k] = std::min(1024, (int)((mx[k] - mn[k]) / cell) + 1);
+		}
+		entries.resize(n);
+		for(unsigned i = 0; i < n; i ++)
+			entries[i] = std::make_pair(Cell(&mesh.positions[3 * i]), i);
+		std::sort(entries.begin(), entries.end());
+	}
+
+	int Coordinate(double x, int k) const
+	{
+		return std::max(0, std::min(dims[k] - 1, (int)floor((x - origin[k]) / cell)));
+	}
+
+	unsigned Cell(const double p[3]) const
+	{
+		return ((unsigned)Coordinate(p[2], 2) * dims[1] + Coordinate(p[1], 1)) * dims[0] + Coordinate(p[0], 0);
+	}
+
+	unsigned Nearest(const IndexedMesh & mesh, const double p[3]) const
+	{
+		int c[3] = { Coordinate(p[0], 0), Coordinate(p[1], 1), Coordinate(p[2], 2) };
+		int rings = std::max(dims[0], std::max(dims[1], dims[2]));
+		double best = 1e300;
+		unsigned found = congruence_none;
+		for(int r = 0; r <= rings; r ++)
+		{
+			for(int z = c[2] - r; z <= c[2] + r; z ++)
+				for(int y = c[1] - r; y <= c[1] + r; y ++)
+					for(int x = c[0] - r; x <= c[0] + r; x ++)
+					{
+						if(std::max(abs(x - c[0]), std::max(abs(y - c[1]), abs(z - c[2]))) != r)
+							continue;
+						if(x < 0 || y < 0 || z < 0 || x >= dims[0] || y >= dims[1] || z >= dims[2])
+							continue;
+						unsigned cell_id = ((unsigned)z * dims[1] + y) * dims[0] + x;
+						std::vector<std::pair<unsigned, unsigned> >::const_iterator it =
+							std::lower_bound(entries.begin(), entries.end(), std::make_pair(cell_id, 0u));
+						for(; it != entries.end() && it->first == cell_id; ++ it)
+						{
+							const double * q = &mesh.positions[3 * it->second];
+							double d = (p[0] - q[0]) * (p[0] - q[0]) + (p[1] - q[1]) * (p[1] - q[1]) + (p[2] - q[2]) * (p[2] - q[2]);
+							if(d < best)
+							{
+								best = d;
+								found = it->second;
+							}
+						}
+					}
+			// every point outside the searched rings is farther than r cells
+			if(found != congruence_none && sqrt(best) <= r * cell)
+				break;
+		}
+		return found;
+	}
+};
+
+void InstanceMedialMesh(const MedialMeshData & ma, const IndexedMesh & reduced, const std::vector<unsigned> & vertex_class,
+						const CongruenceClasses & classes, MedialMeshData & instanced, std::vector<unsigned> & first_vertex)
+{
+	instanced.clear();
+	first_vertex.assign(classes.NumComponents(), 0);
+	unsigned nv = ma.NumVertices();
+	unsigned ncls = classes.NumClasses();
+
+	// class of the nearest surface vertex
+	std::vector<unsigned> nearest(nv, congruence_none);
+	if(reduced.NumVertices() > 0)
+	{
+		CongruenceGrid grid;
+		grid.Build(reduced);
+#pragma omp parallel for schedule(dynamic, 256)
+		for(int i = 0; i < (int)nv; i ++)
+			nearest[i] = vertex_class[grid.Nearest(reduced, &ma.spheres[4 * i])];
+	}
+
+	// majority over the connected parts of the medial mesh
+	std::vector<unsigned> parent(nv);
+	for(unsigned i = 0; i < nv; i ++)
+		parent[i] = i;
+	for(unsigned e = 0; e < ma.NumEdges(); e ++)
+	{
+		unsigned a = FindRoot(parent, ma.edges[2 * e]), b = FindRoot(parent, ma.edges[2 * e + 1]);
+		if(a != b)
+			parent[std::max(a, b)] = std::min(a, b);
+	}
+	for(unsigned f = 0; f < ma.NumFaces(); f ++)
+		for(int k = 1; k < 3; k ++)
+		{
+			unsigned a = FindRoot(parent, ma.faces[3 * f]), b = FindRoot(parent, ma.faces[3 * f + k]);
+			if(a != b)
+				parent[std::max(a, b)] = std::min(a, b);
+		}
+	std::map<std::pair<unsigned, unsigned>, unsigned> votes;
+	for(unsigned i = 0; i < nv; i ++)
+		if(nearest[i] != congruence_none)
+			votes[std::make_pair(FindRoot(parent, i), nearest[i])] ++;
+	std::vector<unsigned> part_class(nv, congruence_none), part_votes(nv, 0);
+	for(std::map<std::pair<unsigned, unsigned>, unsigned>::const_iterator it = votes.begin(); it != votes.end(); ++ it)
+		if(it->second > part_votes[it->first.first])
+		{
+			part_votes[it->first.first] = it->second;
+			part_class[it->first.first] = it->first.second;
+		}
+
+	// elements of each class in local numbering
+	std::vector<unsigned> local(nv, congruence_none);
+	std::vector<std::vector<unsigned> > cls_vertices(ncls), cls_edges(ncls), cls_faces(ncls);
+	std::vector<unsigned> vertex_cls(nv, congruence_none);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		unsigned cls = part_class[FindRoot(parent, i)];
+		if(cls == congruence_none)
+			continue;
+		vertex_cls[i] = cls;
+		local[i] = (unsigned)cls_vertices[cls].size();
+		cls_vertices[cls].push_back(i);
+	}
+	for(unsigned e = 0; e < ma.NumEdges(); e ++)
+	{
+		unsigned cls = vertex_cls[ma.edges[2 * e]];
+		if(cls == congruence_none)
+			continue;
+		cls_edges[cls].push_back(local[ma.edges[2 * e]]);
+		cls_edges[cls].push_back(local[ma.edges[2 * e + 1]]);
+	}
+	for(unsigned f = 0; f < ma.NumFaces(); f ++)
+	{
+		unsigned cls = vertex_cls[ma.faces[3 * f]];
+		if(cls == congruence_none)
+			continue;
+		for(int k = 0; k < 3; k ++)
+			cls_faces[cls].push_back(local[ma.faces[3 * f + k]]);
+	}
+
+	for(unsigned c = 0; c < classes.NumComponents(); c ++)
+	{
+		const ComponentInstance & inst = classes.instances[c];
+		unsigned first = instanced.NumVertices();
+		first_vertex[c] = first;
+		const std::vector<unsigned> & vs = cls_vertices[inst.cls];
+		for(size_t i = 0; i < vs.size(); i ++)
+		{
+			double q[3];
+			inst.Apply(&ma.spheres[4 * vs[i]], q);
+			instanced.spheres.insert(instanced.spheres.end(), q, q + 3);
+			instanced.spheres.push_back(ma.spheres[4 * vs[i] + 3]);
+		}
+		for(size_t i = 0; i < cls_edges[inst.cls].size(); i ++)
+			instanced.edges.push_back(first + cls_edges[inst.cls][i]);
+		for(size_t i = 0; i < cls_faces[inst.cls].size(); i ++)
+			instanced.faces.push_back(first + cls_faces[inst.cls][i]);
+	}
+}
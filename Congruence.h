@@ -0,0 +1,69 @@
+#ifndef _CONGRUENCE_H
+#define _CONGRUENCE_H
+
+#include <string>
+#include <vector>
+#include "IndexedMesh.h"
+#include "MedialChunks.h"
+
+// rigid motion of the representative of a class onto one copy,
+// x_copy = rotation x_rep + translation, rotation is row major
+class ComponentInstance
+{
+public:
+	unsigned component;
+	unsigned cls;
+	double rotation[9];
+	double translation[3];
+
+public:
+	void Apply(const double p[3], double q[3]) const;
+};
+
+// Connected components of a surface grouped into classes of congruent copies.
+// A component is hashed by its vertex and face counts and the histogram of its
+// vertex distances to the area centroid, which do not depend on the pose.
+// Components with the same hash are verified exactly: with the same vertex and
+// face order the rigid motion is fitted to the corresponding vertices, otherwise
+// it is taken from the principal frames (distinct principal moments only).
+// It is accepted when every vertex lands within tolerance of its copy and the
+// faces map onto faces. Mirrored copies are separate classes.
+class CongruenceClasses
+{
+public:
+	std::vector<unsigned> vertex_component;		// per vertex
+	std::vector<unsigned> component_faces;		// faces of component c are
+	std::vector<unsigned> component_offset;		// component_faces[component_offset[c] .. component_offset[c+1])
+	std::vector<unsigned> representative;		// per class, a component
+	std::vector<unsigned long long> class_hash;	// per class, the pose independent hash
+	std::vector<ComponentInstance> instances;	// per component
+
+public:
+	unsigned NumComponents() const { return (unsigned)instances.size(); }
+	unsigned NumClasses() const { return (unsigned)representative.size(); }
+	void clear();
+
+	// text layout:
+	//   <classes> <copies>
+	//   class id hash representative
+	//   copy class component first_vertex r00 r01 r02 r10 r11 r12 r20 r21 r22 t0 t1 t2
+	// first_vertex is where the copy starts in the instanced MA
+	bool Save(const std::string & filename, const std::vector<unsigned> & first_vertex, std::string & error) const;
+};
+
+// tolerance is relative to the bounding box diagonal of the mesh
+void FindCongruentComponents(const IndexedMesh & mesh, double tolerance, CongruenceClasses & classes);
+
+// the representatives of all classes as one mesh, vertex_class gives the class
+// of each of its vertices
+void ExtractRepresentatives(const IndexedMesh & mesh, const CongruenceClasses & classes,
+							IndexedMesh & reduced, std::vector<unsigned> & vertex_class);
+
+// The medial mesh of the representatives placed at every copy. A medial vertex
+// belongs to the class of the nearest surface vertex, by majority over its
+// connected part of the medial mesh. The copies follow each other in component
+// order, first_vertex is the first medial vertex of each copy.
+void InstanceMedialMesh(const MedialMeshData & ma, const IndexedMesh & reduced, const std::vector<unsigned> & vertex_class,
+						const CongruenceClasses & classes, MedialMeshData & instanced, std::vector<unsigned> & first_vertex);
+
+#endif // _CONGRUENCE_H
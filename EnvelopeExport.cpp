@@ -0,0 +1,613 @@
+#include "EnvelopeExport.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <unordered_map>
+
+// resolution cap of a single circle, bounds the size of huge spheres
+static const unsigned envelope_max_segments = 64;
+
+// vertices closer than this fraction of the error bound are welded
+static const double weld_fraction = 0.01;
+
+void EnvelopeMesh::clear()
+{
+	vertices.clear();
+	triangles.clear();
+	triangles_tessellated = 0;
+	triangles_clipped = 0;
+	vertices_welded = 0;
+}
+
+static bool EndsWith(const std::string & s, const std::string & ext)
+{
+	if(s.size() < ext.size())
+		return false;
+	for(size_t i = 0; i < ext.size(); i ++)
+		if(tolower(s[s.size() - ext.size() + i]) != ext[i])
+			return false;
+	return true;
+}
+
+bool EnvelopeMesh::Save(const std::string & filename, std::string & error) const
+{
+	bool ply = EndsWith(filename, ".ply");
+	if(!ply && !EndsWith(filename, ".off"))
+	{
+		error = "Envelope file must end in .off or .ply: " + filename;
+		return false;
+	}
+
+	std::ofstream fout(filename.c_str());
+	if(!fout)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	if(ply)
+	{
+		fout << "ply" << std::endl
+			<< "format ascii 1.0" << std::endl
+			<< "element vertex " << NumVertices() << std::endl
+			<< "property double x" << std::endl
+			<< "property double y" << std::endl
+			<< "property double z" << std::endl
+			<< "element face " << NumTriangles() << std::endl
+			<< "property list uchar int vertex_indices" << std::endl
+			<< "end_header" << std::endl;
+	}
+	else
+		fout << "OFF" << std::endl << NumVertices() << " " << NumTriangles() << " 0" << std::endl;
+
+	for(unsigned i = 0; i < NumVertices(); i ++)
+		fout << std::setiosflags(std::ios::fixed) << std::setprecision(15) << vertices[3 * i] << " "
+			<< vertices[3 * i + 1] << " " << vertices[3 * i + 2] << std::endl;
+	for(unsigned i = 0; i < NumTriangles(); i ++)
+		fout << "3 " << triangles[3 * i] << " " << triangles[3 * i + 1] << " " << triangles[3 * i + 2] << std::endl;
+
+	if(!fout)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+double MedialBoundingDiagonal(const MedialMeshData & ma)
+{
+	if(ma.NumVertices() == 0)
+		return 0.;
+	double mn[3], mx[3];
+	for(int d = 0; d < 3; d ++)
+	{
+		mn[d] = ma.spheres[d] - ma.spheres[3];
+		mx[d] = ma.spheres[d] + ma.spheres[3];
+	}
+	for(unsigned i = 1; i < ma.NumVertices(); i ++)
+		for(int d = 0; d < 3; d ++)
+		{
+			mn[d] = std::min(mn[d], ma.spheres[4 * i + d] - ma.spheres[4 * i + 3]);
+			mx[d] = std::max(mx[d], ma.spheres[4 * i + d] + ma.spheres[4 * i + 3]);
+		}
+	return sqrt((mx[0] - mn[0]) * (mx[0] - mn[0]) + (mx[1] - mn[1]) * (mx[1] - mn[1]) + (mx[2] - mn[2]) * (mx[2] - mn[2]));
+}
+
+// segments of a circle of radius r whose chords deviate less than eps from it
+static unsigned CircleSegments(double r, double eps)
+{
+	if(r <= eps)
+		return 4;
+	double n = ceil(Wm4::Mathd::PI / acos(1. - eps / r));
+	if(n > envelope_max_segments)
+		return envelope_max_segments;
+	return n < 4. ? 4 : (unsigned)n;
+}
+
+static unsigned Subdivisions(double length, double spacing)
+{
+	if(!(spacing > 0.))
+		return 1;
+	double n = ceil(length / spacing);
+	if(n > envelope_max_segments)
+		return envelope_max_segments;
+	return n < 1. ? 1 : (unsigned)n;
+}
+
+double ConeDistance(const Vector3d & p, const Vector3d & c0, double r0, const Vector3d & c1, double r1)
+{
+	double radius;
+	return ConeDistance(p, c0, r0, c1, r1, radius);
+}
+
+double ConeDistance(const Vector3d & p, const Vector3d & c0, double r0, const Vector3d & c1, double r1, double & radius)
+{
+	Vector3d d = c1 - c0;
+	double len = d.Length();
+	double dr = r1 - r0;
+	// one sphere contains the other
+	if(len <= fabs(dr))
+	{
+		radius = std::max(r0, r1);
+		return r0 > r1 ? (p - c0).Length() - r0 : (p - c1).Length() - r1;
+	}
+
+	// the closest sphere on the segment is where the direction to p meets the cone angle
+	Vector3d u = d / len;
+	Vector3d q = p - c0;
+	double x = q.Dot(u);
+	double y = (q - x * u).Length();
+	double s = dr / len;
+	double w = -s * y / sqrt(1. - s * s);
+	double t = (x - w) / len;
+	t = t < 0. ? 0. : (t > 1. ? 1. : t);
+	radius = r0 + t * dr;
+	return (q - t * d).Length() - radius;
+}
+
+double SlabDistance(const Vector3d & p, const Vector3d c[3], const double r[3])
+{
+	double radius;
+	return SlabDistance(p, c, r, radius);
+}
+
+// |p - c(b)| - r(b) is convex in the barycentric coordinates b, so its minimum is
+// either on the triangle border (a cone) or a stationary point, where p - c(b)
+// is along one of the two normals of the tangent planes
+double SlabDistance(const Vector3d & p, const Vector3d c[3], const double r[3], double & radius)
+{
+	double dist = DBL_MAX;
+	for(int k = 0; k < 3; k ++)
+	{
+		double rk;
+		double dk = ConeDistance(p, c[k], r[k], c[(k + 1) % 3], r[(k + 1) % 3], rk);
+		if(dk < dist)
+		{
+			dist = dk;
+			radius = rk;
+		}
+	}
+
+	Vector3d e1 = c[1] - c[0];
+	Vector3d e2 = c[2] - c[0];
+	double dr1 = r[1] - r[0];
+	double dr2 = r[2] - r[0];
+	double g11 = e1.Dot(e1), g12 = e1.Dot(e2), g22 = e2.Dot(e2);
+	double det = g11 * g22 - g12 * g12;
+	if(det <= 1e-12 * g11 * g22)
+		return dist;
+
+	// normals n with n.e1 = -dr1 and n.e2 = -dr2
+	Vector3d m = e1.Cross(e2);
+	double mlen = m.Length();
+	m /= mlen;
+	Vector3d g = ((-dr1 * g22 + dr2 * g12) / det) * e1 + ((-dr2 * g11 + dr1 * g12) / det) * e2;
+	double h2 = 1. - g.SquaredLength();
+	if(h2 <= 0.)
+		return dist;
+	double h = sqrt(h2);
+
+	Vector3d q = p - c[0];
+	for(int side = -1; side <= 1; side += 2)
+	{
+		Vector3d n = g + (side * h) * m;
+		double d3 = side * h * mlen;
+		double b1 = q.Dot(e2.Cross(n)) / d3;
+		double b2 = e1.Dot(q.Cross(n)) / d3;
+		double lambda = e1.Dot(e2.Cross(q)) / d3;
+		double rb = r[0] + b1 * dr1 + b2 * dr2;
+		if(b1 >= 0. && b2 >= 0. && b1 + b2 <= 1. && lambda >= 0. && lambda - rb < dist)
+		{
+			dist = lambda - rb;
+			radius = rb;
+		}
+	}
+	return dist;
+}
+
+// triangles of one element before welding
+class EnvelopePatch
+{
+public:
+	std::vector<Vector3d> points;
+	std::vector<unsigned> triangles;
+	unsigned clipped;
+
+public:
+	EnvelopePatch() : clipped(0) {}
+
+	unsigned AddPoint(const Vector3d & p)
+	{
+		points.push_back(p);
+		return (unsigned)points.size() - 1;
+	}
+
+	// oriented so that the normal points away from inside
+	void AddTriangle(unsigned a, unsigned b, unsigned c, const Vector3d & inside)
+	{
+		Vector3d n = (points[b] - points[a]).Cross(points[c] - points[a]);
+		Vector3d centroid = (points[a] + points[b] + points[c]) / 3.;
+		if(n.Dot(centroid - inside) < 0.)
+			std::swap(b, c);
+		triangles.push_back(a);
+		triangles.push_back(b);
+		triangles.push_back(c);
+	}
+};
+
+static void TessellateSphere(const Vector3d & c, double r, double eps, EnvelopePatch & patch)
+{
+	// a quad of the latitude-longitude grid deviates about twice the chord error
+	unsigned segments = CircleSegments(r, 0.5 * eps);
+	unsigned rings = std::max(2u, segments / 2);
+
+	unsigned north = patch.AddPoint(c + Vector3d(0., 0., r));
+	unsigned first = (unsigned)patch.points.size();
+	for(unsigned i = 1; i < rings; i ++)
+	{
+		double theta = Wm4::Mathd::PI * i / rings;
+		for(unsigned j = 0; j < segments; j ++)
+		{
+			double phi = 2. * Wm4::Mathd::PI * j / segments;
+			patch.AddPoint(c + r * Vector3d(sin(theta) * cos(phi), sin(theta) * sin(phi), cos(theta)));
+		}
+	}
+	unsigned south = patch.AddPoint(c - Vector3d(0., 0., r));
+
+	for(unsigned j = 0; j < segments; j ++)
+	{
+		unsigned jn = (j + 1) % segments;
+		patch.AddTriangle(north, first + j, first + jn, c);
+		for(unsigned i = 0; i + 2 < rings; i ++)
+		{
+			unsigned a = first + i * segments;
+			unsigned b = a + segments;
+			patch.AddTriangle(a + j, b + j, b + jn, c);
+			patch.AddTriangle(a + j, b + jn, a + jn, c);
+		}
+		unsigned last = first + (rings - 2) * segments;
+		patch.AddTriangle(south, last + jn, last + j, c);
+	}
+}
+
+static void TessellateCone(const Vector3d & c0, double r0, const Vector3d & c1, double r1, double eps, EnvelopePatch & patch)
+{
+	Cone cone(c0, r0, c1, r1);
+	if(cone.type == 1 || cone.height <= 0.)
+		return;
+
+	double rmax = std::max(cone.base, cone.top);
+	unsigned segments = CircleSegments(rmax, eps);
+	double spacing = 2. * Wm4::Mathd::PI * rmax / segments;
+	double slant = sqrt(cone.height * cone.height + (cone.top - cone.base) * (cone.top - cone.base));
+	unsigned rows = Subdivisions(slant, spacing);
+
+	Vector3d u, v;
+	Vector3d::GenerateComplementBasis(u, v, cone.axis);
+	unsigned first = (unsigned)patch.points.size();
+	for(unsigned i = 0; i <= rows; i ++)
+	{
+		double t = (double)i / rows;
+		Vector3d center = cone.apex + (t * cone.height) * cone.axis;
+		double radius = cone.base + t * (cone.top - cone.base);
+		for(unsigned j = 0; j < segments; j ++)
+		{
+			double phi = 2. * Wm4::Mathd::PI * j / segments;
+			patch.AddPoint(center + radius * (cos(phi) * u + sin(phi) * v));
+		}
+	}
+
+	for(unsigned i = 0; i < rows; i ++)
+		for(unsigned j = 0; j < segments; j ++)
+		{
+			unsigned jn = (j + 1) % segments;
+			unsigned a = first + i * segments;
+			unsigned b = a + segments;
+			Vector3d inside = cone.apex + ((i + 0.5) / rows * cone.height) * cone.axis;
+			patch.AddTriangle(a + j, a + jn, b + jn, inside);
+			patch.AddTriangle(a + j, b + jn, b + j, inside);
+		}
+}
+
+static void TessellateSlab(const Vector3d c[3], const double r[3], double eps, EnvelopePatch & patch)
+{
+	SimpleTriangle st[2];
+	if(!TriangleFromThreeSpheres(c[0], r[0], c[1], r[1], c[2], r[2], st[0], st[1]))
+		return;
+	if(st[0].normal == Vector3d(0., 0., 0.) || st[1].normal == Vector3d(0., 0., 0.))
+		return;
+
+	// flat, subdivided only so that clipping follows the neighbours at the cone spacing
+	double rmax = std::max(r[0], std::max(r[1], r[2]));
+	double spacing = 2. * Wm4::Mathd::PI * rmax / CircleSegments(rmax, eps);
+	Vector3d inside = (c[0] + c[1] + c[2]) / 3.;
+
+	for(int k = 0; k < 2; k ++)
+	{
+		const Vector3d * v = st[k].v;
+		double longest = std::max((v[1] - v[0]).Length(), std::max((v[2] - v[1]).Length(), (v[0] - v[2]).Length()));
+		unsigned n = Subdivisions(longest, spacing);
+
+		// row i holds n - i + 1 points
+		unsigned first = (unsigned)patch.points.size();
+		std::vector<unsigned> row_start(n + 2);
+		for(unsigned i = 0; i <= n; i ++)
+		{
+			row_start[i] = (unsigned)patch.points.size() - first;
+			for(unsigned j = 0; i + j <= n; j ++)
+				patch.AddPoint(v[0] + ((double)i / n) * (v[1] - v[0]) + ((double)j / n) * (v[2] - v[0]));
+		}
+
+		for(unsigned i = 0; i < n; i ++)
+			for(unsigned j = 0; i + j < n; j ++)
+			{
+				unsigned a = first + row_start[i] + j;
+				unsigned b = first + row_start[i + 1] + j;
+				patch.AddTriangle(a, b, a + 1, inside);
+				if(i + j + 1 < n)
+					patch.AddTriangle(a + 1, b, b + 1, inside);
+			}
+	}
+}
+
+// vertex to element adjacency in compressed rows
+static void BuildIncidence(unsigned nv, const std::vector<unsigned> & elements, unsigned arity,
+						   std::vector<unsigned> & start, std::vector<unsigned> & ids)
+{
+	start.assign(nv + 1, 0);
+	for(size_t i = 0; i < elements.size(); i ++)
+		start[elements[i] + 1] ++;
+	for(unsigned i = 0; i < nv; i ++)
+		start[i + 1] += start[i];
+	ids.resize(elements.size());
+	std::vector<unsigned> fill(start.begin(), start.end() - 1);
+	for(size_t i = 0; i < elements.size(); i ++)
+		ids[fill[elements[i]] ++] = (unsigned)(i / arity);
+}
+
+static void SortUnique(std::vector<unsigned> & v)
+{
+	std::sort(v.begin(), v.end());
+	v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+class EnvelopeWeldKey
+{
+public:
+	long long x, y, z;
+	bool operator==(const EnvelopeWeldKey & k) const { return x == k.x && y == k.y && z == k.z; }
+};
+
+class EnvelopeWeldHash
+{
+public:
+	size_t operator()(const EnvelopeWeldKey & k) const
+	{
+		unsigned long long h = (unsigned long long)k.x * 73856093ULL ^ (unsigned long long)k.y * 19349663ULL ^ (unsigned long long)k.z * 83492791ULL;
+		return (size_t)(h ^ (h >> 29));
+	}
+};
+
+void MedialConeEdges(const MedialMeshData & ma, std::vector<unsigned> & edges)
+{
+	std::vector<unsigned long long> edge_keys;
+	for(unsigned i = 0; i < ma.NumEdges(); i ++)
+	{
+		unsigned a = std::min(ma.edges[2 * i], ma.edges[2 * i + 1]);
+		unsigned b = std::max(ma.edges[2 * i], ma.edges[2 * i + 1]);
+		if(a != b)
+			edge_keys.push_back((unsigned long long)a << 32 | b);
+	}
+	for(unsigned i = 0; i < ma.NumFaces(); i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			unsigned a = std::min(ma.faces[3 * i + k], ma.faces[3 * i + (k + 1) % 3]);
+			unsigned b = std::max(ma.faces[3 * i + k], ma.faces[3 * i + (k + 1) % 3]);
+			if(a != b)
+				edge_keys.push_back((unsigned long long)a << 32 | b);
+		}
+	std::sort(edge_keys.begin(), edge_keys.end());
+	edge_keys.erase(std::unique(edge_keys.begin(), edge_keys.end()), edge_keys.end());
+	edges.resize(2 * edge_keys.size());
+	for(size_t i = 0; i < edge_keys.size(); i ++)
+	{
+		edges[2 * i] = (unsigned)(edge_keys[i] >> 32);
+		edges[2 * i + 1] = (unsigned)(edge_keys[i] & 0xffffffffULL);
+	}
+}
+
+void BuildEnvelope(const MedialMeshData & ma, double max_error, EnvelopeMesh & envelope)
+{
+	envelope.clear();
+	unsigned nv = ma.NumVertices();
+	if(nv == 0 || !(max_error > 0.))
+		return;
+
+	std::vector<Vector3d> centers(nv);
+	std::vector<double> radii(nv);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		centers[i] = Vector3d(ma.spheres[4 * i], ma.spheres[4 * i + 1], ma.spheres[4 * i + 2]);
+		radii[i] = ma.spheres[4 * i + 3];
+	}
+
+	std::vector<unsigned> edges;
+	MedialConeEdges(ma, edges);
+	unsigned ne = (unsigned)edges.size() / 2;
+	unsigned nf = ma.NumFaces();
+
+	std::vector<unsigned> edge_start, edge_ids, face_start, face_ids;
+	BuildIncidence(nv, edges, 2, edge_start, edge_ids);
+	BuildIncidence(nv, ma.faces, 3, face_start, face_ids);
+
+	// spheres, then cones, then slabs
+	int num_elements = (int)(nv + ne + nf);
+	std::vector<EnvelopePatch> patches(num_elements);
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for(int e = 0; e < num_elements; e ++)
+	{
+		EnvelopePatch & patch = patches[e];
+		unsigned vid[3];
+		unsigned arity;
+		if((unsigned)e < nv)
+		{
+			arity = 1;
+			vid[0] = e;
+			if(radii[e] > 0.)
+				TessellateSphere(centers[e], radii[e], max_error, patch);
+		}
+		else if((unsigned)e < nv + ne)
+		{
+			arity = 2;
+			vid[0] = edges[2 * (e - nv)];
+			vid[1] = edges[2 * (e - nv) + 1];
+			TessellateCone(centers[vid[0]], radii[vid[0]], centers[vid[1]], radii[vid[1]], max_error, patch);
+		}
+		else
+		{
+			arity = 3;
+			Vector3d c[3];
+			double r[3];
+			for(int k = 0; k < 3; k ++)
+			{
+				vid[k] = ma.faces[3 * (e - nv - ne) + k];
+				c[k] = centers[vid[k]];
+				r[k] = radii[vid[k]];
+			}
+			TessellateSlab(c, r, max_error, patch);
+		}
+		if(patch.triangles.empty())
+			continue;
+
+		// primitives sharing a vertex with this element
+		std::vector<unsigned> near_spheres, near_edges, near_faces;
+		for(unsigned k = 0; k < arity; k ++)
+		{
+			for(unsigned i = edge_start[vid[k]]; i < edge_start[vid[k] + 1]; i ++)
+				near_edges.push_back(edge_ids[i]);
+			for(unsigned i = face_start[vid[k]]; i < face_start[vid[k] + 1]; i ++)
+				near_faces.push_back(face_ids[i]);
+		}
+		SortUnique(near_edges);
+		SortUnique(near_faces);
+		for(size_t i = 0; i < near_edges.size(); i ++)
+		{
+			near_spheres.push_back(edges[2 * near_edges[i]]);
+			near_spheres.push_back(edges[2 * near_edges[i] + 1]);
+		}
+		for(size_t i = 0; i < near_faces.size(); i ++)
+			for(int k = 0; k < 3; k ++)
+				near_spheres.push_back(ma.faces[3 * near_faces[i] + k]);
+		for(unsigned k = 0; k < arity; k ++)
+			near_spheres.push_back(vid[k]);
+		SortUnique(near_spheres);
+
+		// the element itself is not a neighbour
+		if(arity == 1)
+			near_spheres.erase(std::find(near_spheres.begin(), near_spheres.end(), vid[0]));
+		else if(arity == 2)
+			near_edges.erase(std::find(near_edges.begin(), near_edges.end(), (unsigned)e - nv));
+		else
+			near_faces.erase(std::find(near_faces.begin(), near_faces.end(), (unsigned)e - nv - ne));
+
+		// drop the triangles buried in a neighbour
+		std::vector<unsigned> kept;
+		kept.reserve(patch.triangles.size());
+		for(size_t t = 0; t < patch.triangles.size(); t += 3)
+		{
+			Vector3d p = (patch.points[patch.triangles[t]] + patch.points[patch.triangles[t + 1]] + patch.points[patch.triangles[t + 2]]) / 3.;
+			bool buried = false;
+			for(size_t i = 0; i < near_spheres.size() && !buried; i ++)
+				buried = (p - centers[near_spheres[i]]).Length() - radii[near_spheres[i]] < -max_error;
+			for(size_t i = 0; i < near_edges.size() && !buried; i ++)
+			{
+				unsigned a = edges[2 * near_edges[i]], b = edges[2 * near_edges[i] + 1];
+				buried = ConeDistance(p, centers[a], radii[a], centers[b], radii[b]) < -max_error;
+			}
+			for(size_t i = 0; i < near_faces.size() && !buried; i ++)
+			{
+				Vector3d c[3];
+				double r[3];
+				for(int k = 0; k < 3; k ++)
+				{
+					c[k] = centers[ma.faces[3 * near_faces[i] + k]];
+					r[k] = radii[ma.faces[3 * near_faces[i] + k]];
+				}
+				buried = SlabDistance(p, c, r) < -max_error;
+			}
+			if(buried)
+				patch.clipped ++;
+			else
+				kept.insert(kept.end(), patch.triangles.begin() + t, patch.triangles.begin() + t + 3);
+		}
+		patch.triangles.swap(kept);
+	}
+
+	// weld in element order, the first vertex of a cluster represents it
+	double cell = weld_fraction * max_error;
+	std::unordered_map<EnvelopeWeldKey, std::vector<unsigned>, EnvelopeWeldHash> grid;
+	for(int e = 0; e < num_elements; e ++)
+	{
+		EnvelopePatch & patch = patches[e];
+		envelope.triangles_tessellated += patch.triangles.size() / 3 + patch.clipped;
+		envelope.triangles_clipped += patch.clipped;
+
+		std::vector<unsigned> index(patch.points.size(), (unsigned)-1);
+		for(size_t t = 0; t < patch.triangles.size(); t += 3)
+		{
+			unsigned tri[3];
+			for(int k = 0; k < 3; k ++)
+			{
+				unsigned & id = index[patch.triangles[t + k]];
+				if(id == (unsigned)-1)
+				{
+					const Vector3d & p = patch.points[patch.triangles[t + k]];
+					EnvelopeWeldKey key = {(long long)floor(p[0] / cell), (long long)floor(p[1] / cell), (long long)floor(p[2] / cell)};
+					for(long long dx = -1; dx <= 1 && id == (unsigned)-1; dx ++)
+						for(long long dy = -1; dy <= 1 && id == (unsigned)-1; dy ++)
+							for(long long dz = -1; dz <= 1 && id == (unsigned)-1; dz ++)
+							{
+								EnvelopeWeldKey nk = {key.x + dx, key.y + dy, key.z + dz};
+								std::unordered_map<EnvelopeWeldKey, std::vector<unsigned>, EnvelopeWeldHash>::const_iterator gi = grid.find(nk);
+								if(gi == grid.end())
+									continue;
+								for(size_t i = 0; i < gi->second.size(); i ++)
+								{
+									unsigned w = gi->second[i];
+									Vector3d q(envelope.vertices[3 * w], envelope.vertices[3 * w + 1], envelope.vertices[3 * w + 2]);
+									if((p - q).SquaredLength() <= cell * cell)
+									{
+										id = w;
+										break;
+									}
+								}
+							}
+					if(id == (unsigned)-1)
+					{
+						id = envelope.NumVertices();
+						envelope.vertices.push_back(p[0]);
+						envelope.vertices.push_back(p[1]);
+						envelope.vertices.push_back(p[2]);
+						grid[key].push_back(id);
+					}
+					else
+						envelope.vertices_welded ++;
+				}
+				tri[k] = id;
+			}
+			// collapsed by the weld
+			if(tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+				continue;
+			envelope.triangles.insert(envelope.triangles.end(), tri, tri + 3);
+		}
+
+		// release the patch early, the envelope can be large
+		std::vector<Vector3d>().swap(patch.points);
+		std::vector<unsigned>().swap(patch.triangles);
+	}
+}
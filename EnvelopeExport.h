@@ -0,0 +1,57 @@
+#ifndef _ENVELOPEEXPORT_H
+#define _ENVELOPEEXPORT_H
+
+#include <string>
+#include <vector>
+#include "MedialChunks.h"
+#include "LinearAlgebra/Wm4Vector.h"
+
+// triangle soup of the medial envelope, the union of all spheres, cones and slabs
+class EnvelopeMesh
+{
+public:
+	std::vector<double> vertices;
+	std::vector<unsigned> triangles;
+
+	// statistics of the last BuildEnvelope
+	unsigned long long triangles_tessellated;
+	unsigned long long triangles_clipped;
+	unsigned long long vertices_welded;
+
+public:
+	EnvelopeMesh() : triangles_tessellated(0), triangles_clipped(0), vertices_welded(0) {}
+
+	unsigned NumVertices() const { return (unsigned)vertices.size() / 3; }
+	unsigned NumTriangles() const { return (unsigned)triangles.size() / 3; }
+	void clear();
+
+	// format chosen by the extension, .off or .ply (ascii)
+	bool Save(const std::string & filename, std::string & error) const;
+};
+
+// Tessellates every sphere, edge cone and pair of slab triangles of the medial mesh.
+// The resolution of each element is chosen so that the chord error of the curved
+// parts stays below max_error (up to a cap of envelope_max_segments per circle).
+// Triangles whose centroid lies inside one of the neighbouring primitives by more
+// than max_error are dropped, then vertices closer than a fraction of max_error
+// are welded. The elements are tessellated in parallel, the result does not
+// depend on the number of threads.
+void BuildEnvelope(const MedialMeshData & ma, double max_error, EnvelopeMesh & envelope);
+
+// diagonal of the bounding box of all spheres
+double MedialBoundingDiagonal(const MedialMeshData & ma);
+
+// the cones of the envelope as sorted vertex pairs, the edges of the .ma and
+// every slab border, even where the .ma does not list it
+void MedialConeEdges(const MedialMeshData & ma, std::vector<unsigned> & edges);
+
+// signed distance to the convex hull of two spheres (the medial cone),
+// radius receives the interpolated radius of the closest sphere
+double ConeDistance(const Wm4::Vector3d & p, const Wm4::Vector3d & c0, double r0, const Wm4::Vector3d & c1, double r1);
+double ConeDistance(const Wm4::Vector3d & p, const Wm4::Vector3d & c0, double r0, const Wm4::Vector3d & c1, double r1, double & radius);
+
+// signed distance to the convex hull of three spheres (the medial slab)
+double SlabDistance(const Wm4::Vector3d & p, const Wm4::Vector3d c[3], const double r[3]);
+double SlabDistance(const Wm4::Vector3d & p, const Wm4::Vector3d c[3], const double r[3], double & radius);
+
+#endif // _ENVELOPEEXPORT_H
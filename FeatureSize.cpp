@@ -0,0 +1,295 @@
+#include "FeatureSize.h"
+
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+static const char lfs_magic[8] = {'Q', 'M', 'A', 'T', 'L', 'F', 'S', '1'};
+// centers per leaf of the kd-tree
+static const unsigned kd_leaf_size = 8;
+
+template <class T>
+static void WriteValue(std::ofstream & out, const T & v)
+{
+	out.write((const char *)&v, sizeof(T));
+}
+
+template <class T>
+static void ReadValue(std::ifstream & in, T & v)
+{
+	in.read((char *)&v, sizeof(T));
+}
+
+// orders center ids by one coordinate
+class KdAxisLess
+{
+public:
+	const std::vector<double> & centers;
+	unsigned axis;
+
+	KdAxisLess(const std::vector<double> & c, unsigned a) : centers(c), axis(a) {}
+	bool operator()(unsigned a, unsigned b) const { return centers[3 * a + axis] < centers[3 * b + axis]; }
+};
+
+double MedialKdTree::Node::SquaredDistance(const double p[3]) const
+{
+	double d = 0.;
+	for(int k = 0; k < 3; k ++)
+	{
+		double e = std::max(box_min[k] - p[k], std::max(0., p[k] - box_max[k]));
+		d += e * e;
+	}
+	return d;
+}
+
+void MedialKdTree::Build(const MedialMeshData & ma, const std::vector<double> & exterior)
+{
+	unsigned nm = ma.NumVertices();
+	unsigned n = nm + (unsigned)(exterior.size() / 3);
+	nodes.clear();
+	order.resize(n);
+	for(unsigned i = 0; i < n; i ++)
+		order[i] = i;
+	centers.clear();
+	if(n == 0)
+		return;
+
+	Node root;
+	root.first = 0;
+	root.count = n;
+	root.child = 0;
+	root.axis = 0;
+	root.split = 0.;
+	nodes.push_back(root);
+	// the splits read the centers by id, the queries by position in order
+	centers.resize(3 * (size_t)n);
+	for(unsigned i = 0; i < nm; i ++)
+		for(int k = 0; k < 3; k ++)
+			centers[3 * i + k] = ma.spheres[4 * i + k];
+	std::copy(exterior.begin(), exterior.begin() + 3 * (size_t)(n - nm), centers.begin() + 3 * (size_t)nm);
+	Split(0, 0);
+
+	std::vector<double> sorted(3 * (size_t)n);
+	for(unsigned i = 0; i < n; i ++)
+		for(int k = 0; k < 3; k ++)
+			sorted[3 * i + k] = centers[3 * order[i] + k];
+	centers.swap(sorted);
+}
+
+void MedialKdTree::Split(unsigned node, unsigned depth)
+{
+	unsigned first = nodes[node].first, count = nodes[node].count;
+	double * mn = nodes[node].box_min, * mx = nodes[node].box_max;
+	for(int k = 0; k < 3; k ++)
+	{
+		mn[k] = DBL_MAX;
+		mx[k] = -DBL_MAX;
+	}
+	for(unsigned i = first; i < first + count; i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			mn[k] = std::min(mn[k], centers[3 * order[i] + k]);
+			mx[k] = std::max(mx[k], centers[3 * order[i] + k]);
+		}
+	if(count <= kd_leaf_size || depth >= 64)
+		return;
+
+	unsigned axis = 0;
+	for(unsigned k = 1; k < 3; k ++)
+		if(mx[k] - mn[k] > mx[axis] - mn[axis])
+			axis = k;
+	if(!(mx[axis] > mn[axis]))
+		return;
+
+	unsigned half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, KdAxisLess(centers, axis));
+
+	Node left, right;
+	left.first = first;
+	left.count = half;
+	right.first = first + half;
+	right.count = count - half;
+	left.child = right.child = 0;
+	left.axis = right.axis = 0;
+	left.split = right.split = 0.;
+	unsigned child = (unsigned)nodes.size();
+	nodes[node].child = child;
+	nodes[node].axis = axis;
+	nodes[node].split = centers[3 * order[first + half] + axis];
+	nodes.push_back(left);
+	nodes.push_back(right);
+	Split(child, depth + 1);
+	Split(child + 1, depth + 1);
+}
+
+void MedialKdTree::Search(unsigned node, const double p[3], unsigned & id, double & best) const
+{
+	const Node & n = nodes[node];
+	if(n.SquaredDistance(p) >= best)
+		return;
+	if(n.child == 0)
+	{
+		for(unsigned i = n.first; i < n.first + n.count; i ++)
+		{
+			const double * c = &centers[3 * i];
+			double d = (c[0] - p[0]) * (c[0] - p[0]) + (c[1] - p[1]) * (c[1] - p[1]) + (c[2] - p[2]) * (c[2] - p[2]);
+			if(d < best)
+			{
+				best = d;
+				id = order[i];
+			}
+		}
+		return;
+	}
+
+	// the side of p first, it usually tightens the bound for the other one
+	unsigned near_child = p[n.axis] < n.split ? n.child : n.child + 1;
+	Search(near_child, p, id, best);
+	Search(near_child == n.child ? n.child + 1 : n.child, p, id, best);
+}
+
+bool MedialKdTree::Nearest(const double p[3], unsigned & id, double & distance) const
+{
+	if(nodes.empty())
+		return false;
+	double best = DBL_MAX;
+	Search(0, p, id, best);
+	distance = sqrt(best);
+	return true;
+}
+
+void FeatureSizeField::clear()
+{
+	vertex_lfs.clear();
+	grid_lfs.clear();
+	grid[0] = grid[1] = grid[2] = 0;
+	origin[0] = origin[1] = origin[2] = 0.;
+	spacing = 0.;
+}
+
+bool FeatureSizeField::Save(const std::string & filename, std::string & error) const
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if(!out)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	unsigned nv = (unsigned)vertex_lfs.size();
+	out.write(lfs_magic, 8);
+	WriteValue(out, nv);
+	out.write((const char *)grid, 3 * sizeof(unsigned));
+	out.write((const char *)origin, 3 * sizeof(double));
+	WriteValue(out, spacing);
+	if(nv > 0)
+		out.write((const char *)&vertex_lfs[0], nv * sizeof(float));
+	if(!grid_lfs.empty())
+		out.write((const char *)&grid_lfs[0], grid_lfs.size() * sizeof(float));
+
+	if(!out)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool FeatureSizeField::Load(const std::string & filename, std::string & error)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if(!in)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	clear();
+
+	char magic[8];
+	unsigned nv(0);
+	in.read(magic, 8);
+	ReadValue(in, nv);
+	in.read((char *)grid, 3 * sizeof(unsigned));
+	in.read((char *)origin, 3 * sizeof(double));
+	ReadValue(in, spacing);
+	if(!in || memcmp(magic, lfs_magic, 8) != 0)
+	{
+		error = "Not a feature size field: " + filename;
+		clear();
+		return false;
+	}
+
+	vertex_lfs.resize(nv);
+	if(nv > 0)
+		in.read((char *)&vertex_lfs[0], nv * sizeof(float));
+	grid_lfs.resize((size_t)grid[0] * grid[1] * grid[2]);
+	if(!grid_lfs.empty() && in)
+		in.read((char *)&grid_lfs[0], grid_lfs.size() * sizeof(float));
+	if(!in)
+	{
+		error = "Truncated feature size field: " + filename;
+		clear();
+		return false;
+	}
+	return true;
+}
+
+void ComputeFeatureSize(const MedialMeshData & ma, const std::vector<double> & exterior, const IndexedMesh & mesh,
+						unsigned grid_resolution, FeatureSizeField & field)
+{
+	field.clear();
+	MedialKdTree tree;
+	tree.Build(ma, exterior);
+
+	unsigned nv = mesh.NumVertices();
+	field.vertex_lfs.assign(nv, 0.f);
+#pragma omp parallel for schedule(dynamic, 1024)
+	for(int i = 0; i < (int)nv; i ++)
+	{
+		unsigned id;
+		double distance;
+		if(tree.Nearest(&mesh.positions[3 * i], id, distance))
+			field.vertex_lfs[i] = (float)distance;
+	}
+
+	if(grid_resolution == 0 || nv == 0)
+		return;
+
+	double mn[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, mx[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+	for(unsigned i = 0; i < nv; i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			mn[k] = std::min(mn[k], mesh.positions[3 * i + k]);
+			mx[k] = std::max(mx[k], mesh.positions[3 * i + k]);
+		}
+	double longest = std::max(mx[0] - mn[0], std::max(mx[1] - mn[1], mx[2] - mn[2]));
+	if(!(longest > 0.))
+		return;
+	field.spacing = longest / grid_resolution;
+	for(int k = 0; k < 3; k ++)
+	{
+		field.origin[k] = mn[k];
+		field.grid[k] = (unsigned)ceil((mx[k] - mn[k]) / field.spacing - 1e-9) + 1;
+	}
+
+	// one row of x per iteration
+	size_t row = field.grid[0];
+	unsigned rows = field.grid[1] * field.grid[2];
+	field.grid_lfs.assign(row * rows, 0.f);
+#pragma omp parallel for schedule(dynamic, 16)
+	for(int r = 0; r < (int)rows; r ++)
+	{
+		unsigned y = (unsigned)r % field.grid[1], z = (unsigned)r / field.grid[1];
+		for(unsigned x = 0; x < field.grid[0]; x ++)
+		{
+			double p[3] = {field.origin[0] + x * field.spacing, field.origin[1] + y * field.spacing, field.origin[2] + z * field.spacing};
+			unsigned id;
+			double distance;
+			if(tree.Nearest(p, id, distance))
+				field.grid_lfs[r * row + x] = (float)distance;
+		}
+	}
+}
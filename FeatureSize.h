@@ -0,0 +1,78 @@
+#ifndef _FEATURESIZE_H
+#define _FEATURESIZE_H
+
+#include <string>
+#include <vector>
+#include "IndexedMesh.h"
+#include "MedialChunks.h"
+
+// kd-tree over the sphere centers of a medial mesh and further medial vertices
+// (x, y, z triplets, ids after the spheres), nearest center queries.
+// Leaves hold a few centers, the split is at the median of the widest axis.
+// Subtrees whose box is farther than the best center so far are skipped.
+class MedialKdTree
+{
+public:
+	void Build(const MedialMeshData & ma, const std::vector<double> & exterior);
+
+	// id of the nearest center and its distance, false for an empty tree
+	bool Nearest(const double p[3], unsigned & id, double & distance) const;
+
+private:
+	class Node
+	{
+	public:
+		unsigned first;		// into order
+		unsigned count;
+		unsigned child;		// left child, the right one follows it; 0 for a leaf
+		unsigned axis;
+		double split;
+		double box_min[3];	// of its centers
+		double box_max[3];
+
+		double SquaredDistance(const double p[3]) const;
+	};
+
+	void Split(unsigned node, unsigned depth);
+	void Search(unsigned node, const double p[3], unsigned & id, double & best) const;
+
+	std::vector<Node> nodes;
+	std::vector<unsigned> order;	// center ids, leaves are ranges of it
+	std::vector<double> centers;	// x, y, z triplets in order
+};
+
+// Local feature size, the distance to the medial axis, sampled at the vertices
+// of the surface and optionally on a regular grid over its bounding box. The
+// medial axis is represented by vertices, dense enough for the raw MA: the
+// sphere centers of the inner MA and the exterior medial vertices, without which
+// the feature size at concave parts of the surface comes out too large.
+//
+// layout (.lfs), native byte order:
+//   header   magic "QMATLFS1", vertex count, grid size (3 unsigned),
+//            grid origin (3 double), grid spacing (double)
+//   vertices one float per surface vertex
+//   grid     one float per grid point, x fastest; absent for a 0 x 0 x 0 grid
+class FeatureSizeField
+{
+public:
+	std::vector<float> vertex_lfs;
+	unsigned grid[3];
+	double origin[3];
+	double spacing;
+	std::vector<float> grid_lfs;
+
+public:
+	FeatureSizeField() : spacing(0.) { grid[0] = grid[1] = grid[2] = 0; origin[0] = origin[1] = origin[2] = 0.; }
+	void clear();
+
+	bool Save(const std::string & filename, std::string & error) const;
+	bool Load(const std::string & filename, std::string & error);
+};
+
+// parallel over the samples, exterior as x, y, z triplets (see
+// MPMesh::ExteriorMedialVertices), grid_resolution is the number of cells along
+// the longest side of the bounding box, 0 for no grid
+void ComputeFeatureSize(const MedialMeshData & ma, const std::vector<double> & exterior, const IndexedMesh & mesh,
+						unsigned grid_resolution, FeatureSizeField & field);
+
+#endif // _FEATURESIZE_H
@@ -2096,7 +2096,7 @@ void GLWidget::gl_draw_ma_vertices_bplist()
 		{
 			glBegin(GL_LINES);
 				glVertex3dv(m_pThreeDimensionalShape->input_nmm.vertices[i].second->sphere.center);
-				glVertex3dv(m_pThreeDimensionalShape->input_nmm.BoundaryPoints[*si]);
+				glVertex3d(m_pThreeDimensionalShape->input_nmm.BoundaryPoints.X(*si),m_pThreeDimensionalShape->input_nmm.BoundaryPoints.Y(*si),m_pThreeDimensionalShape->input_nmm.BoundaryPoints.Z(*si));
 			glEnd();
 		}
 	}
@@ -2216,8 +2216,8 @@ void GLWidget::gl_draw_ma_footpoints()
 		else
 			glPointSize(2.);
 		glBegin(GL_POINTS);
-			glVertex3d(m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i][0],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i][1],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i][2]);
-			glVertex3d(m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i].fp[0],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i].fp[1],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i].fp[2]);
+			glVertex3d(m_pThreeDimensionalShape->input_nmm.BoundaryPoints.X(i),m_pThreeDimensionalShape->input_nmm.BoundaryPoints.Y(i),m_pThreeDimensionalShape->input_nmm.BoundaryPoints.Z(i));
+			glVertex3dv(m_pThreeDimensionalShape->input_nmm.BoundaryPoints.FootPoint(i));
 		glEnd();
 	}
 	
@@ -2228,8 +2228,8 @@ void GLWidget::gl_draw_ma_footpoints()
 	glBegin(GL_LINES);
 	for(unsigned int i = 0; i < m_pThreeDimensionalShape->input_nmm.BoundaryPoints.size(); i ++)
 	{
-		glVertex3d(m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i][0],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i][1],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i][2]);
-		glVertex3d(m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i].fp[0],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i].fp[1],m_pThreeDimensionalShape->input_nmm.BoundaryPoints[i].fp[2]);
+		glVertex3d(m_pThreeDimensionalShape->input_nmm.BoundaryPoints.X(i),m_pThreeDimensionalShape->input_nmm.BoundaryPoints.Y(i),m_pThreeDimensionalShape->input_nmm.BoundaryPoints.Z(i));
+		glVertex3dv(m_pThreeDimensionalShape->input_nmm.BoundaryPoints.FootPoint(i));
 	}
 	glEnd();
 	glDisable(GL_LINE_SMOOTH);
@@ -198,6 +198,100 @@ std::vector< Sphere > Cone::SampleSpheres( unsigned num)
 	return vs;
 }
 
+void SamplePointSet::clear()
+{
+	px.clear();
+	py.clear();
+	pz.clear();
+	fpx.clear();
+	fpy.clear();
+	fpz.clear();
+	fpdist.clear();
+	adjacentmedialpointlist.clear();
+	tags.clear();
+}
+
+void SamplePointSet::reserve(size_t n)
+{
+	px.reserve(n);
+	py.reserve(n);
+	pz.reserve(n);
+}
+
+void SamplePointSet::push_back(double x, double y, double z)
+{
+	px.push_back(x);
+	py.push_back(y);
+	pz.push_back(z);
+
+	// keep the side tables which are already allocated in sync
+	if(!fpx.empty())
+	{
+		fpx.push_back(x);
+		fpy.push_back(y);
+		fpz.push_back(z);
+		fpdist.push_back(0.0);
+	}
+	if(!adjacentmedialpointlist.empty())
+		adjacentmedialpointlist.push_back(std::set<unsigned int>());
+	if(!tags.empty())
+		tags.push_back(SamplePointTags());
+}
+
+Wm4::Vector3d SamplePointSet::FootPoint(unsigned i) const
+{
+	if(fpx.empty())
+		return Wm4::Vector3d(px[i], py[i], pz[i]);
+	return Wm4::Vector3d(fpx[i], fpy[i], fpz[i]);
+}
+
+double SamplePointSet::FootPointDistance(unsigned i) const
+{
+	if(fpdist.empty())
+		return 0.0;
+	return fpdist[i];
+}
+
+void SamplePointSet::SetFootPoint(unsigned i, const Wm4::Vector3d & fp, double dist)
+{
+	if(fpx.empty())
+	{
+		fpx = px;
+		fpy = py;
+		fpz = pz;
+		fpdist.assign(px.size(), 0.0);
+	}
+	fpx[i] = fp[0];
+	fpy[i] = fp[1];
+	fpz[i] = fp[2];
+	fpdist[i] = dist;
+}
+
+std::set<unsigned int> & SamplePointSet::AdjacentMedialPoints(unsigned i)
+{
+	if(adjacentmedialpointlist.empty())
+		adjacentmedialpointlist.resize(px.size());
+	return adjacentmedialpointlist[i];
+}
+
+SamplePointTags & SamplePointSet::Tags(unsigned i)
+{
+	if(tags.empty())
+		tags.resize(px.size());
+	return tags[i];
+}
+
+size_t SamplePointSet::MemoryUsage() const
+{
+	size_t bytes = sizeof(double) * (px.capacity() + py.capacity() + pz.capacity());
+	bytes += sizeof(double) * (fpx.capacity() + fpy.capacity() + fpz.capacity() + fpdist.capacity());
+	bytes += sizeof(std::set<unsigned int>) * adjacentmedialpointlist.capacity();
+	for(unsigned i = 0; i < adjacentmedialpointlist.size(); i ++)
+		bytes += adjacentmedialpointlist[i].size() * (sizeof(unsigned int) + 4 * sizeof(void*));
+	bytes += sizeof(SamplePointTags) * tags.capacity();
+	return bytes;
+}
+
 Triangle::Triangle()
 {
 }
@@ -3,6 +3,8 @@
 
 #include "LinearAlgebra/Wm4Matrix.h"
 #include "LinearAlgebra/Wm4Vector.h"
+#include <vector>
+#include <set>
 
 using namespace Wm4;
 
@@ -66,18 +68,18 @@ public:
 	std::vector< Sphere > SampleSpheres(unsigned num);
 };
 
-class SamplePoint : public Wm4::Vector3d
+// per-sample tags, only used by the GUI drawers and the old footpoint code
+class SamplePointTags
 {
 public:
-	SamplePoint() {fp[0] = X(); fp[1] = Y(); fp[2] = Z(); onregion = 0;};
-	SamplePoint(double x,double y,double z) : Vector3d(x,y,z) {fp = Wm4::Vector3d(x,y,z);};
-	~SamplePoint() {};
+	SamplePointTags() : tag(0), connecting_medialpoint(0), onregion(0), tag_int(0), tag_double(0.0), tag_ui(0)
+	{
+		connecting_edge[0] = connecting_edge[1] = -1;
+		connecting_tri[0] = connecting_tri[1] = connecting_tri[2] = -1;
+	}
 
 public:
-	Wm4::Vector3d fp;
-	double fpdist;
 	int tag;
-	std::set<unsigned int> adjacentmedialpointlist;
 	unsigned int connecting_medialpoint;
 	int connecting_edge[2];
 	int connecting_tri[3];
@@ -91,8 +93,52 @@ public:
 	double tag_double;
 	std::set<unsigned int> tag_ui_set;
 	unsigned tag_ui;
+};
+
+// boundary sample points stored as structure of arrays.
+// the footpoints, the adjacent medial points and the tags are side tables 
+// which are only allocated when they are first written.
+class SamplePointSet
+{
+public:
+	SamplePointSet() {}
+
+	void clear();
+	void reserve(size_t n);
+	void push_back(double x, double y, double z);
+	size_t size() const {return px.size();}
+	bool empty() const {return px.empty();}
+
+	double X(unsigned i) const {return px[i];}
+	double Y(unsigned i) const {return py[i];}
+	double Z(unsigned i) const {return pz[i];}
+	Wm4::Vector3d operator[](unsigned i) const {return Wm4::Vector3d(px[i], py[i], pz[i]);}
 
+	// footpoint of the sample, the sample itself if no footpoint was set
+	bool HasFootPoints() const {return !fpx.empty();}
+	Wm4::Vector3d FootPoint(unsigned i) const;
+	double FootPointDistance(unsigned i) const;
+	void SetFootPoint(unsigned i, const Wm4::Vector3d & fp, double dist);
+
+	bool HasAdjacentMedialPoints() const {return !adjacentmedialpointlist.empty();}
+	std::set<unsigned int> & AdjacentMedialPoints(unsigned i);
+
+	bool HasTags() const {return !tags.empty();}
+	SamplePointTags & Tags(unsigned i);
+
+	// bytes held by the store, side tables included
+	size_t MemoryUsage() const;
+
+private:
+	std::vector<double> px, py, pz;
+
+	std::vector<double> fpx, fpy, fpz;
+	std::vector<double> fpdist;
+
+	std::vector< std::set<unsigned int> > adjacentmedialpointlist;
+	std::vector<SamplePointTags> tags;
 };
+
 class Triangle
 {
 public:
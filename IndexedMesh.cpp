@@ -0,0 +1,433 @@
+#include "IndexedMesh.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <ctime>
+#include <cmath>
+
+IndexedMesh::IndexedMesh()
+{
+	clear();
+}
+
+void IndexedMesh::clear()
+{
+	positions.clear();
+	face_offset.clear();
+	face_index.clear();
+	vf_offset.clear();
+	vf_index.clear();
+	vv_offset.clear();
+	vv_index.clear();
+	border.clear();
+	face_normal.clear();
+	vertex_normal.clear();
+	face_color.clear();
+	vertex_color.clear();
+	gaussiancurvature_Meyer.clear();
+
+	m_min[0] = m_min[1] = m_min[2] = 1e20;
+	m_max[0] = m_max[1] = m_max[2] = -1e20;
+	bb_diagonal_length = 0.;
+	m_max_gaussiancurvature_Meyer = -1e20;
+	m_min_gaussiancurvature_Meyer = 1e20;
+}
+
+void IndexedMesh::AddVertex(double x, double y, double z)
+{
+	positions.push_back(x);
+	positions.push_back(y);
+	positions.push_back(z);
+}
+
+void IndexedMesh::AddFace(const unsigned * idx, unsigned degree)
+{
+	if(face_offset.empty())
+		face_offset.push_back(0);
+	face_index.insert(face_index.end(), idx, idx + degree);
+	face_offset.push_back((unsigned)face_index.size());
+}
+
+// next non-empty line with the comment stripped
+static bool NextOFFLine(std::istream & in, std::string & line)
+{
+	while(std::getline(in, line))
+	{
+		size_t pos = line.find('#');
+		if(pos != std::string::npos)
+			line.erase(pos);
+		if(line.find_first_not_of(" \t\r\n") != std::string::npos)
+			return true;
+	}
+	return false;
+}
+
+bool IndexedMesh::LoadOFF(const std::string & filename, std::string & error)
+{
+	std::ifstream in(filename.c_str());
+	if(!in)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+	return LoadOFF(in, error);
+}
+
+bool IndexedMesh::LoadOFF(std::istream & in, std::string & error)
+{
+	clear();
+
+	std::string line;
+	if(!NextOFFLine(in, line))
+	{
+		error = "Empty OFF file";
+		return false;
+	}
+
+	// the counts follow the keyword on its line ("OFF nv nf ne") or on the next
+	// one, the edge count is optional and unused in both forms
+	std::istringstream header(line);
+	std::string keyword;
+	header >> keyword;
+	if(keyword.size() < 3 || keyword.compare(keyword.size() - 3, 3, "OFF") != 0)
+	{
+		error = "Missing OFF header";
+		return false;
+	}
+	line.clear();
+	std::getline(header, line);
+	if(line.find_first_not_of(" \t\r") == std::string::npos && !NextOFFLine(in, line))
+	{
+		error = "Missing OFF counts";
+		return false;
+	}
+	std::istringstream counts(line);
+	unsigned nv(0), nf(0);
+	if(!(counts >> nv >> nf))
+	{
+		error = "Invalid OFF counts";
+		return false;
+	}
+
+	positions.reserve(3 * nv);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		double x, y, z;
+		if(!NextOFFLine(in, line))
+		{
+			error = "Unexpected end of file in vertex list";
+			return false;
+		}
+		std::istringstream vs(line);
+		if(!(vs >> x >> y >> z))
+		{
+			error = "Invalid vertex line";
+			return false;
+		}
+		AddVertex(x, y, z);
+	}
+
+	face_offset.reserve(nf + 1);
+	face_index.reserve(3 * nf);
+	std::vector<unsigned> idx;
+	for(unsigned i = 0; i < nf; i ++)
+	{
+		unsigned degree;
+		if(!NextOFFLine(in, line))
+		{
+			error = "Unexpected end of file in face list";
+			return false;
+		}
+		std::istringstream fs(line);
+		if(!(fs >> degree) || degree < 3)
+		{
+			error = "Invalid face line";
+			return false;
+		}
+		idx.resize(degree);
+		for(unsigned j = 0; j < degree; j ++)
+		{
+			if(!(fs >> idx[j]) || idx[j] >= nv)
+			{
+				error = "Invalid face index";
+				return false;
+			}
+		}
+		AddFace(&idx[0], degree);
+	}
+
+	return true;
+}
+
+void IndexedMesh::BuildAdjacency()
+{
+	int nv = (int)NumVertices();
+	int nf = (int)NumFaces();
+
+	// vertex -> face, counting sort over the face corners
+	vf_offset.assign(nv + 1, 0);
+	for(unsigned i = 0; i < face_index.size(); i ++)
+		vf_offset[face_index[i] + 1] ++;
+	for(int i = 0; i < nv; i ++)
+		vf_offset[i + 1] += vf_offset[i];
+	vf_index.resize(face_index.size());
+	std::vector<unsigned> fill(vf_offset.begin(), vf_offset.end() - 1);
+	for(int f = 0; f < nf; f ++)
+		for(unsigned j = face_offset[f]; j < face_offset[f + 1]; j ++)
+			vf_index[fill[face_index[j]] ++] = f;
+
+	// vertex -> vertex, the one-ring is gathered from the incident faces;
+	// an edge seen from a single face is a border edge
+	std::vector< std::vector<unsigned> > ring(nv);
+	border.assign(nv, 0);
+#pragma omp parallel for
+	for(int i = 0; i < nv; i ++)
+	{
+		std::vector<unsigned> & r = ring[i];
+		for(unsigned k = vf_offset[i]; k < vf_offset[i + 1]; k ++)
+		{
+			unsigned f = vf_index[k];
+			unsigned deg = FaceDegree(f);
+			for(unsigned j = 0; j < deg; j ++)
+			{
+				if(face_index[face_offset[f] + j] != (unsigned)i)
+					continue;
+				r.push_back(face_index[face_offset[f] + (j + deg - 1) % deg]);
+				r.push_back(face_index[face_offset[f] + (j + 1) % deg]);
+			}
+		}
+		std::sort(r.begin(), r.end());
+		bool isborder = r.empty();
+		for(unsigned j = 0; j < r.size(); )
+		{
+			unsigned k = j;
+			while(k < r.size() && r[k] == r[j])
+				k ++;
+			if(k - j == 1)
+				isborder = true;
+			j = k;
+		}
+		border[i] = isborder;
+		r.erase(std::unique(r.begin(), r.end()), r.end());
+	}
+
+	vv_offset.assign(nv + 1, 0);
+	for(int i = 0; i < nv; i ++)
+		vv_offset[i + 1] = vv_offset[i] + (unsigned)ring[i].size();
+	vv_index.resize(vv_offset[nv]);
+#pragma omp parallel for
+	for(int i = 0; i < nv; i ++)
+		std::copy(ring[i].begin(), ring[i].end(), vv_index.begin() + vv_offset[i]);
+}
+
+void IndexedMesh::computebb()
+{
+	int nv = (int)NumVertices();
+
+	m_min[0] = m_min[1] = m_min[2] = 1e20;
+	m_max[0] = m_max[1] = m_max[2] = -1e20;
+
+#pragma omp parallel
+	{
+		double lmin[3] = {1e20, 1e20, 1e20};
+		double lmax[3] = {-1e20, -1e20, -1e20};
+#pragma omp for
+		for(int i = 0; i < nv; i ++)
+		{
+			for(int d = 0; d < 3; d ++)
+			{
+				lmin[d] = std::min(lmin[d], positions[3 * i + d]);
+				lmax[d] = std::max(lmax[d], positions[3 * i + d]);
+			}
+		}
+#pragma omp critical
+		{
+			for(int d = 0; d < 3; d ++)
+			{
+				m_min[d] = std::min(m_min[d], lmin[d]);
+				m_max[d] = std::max(m_max[d], lmax[d]);
+			}
+		}
+	}
+
+	bb_diagonal_length = sqrt((m_max[0] - m_min[0]) * (m_max[0] - m_min[0]) + (m_max[1] - m_min[1]) * (m_max[1] - m_min[1])
+						+(m_max[2] - m_min[2]) * (m_max[2] - m_min[2]));
+}
+
+// a triangle contributes A s / 3 and A / 12 (a a^T + b b^T + c c^T + s s^T)
+// with s = a + b + c, taken about the first corner for the conditioning
+void IndexedMesh::SurfaceMoments(const std::vector<unsigned> & faces, double & area, Wm4::Vector3d & centroid, Wm4::Matrix3d & covariance) const
+{
+	area = 0.;
+	centroid = Wm4::Vector3d(0., 0., 0.);
+	covariance = Wm4::Matrix3d(0., 0., 0., 0., 0., 0., 0., 0., 0.);
+	if(faces.empty())
+		return;
+
+	Wm4::Vector3d origin = Position(face_index[face_offset[faces[0]]]);
+	Wm4::Vector3d first(0., 0., 0.);
+	Wm4::Matrix3d second(0., 0., 0., 0., 0., 0., 0., 0., 0.);
+	for(size_t i = 0; i < faces.size(); i ++)
+	{
+		const unsigned * idx = &face_index[face_offset[faces[i]]];
+		Wm4::Vector3d a = Position(idx[0]) - origin;
+		for(unsigned k = 1; k + 1 < FaceDegree(faces[i]); k ++)
+		{
+			Wm4::Vector3d b = Position(idx[k]) - origin;
+			Wm4::Vector3d c = Position(idx[k + 1]) - origin;
+			Wm4::Vector3d s = a + b + c;
+			double w = 0.5 * (b - a).Cross(c - a).Length();
+			area += w;
+			first += (w / 3.) * s;
+			const Wm4::Vector3d * v[4] = { &a, &b, &c, &s };
+			for(int j = 0; j < 4; j ++)
+				for(int r = 0; r < 3; r ++)
+					for(int q = 0; q < 3; q ++)
+						second[r][q] += w / 12. * (*v[j])[r] * (*v[j])[q];
+		}
+	}
+	if(area == 0.)
+		return;
+
+	Wm4::Vector3d mean = first / area;
+	for(int r = 0; r < 3; r ++)
+		for(int q = 0; q < 3; q ++)
+			covariance[r][q] = second[r][q] / area - mean[r] * mean[q];
+	centroid = origin + mean;
+}
+
+// same averaging of corner normals as the Facet_normal functor
+void IndexedMesh::compute_normals_per_facet()
+{
+	int nf = (int)NumFaces();
+	face_normal.assign(3 * nf, 0.);
+
+#pragma omp parallel for
+	for(int f = 0; f < nf; f ++)
+	{
+		unsigned deg = FaceDegree(f);
+		const unsigned * fi = &face_index[face_offset[f]];
+		Wm4::Vector3d sum(Wm4::Vector3d::ZERO);
+		for(unsigned j = 0; j < deg; j ++)
+		{
+			Wm4::Vector3d p0 = Position(fi[j]);
+			Wm4::Vector3d p1 = Position(fi[(j + 1) % deg]);
+			Wm4::Vector3d p2 = Position(fi[(j + 2) % deg]);
+			Wm4::Vector3d normal = (p1 - p0).Cross(p2 - p1);
+			double sqnorm = normal.SquaredLength();
+			if(sqnorm != 0)
+				normal = normal / std::sqrt(sqnorm);
+			sum += normal;
+		}
+		double sqnorm = sum.SquaredLength();
+		if(sqnorm != 0)
+			sum = sum / std::sqrt(sqnorm);
+		face_normal[3 * f] = sum[0];
+		face_normal[3 * f + 1] = sum[1];
+		face_normal[3 * f + 2] = sum[2];
+	}
+}
+
+// same as the Vertex_normal functor, sum of the incident face normals
+void IndexedMesh::compute_normals_per_vertex()
+{
+	int nv = (int)NumVertices();
+	vertex_normal.assign(3 * nv, 0.);
+
+#pragma omp parallel for
+	for(int i = 0; i < nv; i ++)
+	{
+		double n[3] = {0., 0., 0.};
+		for(unsigned k = vf_offset[i]; k < vf_offset[i + 1]; k ++)
+			for(int d = 0; d < 3; d ++)
+				n[d] += face_normal[3 * vf_index[k] + d];
+		double sqnorm = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+		if(sqnorm != 0)
+			for(int d = 0; d < 3; d ++)
+				vertex_normal[3 * i + d] = n[d] / std::sqrt(sqnorm);
+	}
+}
+
+void IndexedMesh::compute_normals()
+{
+	compute_normals_per_facet();
+	compute_normals_per_vertex();
+}
+
+// rand() is not usable from several threads, every element hashes its own index
+static inline double HashColor(unsigned seed, unsigned i)
+{
+	unsigned h = seed ^ (i * 0x9E3779B9u);
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h / (double)0xFFFFFFFFu;
+}
+
+void IndexedMesh::GenerateRandomColor()
+{
+	int nv = (int)NumVertices();
+	int nf = (int)NumFaces();
+	unsigned seed = (unsigned)time(NULL);
+
+	vertex_color.resize(3 * nv);
+	face_color.resize(3 * nf);
+
+#pragma omp parallel for
+	for(int i = 0; i < 3 * nv; i ++)
+		vertex_color[i] = HashColor(seed, i);
+
+#pragma omp parallel for
+	for(int i = 0; i < 3 * nf; i ++)
+		face_color[i] = HashColor(seed + 1, i);
+}
+
+void IndexedMesh::ComputeVertexGaussianCurvature_Meyer()
+{
+	int nv = (int)NumVertices();
+	gaussiancurvature_Meyer.assign(nv, 0.);
+
+#pragma omp parallel for
+	for(int i = 0; i < nv; i ++)
+	{
+		if(border[i])
+			continue;
+
+		double area(0.0);
+		double angle(0.0);
+		Wm4::Vector3d v = Position(i);
+		for(unsigned k = vf_offset[i]; k < vf_offset[i + 1]; k ++)
+		{
+			unsigned f = vf_index[k];
+			unsigned deg = FaceDegree(f);
+			const unsigned * fi = &face_index[face_offset[f]];
+			for(unsigned j = 0; j < deg; j ++)
+			{
+				if(fi[j] != (unsigned)i)
+					continue;
+				Wm4::Vector3d vp = Position(fi[(j + deg - 1) % deg]);
+				Wm4::Vector3d va = Position(fi[(j + 1) % deg]);
+
+				Triangle t(v,vp,va);
+				area += t.voronoi_area_Meyer(0);
+				angle += angle_from_cotan(v,vp,va);
+			}
+		}
+
+		gaussiancurvature_Meyer[i] = (2. * Wm4::Mathd::PI - angle) / area;
+	}
+
+	m_max_gaussiancurvature_Meyer = -1e20;
+	m_min_gaussiancurvature_Meyer = 1e20;
+	for(int i = 0; i < nv; i ++)
+	{
+		if(border[i])
+			continue;
+		m_max_gaussiancurvature_Meyer = std::max(m_max_gaussiancurvature_Meyer, gaussiancurvature_Meyer[i]);
+		m_min_gaussiancurvature_Meyer = std::min(m_min_gaussiancurvature_Meyer, gaussiancurvature_Meyer[i]);
+	}
+}
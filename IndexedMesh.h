@@ -0,0 +1,73 @@
+#ifndef _INDEXEDMESH_H
+#define _INDEXEDMESH_H
+
+#include <vector>
+#include <string>
+#include <iosfwd>
+
+#include "LinearAlgebra/Wm4Vector.h"
+#include "LinearAlgebra/Wm4Matrix.h"
+
+// flat indexed face set of the input surface
+// positions and faces are plain arrays, the vertex-face and vertex-vertex
+// adjacency is stored in CSR form (offset array + index array), so the
+// per-element passes run as parallel loops without walking halfedges
+class IndexedMesh
+{
+public:
+	IndexedMesh();
+
+	void clear();
+	bool LoadOFF(const std::string & filename, std::string & error);
+	bool LoadOFF(std::istream & in, std::string & error);
+
+	void AddVertex(double x, double y, double z);
+	// the face is appended as one polygon, degree >= 3
+	void AddFace(const unsigned * idx, unsigned degree);
+
+	// build vf / vv adjacency and the border flags, call once after loading
+	void BuildAdjacency();
+
+	unsigned NumVertices() const {return (unsigned)(positions.size() / 3);}
+	unsigned NumFaces() const {return face_offset.empty() ? 0 : (unsigned)(face_offset.size() - 1);}
+	unsigned FaceDegree(unsigned f) const {return face_offset[f + 1] - face_offset[f];}
+	Wm4::Vector3d Position(unsigned i) const {return Wm4::Vector3d(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);}
+
+	// parallel kernels, counterparts of the MPMesh passes of the same name
+	void computebb();
+	void compute_normals_per_facet();
+	void compute_normals_per_vertex();
+	void compute_normals();
+	void GenerateRandomColor();
+	void ComputeVertexGaussianCurvature_Meyer();
+
+	// area, centroid and covariance of the surface of the listed faces,
+	// polygons are split into fans
+	void SurfaceMoments(const std::vector<unsigned> & faces, double & area, Wm4::Vector3d & centroid, Wm4::Matrix3d & covariance) const;
+
+public:
+	std::vector<double> positions;		// x, y, z triplets
+	std::vector<unsigned> face_offset;	// face f is face_index[face_offset[f] .. face_offset[f+1])
+	std::vector<unsigned> face_index;
+
+	std::vector<unsigned> vf_offset;	// faces around each vertex
+	std::vector<unsigned> vf_index;
+	std::vector<unsigned> vv_offset;	// one-ring of each vertex, sorted
+	std::vector<unsigned> vv_index;
+	std::vector<char> border;			// vertex touches a border edge or is isolated
+
+	double m_min[3];
+	double m_max[3];
+	double bb_diagonal_length;
+
+	std::vector<double> face_normal;	// x, y, z triplets
+	std::vector<double> vertex_normal;
+	std::vector<double> face_color;
+	std::vector<double> vertex_color;
+
+	std::vector<double> gaussiancurvature_Meyer;
+	double m_max_gaussiancurvature_Meyer;
+	double m_min_gaussiancurvature_Meyer;
+};
+
+#endif // _INDEXEDMESH_H
@@ -0,0 +1,311 @@
+#include "Logger.h"
+
+#include <chrono>
+#include <cstring>
+
+// messages in flight, a power of two
+static const size_t log_ring_size = 4096;
+
+std::atomic<int> Logger::min_level(LOG_INFO);
+
+static const std::chrono::steady_clock::time_point log_start = std::chrono::steady_clock::now();
+
+static const char * LevelName(LogLevel level)
+{
+	switch(level)
+	{
+	case LOG_DEBUG: return "debug";
+	case LOG_INFO: return "info";
+	case LOG_WARN: return "warn";
+	default: return "error";
+	}
+}
+
+// small sequential thread numbers are easier to read than native ids
+static unsigned ThreadNumber()
+{
+	static std::atomic<unsigned> next(0);
+	static thread_local unsigned number = next ++;
+	return number;
+}
+
+bool Logger::ParseLevel(const std::string & name, LogLevel & level)
+{
+	for(int l = LOG_DEBUG; l <= LOG_ERROR; l ++)
+		if(name == LevelName((LogLevel)l))
+		{
+			level = (LogLevel)l;
+			return true;
+		}
+	return false;
+}
+
+Logger & Logger::Instance()
+{
+	static Logger logger;
+	return logger;
+}
+
+Logger::Logger()
+	: ring(new Slot[log_ring_size]), mask(log_ring_size - 1), enqueue_pos(0), dequeue_pos(0), written(0),
+	  stopping(false), format(TEXT), file((FILE *)NULL), to_stderr(false)
+{
+	for(size_t i = 0; i < log_ring_size; i ++)
+		ring[i].sequence.store(i, std::memory_order_relaxed);
+	writer = std::thread(&Logger::WriterLoop, this);
+}
+
+Logger::~Logger()
+{
+	stopping.store(true);
+	writer.join();
+	FILE * f = file.load();
+	if(f)
+		fclose(f);
+	delete [] ring;
+}
+
+bool Logger::SetFile(const std::string & filename, std::string & error)
+{
+	FILE * f = NULL;
+	if(!filename.empty())
+	{
+		f = fopen(filename.c_str(), "w");
+		if(!f)
+		{
+			error = "Could not open file " + filename;
+			return false;
+		}
+	}
+	Flush();
+	FILE * old = file.exchange(f);
+	if(old)
+		fclose(old);
+	return true;
+}
+
+// bounded multi-producer queue: a slot is free for position pos when its
+// sequence equals pos and holds a record once the sequence is pos + 1
+void Logger::Push(LogRecord & record)
+{
+	size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+	Slot * slot;
+	for(;;)
+	{
+		slot = &ring[pos & mask];
+		size_t seq = slot->sequence.load(std::memory_order_acquire);
+		long long diff = (long long)seq - (long long)pos;
+		if(diff == 0)
+		{
+			if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if(diff < 0)
+		{
+			// full, wait for the writer
+			std::this_thread::yield();
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+		else
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+	}
+
+	slot->record.level = record.level;
+	slot->record.tag = record.tag;
+	slot->record.time = record.time;
+	slot->record.thread = record.thread;
+	slot->record.text.swap(record.text);
+	slot->record.fields.swap(record.fields);
+	slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void Logger::Flush()
+{
+	size_t target = enqueue_pos.load();
+	while(written.load() < target)
+		std::this_thread::sleep_for(std::chrono::microseconds(200));
+}
+
+static void AppendJsonString(std::string & out, const std::string & s)
+{
+	out += '"';
+	for(size_t i = 0; i < s.size(); i ++)
+	{
+		unsigned char ch = (unsigned char)s[i];
+		switch(ch)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if(ch < 0x20)
+			{
+				char buf[8];
+				sprintf(buf, "\\u%04x", ch);
+				out += buf;
+			}
+			else
+				out += (char)ch;
+		}
+	}
+	out += '"';
+}
+
+void Logger::Write(const LogRecord & record, std::string & out_buffer, std::string & err_buffer)
+{
+	if(format.load() == JSON)
+	{
+		char head[64];
+		sprintf(head, "{\"time\":%.6f,\"level\":", record.time);
+		std::string & out = file.load() || record.level < LOG_WARN ? out_buffer : err_buffer;
+		out += head;
+		AppendJsonString(out, LevelName(record.level));
+		out += ",\"tag\":";
+		AppendJsonString(out, record.tag);
+		sprintf(head, ",\"thread\":%u,\"msg\":", record.thread);
+		out += head;
+		AppendJsonString(out, record.text);
+		for(size_t i = 0; i < record.fields.size(); i ++)
+		{
+			out += ',';
+			AppendJsonString(out, record.fields[i].key);
+			out += ':';
+			if(record.fields[i].quoted)
+				AppendJsonString(out, record.fields[i].value);
+			else
+				out += record.fields[i].value;
+		}
+		out += "}\n";
+	}
+	else
+	{
+		std::string & out = file.load() || record.level < LOG_WARN ? out_buffer : err_buffer;
+		out += record.text;
+		out += '\n';
+	}
+}
+
+// drains the ring in batches, one write and one flush per batch
+void Logger::WriterLoop()
+{
+	std::string out_buffer, err_buffer;
+	for(;;)
+	{
+		bool stop = stopping.load();
+		size_t count = 0;
+		for(;;)
+		{
+			Slot & slot = ring[dequeue_pos & mask];
+			if(slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1)
+				break;
+			Write(slot.record, out_buffer, err_buffer);
+			slot.record.text.clear();
+			slot.record.fields.clear();
+			slot.sequence.store(dequeue_pos + log_ring_size, std::memory_order_release);
+			dequeue_pos ++;
+			count ++;
+		}
+
+		if(count > 0)
+		{
+			FILE * f = file.load();
+			FILE * out = f ? f : (to_stderr.load() ? stderr : stdout);
+			if(!out_buffer.empty())
+			{
+				fwrite(out_buffer.data(), 1, out_buffer.size(), out);
+				fflush(out);
+				out_buffer.clear();
+			}
+			if(!err_buffer.empty())
+			{
+				fwrite(err_buffer.data(), 1, err_buffer.size(), stderr);
+				fflush(stderr);
+				err_buffer.clear();
+			}
+			written.fetch_add(count);
+		}
+		else if(stop)
+			return;
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+}
+
+LogMessage::LogMessage(LogLevel level, const char * tag)
+{
+	record.level = level;
+	record.tag = tag;
+	record.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - log_start).count();
+	record.thread = ThreadNumber();
+}
+
+LogMessage::~LogMessage()
+{
+	record.text = text.str();
+	Logger::Instance().Push(record);
+}
+
+LogMessage & LogMessage::Field(const char * key, const std::string & value)
+{
+	LogField field;
+	field.key = key;
+	field.value = value;
+	field.quoted = true;
+	record.fields.push_back(field);
+	return *this;
+}
+
+LogMessage & LogMessage::Field(const char * key, const char * value)
+{
+	return Field(key, std::string(value));
+}
+
+LogMessage & LogMessage::Field(const char * key, double value)
+{
+	LogField field;
+	field.key = key;
+	field.quoted = false;
+	// json has no inf or nan
+	if(value != value || value > 1e308 || value < -1e308)
+		field.value = "null";
+	else
+	{
+		char buf[32];
+		sprintf(buf, "%.17g", value);
+		field.value = buf;
+	}
+	record.fields.push_back(field);
+	return *this;
+}
+
+LogMessage & LogMessage::Field(const char * key, long long value)
+{
+	LogField field;
+	field.key = key;
+	field.value = std::to_string(value);
+	field.quoted = false;
+	record.fields.push_back(field);
+	return *this;
+}
+
+LogMessage & LogMessage::Field(const char * key, unsigned long long value)
+{
+	LogField field;
+	field.key = key;
+	field.value = std::to_string(value);
+	field.quoted = false;
+	record.fields.push_back(field);
+	return *this;
+}
+
+LogMessage & LogMessage::Field(const char * key, bool value)
+{
+	LogField field;
+	field.key = key;
+	field.value = value ? "true" : "false";
+	field.quoted = false;
+	record.fields.push_back(field);
+	return *this;
+}
@@ -0,0 +1,148 @@
+#ifndef _LOGGER_H
+#define _LOGGER_H
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <cstdio>
+
+enum LogLevel
+{
+	LOG_DEBUG = 0,
+	LOG_INFO = 1,
+	LOG_WARN = 2,
+	LOG_ERROR = 3
+};
+
+// messages below this level are removed by the compiler, release builds drop debug
+#ifndef QMAT_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define QMAT_LOG_MIN_LEVEL 1
+#else
+#define QMAT_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+// one key/value pair of a message, value already formatted
+class LogField
+{
+public:
+	std::string key;
+	std::string value;
+	bool quoted;
+};
+
+class LogRecord
+{
+public:
+	LogLevel level;
+	const char * tag;
+	double time;
+	unsigned thread;
+	std::string text;
+	std::vector<LogField> fields;
+};
+
+// Process-wide logger. Producers format a record and push it into a fixed-size
+// lock-free ring, a background thread writes it out, so a message never flushes
+// a stream on the producing thread. A full ring makes the producer wait instead
+// of dropping messages.
+//   text format: the message only, debug/info to stdout, warn/error to stderr
+//                (everything to stderr after UseStderr, when stdout carries data)
+//   json format: one object per line with time, level, tag, thread, msg and the fields
+class Logger
+{
+public:
+	enum Format { TEXT, JSON };
+
+	static Logger & Instance();
+	static bool Enabled(LogLevel level) { return (int)level >= min_level.load(std::memory_order_relaxed); }
+
+	void SetLevel(LogLevel level) { min_level.store((int)level, std::memory_order_relaxed); }
+	void SetFormat(Format f) { format.store((int)f); }
+	// all levels go to the file, empty name restores stdout/stderr
+	bool SetFile(const std::string & filename, std::string & error);
+	void UseStderr() { Flush(); to_stderr.store(true); }
+
+	void Push(LogRecord & record);
+	// returns once everything pushed before the call has been written
+	void Flush();
+
+	static bool ParseLevel(const std::string & name, LogLevel & level);
+
+private:
+	Logger();
+	~Logger();
+	Logger(const Logger &);
+	Logger & operator=(const Logger &);
+
+	void WriterLoop();
+	void Write(const LogRecord & record, std::string & out_buffer, std::string & err_buffer);
+
+	class Slot
+	{
+	public:
+		std::atomic<size_t> sequence;
+		LogRecord record;
+	};
+
+	static std::atomic<int> min_level;
+
+	Slot * ring;
+	size_t mask;
+	std::atomic<size_t> enqueue_pos;
+	size_t dequeue_pos;
+	std::atomic<size_t> written;
+	std::atomic<bool> stopping;
+	std::atomic<int> format;
+	std::atomic<FILE *> file;
+	std::atomic<bool> to_stderr;
+	std::thread writer;
+};
+
+// collects one message, pushed to the logger when it goes out of scope
+class LogMessage
+{
+public:
+	LogMessage(LogLevel level, const char * tag);
+	~LogMessage();
+
+	template<class T>
+	LogMessage & operator<<(const T & value)
+	{
+		text << value;
+		return *this;
+	}
+
+	// structured data, only written by the json format
+	LogMessage & Field(const char * key, const std::string & value);
+	LogMessage & Field(const char * key, const char * value);
+	LogMessage & Field(const char * key, double value);
+	LogMessage & Field(const char * key, long long value);
+	LogMessage & Field(const char * key, unsigned long long value);
+	LogMessage & Field(const char * key, int value) { return Field(key, (long long)value); }
+	LogMessage & Field(const char * key, unsigned value) { return Field(key, (unsigned long long)value); }
+	LogMessage & Field(const char * key, long value) { return Field(key, (long long)value); }
+	LogMessage & Field(const char * key, unsigned long value) { return Field(key, (unsigned long long)value); }
+	LogMessage & Field(const char * key, bool value);
+
+private:
+	LogRecord record;
+	std::ostringstream text;
+};
+
+// QMAT_LOG_INFO("dt") << "Computing ..." ; QMAT_LOG_INFO("dt").Field("cells", n) << "..."
+// the message is neither formatted nor evaluated when the level is disabled
+#define QMAT_LOG(level, tag) if(!Logger::Enabled(level)) ; else LogMessage(level, tag)
+#if QMAT_LOG_MIN_LEVEL <= 0
+#define QMAT_LOG_DEBUG(tag) QMAT_LOG(LOG_DEBUG, tag)
+#else
+#define QMAT_LOG_DEBUG(tag) if(true) ; else LogMessage(LOG_DEBUG, tag)
+#endif
+#define QMAT_LOG_INFO(tag) QMAT_LOG(LOG_INFO, tag)
+#define QMAT_LOG_WARN(tag) QMAT_LOG(LOG_WARN, tag)
+#define QMAT_LOG_ERROR(tag) QMAT_LOG(LOG_ERROR, tag)
+
+#endif // _LOGGER_H
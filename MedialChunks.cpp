@@ -0,0 +1,586 @@
+#include "MedialChunks.h"
+#include "SpatialOrder.h"
+
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <algorithm>
+
+static const char chunk_magic[8] = {'Q', 'M', 'A', 'T', 'C', 'H', 'K', '1'};
+
+// magic + 7 unsigned + 6 double
+static const unsigned long long header_size = 8 + 7 * sizeof(unsigned) + 6 * sizeof(double);
+// 6 float + offset + 4 unsigned
+static const unsigned long long directory_entry_size = 6 * sizeof(float) + sizeof(unsigned long long) + 4 * sizeof(unsigned);
+
+void MedialMeshData::clear()
+{
+	spheres.clear();
+	edges.clear();
+	faces.clear();
+}
+
+bool MedialMeshData::LoadMA(const std::string & filename, std::string & error)
+{
+	std::ifstream in(filename.c_str());
+	if(!in)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+	return LoadMA(in, error);
+}
+
+bool MedialMeshData::LoadMA(std::istream & in, std::string & error)
+{
+	clear();
+
+	unsigned nv, ne, nf;
+	if(!(in >> nv >> ne >> nf))
+	{
+		error = "Invalid .ma header";
+		return false;
+	}
+
+	spheres.resize(4 * nv);
+	edges.resize(2 * ne);
+	faces.resize(3 * nf);
+	char ch;
+	for(unsigned i = 0; i < nv; i ++)
+		in >> ch >> spheres[4 * i] >> spheres[4 * i + 1] >> spheres[4 * i + 2] >> spheres[4 * i + 3];
+	for(unsigned i = 0; i < ne; i ++)
+		in >> ch >> edges[2 * i] >> edges[2 * i + 1];
+	for(unsigned i = 0; i < nf; i ++)
+		in >> ch >> faces[3 * i] >> faces[3 * i + 1] >> faces[3 * i + 2];
+
+	if(!in)
+	{
+		error = "Unexpected end of .ma file";
+		return false;
+	}
+	for(unsigned i = 0; i < edges.size(); i ++)
+		if(edges[i] >= nv)
+		{
+			error = "Invalid vertex index in .ma edge";
+			return false;
+		}
+	for(unsigned i = 0; i < faces.size(); i ++)
+		if(faces[i] >= nv)
+		{
+			error = "Invalid vertex index in .ma face";
+			return false;
+		}
+	return true;
+}
+
+bool MedialMeshData::SaveMA(const std::string & filename, std::string & error) const
+{
+	std::ofstream fout(filename.c_str());
+	if(!fout)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+	if(!SaveMA(fout, error))
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+bool MedialMeshData::SaveMA(std::ostream & fout, std::string & error) const
+{
+	fout << NumVertices() << " " << NumEdges() << " " << NumFaces() << std::endl;
+	for(unsigned i = 0; i < NumVertices(); i ++)
+		fout << "v " << std::setiosflags(std::ios::fixed) << std::setprecision(15) << spheres[4 * i] << ' ' << spheres[4 * i + 1] << ' '
+			<< spheres[4 * i + 2] << " " << spheres[4 * i + 3] << std::endl;
+	for(unsigned i = 0; i < NumEdges(); i ++)
+		fout << "e " << edges[2 * i] << " " << edges[2 * i + 1] << std::endl;
+	for(unsigned i = 0; i < NumFaces(); i ++)
+		fout << "f " << faces[3 * i] << " " << faces[3 * i + 1] << " " << faces[3 * i + 2] << std::endl;
+
+	if(!fout)
+	{
+		error = "Could not write .ma stream";
+		return false;
+	}
+	return true;
+}
+
+bool MedialChunkBrick::Intersects(const double mn[3], const double mx[3]) const
+{
+	for(int d = 0; d < 3; d ++)
+		if(box_max[d] < mn[d] || box_min[d] > mx[d])
+			return false;
+	return true;
+}
+
+template <class T>
+static void WriteValue(std::ofstream & out, const T & v)
+{
+	out.write((const char *)&v, sizeof(T));
+}
+
+template <class T>
+static void ReadValue(std::ifstream & in, T & v)
+{
+	in.read((char *)&v, sizeof(T));
+}
+
+// float box that contains the double box
+static void OutwardBox(const double mn[3], const double mx[3], float fmn[3], float fmx[3])
+{
+	for(int d = 0; d < 3; d ++)
+	{
+		fmn[d] = (float)mn[d];
+		if(fmn[d] > mn[d])
+			fmn[d] = nextafterf(fmn[d], -HUGE_VALF);
+		fmx[d] = (float)mx[d];
+		if(fmx[d] < mx[d])
+			fmx[d] = nextafterf(fmx[d], HUGE_VALF);
+	}
+}
+
+class BrickContent
+{
+public:
+	std::vector<unsigned> vertices;
+	std::vector<unsigned> ghosts;
+	std::vector<unsigned> edges;
+	std::vector<unsigned> faces;
+};
+
+bool WriteMedialChunks(const MedialMeshData & mesh, const std::string & filename, unsigned vertices_per_brick, std::string & error)
+{
+	unsigned nv = mesh.NumVertices();
+	unsigned ne = mesh.NumEdges();
+	unsigned nf = mesh.NumFaces();
+	if(vertices_per_brick == 0)
+		vertices_per_brick = 1;
+
+	double mn[3] = {0., 0., 0.}, mx[3] = {0., 0., 0.};
+	if(nv > 0)
+	{
+		for(int d = 0; d < 3; d ++)
+			mn[d] = mx[d] = mesh.spheres[d];
+		for(unsigned i = 0; i < nv; i ++)
+			for(int d = 0; d < 3; d ++)
+			{
+				mn[d] = std::min(mn[d], mesh.spheres[4 * i + d] - mesh.spheres[4 * i + 3]);
+				mx[d] = std::max(mx[d], mesh.spheres[4 * i + d] + mesh.spheres[4 * i + 3]);
+			}
+	}
+
+	// cubic cells sized for about vertices_per_brick vertices each
+	unsigned grid[3] = {1, 1, 1};
+	double ext[3];
+	int ndims = 0;
+	double volume = 1.;
+	for(int d = 0; d < 3; d ++)
+	{
+		ext[d] = mx[d] - mn[d];
+		if(ext[d] > 0)
+		{
+			volume *= ext[d];
+			ndims ++;
+		}
+	}
+	unsigned target = (nv + vertices_per_brick - 1) / vertices_per_brick;
+	if(target > 1 && ndims > 0)
+	{
+		double cell = pow(volume / target, 1. / ndims);
+		for(int d = 0; d < 3; d ++)
+			if(ext[d] > 0)
+				grid[d] = std::max(1u, std::min(1024u, (unsigned)ceil(ext[d] / cell)));
+	}
+
+	// vertices to cells
+	std::vector<unsigned> vertex_cell(nv);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		unsigned c[3];
+		for(int d = 0; d < 3; d ++)
+		{
+			double t = ext[d] > 0 ? (mesh.spheres[4 * i + d] - mn[d]) / ext[d] : 0.;
+			c[d] = std::min(grid[d] - 1, (unsigned)std::max(0., t * grid[d]));
+		}
+		vertex_cell[i] = (c[2] * grid[1] + c[1]) * grid[0] + c[0];
+	}
+
+	// non-empty cells become bricks, in Morton order of the cells
+	std::map<unsigned, unsigned> cell_brick;
+	for(unsigned i = 0; i < nv; i ++)
+		cell_brick[vertex_cell[i]] = 0;
+	std::vector<unsigned> cells;
+	std::vector<unsigned long long> keys;
+	double cmn[3] = {0., 0., 0.};
+	double cmx[3] = {(double)grid[0], (double)grid[1], (double)grid[2]};
+	for(std::map<unsigned, unsigned>::iterator mi = cell_brick.begin(); mi != cell_brick.end(); mi ++)
+	{
+		unsigned c = mi->first;
+		Wm4::Vector3d p(c % grid[0] + 0.5, (c / grid[0]) % grid[1] + 0.5, c / (grid[0] * grid[1]) + 0.5);
+		cells.push_back(c);
+		keys.push_back(MortonCode(p, cmn, cmx));
+	}
+	std::vector<unsigned> order;
+	RadixSortIndices(keys, order);
+	for(unsigned i = 0; i < order.size(); i ++)
+		cell_brick[cells[order[i]]] = i;
+
+	unsigned nbricks = (unsigned)cells.size();
+	std::vector<unsigned> vertex_brick(nv);
+	std::vector<BrickContent> content(nbricks);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		vertex_brick[i] = cell_brick[vertex_cell[i]];
+		content[vertex_brick[i]].vertices.push_back(i);
+	}
+
+	// cones and slabs go to the brick of their smallest vertex id
+	for(unsigned i = 0; i < ne; i ++)
+	{
+		const unsigned * v = &mesh.edges[2 * i];
+		unsigned b = vertex_brick[std::min(v[0], v[1])];
+		content[b].edges.push_back(i);
+		for(int k = 0; k < 2; k ++)
+			if(vertex_brick[v[k]] != b)
+				content[b].ghosts.push_back(v[k]);
+	}
+	for(unsigned i = 0; i < nf; i ++)
+	{
+		const unsigned * v = &mesh.faces[3 * i];
+		unsigned b = vertex_brick[std::min(v[0], std::min(v[1], v[2]))];
+		content[b].faces.push_back(i);
+		for(int k = 0; k < 3; k ++)
+			if(vertex_brick[v[k]] != b)
+				content[b].ghosts.push_back(v[k]);
+	}
+
+	std::vector<MedialChunkBrick> bricks(nbricks);
+	unsigned long long offset = header_size + nbricks * directory_entry_size;
+	for(unsigned b = 0; b < nbricks; b ++)
+	{
+		BrickContent & bc = content[b];
+		std::sort(bc.ghosts.begin(), bc.ghosts.end());
+		bc.ghosts.erase(std::unique(bc.ghosts.begin(), bc.ghosts.end()), bc.ghosts.end());
+
+		double bmn[3] = {1e300, 1e300, 1e300}, bmx[3] = {-1e300, -1e300, -1e300};
+		for(int pass = 0; pass < 2; pass ++)
+		{
+			const std::vector<unsigned> & vs = pass == 0 ? bc.vertices : bc.ghosts;
+			for(unsigned i = 0; i < vs.size(); i ++)
+				for(int d = 0; d < 3; d ++)
+				{
+					bmn[d] = std::min(bmn[d], mesh.spheres[4 * vs[i] + d] - mesh.spheres[4 * vs[i] + 3]);
+					bmx[d] = std::max(bmx[d], mesh.spheres[4 * vs[i] + d] + mesh.spheres[4 * vs[i] + 3]);
+				}
+		}
+
+		MedialChunkBrick & brick = bricks[b];
+		OutwardBox(bmn, bmx, brick.box_min, brick.box_max);
+		brick.offset = offset;
+		brick.num_vertices = (unsigned)bc.vertices.size();
+		brick.num_ghosts = (unsigned)bc.ghosts.size();
+		brick.num_edges = (unsigned)bc.edges.size();
+		brick.num_faces = (unsigned)bc.faces.size();
+		offset += (unsigned long long)(brick.num_vertices + brick.num_ghosts) * (sizeof(unsigned) + 4 * sizeof(double))
+			+ (unsigned long long)brick.num_edges * 3 * sizeof(unsigned)
+			+ (unsigned long long)brick.num_faces * 4 * sizeof(unsigned);
+	}
+
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	if(!out)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	out.write(chunk_magic, 8);
+	WriteValue(out, nv);
+	WriteValue(out, ne);
+	WriteValue(out, nf);
+	WriteValue(out, nbricks);
+	for(int d = 0; d < 3; d ++)
+		WriteValue(out, grid[d]);
+	for(int d = 0; d < 3; d ++)
+		WriteValue(out, mn[d]);
+	for(int d = 0; d < 3; d ++)
+		WriteValue(out, mx[d]);
+
+	for(unsigned b = 0; b < nbricks; b ++)
+	{
+		out.write((const char *)bricks[b].box_min, 3 * sizeof(float));
+		out.write((const char *)bricks[b].box_max, 3 * sizeof(float));
+		WriteValue(out, bricks[b].offset);
+		WriteValue(out, bricks[b].num_vertices);
+		WriteValue(out, bricks[b].num_ghosts);
+		WriteValue(out, bricks[b].num_edges);
+		WriteValue(out, bricks[b].num_faces);
+	}
+
+	for(unsigned b = 0; b < nbricks; b ++)
+	{
+		const BrickContent & bc = content[b];
+		for(int pass = 0; pass < 2; pass ++)
+		{
+			const std::vector<unsigned> & vs = pass == 0 ? bc.vertices : bc.ghosts;
+			for(unsigned i = 0; i < vs.size(); i ++)
+			{
+				WriteValue(out, vs[i]);
+				out.write((const char *)&mesh.spheres[4 * vs[i]], 4 * sizeof(double));
+			}
+		}
+		for(unsigned i = 0; i < bc.edges.size(); i ++)
+		{
+			WriteValue(out, bc.edges[i]);
+			out.write((const char *)&mesh.edges[2 * bc.edges[i]], 2 * sizeof(unsigned));
+		}
+		for(unsigned i = 0; i < bc.faces.size(); i ++)
+		{
+			WriteValue(out, bc.faces[i]);
+			out.write((const char *)&mesh.faces[3 * bc.faces[i]], 3 * sizeof(unsigned));
+		}
+	}
+
+	if(!out)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+MedialChunkReader::MedialChunkReader()
+	: num_vertices(0), num_edges(0), num_faces(0)
+{
+	for(int d = 0; d < 3; d ++)
+	{
+		grid[d] = 0;
+		box_min[d] = box_max[d] = 0.;
+	}
+}
+
+bool MedialChunkReader::Open(const std::string & fname, std::string & error)
+{
+	std::ifstream in(fname.c_str(), std::ios::binary);
+	if(!in)
+	{
+		error = "Could not open file " + fname;
+		return false;
+	}
+
+	char magic[8];
+	unsigned nbricks(0);
+	in.read(magic, 8);
+	ReadValue(in, num_vertices);
+	ReadValue(in, num_edges);
+	ReadValue(in, num_faces);
+	ReadValue(in, nbricks);
+	for(int d = 0; d < 3; d ++)
+		ReadValue(in, grid[d]);
+	for(int d = 0; d < 3; d ++)
+		ReadValue(in, box_min[d]);
+	for(int d = 0; d < 3; d ++)
+		ReadValue(in, box_max[d]);
+	if(!in || memcmp(magic, chunk_magic, 8) != 0)
+	{
+		error = "Not a chunked medial mesh: " + fname;
+		return false;
+	}
+
+	bricks.resize(nbricks);
+	for(unsigned b = 0; b < nbricks; b ++)
+	{
+		in.read((char *)bricks[b].box_min, 3 * sizeof(float));
+		in.read((char *)bricks[b].box_max, 3 * sizeof(float));
+		ReadValue(in, bricks[b].offset);
+		ReadValue(in, bricks[b].num_vertices);
+		ReadValue(in, bricks[b].num_ghosts);
+		ReadValue(in, bricks[b].num_edges);
+		ReadValue(in, bricks[b].num_faces);
+	}
+	if(!in)
+	{
+		error = "Truncated brick directory: " + fname;
+		bricks.clear();
+		return false;
+	}
+
+	filename = fname;
+	return true;
+}
+
+void MedialChunkReader::QueryBricks(const double mn[3], const double mx[3], std::vector<unsigned> & ids) const
+{
+	ids.clear();
+	for(unsigned b = 0; b < bricks.size(); b ++)
+		if(bricks[b].Intersects(mn, mx))
+			ids.push_back(b);
+}
+
+bool MedialChunkReader::LoadBricks(const std::vector<unsigned> & ids, MedialChunkRegion & region, std::string & error)
+{
+	region.mesh.clear();
+	region.vertex_ids.clear();
+	region.edge_ids.clear();
+	region.face_ids.clear();
+	region.bricks_loaded = 0;
+
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	if(!in)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	// ghosts of one brick may be owned by another loaded brick, the copies are identical
+	std::map<unsigned, unsigned> local;
+	std::vector<unsigned> gedges, gfaces;
+	for(unsigned k = 0; k < ids.size(); k ++)
+	{
+		const MedialChunkBrick & brick = bricks[ids[k]];
+		in.seekg((std::streamoff)brick.offset);
+
+		unsigned nverts = brick.num_vertices + brick.num_ghosts;
+		for(unsigned i = 0; i < nverts; i ++)
+		{
+			unsigned id;
+			double s[4];
+			ReadValue(in, id);
+			in.read((char *)s, 4 * sizeof(double));
+			if(local.find(id) != local.end())
+				continue;
+			local[id] = (unsigned)region.vertex_ids.size();
+			region.vertex_ids.push_back(id);
+			region.mesh.spheres.insert(region.mesh.spheres.end(), s, s + 4);
+		}
+		for(unsigned i = 0; i < brick.num_edges; i ++)
+		{
+			unsigned id, v[2];
+			ReadValue(in, id);
+			in.read((char *)v, 2 * sizeof(unsigned));
+			region.edge_ids.push_back(id);
+			gedges.insert(gedges.end(), v, v + 2);
+		}
+		for(unsigned i = 0; i < brick.num_faces; i ++)
+		{
+			unsigned id, v[3];
+			ReadValue(in, id);
+			in.read((char *)v, 3 * sizeof(unsigned));
+			region.face_ids.push_back(id);
+			gfaces.insert(gfaces.end(), v, v + 3);
+		}
+		if(!in)
+		{
+			error = "Truncated brick in " + filename;
+			return false;
+		}
+		region.bricks_loaded ++;
+	}
+
+	// every vertex of an owned element is in the brick, owned or as a ghost
+	region.mesh.edges.resize(gedges.size());
+	for(unsigned i = 0; i < gedges.size(); i ++)
+		region.mesh.edges[i] = local[gedges[i]];
+	region.mesh.faces.resize(gfaces.size());
+	for(unsigned i = 0; i < gfaces.size(); i ++)
+		region.mesh.faces[i] = local[gfaces[i]];
+	return true;
+}
+
+bool MedialChunkReader::LoadRegion(const double mn[3], const double mx[3], bool clip, MedialChunkRegion & region, std::string & error)
+{
+	std::vector<unsigned> ids;
+	QueryBricks(mn, mx, ids);
+	if(!LoadBricks(ids, region, error))
+		return false;
+	if(!clip)
+		return true;
+
+	MedialMeshData & m = region.mesh;
+	unsigned nv = m.NumVertices();
+	std::vector<char> inside(nv), keep(nv);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		bool hit = true;
+		for(int d = 0; d < 3; d ++)
+			if(m.spheres[4 * i + d] + m.spheres[4 * i + 3] < mn[d] || m.spheres[4 * i + d] - m.spheres[4 * i + 3] > mx[d])
+				hit = false;
+		inside[i] = keep[i] = hit;
+	}
+
+	MedialChunkRegion clipped;
+	clipped.bricks_loaded = region.bricks_loaded;
+	std::vector<unsigned> kept_edges, kept_faces;
+	for(unsigned i = 0; i < m.NumEdges(); i ++)
+		if(inside[m.edges[2 * i]] || inside[m.edges[2 * i + 1]])
+		{
+			kept_edges.push_back(i);
+			keep[m.edges[2 * i]] = keep[m.edges[2 * i + 1]] = 1;
+		}
+	for(unsigned i = 0; i < m.NumFaces(); i ++)
+		if(inside[m.faces[3 * i]] || inside[m.faces[3 * i + 1]] || inside[m.faces[3 * i + 2]])
+		{
+			kept_faces.push_back(i);
+			for(int k = 0; k < 3; k ++)
+				keep[m.faces[3 * i + k]] = 1;
+		}
+
+	std::vector<unsigned> newv(nv);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		if(!keep[i])
+			continue;
+		newv[i] = (unsigned)clipped.vertex_ids.size();
+		clipped.vertex_ids.push_back(region.vertex_ids[i]);
+		clipped.mesh.spheres.insert(clipped.mesh.spheres.end(), &m.spheres[4 * i], &m.spheres[4 * i] + 4);
+	}
+	for(unsigned i = 0; i < kept_edges.size(); i ++)
+	{
+		clipped.edge_ids.push_back(region.edge_ids[kept_edges[i]]);
+		for(int k = 0; k < 2; k ++)
+			clipped.mesh.edges.push_back(newv[m.edges[2 * kept_edges[i] + k]]);
+	}
+	for(unsigned i = 0; i < kept_faces.size(); i ++)
+	{
+		clipped.face_ids.push_back(region.face_ids[kept_faces[i]]);
+		for(int k = 0; k < 3; k ++)
+			clipped.mesh.faces.push_back(newv[m.faces[3 * kept_faces[i] + k]]);
+	}
+
+	region = clipped;
+	return true;
+}
+
+bool MedialChunkReader::LoadAll(MedialMeshData & mesh, std::string & error)
+{
+	std::vector<unsigned> ids(bricks.size());
+	for(unsigned b = 0; b < bricks.size(); b ++)
+		ids[b] = b;
+	MedialChunkRegion region;
+	if(!LoadBricks(ids, region, error))
+		return false;
+	if(region.vertex_ids.size() != num_vertices || region.edge_ids.size() != num_edges || region.face_ids.size() != num_faces)
+	{
+		error = "Brick contents do not match the header of " + filename;
+		return false;
+	}
+
+	// back to the global numbering
+	mesh.clear();
+	mesh.spheres.resize(4 * num_vertices);
+	mesh.edges.resize(2 * num_edges);
+	mesh.faces.resize(3 * num_faces);
+	for(unsigned i = 0; i < num_vertices; i ++)
+		std::copy(&region.mesh.spheres[4 * i], &region.mesh.spheres[4 * i] + 4, &mesh.spheres[4 * region.vertex_ids[i]]);
+	for(unsigned i = 0; i < num_edges; i ++)
+		for(int k = 0; k < 2; k ++)
+			mesh.edges[2 * region.edge_ids[i] + k] = region.vertex_ids[region.mesh.edges[2 * i + k]];
+	for(unsigned i = 0; i < num_faces; i ++)
+		for(int k = 0; k < 3; k ++)
+			mesh.faces[3 * region.face_ids[i] + k] = region.vertex_ids[region.mesh.faces[3 * i + k]];
+	return true;
+}
@@ -0,0 +1,105 @@
+#ifndef _MEDIALCHUNKS_H
+#define _MEDIALCHUNKS_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+// plain medial mesh as stored in a .ma file
+// spheres (x y z r), cones as vertex pairs and slabs as vertex triples
+class MedialMeshData
+{
+public:
+	std::vector<double> spheres;
+	std::vector<unsigned> edges;
+	std::vector<unsigned> faces;
+
+public:
+	unsigned NumVertices() const { return (unsigned)spheres.size() / 4; }
+	unsigned NumEdges() const { return (unsigned)edges.size() / 2; }
+	unsigned NumFaces() const { return (unsigned)faces.size() / 3; }
+	void clear();
+
+	bool LoadMA(const std::string & filename, std::string & error);
+	bool LoadMA(std::istream & in, std::string & error);
+	// same text format as the SlabMesh and NonManifoldMesh writers
+	bool SaveMA(const std::string & filename, std::string & error) const;
+	bool SaveMA(std::ostream & fout, std::string & error) const;
+};
+
+// Spatially chunked medial mesh (.qmc)
+// The vertices are bucketed into bricks of a regular grid by their sphere center.
+// A cone or slab belongs to the brick of its smallest vertex id; the vertices it
+// uses from other bricks are duplicated in that brick as ghosts, so every brick
+// is self-contained. Every element is owned by exactly one brick and keeps its
+// global id, which makes the conversion from and back to .ma lossless.
+//
+// layout, native byte order:
+//   header     magic "QMATCHK1", vertex/edge/face/brick counts, grid size, bounding box
+//   directory  per brick: bounding box of all its spheres (float, rounded outwards),
+//              payload offset, owned vertex/ghost/edge/face counts
+//   payloads   per brick: vertices and ghosts (id, x, y, z, r), edges (id, v0, v1),
+//              faces (id, v0, v1, v2), vertex ids are global
+class MedialChunkBrick
+{
+public:
+	float box_min[3];
+	float box_max[3];
+	unsigned long long offset;
+	unsigned num_vertices;
+	unsigned num_ghosts;
+	unsigned num_edges;
+	unsigned num_faces;
+
+	bool Intersects(const double mn[3], const double mx[3]) const;
+};
+
+// write mesh as bricks of about vertices_per_brick vertices
+bool WriteMedialChunks(const MedialMeshData & mesh, const std::string & filename, unsigned vertices_per_brick, std::string & error);
+
+// part of a chunked medial mesh in local numbering
+class MedialChunkRegion
+{
+public:
+	MedialMeshData mesh;
+	// global ids of the local vertices, edges and faces
+	std::vector<unsigned> vertex_ids;
+	std::vector<unsigned> edge_ids;
+	std::vector<unsigned> face_ids;
+	unsigned bricks_loaded;
+};
+
+class MedialChunkReader
+{
+public:
+	unsigned num_vertices;
+	unsigned num_edges;
+	unsigned num_faces;
+	unsigned grid[3];
+	double box_min[3];
+	double box_max[3];
+	std::vector<MedialChunkBrick> bricks;
+
+public:
+	MedialChunkReader();
+
+	// reads the header and the directory only
+	bool Open(const std::string & filename, std::string & error);
+
+	// bricks whose bounding box intersects [mn, mx]
+	void QueryBricks(const double mn[3], const double mx[3], std::vector<unsigned> & ids) const;
+
+	// Loads the bricks intersecting [mn, mx]. With clip set only the spheres whose
+	// bounding box intersects the query box are kept, together with the cones and
+	// slabs touching them and the other vertices these need.
+	bool LoadRegion(const double mn[3], const double mx[3], bool clip, MedialChunkRegion & region, std::string & error);
+
+	// all bricks back in global order, the inverse of WriteMedialChunks
+	bool LoadAll(MedialMeshData & mesh, std::string & error);
+
+private:
+	std::string filename;
+	bool LoadBricks(const std::vector<unsigned> & ids, MedialChunkRegion & region, std::string & error);
+};
+
+#endif // _MEDIALCHUNKS_H
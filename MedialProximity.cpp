@@ -0,0 +1,433 @@
+#include "MedialProximity.h"
+#include "EnvelopeExport.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// elements per leaf of the hierarchy
+static const unsigned medial_leaf_size = 4;
+
+// orders elements by one coordinate of their box center
+class MedialAxisLess
+{
+public:
+	unsigned axis;
+
+	MedialAxisLess(unsigned a) : axis(a) {}
+	bool operator()(const MedialElement & a, const MedialElement & b) const { return a.center[axis] < b.center[axis]; }
+};
+
+double MedialPrimitiveTree::Node::LowerBound(const double p[3]) const
+{
+	double d = 0.;
+	for(int k = 0; k < 3; k ++)
+	{
+		double e = std::max(box_min[k] - p[k], std::max(0., p[k] - box_max[k]));
+		d += e * e;
+	}
+	return sqrt(d) - max_radius;
+}
+
+void MedialPrimitiveTree::Build(const MedialMeshData & ma)
+{
+	spheres = ma.spheres;
+	unsigned nv = ma.NumVertices();
+	std::vector<unsigned> cones;
+	MedialConeEdges(ma, cones);
+	std::vector<char> in_cone(nv, 0);
+	for(size_t i = 0; i < cones.size(); i ++)
+		in_cone[cones[i]] = 1;
+
+	// a sphere on a cone is covered by the cone
+	elements.clear();
+	MedialElement e;
+	for(unsigned i = 0; i < nv; i ++)
+		if(!in_cone[i])
+		{
+			e.type = MedialElement::SPHERE;
+			e.vertices[0] = e.vertices[1] = e.vertices[2] = i;
+			elements.push_back(e);
+		}
+	for(size_t i = 0; i + 1 < cones.size(); i += 2)
+	{
+		e.type = MedialElement::CONE;
+		e.vertices[0] = cones[i];
+		e.vertices[1] = e.vertices[2] = cones[i + 1];
+		elements.push_back(e);
+	}
+	for(unsigned i = 0; i < ma.NumFaces(); i ++)
+	{
+		e.type = MedialElement::SLAB;
+		for(int k = 0; k < 3; k ++)
+			e.vertices[k] = ma.faces[3 * i + k];
+		elements.push_back(e);
+	}
+	for(size_t i = 0; i < elements.size(); i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			double mn = DBL_MAX, mx = -DBL_MAX;
+			for(int j = 0; j < 3; j ++)
+			{
+				mn = std::min(mn, spheres[4 * elements[i].vertices[j] + k]);
+				mx = std::max(mx, spheres[4 * elements[i].vertices[j] + k]);
+			}
+			elements[i].center[k] = 0.5 * (mn + mx);
+		}
+
+	nodes.clear();
+	if(elements.empty())
+		return;
+	Node root;
+	root.first = 0;
+	root.count = (unsigned)elements.size();
+	root.child = 0;
+	nodes.push_back(root);
+	Split(0);
+}
+
+void MedialPrimitiveTree::Split(unsigned node)
+{
+	unsigned first = nodes[node].first, count = nodes[node].count;
+	double mn[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, mx[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+	double cmn[3] = {DBL_MAX, DBL_MAX, DBL_MAX}, cmx[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+	double max_radius = 0.;
+	for(unsigned i = first; i < first + count; i ++)
+	{
+		const MedialElement & e = elements[i];
+		for(unsigned j = 0; j < e.type; j ++)
+		{
+			const double * s = &spheres[4 * e.vertices[j]];
+			for(int k = 0; k < 3; k ++)
+			{
+				mn[k] = std::min(mn[k], s[k]);
+				mx[k] = std::max(mx[k], s[k]);
+			}
+			max_radius = std::max(max_radius, s[3]);
+		}
+		for(int k = 0; k < 3; k ++)
+		{
+			cmn[k] = std::min(cmn[k], e.center[k]);
+			cmx[k] = std::max(cmx[k], e.center[k]);
+		}
+	}
+	double bound_radius = 0.;
+	for(int k = 0; k < 3; k ++)
+		nodes[node].bound_center[k] = 0.5 * (mn[k] + mx[k]);
+	for(unsigned i = first; i < first + count; i ++)
+		for(unsigned j = 0; j < elements[i].type; j ++)
+		{
+			const double * s = &spheres[4 * elements[i].vertices[j]];
+			const double * c = nodes[node].bound_center;
+			double d = sqrt((s[0] - c[0]) * (s[0] - c[0]) + (s[1] - c[1]) * (s[1] - c[1]) + (s[2] - c[2]) * (s[2] - c[2]));
+			bound_radius = std::max(bound_radius, d + s[3]);
+		}
+	for(int k = 0; k < 3; k ++)
+	{
+		nodes[node].box_min[k] = mn[k];
+		nodes[node].box_max[k] = mx[k];
+	}
+	nodes[node].max_radius = max_radius;
+	nodes[node].bound_radius = bound_radius;
+	if(count <= medial_leaf_size)
+		return;
+
+	unsigned axis = 0;
+	for(unsigned k = 1; k < 3; k ++)
+		if(cmx[k] - cmn[k] > cmx[axis] - cmn[axis])
+			axis = k;
+	if(!(cmx[axis] > cmn[axis]))
+		return;
+
+	unsigned half = count / 2;
+	std::nth_element(elements.begin() + first, elements.begin() + first + half, elements.begin() + first + count, MedialAxisLess(axis));
+
+	Node left, right;
+	left.first = first;
+	left.count = half;
+	right.first = first + half;
+	right.count = count - half;
+	left.child = right.child = 0;
+	unsigned child = (unsigned)nodes.size();
+	nodes[node].child = child;
+	nodes.push_back(left);
+	nodes.push_back(right);
+	Split(child);
+	Split(child + 1);
+}
+
+void MedialPrimitiveTree::Element(unsigned e, Wm4::Vector3d c[3], double r[3]) const
+{
+	for(int k = 0; k < 3; k ++)
+	{
+		const double * s = &spheres[4 * elements[e].vertices[k]];
+		c[k] = Vector3d(s[0], s[1], s[2]);
+		r[k] = s[3];
+	}
+}
+
+MedialPose::MedialPose()
+{
+	for(int k = 0; k < 9; k ++)
+		rotation[k] = k % 4 == 0 ? 1. : 0.;
+	translation[0] = translation[1] = translation[2] = 0.;
+}
+
+Wm4::Vector3d MedialPose::Apply(const Wm4::Vector3d & p) const
+{
+	return Vector3d(rotation[0] * p[0] + rotation[1] * p[1] + rotation[2] * p[2] + translation[0],
+					rotation[3] * p[0] + rotation[4] * p[1] + rotation[5] * p[2] + translation[1],
+					rotation[6] * p[0] + rotation[7] * p[1] + rotation[8] * p[2] + translation[2]);
+}
+
+MedialPose MedialPose::Relative(const MedialPose & a, const MedialPose & b)
+{
+	MedialPose r;
+	for(int i = 0; i < 3; i ++)
+	{
+		for(int j = 0; j < 3; j ++)
+			r.rotation[3 * i + j] = a.rotation[i] * b.rotation[j] + a.rotation[3 + i] * b.rotation[3 + j] + a.rotation[6 + i] * b.rotation[6 + j];
+		r.translation[i] = a.rotation[i] * (b.translation[0] - a.translation[0]) + a.rotation[3 + i] * (b.translation[1] - a.translation[1])
+			+ a.rotation[6 + i] * (b.translation[2] - a.translation[2]);
+	}
+	return r;
+}
+
+// the difference of the cones is the parallelogram of centers a(s) - b(t) with
+// radius ra(s) + rb(t), split into two slabs
+static double ConeConeDistance(const Vector3d & a0, double ra0, const Vector3d & a1, double ra1,
+							   const Vector3d & b0, double rb0, const Vector3d & b1, double rb1)
+{
+	static const Vector3d origin(0., 0., 0.);
+	Vector3d c[3] = {a0 - b0, a1 - b0, a1 - b1};
+	double r[3] = {ra0 + rb0, ra1 + rb0, ra1 + rb1};
+	double d = SlabDistance(origin, c, r);
+	c[1] = a0 - b1;
+	r[1] = ra0 + rb1;
+	return std::min(d, SlabDistance(origin, c, r));
+}
+
+// where the segment a0 a1 crosses the triangle b, the depth of the two spheres there
+static bool SegmentCrossesTriangle(const Vector3d & a0, double ra0, const Vector3d & a1, double ra1,
+								   const Vector3d b[3], const double rb[3], double & depth)
+{
+	Vector3d d = a1 - a0;
+	Vector3d e1 = b[1] - b[0], e2 = b[2] - b[0];
+	Vector3d p = d.Cross(e2);
+	double det = e1.Dot(p);
+	if(fabs(det) <= 1e-12 * d.Length() * e1.Length() * e2.Length())
+		return false;
+	Vector3d q = a0 - b[0];
+	double u = q.Dot(p) / det;
+	Vector3d qe = q.Cross(e1);
+	double v = d.Dot(qe) / det;
+	double t = e2.Dot(qe) / det;
+	if(u < 0. || v < 0. || u + v > 1. || t < 0. || t > 1.)
+		return false;
+	depth = -((1. - t) * ra0 + t * ra1 + (1. - u - v) * rb[0] + u * rb[1] + v * rb[2]);
+	return true;
+}
+
+// boundary of the segment x triangle: the end spheres against the slab and the
+// segment against the three triangle edges
+static double ConeSlabDistance(const Vector3d a[2], const double ra[2], const Vector3d b[3], const double rb[3])
+{
+	double d = std::min(SlabDistance(a[0], b, rb) - ra[0], SlabDistance(a[1], b, rb) - ra[1]);
+	for(int k = 0; k < 3; k ++)
+		d = std::min(d, ConeConeDistance(a[0], ra[0], a[1], ra[1], b[k], rb[k], b[(k + 1) % 3], rb[(k + 1) % 3]));
+	double depth;
+	if(SegmentCrossesTriangle(a[0], ra[0], a[1], ra[1], b, rb, depth))
+		d = std::min(d, depth);
+	return d;
+}
+
+static double SlabSlabDistance(const Vector3d a[3], const double ra[3], const Vector3d b[3], const double rb[3])
+{
+	double d = DBL_MAX, depth;
+	for(int i = 0; i < 3; i ++)
+	{
+		d = std::min(d, SlabDistance(a[i], b, rb) - ra[i]);
+		d = std::min(d, SlabDistance(b[i], a, ra) - rb[i]);
+		for(int j = 0; j < 3; j ++)
+			d = std::min(d, ConeConeDistance(a[i], ra[i], a[(i + 1) % 3], ra[(i + 1) % 3], b[j], rb[j], b[(j + 1) % 3], rb[(j + 1) % 3]));
+		if(SegmentCrossesTriangle(a[i], ra[i], a[(i + 1) % 3], ra[(i + 1) % 3], b, rb, depth))
+			d = std::min(d, depth);
+		if(SegmentCrossesTriangle(b[i], rb[i], b[(i + 1) % 3], rb[(i + 1) % 3], a, ra, depth))
+			d = std::min(d, depth);
+	}
+	return d;
+}
+
+double MedialElementDistance(const Wm4::Vector3d ca[3], const double ra[3], unsigned na,
+							 const Wm4::Vector3d cb[3], const double rb[3], unsigned nb)
+{
+	if(na > nb)
+		return MedialElementDistance(cb, rb, nb, ca, ra, na);
+	if(na == MedialElement::SPHERE)
+	{
+		if(nb == MedialElement::SPHERE)
+			return (ca[0] - cb[0]).Length() - ra[0] - rb[0];
+		if(nb == MedialElement::CONE)
+			return ConeDistance(ca[0], cb[0], rb[0], cb[1], rb[1]) - ra[0];
+		return SlabDistance(ca[0], cb, rb) - ra[0];
+	}
+	if(na == MedialElement::CONE)
+	{
+		if(nb == MedialElement::CONE)
+			return ConeConeDistance(ca[0], ra[0], ca[1], ra[1], cb[0], rb[0], cb[1], rb[1]);
+		return ConeSlabDistance(ca, ra, cb, rb);
+	}
+	return SlabSlabDistance(ca, ra, cb, rb);
+}
+
+// a point is a sphere of radius 0
+static void PointSearch(const MedialPrimitiveTree & tree, unsigned node, const Vector3d & p, double & best)
+{
+	const MedialPrimitiveTree::Node & n = tree.nodes[node];
+	const double q[3] = {p[0], p[1], p[2]};
+	if(n.LowerBound(q) >= best)
+		return;
+	if(n.child == 0)
+	{
+		const Vector3d cp[3] = {p, p, p};
+		const double rp[3] = {0., 0., 0.};
+		Vector3d c[3];
+		double r[3];
+		for(unsigned i = n.first; i < n.first + n.count; i ++)
+		{
+			tree.Element(i, c, r);
+			best = std::min(best, MedialElementDistance(cp, rp, MedialElement::SPHERE, c, r, tree.elements[i].type));
+		}
+		return;
+	}
+
+	unsigned a = n.child, b = n.child + 1;
+	if(tree.nodes[b].LowerBound(q) < tree.nodes[a].LowerBound(q))
+		std::swap(a, b);
+	PointSearch(tree, a, p, best);
+	PointSearch(tree, b, p, best);
+}
+
+double MedialPointDistance(const MedialPrimitiveTree & tree, const Wm4::Vector3d & p)
+{
+	double best = DBL_MAX;
+	if(!tree.nodes.empty())
+		PointSearch(tree, 0, p, best);
+	return best;
+}
+
+// state of one simultaneous descent, b is seen in the frame of a
+class MedialDescent
+{
+public:
+	const MedialPrimitiveTree & a;
+	const MedialPrimitiveTree & b;
+	MedialPose pose;
+	bool stop_at_contact;
+	bool stopped;
+	MedialProximityResult & result;
+
+	MedialDescent(const MedialPrimitiveTree & ta, const MedialPrimitiveTree & tb, const MedialPose & p, bool stop, MedialProximityResult & r)
+		: a(ta), b(tb), pose(p), stop_at_contact(stop), stopped(false), result(r) {}
+
+	double LowerBound(unsigned na, unsigned nb) const
+	{
+		const MedialPrimitiveTree::Node & x = a.nodes[na];
+		const MedialPrimitiveTree::Node & y = b.nodes[nb];
+		Vector3d c = pose.Apply(Vector3d(y.bound_center[0], y.bound_center[1], y.bound_center[2]));
+		return (Vector3d(x.bound_center[0], x.bound_center[1], x.bound_center[2]) - c).Length() - x.bound_radius - y.bound_radius;
+	}
+
+	void Leaves(unsigned na, unsigned nb)
+	{
+		const MedialPrimitiveTree::Node & x = a.nodes[na];
+		const MedialPrimitiveTree::Node & y = b.nodes[nb];
+		Vector3d ca[3], cb[3];
+		double ra[3], rb[3];
+		for(unsigned j = y.first; j < y.first + y.count && !stopped; j ++)
+		{
+			b.Element(j, cb, rb);
+			for(int k = 0; k < 3; k ++)
+				cb[k] = pose.Apply(cb[k]);
+			for(unsigned i = x.first; i < x.first + x.count && !stopped; i ++)
+			{
+				a.Element(i, ca, ra);
+				double d = MedialElementDistance(ca, ra, a.elements[i].type, cb, rb, b.elements[j].type);
+				result.element_pairs ++;
+				if(d < result.distance)
+				{
+					result.distance = d;
+					result.element[0] = i;
+					result.element[1] = j;
+					if(stop_at_contact && d <= 0.)
+						stopped = true;
+				}
+			}
+		}
+	}
+
+	void Descend(unsigned na, unsigned nb)
+	{
+		if(stopped)
+			return;
+		result.node_pairs ++;
+		const MedialPrimitiveTree::Node & x = a.nodes[na];
+		const MedialPrimitiveTree::Node & y = b.nodes[nb];
+		if(x.child == 0 && y.child == 0)
+		{
+			Leaves(na, nb);
+			return;
+		}
+
+		// open the larger node, the nearer child first
+		unsigned pairs[2][2];
+		if(y.child == 0 || (x.child != 0 && x.bound_radius >= y.bound_radius))
+		{
+			pairs[0][0] = x.child;
+			pairs[1][0] = x.child + 1;
+			pairs[0][1] = pairs[1][1] = nb;
+		}
+		else
+		{
+			pairs[0][0] = pairs[1][0] = na;
+			pairs[0][1] = y.child;
+			pairs[1][1] = y.child + 1;
+		}
+		double bound[2] = {LowerBound(pairs[0][0], pairs[0][1]), LowerBound(pairs[1][0], pairs[1][1])};
+		int order = bound[1] < bound[0] ? 1 : 0;
+		for(int k = 0; k < 2; k ++)
+		{
+			int c = k == 0 ? order : 1 - order;
+			if(bound[c] < result.distance)
+				Descend(pairs[c][0], pairs[c][1]);
+		}
+	}
+};
+
+bool MedialDistance(const MedialPrimitiveTree & a, const MedialPose & pa, const MedialPrimitiveTree & b, const MedialPose & pb,
+					double max_distance, MedialProximityResult & result)
+{
+	result = MedialProximityResult();
+	result.distance = max_distance;
+	if(a.nodes.empty() || b.nodes.empty())
+		return false;
+	MedialDescent descent(a, b, MedialPose::Relative(pa, pb), false, result);
+	if(descent.LowerBound(0, 0) < result.distance)
+		descent.Descend(0, 0);
+	return result.element[0] != 0xffffffffu;
+}
+
+bool MedialOverlap(const MedialPrimitiveTree & a, const MedialPose & pa, const MedialPrimitiveTree & b, const MedialPose & pb,
+				   MedialProximityResult & result)
+{
+	result = MedialProximityResult();
+	// the contact test accepts any pair at distance 0 or below
+	result.distance = DBL_MIN;
+	if(a.nodes.empty() || b.nodes.empty())
+		return false;
+	MedialDescent descent(a, b, MedialPose::Relative(pa, pb), true, result);
+	if(descent.LowerBound(0, 0) < result.distance)
+		descent.Descend(0, 0);
+	return descent.stopped;
+}
@@ -0,0 +1,107 @@
+#ifndef _MEDIALPROXIMITY_H
+#define _MEDIALPROXIMITY_H
+
+#include <vector>
+#include "MedialChunks.h"
+#include "LinearAlgebra/Wm4Vector.h"
+
+// a sphere, cone or slab of a medial mesh, type is its number of spheres
+class MedialElement
+{
+public:
+	enum Type { SPHERE = 1, CONE = 2, SLAB = 3 };
+
+	unsigned type;
+	unsigned vertices[3];	// unused ones repeat the last
+	double center[3];		// of the box of its sphere centers, for the splits
+};
+
+// Bounding volume hierarchy over the elements of a medial mesh: every sphere
+// that is on no cone, every cone of the envelope and every slab. A node bounds
+// the sphere centers below it by a box and the envelope by a sphere. Leaves hold
+// a few elements, the split is at the median of the widest axis.
+class MedialPrimitiveTree
+{
+public:
+	class Node
+	{
+	public:
+		unsigned first;		// into elements
+		unsigned count;
+		unsigned child;		// left child, the right one follows it; 0 for a leaf
+		double box_min[3];	// of the sphere centers
+		double box_max[3];
+		double max_radius;
+		double bound_center[3];	// sphere around the envelope
+		double bound_radius;
+
+		// no envelope below is closer to p
+		double LowerBound(const double p[3]) const;
+	};
+
+	std::vector<double> spheres;	// copy of the medial spheres, x y z r
+	std::vector<MedialElement> elements;
+	std::vector<Node> nodes;
+
+public:
+	void Build(const MedialMeshData & ma);
+
+	unsigned NumElements() const { return (unsigned)elements.size(); }
+	// centers and radii of an element, the unused ones repeat the last
+	void Element(unsigned e, Wm4::Vector3d c[3], double r[3]) const;
+
+private:
+	void Split(unsigned node);
+};
+
+// rigid motion, x' = rotation x + translation, rotation is row major
+class MedialPose
+{
+public:
+	double rotation[9];
+	double translation[3];
+
+public:
+	MedialPose();
+	Wm4::Vector3d Apply(const Wm4::Vector3d & p) const;
+	// the pose of b seen from a, inverse(a) * b
+	static MedialPose Relative(const MedialPose & a, const MedialPose & b);
+};
+
+// Distance between the envelopes of two elements (the convex hulls of their
+// spheres), negative when they overlap. Exact when they are apart: the distance
+// is the envelope distance of the origin to the difference of the two elements,
+// whose minimum lies on a sphere-slab or cone-cone pair, and a cone-cone
+// difference is a parallelogram slab. When they overlap the value is the depth
+// at the deepest pair found, an upper bound of the true minimum.
+double MedialElementDistance(const Wm4::Vector3d ca[3], const double ra[3], unsigned na,
+							 const Wm4::Vector3d cb[3], const double rb[3], unsigned nb);
+
+// Envelope distance of a point to the nearest element, negative inside one.
+// DBL_MAX for an empty tree.
+double MedialPointDistance(const MedialPrimitiveTree & tree, const Wm4::Vector3d & p);
+
+class MedialProximityResult
+{
+public:
+	double distance;		// smallest found, negative for an overlap
+	unsigned element[2];	// the closest pair
+	unsigned long long node_pairs;
+	unsigned long long element_pairs;
+
+public:
+	MedialProximityResult() : distance(0.), node_pairs(0), element_pairs(0) { element[0] = element[1] = 0xffffffffu; }
+};
+
+// Smallest distance between two posed medial meshes by simultaneous descent of
+// both hierarchies, the larger node is opened first and pairs whose bounding
+// spheres are farther than the best distance are skipped. Pairs farther than
+// max_distance are not looked at, false when none is closer.
+bool MedialDistance(const MedialPrimitiveTree & a, const MedialPose & pa, const MedialPrimitiveTree & b, const MedialPose & pb,
+					double max_distance, MedialProximityResult & result);
+
+// Stops at the first overlapping pair, true when one is found.
+bool MedialOverlap(const MedialPrimitiveTree & a, const MedialPose & pa, const MedialPrimitiveTree & b, const MedialPose & pb,
+				   MedialProximityResult & result);
+
+#endif // _MEDIALPROXIMITY_H
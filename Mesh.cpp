@@ -1,9 +1,21 @@
 #include "Mesh.h"
+#include "Logger.h"
 
 #include <CGAL/centroid.h>
+#include <CGAL/Cartesian_d.h>
+#include <CGAL/Min_sphere_d.h>
+#include <CGAL/Min_sphere_annulus_d_traits_d.h>
 
 #include <Eigen/Dense>
 
+#include <queue>
+
+typedef CGAL::Cartesian_d<double> CarK;
+typedef CGAL::Min_sphere_annulus_d_traits_d<CarK> MSTraits;
+typedef CGAL::Min_sphere_d<MSTraits> Min_sphere;
+
+typedef CarK::Point_d MSPoint;
+
 double Triangulation::TetCircumRadius(const Tetrahedron & tet)
 {
 	return (to_wm4(tet.vertex(0))-to_wm4(CGAL::circumcenter(tet))).Length();
@@ -89,6 +101,9 @@ MPMesh::MPMesh()
 	m_metric_policy = K1_K2;
 
 	number_of_bad_vertices = 0;
+
+	m_cell_labeling = EXACT_QUERY;
+	m_labeling_ambiguity = 0.2;
 }
 
 // compute the bounding box
@@ -182,6 +197,62 @@ void MPMesh::GenerateRandomColor()
 	}
 }
 
+bool MPMesh::CopyAttributes(const IndexedMesh & im)
+{
+	if(pVertexList.size() != im.NumVertices())
+		return false;
+
+	for(unsigned d = 0; d < 3; d ++)
+	{
+		m_min[d] = im.m_min[d];
+		m_max[d] = im.m_max[d];
+	}
+	bb_diagonal_length = im.bb_diagonal_length;
+
+	int nv = (int)pVertexList.size();
+	int nf = (int)pFaceList.size();
+	// the builder may have skipped invalid facets, face arrays then no longer line up
+	bool faces_match = (pFaceList.size() == im.NumFaces());
+
+#pragma omp parallel for
+	for(int i = 0; i < nv; i ++)
+	{
+		Vertex_iterator pVertex = pVertexList[i];
+		if(!im.vertex_color.empty())
+			pVertex->color = Vector3d(im.vertex_color[3 * i], im.vertex_color[3 * i + 1], im.vertex_color[3 * i + 2]);
+		if(faces_match && !im.vertex_normal.empty())
+			pVertex->normal = Vector(im.vertex_normal[3 * i], im.vertex_normal[3 * i + 1], im.vertex_normal[3 * i + 2]);
+		if(!im.gaussiancurvature_Meyer.empty())
+			pVertex->gaussiancurvature_Meyer = im.gaussiancurvature_Meyer[i];
+	}
+
+	if(faces_match)
+	{
+#pragma omp parallel for
+		for(int i = 0; i < nf; i ++)
+		{
+			Facet_iterator pFacet = pFaceList[i];
+			if(!im.face_color.empty())
+				pFacet->color = Vector3d(im.face_color[3 * i], im.face_color[3 * i + 1], im.face_color[3 * i + 2]);
+			if(!im.face_normal.empty())
+				pFacet->normal = Vector(im.face_normal[3 * i], im.face_normal[3 * i + 1], im.face_normal[3 * i + 2]);
+		}
+	}
+	else
+	{
+		compute_normals();
+		GenerateRandomColor();
+	}
+
+	if(!im.gaussiancurvature_Meyer.empty())
+	{
+		m_max_gaussiancurvature_Meyer = im.m_max_gaussiancurvature_Meyer;
+		m_min_gaussiancurvature_Meyer = im.m_min_gaussiancurvature_Meyer;
+	}
+
+	return true;
+}
+
 // compute the matrix of A and b for sphere mesh
 void MPMesh::compute_sphere_matrix()
 {
@@ -687,7 +758,7 @@ void MPMesh::EvaluateCurvatureInterval()
 
 void MPMesh::ComputeFaceCurvatures(double MinThreshold, double RatioThreshold)
 {
-	std::cout << "Computing Face Curvatures..." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Computing Face Curvatures...";
 	for(unsigned int i = 0; i < pFaceList.size(); i ++)
 	{
 		Halfedge_around_facet_circulator pHalfedge = pFaceList[i]->facet_begin();
@@ -773,12 +844,12 @@ void MPMesh::ComputeFaceCurvatures(double MinThreshold, double RatioThreshold)
 			pFaceList[i]->mincurvature = -absmin;
 	}
 	ComputeFaceDensity();
-	std::cout << "Done." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Done.";
 }
 
 void MPMesh::ComputeFaceDensity()
 {
-	std::cout << "Computing Face Density..." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Computing Face Density...";
 	for(unsigned int i = 0; i < pFaceList.size(); i ++)
 	{
 		if(m_density_policy == ONE)
@@ -788,12 +859,12 @@ void MPMesh::ComputeFaceDensity()
 		else if(m_density_policy == K1K2)
 			pFaceList[i]->density = fabs(pFaceList[i]->maxcurvature*pFaceList[i]->mincurvature);
 	}
-	std::cout << "Done." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Done.";
 }
 
 void MPMesh::ComputeVertexDensity()
 {
-	std::cout << "Computing Vertex Density..." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Computing Vertex Density...";
 	Vertex_iterator pVertex;
 	for(pVertex = vertices_begin(); pVertex != vertices_end(); pVertex ++)
 	{
@@ -804,12 +875,12 @@ void MPMesh::ComputeVertexDensity()
 		else if(m_density_policy == K1K2)
 			pVertex->density = fabs(pVertex->maxcurvature*pVertex->mincurvature);
 	}
-	std::cout << "Done." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Done.";
 }
 
 void MPMesh::BuildVertexMetricTensors(double normal_coefficient)
 {
-	std::cout << "Building Vertex Metric Tensors..." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Building Vertex Metric Tensors...";
 	for(Vertex_iterator pVertex = vertices_begin(); pVertex != vertices_end(); pVertex ++)
 	{
 		// build the metric tensor
@@ -822,12 +893,12 @@ void MPMesh::BuildVertexMetricTensors(double normal_coefficient)
 		//std::cout << pt[0][0] << " " << pt[1][1] << " " << pt[2][2] << std::endl << std::endl;
 		pVertex->metric = pf * pt * (pf.Transpose());
 	}
-	std::cout << "Done." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Done.";
 }
 
 void MPMesh::BuildFaceMetricTensors(double normal_coefficient)
 {
-	std::cout << "Building Face Metric Tensors..." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Building Face Metric Tensors...";
 	for(unsigned int i = 0; i < pFaceList.size(); i ++)
 	{
 		// build the metric tensor
@@ -840,12 +911,12 @@ void MPMesh::BuildFaceMetricTensors(double normal_coefficient)
 		//std::cout << pt[0][0] << " " << pt[1][1] << " " << pt[2][2] << std::endl << std::endl;
 		pFaceList[i]->metric = pf * pt * (pf.Transpose());
 	}
-	std::cout << "Done." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Done.";
 }
 
 void MPMesh::LoadPrincipalCurvatures(string filename, double MinThreshold, double RatioThreshold, double IsotropicCoefficient)
 {
-	std::cout << "Loading Principal Curvatures..." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Loading Principal Curvatures...";
 	ifstream fin(filename.c_str());
 	string str;
 	fin >> str >> str >> str >> str >> str;
@@ -917,7 +988,7 @@ void MPMesh::LoadPrincipalCurvatures(string filename, double MinThreshold, doubl
 	}
 	fin.close();
 	ComputeVertexDensity();
-	std::cout << "Done." << std::endl;
+	QMAT_LOG_INFO("mesh") << "Done.";
 }
 
 double MPMesh::vertex_voronoi_area_Meyer(Vertex_handle vh)
@@ -1268,6 +1339,8 @@ void MPMesh::computedt()
 	for(; pVertex != vertices_end(); pVertex ++, idx ++)
 	{
 		Point_t p(pVertex->point()[0],pVertex->point()[1],pVertex->point()[2]);
+		if(3 * idx + 2 < (int)dt_offset.size())
+			p = Point_t(p[0] + dt_offset[3 * idx], p[1] + dt_offset[3 * idx + 1], p[2] + dt_offset[3 * idx + 2]);
 		Vertex_handle_t vh;
 		vh = dt.insert(p);
 		vh->info().id = idx;
@@ -1281,6 +1354,12 @@ void MPMesh::computedt()
 	//	vh->info().id = pVertexList[i]->id;
 	//}
 
+	if(m_cell_labeling == POWERCRUST)
+	{
+		LabelCellsPowerCrust();
+		return;
+	}
+
 	unsigned int fid(0);
 	for(Finite_cells_iterator_t fci = dt.finite_cells_begin(); 
 		fci != dt.finite_cells_end();
@@ -1295,7 +1374,231 @@ void MPMesh::computedt()
 		if(!inside_boundingbox(cent_wm4))
 			fci->info().inside = false;
 		else
-			fci->info().inside = (domain->is_in_domain_object()(cent) > 0);
+			fci->info().inside = domain->IsInside(cent_wm4);
+	}
+}
+
+// Inside/outside labeling in the spirit of the power crust [Amenta et al. 2001].
+// The infinite cell is the only seed, it is outside and the outer pole of every
+// hull sample. Labels then flood through the cell graph in order of certainty:
+// - two cells sharing a facet whose Delaunay balls intersect deeply get the same label,
+//   the ball of the infinite cell is the half space beyond the hull facet
+// - the inner and outer pole of a sample get opposite labels
+// Cells centered outside the bounding box are outside, as with EXACT_QUERY.
+// Cells whose two priorities stay close are collected in ambiguous_cells and
+// resolved by exact domain queries when a domain is available.
+void MPMesh::LabelCellsPowerCrust()
+{
+	std::vector<Cell_handle_t> cells;
+	std::vector<Vector3d> center;
+	std::vector<double> radius;
+
+	for(Finite_cells_iterator_t fci = dt.finite_cells_begin(); fci != dt.finite_cells_end(); fci ++)
+	{
+		fci->info().id = (int)cells.size();
+		cells.push_back(fci);
+		Vector3d cent = to_wm4(CGAL::circumcenter(dt.tetrahedron(fci)));
+		center.push_back(cent);
+		radius.push_back((cent - to_wm4(fci->vertex(0)->point())).Length());
+	}
+
+	unsigned nc = (unsigned)cells.size();
+	std::vector<double> pin(nc, 0.), pout(nc, 0.);
+	std::vector<char> labeled(nc, 0);
+	std::vector< std::vector< std::pair<unsigned, double> > > opposite(nc);
+
+	// the infinite cell is labeled outside first, a hull cell intersects its half
+	// space as deep as the circumcenter lies beyond the hull facet
+	for(unsigned i = 0; i < nc; i ++)
+		for(int j = 0; j < 4; j ++)
+		{
+			if(!dt.is_infinite(cells[i]->neighbor(j)))
+				continue;
+			Vector3d f[3];
+			for(int k = 0; k < 3; k ++)
+				f[k] = to_wm4(cells[i]->vertex((j + 1 + k) % 4)->point());
+			Vector3d n = (f[1] - f[0]).Cross(f[2] - f[0]);
+			if(n.Normalize() == 0.)
+				continue;
+			if(n.Dot(to_wm4(cells[i]->vertex(j)->point()) - f[0]) > 0)
+				n = -n;
+			double w = std::min(n.Dot(center[i] - f[0]) / radius[i], 1.);
+			pout[i] = std::max(pout[i], w);
+		}
+
+	// pole pairs, the outer pole of a hull sample lies at infinity
+	for(Finite_vertices_iterator_t fvi = dt.finite_vertices_begin(); fvi != dt.finite_vertices_end(); fvi ++)
+	{
+		Vector3d p = to_wm4(fvi->point());
+		std::vector<Cell_handle_t> ic;
+		dt.incident_cells(fvi, std::back_inserter(ic));
+
+		bool onhull = false;
+		int plus = -1;
+		double ld(0);
+		for(unsigned i = 0; i < ic.size(); i ++)
+		{
+			if(dt.is_infinite(ic[i]))
+			{
+				onhull = true;
+				continue;
+			}
+			double td = (center[ic[i]->info().id] - p).SquaredLength();
+			if(td > ld)
+			{
+				ld = td;
+				plus = ic[i]->info().id;
+			}
+		}
+
+		Vector3d dplus;
+		if(onhull)
+		{
+			// the hull vertex sticks out of its neighbours
+			std::vector<Vertex_handle_t> av;
+			dt.finite_adjacent_vertices(fvi, std::back_inserter(av));
+			if(av.empty())
+				continue;
+			Vector3d mean(Vector3d::ZERO);
+			for(unsigned i = 0; i < av.size(); i ++)
+				mean += to_wm4(av[i]->point());
+			dplus = p - mean / (double)av.size();
+		}
+		else if(plus >= 0)
+			dplus = center[plus] - p;
+		else
+			continue;
+		if(dplus.Normalize() == 0.)
+			continue;
+
+		int minus = -1;
+		ld = 0;
+		for(unsigned i = 0; i < ic.size(); i ++)
+		{
+			if(dt.is_infinite(ic[i]))
+				continue;
+			Vector3d dv = center[ic[i]->info().id] - p;
+			double td = dv.SquaredLength();
+			if(dv.Dot(dplus) < 0 && td > ld)
+			{
+				ld = td;
+				minus = ic[i]->info().id;
+			}
+		}
+		if(minus < 0)
+			continue;
+
+		Vector3d dminus = center[minus] - p;
+		dminus.Normalize();
+		double w = -dplus.Dot(dminus);
+		if(onhull)
+			pin[minus] = std::max(pin[minus], w);
+		else
+		{
+			opposite[plus].push_back(std::make_pair((unsigned)minus, w));
+			opposite[minus].push_back(std::make_pair((unsigned)plus, w));
+		}
+	}
+
+	// flood, the most certain cell is labeled first
+	std::priority_queue< std::pair<double, unsigned> > pq;
+	for(unsigned i = 0; i < nc; i ++)
+		if(pin[i] != pout[i])
+			pq.push(std::make_pair(fabs(pin[i] - pout[i]), i));
+
+	while(!pq.empty())
+	{
+		unsigned id = pq.top().second;
+		double prio = pq.top().first;
+		pq.pop();
+		// stale entry, a newer one carries the current priority
+		if(labeled[id] || prio != fabs(pin[id] - pout[id]))
+			continue;
+		labeled[id] = 1;
+		bool in = pin[id] > pout[id];
+
+		for(int j = 0; j < 4; j ++)
+		{
+			Cell_handle_t nh = cells[id]->neighbor(j);
+			if(dt.is_infinite(nh))
+				continue;
+			unsigned nid = nh->info().id;
+			if(labeled[nid])
+				continue;
+			// cosine of the intersection angle of the two Delaunay balls
+			double d2 = (center[id] - center[nid]).SquaredLength();
+			double w = (radius[id] * radius[id] + radius[nid] * radius[nid] - d2) / (2. * radius[id] * radius[nid]);
+			if(w <= 0)
+				continue;
+			double & pr = in ? pin[nid] : pout[nid];
+			if(w > pr)
+			{
+				pr = w;
+				pq.push(std::make_pair(fabs(pin[nid] - pout[nid]), nid));
+			}
+		}
+
+		for(unsigned j = 0; j < opposite[id].size(); j ++)
+		{
+			unsigned nid = opposite[id][j].first;
+			if(labeled[nid])
+				continue;
+			double & pr = in ? pout[nid] : pin[nid];
+			if(opposite[id][j].second > pr)
+			{
+				pr = opposite[id][j].second;
+				pq.push(std::make_pair(fabs(pin[nid] - pout[nid]), nid));
+			}
+		}
+	}
+
+	ambiguous_cells.clear();
+	for(unsigned i = 0; i < nc; i ++)
+	{
+		if(!inside_boundingbox(center[i]))
+		{
+			cells[i]->info().inside = false;
+			continue;
+		}
+		cells[i]->info().inside = pin[i] > pout[i];
+		if(fabs(pin[i] - pout[i]) < m_labeling_ambiguity)
+			ambiguous_cells.push_back(cells[i]);
+	}
+
+	QMAT_LOG_INFO("dt").Field("cells", nc).Field("ambiguous", ambiguous_cells.size())
+		<< "  Power crust labeling: " << nc << " cells, " << ambiguous_cells.size() << " ambiguous";
+
+	if(domain != NULL)
+		ResolveAmbiguousCells();
+}
+
+// exact domain query for the cells the propagation could not decide
+unsigned MPMesh::ResolveAmbiguousCells()
+{
+	if(domain == NULL)
+		return 0;
+
+	unsigned count = (unsigned)ambiguous_cells.size();
+	for(unsigned i = 0; i < ambiguous_cells.size(); i ++)
+	{
+		Point_t cent = CGAL::circumcenter(dt.tetrahedron(ambiguous_cells[i]));
+		ambiguous_cells[i]->info().inside = domain->IsInside(Wm4::Vector3d(cent[0], cent[1], cent[2]));
+	}
+	ambiguous_cells.clear();
+	return count;
+}
+
+void MPMesh::ExteriorMedialVertices(std::vector<double> & centers)
+{
+	centers.clear();
+	for(Finite_cells_iterator_t fci = dt.finite_cells_begin(); fci != dt.finite_cells_end(); fci ++)
+	{
+		if(fci->info().inside)
+			continue;
+		Point_t cent = CGAL::circumcenter(dt.tetrahedron(fci));
+		centers.push_back(cent[0]);
+		centers.push_back(cent[1]);
+		centers.push_back(cent[2]);
 	}
 }
 
@@ -7,29 +7,12 @@
 #include <CGAL/IO/Polyhedron_iostream.h>
 #include <CGAL/convex_hull_2.h>
 
-
-#include <CGAL/Mesh_triangulation_3.h>
-#include <CGAL/Mesh_complex_3_in_triangulation_3.h>
-#include <CGAL/Mesh_criteria_3.h>
-
-#include <CGAL/Polyhedral_mesh_domain_3.h>
-#include <CGAL/make_mesh_3.h>
-#include <CGAL/refine_mesh_3.h>
-
-#include <CGAL/IO/Polyhedron_iostream.h>
-
-
-
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/Delaunay_triangulation_3.h>
 #include <CGAL/Triangulation_vertex_base_with_info_3.h>
 #include <CGAL/Triangulation_cell_base_with_info_3.h>
 #include <CGAL/Delaunay_triangulation_cell_base_with_circumcenter_3.h>
 
-#include <CGAL/Cartesian_d.h>
-#include <CGAL/Min_sphere_d.h>
-#include <CGAL/Min_sphere_annulus_d_traits_d.h>
-
 #include <vector>
 #include <list>
 #include <set>
@@ -40,6 +23,8 @@
 #include "LinearAlgebra/Wm4Vector.h"
 #include "LinearAlgebra/Wm4Matrix.h"
 #include "GeometryObjects/GeometryObjects.h"
+#include "IndexedMesh.h"
+#include "MeshDomain.h"
 
 
 typedef double simple_numbertype;
@@ -111,15 +96,6 @@ typedef Triangulation::Point Point_t;
 
 
 typedef CGAL::Polyhedron_3<K> Polyhedron;
-typedef CGAL::Polyhedral_mesh_domain_3<Polyhedron, K> Mesh_domain;
-
-
-
-typedef CGAL::Cartesian_d<double> CarK;
-typedef CGAL::Min_sphere_annulus_d_traits_d<CarK> MSTraits;
-typedef CGAL::Min_sphere_d<MSTraits> Min_sphere;
-
-typedef CarK::Point_d MSPoint;
 
 
 
@@ -161,6 +137,13 @@ enum METRICPOLICY
 	SQUAREK1_SQUAREK2
 };
 
+// how computedt decides whether a Delaunay cell lies inside the shape
+enum CELLLABELING
+{
+	EXACT_QUERY,	// one domain query per cell
+	POWERCRUST		// priority flood over the cell graph, exact query only for ambiguous cells
+};
+
 enum VertexDiffType
 {
 	ELLIPTIC,
@@ -330,6 +313,10 @@ public:
 	void compute_normals(); // implemented
 	void copybb(MPMesh * pmesh); // implemented
 
+	// take over bounding box, colors, normals and curvature computed on the
+	// flat mesh the polyhedron was built from, GenerateList() must be called first
+	bool CopyAttributes(const IndexedMesh & im);
+
 	// compute the matrix of A and b for sphere mesh
 	void compute_sphere_matrix();
 
@@ -469,7 +456,7 @@ public:
 
 public:
 	
-	Mesh_domain * domain;
+	MeshDomain * domain;
 	Triangulation dt;
 	Triangulation dt_dt;
 
@@ -487,8 +474,24 @@ public:
 
 	void computesimpledt();
 	void computedt();
+	// offsets of the Delaunay samples as x, y, z triplets per vertex, empty for none;
+	// the surface, the domain and the reported distances keep the original positions
+	std::vector<double> dt_offset;
 	void markpoles();
 
+	// cell labeling used by computedt
+	CELLLABELING m_cell_labeling;
+	// cells whose in/out priorities differ by less than this are ambiguous
+	double m_labeling_ambiguity;
+	// cells left ambiguous by the propagation, waiting for an exact query
+	std::vector<Cell_handle_t> ambiguous_cells;
+
+	void LabelCellsPowerCrust();
+	unsigned ResolveAmbiguousCells();
+	// circumcenters of the finite cells labeled outside as x, y, z triplets,
+	// the exterior medial vertices next to the raw MA of the inside cells
+	void ExteriorMedialVertices(std::vector<double> & centers);
+
 public:
 	int LocalFlipCount(Vertex_handle vh);
 	bool insideout[50][50][50];
@@ -0,0 +1,68 @@
+#include "MeshDomain.h"
+#include "ObjLoader.h"
+
+#include <CGAL/Polyhedral_mesh_domain_3.h>
+
+typedef CGAL::Polyhedral_mesh_domain_3<Polyhedron, K> Mesh_domain;
+
+class MeshDomainImpl
+{
+public:
+	Polyhedron polyhedron;
+	Mesh_domain * domain;
+
+public:
+	MeshDomainImpl() : domain(NULL) {}
+	~MeshDomainImpl() { delete domain; }
+
+	// the domain keeps handles into the polyhedron, rebuild it after loading
+	void Reset()
+	{
+		delete domain;
+		domain = new Mesh_domain(polyhedron);
+	}
+};
+
+MeshDomain::MeshDomain() : impl(new MeshDomainImpl)
+{
+}
+
+MeshDomain::~MeshDomain()
+{
+	delete impl;
+}
+
+bool MeshDomain::Build(const IndexedMesh & mesh, std::string & error)
+{
+	impl->polyhedron.clear();
+	if(!BuildPolyhedron(mesh, impl->polyhedron, error))
+		return false;
+	impl->Reset();
+	return true;
+}
+
+bool MeshDomain::LoadOFF(const std::string & filename, std::string & error)
+{
+	std::ifstream stream(filename.c_str());
+	if(!stream)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+	impl->polyhedron.clear();
+	stream >> impl->polyhedron;
+	if(!stream && !stream.eof())
+	{
+		error = "Invalid OFF file " + filename;
+		return false;
+	}
+	impl->Reset();
+	return true;
+}
+
+bool MeshDomain::IsInside(const Wm4::Vector3d & p) const
+{
+	if(impl->domain == NULL)
+		return false;
+	return impl->domain->is_in_domain_object()(K::Point_3(p[0], p[1], p[2])) > 0;
+}
@@ -0,0 +1,31 @@
+#ifndef _MESHDOMAIN_H
+#define _MESHDOMAIN_H
+
+#include <string>
+#include "LinearAlgebra/Wm4Vector.h"
+
+class IndexedMesh;
+class MeshDomainImpl;
+
+// inside/outside queries against the input surface
+// The CGAL polyhedral domain and its AABB tree live behind the pointer, only
+// MeshDomain.cpp includes their headers. The domain owns its polyhedron.
+class MeshDomain
+{
+public:
+	MeshDomain();
+	~MeshDomain();
+
+	bool Build(const IndexedMesh & mesh, std::string & error);
+	bool LoadOFF(const std::string & filename, std::string & error);
+
+	bool IsInside(const Wm4::Vector3d & p) const;
+
+private:
+	MeshDomain(const MeshDomain &);
+	MeshDomain & operator=(const MeshDomain &);
+
+	MeshDomainImpl * impl;
+};
+
+#endif // _MESHDOMAIN_H
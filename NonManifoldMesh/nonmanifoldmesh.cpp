@@ -1,4 +1,6 @@
 #include "nonmanifoldmesh.h"
+#include "SpatialOrder.h"
+#include "Logger.h"
 #include <ctime>
 #include <cstdio>
 #include <boost/lexical_cast.hpp>
@@ -30,9 +32,27 @@ void NonManifoldMesh::AdjustStorage()
 		if(faces[i].first)
 			newf[i] = count ++;
 
-	std::vector<Bool_VertexPointer> new_vertices;
-	std::vector<Bool_EdgePointer> new_edges;
-	std::vector<Bool_FacePointer> new_faces;
+	RemapStorage(newv, newe, newf);
+}
+
+// renumber the valid elements, element i moves to slot newv[i] / newe[i] / newf[i],
+// the invalid ones are dropped
+void NonManifoldMesh::RemapStorage(const std::vector<unsigned> & newv, const std::vector<unsigned> & newe, const std::vector<unsigned> & newf)
+{
+	unsigned nv = 0, ne = 0, nf = 0;
+	for(unsigned i = 0; i < vertices.size(); i ++)
+		if(vertices[i].first)
+			nv ++;
+	for(unsigned i = 0; i < edges.size(); i ++)
+		if(edges[i].first)
+			ne ++;
+	for(unsigned i = 0; i < faces.size(); i ++)
+		if(faces[i].first)
+			nf ++;
+
+	std::vector<Bool_VertexPointer> new_vertices(nv);
+	std::vector<Bool_EdgePointer> new_edges(ne);
+	std::vector<Bool_FacePointer> new_faces(nf);
 
 	for(unsigned i = 0; i < vertices.size(); i ++)
 		if(vertices[i].first)
@@ -51,53 +71,114 @@ void NonManifoldMesh::AdjustStorage()
 
 			bvp.second->edges_ = neweset;
 			bvp.second->faces_ = newfset;
-			new_vertices.push_back(bvp);
+			new_vertices[newv[i]] = bvp;
 		}
 
-		for(unsigned i = 0; i < edges.size(); i ++)
-			if(edges[i].first)
-			{
-				Bool_EdgePointer bep;
-				bep = edges[i];
-				std::pair<unsigned,unsigned> newvpair;
-				std::set<unsigned> newfset;
+	for(unsigned i = 0; i < edges.size(); i ++)
+		if(edges[i].first)
+		{
+			Bool_EdgePointer bep;
+			bep = edges[i];
+			std::pair<unsigned,unsigned> newvpair;
+			std::set<unsigned> newfset;
 
-				newvpair.first = newv[bep.second->vertices_.first];
-				newvpair.second = newv[bep.second->vertices_.second];
+			newvpair.first = newv[bep.second->vertices_.first];
+			newvpair.second = newv[bep.second->vertices_.second];
 
-				for(std::set<unsigned>::iterator si = bep.second->faces_.begin();
-					si != bep.second->faces_.end(); si ++)
-					newfset.insert(newf[*si]);
+			for(std::set<unsigned>::iterator si = bep.second->faces_.begin();
+				si != bep.second->faces_.end(); si ++)
+				newfset.insert(newf[*si]);
 
-				bep.second->vertices_ = newvpair;
-				bep.second->faces_ = newfset;
-				new_edges.push_back(bep);
-			}
+			bep.second->vertices_ = newvpair;
+			bep.second->faces_ = newfset;
+			new_edges[newe[i]] = bep;
+		}
 
-			for(unsigned i = 0; i < faces.size(); i ++)
-				if(faces[i].first)
-				{
-					Bool_FacePointer bfp;
-					bfp = faces[i];
-					std::set<unsigned> newvset;
-					std::set<unsigned> neweset;
-
-					for(std::set<unsigned>::iterator si = bfp.second->vertices_.begin();
-						si != bfp.second->vertices_.end(); si ++)
-						newvset.insert(newv[*si]);
-
-					for(std::set<unsigned>::iterator si = bfp.second->edges_.begin();
-						si != bfp.second->edges_.end(); si ++)
-						neweset.insert(newe[*si]);
-
-					bfp.second->vertices_ = newvset;
-					bfp.second->edges_ = neweset;
-					new_faces.push_back(bfp);
-				}
+	for(unsigned i = 0; i < faces.size(); i ++)
+		if(faces[i].first)
+		{
+			Bool_FacePointer bfp;
+			bfp = faces[i];
+			std::set<unsigned> newvset;
+			std::set<unsigned> neweset;
+
+			for(std::set<unsigned>::iterator si = bfp.second->vertices_.begin();
+				si != bfp.second->vertices_.end(); si ++)
+				newvset.insert(newv[*si]);
+
+			for(std::set<unsigned>::iterator si = bfp.second->edges_.begin();
+				si != bfp.second->edges_.end(); si ++)
+				neweset.insert(newe[*si]);
 
-				vertices = new_vertices;
-				edges = new_edges;
-				faces = new_faces;
+			bfp.second->vertices_ = newvset;
+			bfp.second->edges_ = neweset;
+			new_faces[newf[i]] = bfp;
+		}
+
+	vertices = new_vertices;
+	edges = new_edges;
+	faces = new_faces;
+}
+
+// renumber the vertices along a Morton curve of their centers, then the edges
+// and faces by their smallest new vertex id, so that elements close in space
+// are close in memory
+void NonManifoldMesh::SpatialReorder()
+{
+	std::vector<unsigned> vid;
+	std::vector<Wm4::Vector3d> centers;
+	for(unsigned i = 0; i < vertices.size(); i ++)
+		if(vertices[i].first)
+		{
+			vid.push_back(i);
+			centers.push_back(vertices[i].second->sphere.center);
+		}
+
+	std::vector<unsigned> order;
+	MortonOrder(centers, order);
+
+	std::vector<unsigned> newv(vertices.size(), 0);
+	for(unsigned i = 0; i < order.size(); i ++)
+		newv[vid[order[i]]] = i;
+
+	// key = (smallest vertex, second smallest vertex)
+	std::vector<unsigned> eid;
+	std::vector<unsigned long long> ekeys;
+	for(unsigned i = 0; i < edges.size(); i ++)
+		if(edges[i].first)
+		{
+			unsigned a = newv[edges[i].second->vertices_.first];
+			unsigned b = newv[edges[i].second->vertices_.second];
+			eid.push_back(i);
+			ekeys.push_back(((unsigned long long)std::min(a, b) << 32) | std::max(a, b));
+		}
+	RadixSortIndices(ekeys, order);
+	std::vector<unsigned> newe(edges.size(), 0);
+	for(unsigned i = 0; i < order.size(); i ++)
+		newe[eid[order[i]]] = i;
+
+	std::vector<unsigned> fid;
+	std::vector<unsigned long long> fkeys;
+	for(unsigned i = 0; i < faces.size(); i ++)
+		if(faces[i].first)
+		{
+			std::vector<unsigned> fv;
+			for(std::set<unsigned>::iterator si = faces[i].second->vertices_.begin();
+				si != faces[i].second->vertices_.end(); si ++)
+				fv.push_back(newv[*si]);
+			std::sort(fv.begin(), fv.end());
+			unsigned long long key = (unsigned long long)(fv.empty() ? 0 : fv[0]) << 32;
+			if(fv.size() > 1)
+				key |= fv[1];
+			fid.push_back(i);
+			fkeys.push_back(key);
+		}
+	RadixSortIndices(fkeys, order);
+	std::vector<unsigned> newf(faces.size(), 0);
+	for(unsigned i = 0; i < order.size(); i ++)
+		newf[fid[order[i]]] = i;
+
+	RemapStorage(newv, newe, newf);
 }
 
 bool NonManifoldMesh::ValidVertex(unsigned vid)
@@ -687,7 +768,6 @@ void NonManifoldMesh::Export(std::string fname){
 	// 	fname = fname.substr(0, fname.find(".off"));
 	// }
 	
-	AdjustStorage();
 
 	//std::string sphname = fname;
 	//sphname += ".sph";
@@ -726,38 +806,13 @@ void NonManifoldMesh::Export(std::string fname){
 
 	std::string maname = fname;
 	maname += ".ma";
-	std::cout << "Exporting to " << maname << std::endl;
+	QMAT_LOG_INFO("export") << "Exporting to " << maname;
 	//std::ofstream fout("3dma.ma");
 	std::ofstream fout(maname);
 
 //	GraphVertexIterator gvi,gvi_end;
 
-	fout << numVertices << " " << numEdges << " " << numFaces << std::endl;
-	
-	//fout << num_vertices(*g) << " " << num_edges(*g) << " " << g->tris.size() << std::endl;
-
-	for(unsigned i = 0; i < vertices.size(); i ++)
-		//fout << "v " << vertices[i].second->sphere.center << " " << vertices[i].second->sphere.radius << std::endl;
-		fout << "v " << setiosflags(ios::fixed) << setprecision(15) << vertices[i].second->sphere.center << " " << vertices[i].second->sphere.radius << std::endl;
-
-	for(unsigned i = 0; i < edges.size(); i ++)
-		fout << "e " << edges[i].second->vertices_.first << " " << edges[i].second->vertices_.second << std::endl;
-	for(unsigned i = 0; i < faces.size(); i ++)
-	{
-		fout << "f";
-		for(std::set<unsigned>::iterator si = faces[i].second->vertices_.begin();
-			si != faces[i].second->vertices_.end(); si ++)
-			fout << " " << *si;
-		fout << std::endl;
-	}
-	/*
-	for(boost::tie(gvi,gvi_end) = vertices(*g); gvi != gvi_end; gvi ++)
-		fout << "v "<< (*g)[*gvi].pos[0] << ' ' << (*g)[*gvi].pos[1] << ' ' << (*g)[*gvi].pos[2] << ' ' << (*g)[*gvi].radius << std::endl;
-	for(std::pair<GraphEdgeIterator, GraphEdgeIterator> geip = edges(*g); geip.first != geip.second; geip.first ++)
-		fout << "e " << boost::source(*geip.first, *g) << " " << boost::target(*geip.first, *g) << std::endl;// << " " << boost::target(*geip.first, *g) + 1 << std::endl;
-	for(unsigned int i = 0; i < g->tris.size(); i ++)
-		fout << "f " << MappingIdtoGVD(g,g->tris[i].vid[0]) << ' ' << MappingIdtoGVD(g,g->tris[i].vid[1]) << ' ' << MappingIdtoGVD(g,g->tris[i].vid[2]) << std::endl;
-	*/
+	Export(fout);
 	fout.close();
 
 	//std::string mappingname = fname;
@@ -789,4 +844,35 @@ void NonManifoldMesh::Export(std::string fname){
 	//	
 
 	//fmapping.close();
+}
+
+void NonManifoldMesh::Export(std::ostream & fout){
+	AdjustStorage();
+
+	fout << numVertices << " " << numEdges << " " << numFaces << std::endl;
+	
+	//fout << num_vertices(*g) << " " << num_edges(*g) << " " << g->tris.size() << std::endl;
+
+	for(unsigned i = 0; i < vertices.size(); i ++)
+		//fout << "v " << vertices[i].second->sphere.center << " " << vertices[i].second->sphere.radius << std::endl;
+		fout << "v " << setiosflags(ios::fixed) << setprecision(15) << vertices[i].second->sphere.center << " " << vertices[i].second->sphere.radius << std::endl;
+
+	for(unsigned i = 0; i < edges.size(); i ++)
+		fout << "e " << edges[i].second->vertices_.first << " " << edges[i].second->vertices_.second << std::endl;
+	for(unsigned i = 0; i < faces.size(); i ++)
+	{
+		fout << "f";
+		for(std::set<unsigned>::iterator si = faces[i].second->vertices_.begin();
+			si != faces[i].second->vertices_.end(); si ++)
+			fout << " " << *si;
+		fout << std::endl;
+	}
+	/*
+	for(boost::tie(gvi,gvi_end) = vertices(*g); gvi != gvi_end; gvi ++)
+		fout << "v "<< (*g)[*gvi].pos[0] << ' ' << (*g)[*gvi].pos[1] << ' ' << (*g)[*gvi].pos[2] << ' ' << (*g)[*gvi].radius << std::endl;
+	for(std::pair<GraphEdgeIterator, GraphEdgeIterator> geip = edges(*g); geip.first != geip.second; geip.first ++)
+		fout << "e " << boost::source(*geip.first, *g) << " " << boost::target(*geip.first, *g) << std::endl;// << " " << boost::target(*geip.first, *g) + 1 << std::endl;
+	for(unsigned int i = 0; i < g->tris.size(); i ++)
+		fout << "f " << MappingIdtoGVD(g,g->tris[i].vid[0]) << ' ' << MappingIdtoGVD(g,g->tris[i].vid[1]) << ' ' << MappingIdtoGVD(g,g->tris[i].vid[2]) << std::endl;
+	*/
 }
\ No newline at end of file
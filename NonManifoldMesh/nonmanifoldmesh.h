@@ -165,7 +165,7 @@ class NonManifoldMesh
 {
 public:
 	Mesh * pmesh;
-	Mesh_domain * domain;
+	MeshDomain * domain;
 public:
 	double diameter;
 public:
@@ -203,7 +203,7 @@ public:
 	}
 
 public:
-	std::vector<SamplePoint> BoundaryPoints;
+	SamplePointSet BoundaryPoints;
 	unsigned num_f_manifolds;
 	unsigned num_e_manifolds;
 	unsigned num_v_manifolds;
@@ -222,6 +222,8 @@ public:
 
 public:
 	void AdjustStorage();
+	void RemapStorage(const std::vector<unsigned> & newv, const std::vector<unsigned> & newe, const std::vector<unsigned> & newf);
+	void SpatialReorder();
 
 public:
 	bool ValidVertex(unsigned vid);
@@ -243,6 +245,7 @@ public:
 
 public:
 	void Export(std::string fname);
+	void Export(std::ostream & fout);
 
 	void DeleteFace(unsigned fid);
 	void DeleteEdge(unsigned eid);
@@ -2,6 +2,7 @@
 #include "tiny_obj_loader.h"
 
 #include "ObjLoader.h"
+#include "Logger.h"
 #include <algorithm>
 #include <cctype>
 
@@ -25,14 +26,59 @@ bool IsOffFile(const std::string& filename) {
     return GetFileExtension(filename) == "off";
 }
 
-// Internal struct to hold parsed OBJ data
-struct ObjData {
-    std::vector<double> vertices;
-    std::vector<std::vector<int>> faces;
-};
+// Copy the parsed OBJ into the flat indexed mesh
+static bool CopyObj(const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes,
+                    IndexedMesh& data, std::string& error) {
+    if (attrib.vertices.empty()) {
+        error = "OBJ file contains no vertices";
+        return false;
+    }
+
+    // Copy vertices (tinyobj stores as x,y,z triplets)
+    // Convert from tinyobj::real_t (float) to double
+    data.positions.reserve(attrib.vertices.size());
+    for (const auto& v : attrib.vertices) {
+        data.positions.push_back(static_cast<double>(v));
+    }
+
+    // Collect all faces from all shapes, tinyobj does not check the index range
+    const long long numVertices = (long long)data.NumVertices();
+    std::vector<unsigned> faceIndices;
+    for (const auto& shape : shapes) {
+        size_t indexOffset = 0;
+        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); ++f) {
+            int fv = shape.mesh.num_face_vertices[f];
+
+            faceIndices.resize(fv);
+            for (int v = 0; v < fv; ++v) {
+                tinyobj::index_t idx = shape.mesh.indices[indexOffset + v];
+                if (idx.vertex_index < 0 || idx.vertex_index >= numVertices) {
+                    error = "Invalid face index in OBJ file";
+                    return false;
+                }
+                faceIndices[v] = idx.vertex_index;
+            }
+
+            data.AddFace(faceIndices.data(), fv);
+            indexOffset += fv;
+        }
+    }
+
+    if (data.NumFaces() == 0) {
+        error = "OBJ file contains no faces";
+        return false;
+    }
+
+    QMAT_LOG_INFO("load").Field("vertices", data.NumVertices()).Field("faces", data.NumFaces())
+        << "  OBJ: " << data.NumVertices() << " vertices, " << data.NumFaces() << " faces";
+
+    return true;
+}
+
+// Parse an OBJ file straight into the flat indexed mesh
+bool LoadObjFile(const std::string& filename, IndexedMesh& data, std::string& error) {
+    data.clear();
 
-// Internal function to parse OBJ file into raw data
-static bool ParseObjFile(const std::string& filename, ObjData& data, std::string& error) {
     tinyobj::attrib_t attrib;
     std::vector<tinyobj::shape_t> shapes;
     std::vector<tinyobj::material_t> materials;
@@ -65,59 +111,57 @@ static bool ParseObjFile(const std::string& filename, ObjData& data, std::string
         return false;
     }
 
-    if (attrib.vertices.empty()) {
-        error = "OBJ file contains no vertices";
-        return false;
-    }
-
-    // Copy vertices (tinyobj stores as x,y,z triplets)
-    // Convert from tinyobj::real_t (float) to double
-    data.vertices.reserve(attrib.vertices.size());
-    for (const auto& v : attrib.vertices) {
-        data.vertices.push_back(static_cast<double>(v));
-    }
-
-    // Collect all faces from all shapes
-    for (const auto& shape : shapes) {
-        size_t indexOffset = 0;
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); ++f) {
-            int fv = shape.mesh.num_face_vertices[f];
+    return CopyObj(attrib, shapes, data, error);
+}
 
-            std::vector<int> faceIndices;
-            faceIndices.reserve(fv);
+bool LoadObjStream(std::istream& in, IndexedMesh& data, std::string& error) {
+    data.clear();
 
-            for (int v = 0; v < fv; ++v) {
-                tinyobj::index_t idx = shape.mesh.indices[indexOffset + v];
-                faceIndices.push_back(idx.vertex_index);
-            }
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string err;
 
-            data.faces.push_back(faceIndices);
-            indexOffset += fv;
-        }
+    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &err, &in, nullptr, true);
+    if (!err.empty()) {
+        error = err;
     }
-
-    if (data.faces.empty()) {
-        error = "OBJ file contains no faces";
+    if (!ret) {
+        if (error.empty()) {
+            error = "Failed to read OBJ stream";
+        }
         return false;
     }
 
-    std::cout << "  OBJ: " << data.vertices.size() / 3 << " vertices, "
-              << data.faces.size() << " faces" << std::endl;
+    return CopyObj(attrib, shapes, data, error);
+}
 
-    return true;
+bool LoadMeshFile(const std::string& filename, IndexedMesh& mesh, std::string& error) {
+    if (IsObjFile(filename)) {
+        return LoadObjFile(filename, mesh, error);
+    }
+    if (IsOffFile(filename)) {
+        return mesh.LoadOFF(filename, error);
+    }
+    error = "Unsupported file format: " + filename;
+    return false;
 }
 
-// Load OBJ into MPMesh (uses simple_kernel::Point_3)
-bool LoadObjFile(const std::string& filename, Mesh& mesh, std::string& error) {
-    ObjData data;
-    if (!ParseObjFile(filename, data, error)) {
-        return false;
+bool LoadMeshStream(std::istream& in, const std::string& format, IndexedMesh& mesh, std::string& error) {
+    if (format == "obj") {
+        return LoadObjStream(in, mesh, error);
     }
+    if (format == "off") {
+        return mesh.LoadOFF(in, error);
+    }
+    error = "Unsupported mesh format: " + format;
+    return false;
+}
 
-    // Create the builder with simple_kernel Point type
-    ObjPolyhedronBuilderT<Mesh::HalfedgeDS, simple_kernel::Point_3> builder;
-    builder.vertices = std::move(data.vertices);
-    builder.faces = std::move(data.faces);
+// Shared by both polyhedron types, only the point type of the kernel differs
+template <class PolyhedronType, class PointType>
+static bool BuildPolyhedronT(const IndexedMesh& indexed, PolyhedronType& mesh, std::string& error) {
+    IndexedPolyhedronBuilder<typename PolyhedronType::HalfedgeDS, PointType> builder(indexed);
 
     // Build the polyhedron
     try {
@@ -139,34 +183,30 @@ bool LoadObjFile(const std::string& filename, Mesh& mesh, std::string& error) {
     return true;
 }
 
-// Load OBJ into basic Polyhedron (uses K::Point_3 for mesh domain)
-bool LoadObjFile(const std::string& filename, Polyhedron& mesh, std::string& error) {
-    ObjData data;
-    if (!ParseObjFile(filename, data, error)) {
-        return false;
-    }
+// Build MPMesh (uses simple_kernel::Point_3)
+bool BuildPolyhedron(const IndexedMesh& indexed, Mesh& mesh, std::string& error) {
+    return BuildPolyhedronT<Mesh, simple_kernel::Point_3>(indexed, mesh, error);
+}
 
-    // Create the builder with K (Exact_predicates_inexact_constructions_kernel) Point type
-    ObjPolyhedronBuilderT<Polyhedron::HalfedgeDS, K::Point_3> builder;
-    builder.vertices = std::move(data.vertices);
-    builder.faces = std::move(data.faces);
+// Build basic Polyhedron (uses K::Point_3 for mesh domain)
+bool BuildPolyhedron(const IndexedMesh& indexed, Polyhedron& mesh, std::string& error) {
+    return BuildPolyhedronT<Polyhedron, K::Point_3>(indexed, mesh, error);
+}
 
-    // Build the polyhedron
-    try {
-        mesh.delegate(builder);
-    } catch (const std::exception& e) {
-        error = std::string("Failed to build polyhedron: ") + e.what();
+// Load OBJ into MPMesh (uses simple_kernel::Point_3)
+bool LoadObjFile(const std::string& filename, Mesh& mesh, std::string& error) {
+    IndexedMesh data;
+    if (!LoadObjFile(filename, data, error)) {
         return false;
     }
+    return BuildPolyhedron(data, mesh, error);
+}
 
-    if (!mesh.is_valid()) {
-        error = "Resulting mesh is not valid";
+// Load OBJ into basic Polyhedron (uses K::Point_3 for mesh domain)
+bool LoadObjFile(const std::string& filename, Polyhedron& mesh, std::string& error) {
+    IndexedMesh data;
+    if (!LoadObjFile(filename, data, error)) {
         return false;
     }
-
-    if (!mesh.is_closed()) {
-        std::cerr << "Warning: Mesh is not closed (has boundary edges)" << std::endl;
-    }
-
-    return true;
+    return BuildPolyhedron(data, mesh, error);
 }
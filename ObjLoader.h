@@ -6,41 +6,44 @@
 #include <iostream>
 #include <CGAL/Polyhedron_incremental_builder_3.h>
 #include "Mesh.h"
+#include "IndexedMesh.h"
 
-// Builder class for constructing CGAL Polyhedron from OBJ data
+// Builder class for constructing a CGAL Polyhedron from a flat indexed mesh
 // Template parameter PointType allows using different point types for different kernels
 template <class HDS, class PointType>
-class ObjPolyhedronBuilderT : public CGAL::Modifier_base<HDS> {
+class IndexedPolyhedronBuilder : public CGAL::Modifier_base<HDS> {
 public:
-    std::vector<double> vertices;  // x, y, z triplets
-    std::vector<std::vector<int>> faces;  // face vertex indices
-    std::string error;
+    const IndexedMesh& mesh;
+    size_t skippedFaces;
 
-    ObjPolyhedronBuilderT() {}
+    IndexedPolyhedronBuilder(const IndexedMesh& m) : mesh(m), skippedFaces(0) {}
 
     void operator()(HDS& hds) {
         CGAL::Polyhedron_incremental_builder_3<HDS> builder(hds, true);
 
-        size_t numVertices = vertices.size() / 3;
-        size_t numFaces = faces.size();
+        size_t numVertices = mesh.NumVertices();
+        size_t numFaces = mesh.NumFaces();
 
         builder.begin_surface(numVertices, numFaces);
 
         // Add vertices
         for (size_t i = 0; i < numVertices; ++i) {
             builder.add_vertex(PointType(
-                vertices[i * 3],
-                vertices[i * 3 + 1],
-                vertices[i * 3 + 2]
+                mesh.positions[i * 3],
+                mesh.positions[i * 3 + 1],
+                mesh.positions[i * 3 + 2]
             ));
         }
 
         // Add faces
         for (size_t i = 0; i < numFaces; ++i) {
-            if (builder.test_facet(faces[i].begin(), faces[i].end())) {
-                builder.add_facet(faces[i].begin(), faces[i].end());
+            const unsigned* first = &mesh.face_index[mesh.face_offset[i]];
+            const unsigned* last = first + mesh.FaceDegree((unsigned)i);
+            if (builder.test_facet(first, last)) {
+                builder.add_facet(first, last);
             } else {
                 std::cerr << "Warning: Skipping invalid facet " << i << std::endl;
+                ++skippedFaces;
             }
         }
 
@@ -48,9 +51,26 @@ public:
     }
 };
 
-// Type alias for MPMesh (uses simple_kernel Point)
-template <class HDS>
-using ObjPolyhedronBuilder = ObjPolyhedronBuilderT<HDS, Point>;
+// Load an OBJ file into a flat indexed mesh
+// Returns true on success, false on failure
+// Error message is stored in 'error' parameter
+bool LoadObjFile(const std::string& filename, IndexedMesh& mesh, std::string& error);
+
+// Load OBJ text from a stream, material libraries are not read
+bool LoadObjStream(std::istream& in, IndexedMesh& mesh, std::string& error);
+
+// Load an OBJ or OFF file into a flat indexed mesh, dispatching on the extension
+bool LoadMeshFile(const std::string& filename, IndexedMesh& mesh, std::string& error);
+
+// Load a mesh from a stream, format is "obj" or "off"
+bool LoadMeshStream(std::istream& in, const std::string& format, IndexedMesh& mesh, std::string& error);
+
+// Build the CGAL Polyhedron of an already loaded indexed mesh (MPMesh type)
+// The vertex order of the polyhedron is the order of the indexed mesh
+bool BuildPolyhedron(const IndexedMesh& indexed, Mesh& mesh, std::string& error);
+
+// Build a basic CGAL Polyhedron (for mesh domain) of an already loaded indexed mesh
+bool BuildPolyhedron(const IndexedMesh& indexed, Polyhedron& mesh, std::string& error);
 
 // Load an OBJ file into a CGAL Polyhedron mesh (MPMesh type)
 // Returns true on success, false on failure
@@ -0,0 +1,191 @@
+#include "Perturbation.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <cmath>
+#include <algorithm>
+
+// nearest neighbors a vertex is tested with, the triples grow with its cube
+static const unsigned degeneracy_neighbors = 8;
+// spheres larger than this many neighborhood radii come from nearly coplanar
+// samples, the coplanar test covers those
+static const double degeneracy_max_radius = 10.;
+
+static unsigned long long DegeneracyCellKey(long long x, long long y, long long z)
+{
+	return ((unsigned long long)(x & 0x1fffff) << 42) | ((unsigned long long)(y & 0x1fffff) << 21) | (unsigned long long)(z & 0x1fffff);
+}
+
+static unsigned long long SplitMix64(unsigned long long & state)
+{
+	unsigned long long z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// |d - center| equals the radius within tolerance
+static bool OnSphere(const Vector3d & d, const Vector3d & center, double radius, double tolerance)
+{
+	return fabs((d - center).Length() - radius) <= tolerance * radius;
+}
+
+void DetectDegenerateVertices(const IndexedMesh & mesh, double tolerance,
+							  std::vector<char> & degenerate, DegeneracyStats & stats)
+{
+	unsigned nv = mesh.NumVertices();
+	stats = DegeneracyStats();
+	degenerate.assign(nv, 0);
+	if(nv < 5)
+		return;
+
+	// the cells are as large as the mean edge
+	double edge_sum = 0.;
+	unsigned edge_count = 0;
+	for(unsigned f = 0; f < mesh.NumFaces(); f ++)
+		for(unsigned k = 0; k < mesh.FaceDegree(f); k ++)
+		{
+			unsigned a = mesh.face_index[mesh.face_offset[f] + k];
+			unsigned b = mesh.face_index[mesh.face_offset[f] + (k + 1) % mesh.FaceDegree(f)];
+			edge_sum += (mesh.Position(a) - mesh.Position(b)).Length();
+			edge_count ++;
+		}
+	double cell = edge_count > 0 ? edge_sum / edge_count : mesh.bb_diagonal_length / pow((double)nv, 1. / 3.);
+	if(!(cell > 0.))
+		cell = 1.;
+
+	std::vector<std::pair<unsigned long long, unsigned> > grid(nv);
+#pragma omp parallel for
+	for(int i = 0; i < (int)nv; i ++)
+	{
+		long long c[3];
+		for(int k = 0; k < 3; k ++)
+			c[k] = (long long)floor((mesh.positions[3 * i + k] - mesh.m_min[k]) / cell);
+		grid[i] = std::make_pair(DegeneracyCellKey(c[0], c[1], c[2]), (unsigned)i);
+	}
+	std::sort(grid.begin(), grid.end());
+
+	unsigned coincident = 0, cospherical = 0, cocircular = 0, flagged = 0;
+#pragma omp parallel
+	{
+		std::vector<std::pair<double, unsigned> > near;
+		unsigned lcoincident = 0, lcospherical = 0, lcocircular = 0, lflagged = 0;
+
+#pragma omp for schedule(dynamic, 256) nowait
+		for(int i = 0; i < (int)nv; i ++)
+		{
+			Vector3d p = mesh.Position(i);
+			long long c[3];
+			for(int k = 0; k < 3; k ++)
+				c[k] = (long long)floor((mesh.positions[3 * i + k] - mesh.m_min[k]) / cell);
+
+			bool is_coincident = false;
+			near.clear();
+			for(long long dz = -1; dz <= 1; dz ++)
+				for(long long dy = -1; dy <= 1; dy ++)
+					for(long long dx = -1; dx <= 1; dx ++)
+					{
+						std::pair<unsigned long long, unsigned> lo(DegeneracyCellKey(c[0] + dx, c[1] + dy, c[2] + dz), 0);
+						std::vector<std::pair<unsigned long long, unsigned> >::const_iterator it = std::lower_bound(grid.begin(), grid.end(), lo);
+						for(; it != grid.end() && it->first == lo.first; ++it)
+						{
+							if(it->second == (unsigned)i)
+								continue;
+							double d = (mesh.Position(it->second) - p).Length();
+							if(d <= tolerance * cell)
+								is_coincident = true;
+							else
+								near.push_back(std::make_pair(d, it->second));
+						}
+					}
+			unsigned k = std::min((unsigned)near.size(), degeneracy_neighbors);
+			std::partial_sort(near.begin(), near.begin() + k, near.end());
+
+			bool is_cospherical = false, is_cocircular = false;
+			for(unsigned a = 0; a < k && !is_cospherical && !is_cocircular; a ++)
+				for(unsigned b = a + 1; b < k && !is_cospherical && !is_cocircular; b ++)
+					for(unsigned t = b + 1; t < k && !is_cospherical && !is_cocircular; t ++)
+					{
+						Vector3d u = mesh.Position(near[a].second) - p;
+						Vector3d v = mesh.Position(near[b].second) - p;
+						Vector3d w = mesh.Position(near[t].second) - p;
+						double volume = u.Dot(v.Cross(w));
+						if(fabs(volume) <= tolerance * near[a].first * near[b].first * near[t].first)
+						{
+							// coplanar, four samples on the circle through p, a and b
+							Vector3d n = u.Cross(v);
+							double nn = n.Dot(n);
+							if(nn <= tolerance * tolerance * near[a].first * near[a].first * near[b].first * near[b].first)
+								continue;
+							Vector3d center = p + (u.Dot(u) * v.Cross(n) + v.Dot(v) * n.Cross(u)) / (2. * nn);
+							if(OnSphere(p + w, center, (center - p).Length(), tolerance))
+								is_cocircular = true;
+							continue;
+						}
+						Vector3d center = p + (u.Dot(u) * v.Cross(w) + v.Dot(v) * w.Cross(u) + w.Dot(w) * u.Cross(v)) / (2. * volume);
+						double radius = (center - p).Length();
+						if(radius > degeneracy_max_radius * near[k - 1].first)
+							continue;
+						for(unsigned d = 0; d < k; d ++)
+							if(d != a && d != b && d != t && OnSphere(mesh.Position(near[d].second), center, radius, tolerance))
+							{
+								is_cospherical = true;
+								break;
+							}
+					}
+
+			if(is_coincident)
+				lcoincident ++;
+			if(is_cospherical)
+				lcospherical ++;
+			if(is_cocircular)
+				lcocircular ++;
+			if(is_coincident || is_cospherical || is_cocircular)
+			{
+				degenerate[i] = 1;
+				lflagged ++;
+			}
+		}
+
+#pragma omp critical
+		{
+			coincident += lcoincident;
+			cospherical += lcospherical;
+			cocircular += lcocircular;
+			flagged += lflagged;
+		}
+	}
+
+	stats.coincident = coincident;
+	stats.cospherical = cospherical;
+	stats.cocircular = cocircular;
+	stats.degenerate = flagged;
+}
+
+void PerturbDegenerateVertices(const IndexedMesh & mesh, const std::vector<char> & degenerate,
+							   double magnitude, unsigned seed, std::vector<double> & offsets, DegeneracyStats & stats)
+{
+	unsigned nv = mesh.NumVertices();
+	offsets.assign(3 * nv, 0.);
+	double amplitude = magnitude * mesh.bb_diagonal_length;
+
+	unsigned perturbed = 0;
+	double max_displacement = 0.;
+	for(unsigned i = 0; i < nv && i < degenerate.size(); i ++)
+	{
+		if(!degenerate[i])
+			continue;
+		unsigned long long state = ((unsigned long long)seed << 32) ^ i;
+		double length = 0.;
+		for(int k = 0; k < 3; k ++)
+		{
+			// uniform in [-1, 1)
+			double r = (double)(SplitMix64(state) >> 11) / 9007199254740992. * 2. - 1.;
+			offsets[3 * i + k] = amplitude * r;
+			length += offsets[3 * i + k] * offsets[3 * i + k];
+		}
+		max_displacement = std::max(max_displacement, sqrt(length));
+		perturbed ++;
+	}
+	stats.perturbed = perturbed;
+	stats.max_displacement = max_displacement;
+}
@@ -0,0 +1,38 @@
+#ifndef _PERTURBATION_H
+#define _PERTURBATION_H
+
+#include <vector>
+#include "IndexedMesh.h"
+
+// counts of the last DetectDegenerateVertices / PerturbDegenerateVertices
+class DegeneracyStats
+{
+public:
+	unsigned coincident;		// vertices sharing their position with another one
+	unsigned cospherical;		// vertices with five nearby samples on one sphere
+	unsigned cocircular;		// vertices with four nearby coplanar samples on one circle
+	unsigned degenerate;		// vertices flagged by any of the tests
+	unsigned perturbed;
+	double max_displacement;
+
+public:
+	DegeneracyStats() : coincident(0), cospherical(0), cocircular(0), degenerate(0), perturbed(0), max_displacement(0.) {}
+};
+
+// Flags the vertices that take part in a degenerate Delaunay configuration with
+// their nearest neighbors, found on a uniform grid. A vertex and three of its
+// neighbors span a sphere (a circle when coplanar); the vertex is flagged when a
+// further neighbor lies on it within tolerance * radius. Grid aligned and
+// rotationally regular tessellations of CAD models are flagged almost entirely,
+// free form scans hardly at all.
+void DetectDegenerateVertices(const IndexedMesh & mesh, double tolerance,
+							  std::vector<char> & degenerate, DegeneracyStats & stats);
+
+// Offsets of the flagged vertices as x, y, z triplets, zero elsewhere. Every
+// coordinate moves by at most magnitude * bounding box diagonal. The offset of a
+// vertex only depends on seed and its index, so runs are reproducible with any
+// thread count.
+void PerturbDegenerateVertices(const IndexedMesh & mesh, const std::vector<char> & degenerate,
+							   double magnitude, unsigned seed, std::vector<double> & offsets, DegeneracyStats & stats);
+
+#endif // _PERTURBATION_H
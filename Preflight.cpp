@@ -0,0 +1,412 @@
+#include "Preflight.h"
+#include "SpatialOrder.h"
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+
+PreflightCostModel::PreflightCostModel()
+{
+	dt_cells_per_vertex = 6.5;
+	ma_vertices_per_cell = 0.45;
+	ma_edges_per_ma_vertex = 1.9;
+	ma_faces_per_ma_vertex = 0.9;
+	size_error = 0.3;
+
+	bytes_per_input_vertex = 1600.;
+	bytes_per_dt_cell = 200.;
+	bytes_per_ma_vertex = 1100.;
+	bytes_per_ma_edge = 700.;
+	bytes_per_ma_face = 500.;
+	memory_error = 0.25;
+
+	us_dt_per_cell = 1.5;
+	us_exact_label_per_cell = 25.;
+	us_powercrust_label_per_cell = 2.;
+	us_ma_per_cell = 4.;
+	us_load_slab_per_ma_vertex = 20.;
+	us_simplify_per_collapse = 150.;
+	time_error = 0.5;
+}
+
+bool PreflightCostModel::Load(const std::string & filename, std::string & error)
+{
+	std::ifstream in(filename.c_str());
+	if(!in)
+	{
+		error = "Could not open cost model " + filename;
+		return false;
+	}
+
+	std::string line;
+	while(std::getline(in, line))
+	{
+		size_t pos = line.find('=');
+		if(pos == std::string::npos || line[0] == '#')
+			continue;
+		std::string key = line.substr(0, pos);
+		double value;
+		std::istringstream vs(line.substr(pos + 1));
+		if(!(vs >> value))
+			continue;
+
+		if(key == "dt_cells_per_vertex") dt_cells_per_vertex = value;
+		else if(key == "ma_vertices_per_cell") ma_vertices_per_cell = value;
+		else if(key == "ma_edges_per_ma_vertex") ma_edges_per_ma_vertex = value;
+		else if(key == "ma_faces_per_ma_vertex") ma_faces_per_ma_vertex = value;
+		else if(key == "size_error") size_error = value;
+		else if(key == "bytes_per_input_vertex") bytes_per_input_vertex = value;
+		else if(key == "bytes_per_dt_cell") bytes_per_dt_cell = value;
+		else if(key == "bytes_per_ma_vertex") bytes_per_ma_vertex = value;
+		else if(key == "bytes_per_ma_edge") bytes_per_ma_edge = value;
+		else if(key == "bytes_per_ma_face") bytes_per_ma_face = value;
+		else if(key == "memory_error") memory_error = value;
+		else if(key == "us_dt_per_cell") us_dt_per_cell = value;
+		else if(key == "us_exact_label_per_cell") us_exact_label_per_cell = value;
+		else if(key == "us_powercrust_label_per_cell") us_powercrust_label_per_cell = value;
+		else if(key == "us_ma_per_cell") us_ma_per_cell = value;
+		else if(key == "us_load_slab_per_ma_vertex") us_load_slab_per_ma_vertex = value;
+		else if(key == "us_simplify_per_collapse") us_simplify_per_collapse = value;
+		else if(key == "time_error") time_error = value;
+	}
+	source = filename;
+	return true;
+}
+
+PreflightReport::PreflightReport()
+{
+	num_vertices = num_faces = num_edges = 0;
+	border_edges = non_manifold_edges = inconsistent_edges = 0;
+	degenerate_faces = isolated_vertices = components = 0;
+	intersection_tests = intersection_hits = 0;
+	manifold = watertight = false;
+}
+
+static void PrintRange(std::ostream & out, const char * name, const PreflightRange & r, const char * unit, int precision = 0)
+{
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize prec = out.precision();
+	out << std::fixed << std::setprecision(precision);
+	out << "  " << name << ": " << r.estimate << unit
+		<< " [" << r.low << ", " << r.high << "]" << std::endl;
+	out.flags(flags);
+	out.precision(prec);
+}
+
+void PreflightReport::Print(std::ostream & out) const
+{
+	out << "Input mesh:" << std::endl;
+	out << "  Vertices: " << num_vertices << " (" << isolated_vertices << " isolated)" << std::endl;
+	out << "  Faces: " << num_faces << " (" << degenerate_faces << " degenerate)" << std::endl;
+	out << "  Edges: " << num_edges << std::endl;
+	out << "  Components: " << components << std::endl;
+	out << "  Border edges: " << border_edges << std::endl;
+	out << "  Non-manifold edges: " << non_manifold_edges << std::endl;
+	out << "  Inconsistently oriented edges: " << inconsistent_edges << std::endl;
+	out << "  Self-intersections: " << intersection_hits << " of " << intersection_tests << " sampled triangles" << std::endl;
+	out << "  Manifold: " << (manifold ? "yes" : "no") << ", watertight: " << (watertight ? "yes" : "no") << std::endl;
+
+	if(model_source.empty())
+		out << "Predictions (uncalibrated: default cost model, hand-picked coefficients; use --cost-model for fitted ones):" << std::endl;
+	else
+		out << "Predictions (cost model " << model_source << "):" << std::endl;
+	PrintRange(out, "DT cells", dt_cells, "");
+	PrintRange(out, "Raw MA vertices", ma_vertices, "");
+	PrintRange(out, "Raw MA edges", ma_edges, "");
+	PrintRange(out, "Raw MA faces", ma_faces, "");
+	PrintRange(out, "Peak memory", peak_memory_mb, " MB", 1);
+	PrintRange(out, "DT time", time_dt_ms, " ms");
+	PrintRange(out, "Labeling time", time_label_ms, " ms");
+	PrintRange(out, "MA time", time_ma_ms, " ms");
+	PrintRange(out, "Simplification time", time_simplify_ms, " ms");
+	PrintRange(out, "Total time", time_total_ms, " ms");
+}
+
+// range of r scaled by a coefficient with its own relative error
+static PreflightRange Scale(const PreflightRange & r, double coef, double relerr)
+{
+	PreflightRange s;
+	s.low = r.low * coef * std::max(0., 1. - relerr);
+	s.estimate = r.estimate * coef;
+	s.high = r.high * coef * (1. + relerr);
+	return s;
+}
+
+static PreflightRange Sum(const PreflightRange & a, const PreflightRange & b)
+{
+	PreflightRange s;
+	s.low = a.low + b.low;
+	s.estimate = a.estimate + b.estimate;
+	s.high = a.high + b.high;
+	return s;
+}
+
+static unsigned FindRoot(std::vector<unsigned> & parent, unsigned i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+static double Orient(const Wm4::Vector3d & a, const Wm4::Vector3d & b, const Wm4::Vector3d & c, const Wm4::Vector3d & d)
+{
+	return (b - a).Cross(c - a).Dot(d - a);
+}
+
+// segment pq crosses the interior of triangle abc, touching does not count
+static bool SegmentCrossesTriangle(const Wm4::Vector3d & p, const Wm4::Vector3d & q,
+								   const Wm4::Vector3d & a, const Wm4::Vector3d & b, const Wm4::Vector3d & c)
+{
+	double sp = Orient(a, b, c, p);
+	double sq = Orient(a, b, c, q);
+	if(sp * sq >= 0)
+		return false;
+	double s0 = Orient(p, q, a, b);
+	double s1 = Orient(p, q, b, c);
+	double s2 = Orient(p, q, c, a);
+	return (s0 > 0 && s1 > 0 && s2 > 0) || (s0 < 0 && s1 < 0 && s2 < 0);
+}
+
+// non-coplanar triangles intersect iff an edge of one crosses the other
+static bool TrianglesIntersect(const Wm4::Vector3d * t0, const Wm4::Vector3d * t1)
+{
+	for(int i = 0; i < 3; i ++)
+	{
+		if(SegmentCrossesTriangle(t0[i], t0[(i + 1) % 3], t1[0], t1[1], t1[2]))
+			return true;
+		if(SegmentCrossesTriangle(t1[i], t1[(i + 1) % 3], t0[0], t0[1], t0[2]))
+			return true;
+	}
+	return false;
+}
+
+static void CheckTopology(const IndexedMesh & mesh, PreflightReport & report)
+{
+	unsigned nv = mesh.NumVertices();
+	unsigned nf = mesh.NumFaces();
+
+	// undirected edge keys, the direction is kept on the side
+	std::vector<unsigned long long> keys;
+	std::vector<char> forward;
+	keys.reserve(mesh.face_index.size());
+	forward.reserve(mesh.face_index.size());
+
+	std::vector<char> used(nv, 0);
+	std::vector<unsigned> parent(nv);
+	for(unsigned i = 0; i < nv; i ++)
+		parent[i] = i;
+
+	for(unsigned f = 0; f < nf; f ++)
+	{
+		unsigned deg = mesh.FaceDegree(f);
+		const unsigned * fi = &mesh.face_index[mesh.face_offset[f]];
+		bool degenerate = false;
+		for(unsigned j = 0; j < deg; j ++)
+		{
+			unsigned a = fi[j];
+			unsigned b = fi[(j + 1) % deg];
+			used[a] = 1;
+			if(a == b)
+			{
+				degenerate = true;
+				continue;
+			}
+			keys.push_back(((unsigned long long)std::min(a, b) << 32) | std::max(a, b));
+			forward.push_back(a < b);
+			unsigned ra = FindRoot(parent, a);
+			unsigned rb = FindRoot(parent, b);
+			if(ra != rb)
+				parent[ra] = rb;
+		}
+		if(!degenerate && deg == 3)
+		{
+			Wm4::Vector3d p0 = mesh.Position(fi[0]);
+			Wm4::Vector3d p1 = mesh.Position(fi[1]);
+			Wm4::Vector3d p2 = mesh.Position(fi[2]);
+			degenerate = (p1 - p0).Cross(p2 - p0).SquaredLength() == 0.;
+		}
+		if(degenerate)
+			report.degenerate_faces ++;
+	}
+
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		if(!used[i])
+			report.isolated_vertices ++;
+		else if(FindRoot(parent, i) == i)
+			report.components ++;
+	}
+
+	std::vector<unsigned> order;
+	RadixSortIndices(keys, order);
+	for(unsigned i = 0; i < order.size(); )
+	{
+		unsigned j = i;
+		unsigned nforward = 0;
+		while(j < order.size() && keys[order[j]] == keys[order[i]])
+		{
+			if(forward[order[j]])
+				nforward ++;
+			j ++;
+		}
+		unsigned count = j - i;
+		report.num_edges ++;
+		if(count == 1)
+			report.border_edges ++;
+		else if(count > 2)
+			report.non_manifold_edges ++;
+		else if(nforward != 1)
+			report.inconsistent_edges ++;
+		i = j;
+	}
+
+	report.manifold = (report.non_manifold_edges == 0);
+	report.watertight = report.manifold && (report.border_edges == 0);
+}
+
+// sample triangles and test them against the triangles of the grid cells they overlap
+static void SampleSelfIntersections(const IndexedMesh & mesh, unsigned max_samples, PreflightReport & report)
+{
+	// fan triangulation of the faces
+	std::vector<unsigned> tris;
+	std::vector<unsigned> tri_face;
+	for(unsigned f = 0; f < mesh.NumFaces(); f ++)
+	{
+		const unsigned * fi = &mesh.face_index[mesh.face_offset[f]];
+		for(unsigned j = 1; j + 1 < mesh.FaceDegree(f); j ++)
+		{
+			tris.push_back(fi[0]);
+			tris.push_back(fi[j]);
+			tris.push_back(fi[j + 1]);
+			tri_face.push_back(f);
+		}
+	}
+	unsigned nt = (unsigned)tri_face.size();
+	if(nt == 0 || max_samples == 0)
+		return;
+
+	double mn[3] = {1e20, 1e20, 1e20};
+	double mx[3] = {-1e20, -1e20, -1e20};
+	for(unsigned i = 0; i < mesh.NumVertices(); i ++)
+		for(int d = 0; d < 3; d ++)
+		{
+			mn[d] = std::min(mn[d], mesh.positions[3 * i + d]);
+			mx[d] = std::max(mx[d], mesh.positions[3 * i + d]);
+		}
+
+	int res = std::max(1, std::min(64, (int)std::pow((double)nt, 1. / 3.)));
+	std::vector< std::vector<unsigned> > grid(res * res * res);
+	std::vector<int> box(6 * nt);
+
+	for(unsigned t = 0; t < nt; t ++)
+	{
+		for(int d = 0; d < 3; d ++)
+		{
+			double lo = 1e20, hi = -1e20;
+			for(int k = 0; k < 3; k ++)
+			{
+				lo = std::min(lo, mesh.positions[3 * tris[3 * t + k] + d]);
+				hi = std::max(hi, mesh.positions[3 * tris[3 * t + k] + d]);
+			}
+			double ext = mx[d] - mn[d];
+			int clo = ext > 0 ? (int)((lo - mn[d]) / ext * res) : 0;
+			int chi = ext > 0 ? (int)((hi - mn[d]) / ext * res) : 0;
+			box[6 * t + d] = std::min(std::max(clo, 0), res - 1);
+			box[6 * t + 3 + d] = std::min(std::max(chi, 0), res - 1);
+		}
+		for(int x = box[6 * t]; x <= box[6 * t + 3]; x ++)
+			for(int y = box[6 * t + 1]; y <= box[6 * t + 4]; y ++)
+				for(int z = box[6 * t + 2]; z <= box[6 * t + 5]; z ++)
+					grid[(x * res + y) * res + z].push_back(t);
+	}
+
+	unsigned stride = std::max(1u, nt / max_samples);
+	std::vector<unsigned> stamp(nt, (unsigned)-1);
+	for(unsigned t = 0; t < nt; t += stride)
+	{
+		report.intersection_tests ++;
+		Wm4::Vector3d t0[3];
+		for(int k = 0; k < 3; k ++)
+			t0[k] = mesh.Position(tris[3 * t + k]);
+
+		bool hit = false;
+		for(int x = box[6 * t]; x <= box[6 * t + 3] && !hit; x ++)
+			for(int y = box[6 * t + 1]; y <= box[6 * t + 4] && !hit; y ++)
+				for(int z = box[6 * t + 2]; z <= box[6 * t + 5] && !hit; z ++)
+				{
+					const std::vector<unsigned> & cell = grid[(x * res + y) * res + z];
+					for(unsigned c = 0; c < cell.size() && !hit; c ++)
+					{
+						unsigned u = cell[c];
+						if(stamp[u] == t || tri_face[u] == tri_face[t])
+							continue;
+						stamp[u] = t;
+
+						// triangles sharing a vertex are neighbours, not intersections
+						bool shared = false;
+						for(int i = 0; i < 3; i ++)
+							for(int j = 0; j < 3; j ++)
+								if(tris[3 * t + i] == tris[3 * u + j])
+									shared = true;
+						if(shared)
+							continue;
+
+						Wm4::Vector3d t1[3];
+						for(int k = 0; k < 3; k ++)
+							t1[k] = mesh.Position(tris[3 * u + k]);
+						hit = TrianglesIntersect(t0, t1);
+					}
+				}
+		if(hit)
+			report.intersection_hits ++;
+	}
+}
+
+void RunPreflight(const IndexedMesh & mesh, const PreflightCostModel & model, bool powercrust,
+				  int simplify_target, unsigned max_intersection_samples, PreflightReport & report)
+{
+	report = PreflightReport();
+	report.model_source = model.source;
+	report.num_vertices = mesh.NumVertices();
+	report.num_faces = mesh.NumFaces();
+
+	CheckTopology(mesh, report);
+	SampleSelfIntersections(mesh, max_intersection_samples, report);
+
+	// sizes, the DT is built on the used input vertices
+	PreflightRange nv((double)(report.num_vertices - report.isolated_vertices), 0.);
+	report.dt_cells = Scale(nv, model.dt_cells_per_vertex, model.size_error);
+	report.ma_vertices = Scale(report.dt_cells, model.ma_vertices_per_cell, model.size_error);
+	report.ma_edges = Scale(report.ma_vertices, model.ma_edges_per_ma_vertex, model.size_error);
+	report.ma_faces = Scale(report.ma_vertices, model.ma_faces_per_ma_vertex, model.size_error);
+
+	// memory, the input mesh, the DT and the medial mesh are alive together during simplification
+	const double mb = 1024. * 1024.;
+	PreflightRange memory = Scale(PreflightRange((double)report.num_vertices, 0.), model.bytes_per_input_vertex / mb, model.memory_error);
+	memory = Sum(memory, Scale(report.dt_cells, model.bytes_per_dt_cell / mb, model.memory_error));
+	memory = Sum(memory, Scale(report.ma_vertices, model.bytes_per_ma_vertex / mb, model.memory_error));
+	memory = Sum(memory, Scale(report.ma_edges, model.bytes_per_ma_edge / mb, model.memory_error));
+	memory = Sum(memory, Scale(report.ma_faces, model.bytes_per_ma_face / mb, model.memory_error));
+	report.peak_memory_mb = memory;
+
+	// time
+	report.time_dt_ms = Scale(report.dt_cells, model.us_dt_per_cell / 1000., model.time_error);
+	report.time_label_ms = Scale(report.dt_cells,
+		(powercrust ? model.us_powercrust_label_per_cell : model.us_exact_label_per_cell) / 1000., model.time_error);
+	report.time_ma_ms = Scale(report.dt_cells, model.us_ma_per_cell / 1000., model.time_error);
+	if(simplify_target > 0)
+	{
+		PreflightRange collapses;
+		collapses.low = std::max(0., report.ma_vertices.low - simplify_target);
+		collapses.estimate = std::max(0., report.ma_vertices.estimate - simplify_target);
+		collapses.high = std::max(0., report.ma_vertices.high - simplify_target);
+		report.time_simplify_ms = Sum(Scale(report.ma_vertices, model.us_load_slab_per_ma_vertex / 1000., model.time_error),
+			Scale(collapses, model.us_simplify_per_collapse / 1000., model.time_error));
+	}
+	report.time_total_ms = Sum(Sum(report.time_dt_ms, report.time_label_ms), Sum(report.time_ma_ms, report.time_simplify_ms));
+}
@@ -0,0 +1,105 @@
+#ifndef _PREFLIGHT_H
+#define _PREFLIGHT_H
+
+#include <string>
+#include <iostream>
+
+#include "IndexedMesh.h"
+
+// Coefficients of the cost model used to predict the size and the run time
+// of a job from the input vertex count. Every coefficient comes with a relative
+// error, the predictions are reported as [low, high] ranges.
+// The defaults are hand-picked guesses, not fitted on measured runs, and the
+// report labels its predictions uncalibrated unless a model was loaded with Load().
+class PreflightCostModel
+{
+public:
+	PreflightCostModel();
+
+	// key=value lines, unknown keys are ignored
+	bool Load(const std::string & filename, std::string & error);
+
+public:
+	// file the coefficients were loaded from, empty for the defaults
+	std::string source;
+
+	// sizes
+	double dt_cells_per_vertex;
+	double ma_vertices_per_cell;
+	double ma_edges_per_ma_vertex;
+	double ma_faces_per_ma_vertex;
+	double size_error;
+
+	// memory, bytes per element
+	double bytes_per_input_vertex;
+	double bytes_per_dt_cell;
+	double bytes_per_ma_vertex;
+	double bytes_per_ma_edge;
+	double bytes_per_ma_face;
+	double memory_error;
+
+	// time, microseconds per element
+	double us_dt_per_cell;
+	double us_exact_label_per_cell;
+	double us_powercrust_label_per_cell;
+	double us_ma_per_cell;
+	double us_load_slab_per_ma_vertex;
+	double us_simplify_per_collapse;
+	double time_error;
+};
+
+class PreflightRange
+{
+public:
+	double low;
+	double estimate;
+	double high;
+
+	PreflightRange() : low(0.), estimate(0.), high(0.) {}
+	PreflightRange(double e, double relerr) : low(e * (1. - relerr)), estimate(e), high(e * (1. + relerr)) {}
+};
+
+class PreflightReport
+{
+public:
+	// input checks
+	unsigned num_vertices;
+	unsigned num_faces;
+	unsigned num_edges;
+	unsigned border_edges;
+	unsigned non_manifold_edges;
+	unsigned inconsistent_edges;	// both faces walk the edge in the same direction
+	unsigned degenerate_faces;
+	unsigned isolated_vertices;
+	unsigned components;
+	unsigned intersection_tests;	// sampled triangles
+	unsigned intersection_hits;		// sampled triangles crossing another triangle
+
+	bool manifold;
+	bool watertight;
+
+	// PreflightCostModel::source of the predictions
+	std::string model_source;
+
+	// predictions
+	PreflightRange dt_cells;
+	PreflightRange ma_vertices;
+	PreflightRange ma_edges;
+	PreflightRange ma_faces;
+	PreflightRange peak_memory_mb;
+	PreflightRange time_dt_ms;
+	PreflightRange time_label_ms;
+	PreflightRange time_ma_ms;
+	PreflightRange time_simplify_ms;
+	PreflightRange time_total_ms;
+
+public:
+	PreflightReport();
+	void Print(std::ostream & out) const;
+};
+
+// check the input mesh and predict the job, simplify_target <= 0 means no simplification
+void RunPreflight(const IndexedMesh & mesh, const PreflightCostModel & model, bool powercrust,
+				  int simplify_target, unsigned max_intersection_samples, PreflightReport & report);
+
+#endif // _PREFLIGHT_H
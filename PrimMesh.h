@@ -8,8 +8,17 @@
 #include <vector>
 #include <map>
 #include <queue>
+#include <set>
+#include <string>
 #include "LinearAlgebra/Wm4Vector.h"
-#include "Mesh.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+using namespace std;
+
+// the input surface is only used through a pointer, the CGAL headers of Mesh.h
+// stay out of the slab simplifier
+class MPMesh;
+typedef MPMesh Mesh;
 
 class PrimVertex{
 public:
@@ -129,7 +138,6 @@ public:
 class PrimMesh{
 public:
 	Mesh * pmesh;
-	Mesh_domain * domain;
 	std::string meshname;
 	//public:
 	//	std::vector<Bool_PrimVertexPointer> vertices;
@@ -159,7 +167,6 @@ public:
 	double meanhausdorff_distance;
 	double maxhausdorff_distance;
 	double initialhausdorff_distance;
-	Triangulation dt;
 
 	// 0 for medial mesh
 	// 1 for slab mesh
@@ -0,0 +1,395 @@
+#include "ScaleAxis.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+// average number of grid cells a sphere may be inserted into
+static const double scale_axis_cells_per_sphere = 16.;
+// strictness of the cover tests relative to the bounding box diagonal,
+// identical or touching spheres do not remove each other
+static const double scale_axis_tolerance = 1e-9;
+
+class ScaleAxisGrid
+{
+public:
+	double origin[3];
+	double cell;
+	std::unordered_map<unsigned long long, std::vector<unsigned> > cells;
+
+	void Range(const Vector3d & c, double r, long long lo[3], long long hi[3]) const
+	{
+		for(int k = 0; k < 3; k ++)
+		{
+			lo[k] = (long long)floor((c[k] - r - origin[k]) / cell);
+			hi[k] = (long long)floor((c[k] + r - origin[k]) / cell);
+		}
+	}
+
+	static unsigned long long Key(long long x, long long y, long long z)
+	{
+		return ((unsigned long long)x & 0x1fffff) << 42 | ((unsigned long long)y & 0x1fffff) << 21 | ((unsigned long long)z & 0x1fffff);
+	}
+};
+
+class ScaleAxisArc
+{
+public:
+	double start, end;
+	bool operator<(const ScaleAxisArc & a) const { return start < a.start; }
+};
+
+// true when the circle center + rho (u cos t + v sin t) lies inside the union of
+// the balls, each ball covers one arc of it
+static bool CircleCovered(const Vector3d & center, double rho, const Vector3d & u, const Vector3d & v,
+						  const std::vector<Vector3d> & ball_centers, const std::vector<double> & ball_radii,
+						  std::vector<ScaleAxisArc> & arcs)
+{
+	const double two_pi = 2. * 3.14159265358979323846;
+	arcs.clear();
+	for(size_t k = 0; k < ball_centers.size(); k ++)
+	{
+		// |w + rho (u cos t + v sin t)|^2 < r^2  <=>  a cos t + b sin t < -c
+		Vector3d w = center - ball_centers[k];
+		double a = 2. * rho * w.Dot(u);
+		double b = 2. * rho * w.Dot(v);
+		double c = w.Dot(w) + rho * rho - ball_radii[k] * ball_radii[k];
+		double m = sqrt(a * a + b * b);
+		if(-c > m)
+			return true;
+		if(-c <= -m)
+			continue;
+		double half = 3.14159265358979323846 - acos(std::max(-1., std::min(1., -c / m)));
+		double mid = atan2(b, a) + 3.14159265358979323846;
+		double start = fmod(mid - half + 2. * two_pi, two_pi);
+		ScaleAxisArc arc;
+		arc.start = start;
+		arc.end = start + 2. * half;
+		if(arc.end > two_pi)
+		{
+			ScaleAxisArc wrap;
+			wrap.start = 0.;
+			wrap.end = arc.end - two_pi;
+			arcs.push_back(wrap);
+			arc.end = two_pi;
+		}
+		arcs.push_back(arc);
+	}
+	std::sort(arcs.begin(), arcs.end());
+	double reach = 0.;
+	for(size_t k = 0; k < arcs.size(); k ++)
+	{
+		if(arcs[k].start > reach)
+			return false;
+		reach = std::max(reach, arcs[k].end);
+	}
+	return reach >= two_pi;
+}
+
+static unsigned FindRoot(std::vector<unsigned> & parent, unsigned i)
+{
+	while(parent[i] != i)
+	{
+		parent[i] = parent[parent[i]];
+		i = parent[i];
+	}
+	return i;
+}
+
+// edge or face after merging, duplicates keep the first occurrence
+class ScaleAxisElementKey
+{
+public:
+	unsigned v[3];
+	unsigned index;
+
+	bool operator<(const ScaleAxisElementKey & k) const
+	{
+		if(v[0] != k.v[0]) return v[0] < k.v[0];
+		if(v[1] != k.v[1]) return v[1] < k.v[1];
+		if(v[2] != k.v[2]) return v[2] < k.v[2];
+		return index < k.index;
+	}
+	bool SameElement(const ScaleAxisElementKey & k) const { return v[0] == k.v[0] && v[1] == k.v[1] && v[2] == k.v[2]; }
+};
+
+static bool IndexOrder(const ScaleAxisElementKey & a, const ScaleAxisElementKey & b) { return a.index < b.index; }
+
+static void UniqueElements(std::vector<ScaleAxisElementKey> & keys)
+{
+	std::sort(keys.begin(), keys.end());
+	size_t n = 0;
+	for(size_t i = 0; i < keys.size(); i ++)
+		if(n == 0 || !keys[i].SameElement(keys[n - 1]))
+			keys[n ++] = keys[i];
+	keys.resize(n);
+	std::sort(keys.begin(), keys.end(), IndexOrder);
+}
+
+void ScaleAxisPrune(const MedialMeshData & ma, double scale, MedialMeshData & pruned, ScaleAxisStats & stats)
+{
+	stats = ScaleAxisStats();
+	pruned.clear();
+	unsigned nv = ma.NumVertices();
+	if(nv == 0 || !(scale >= 1.))
+	{
+		pruned = ma;
+		return;
+	}
+
+	std::vector<Vector3d> centers(nv);
+	std::vector<double> radii(nv);
+	double mn[3] = {1e300, 1e300, 1e300}, mx[3] = {-1e300, -1e300, -1e300};
+	double diameter_sum = 0.;
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		centers[i] = Vector3d(ma.spheres[4 * i], ma.spheres[4 * i + 1], ma.spheres[4 * i + 2]);
+		radii[i] = scale * std::max(0., ma.spheres[4 * i + 3]);
+		diameter_sum += 2. * radii[i];
+		for(int k = 0; k < 3; k ++)
+		{
+			mn[k] = std::min(mn[k], centers[i][k] - radii[i]);
+			mx[k] = std::max(mx[k], centers[i][k] + radii[i]);
+		}
+	}
+	double diagonal = sqrt((mx[0] - mn[0]) * (mx[0] - mn[0]) + (mx[1] - mn[1]) * (mx[1] - mn[1]) + (mx[2] - mn[2]) * (mx[2] - mn[2]));
+	double tolerance = scale_axis_tolerance * diagonal;
+
+	// every inflated ball goes into the cells its bounding box overlaps, the cell
+	// starts at the mean diameter and grows until the few huge balls stay cheap
+	ScaleAxisGrid grid;
+	for(int k = 0; k < 3; k ++)
+		grid.origin[k] = mn[k];
+	grid.cell = std::max(diameter_sum / nv, diagonal / 1024.);
+	if(!(grid.cell > 0.))
+		grid.cell = 1.;
+	for(;;)
+	{
+		double inserts = 0.;
+		long long lo[3], hi[3];
+		for(unsigned i = 0; i < nv; i ++)
+		{
+			grid.Range(centers[i], radii[i], lo, hi);
+			inserts += (double)(hi[0] - lo[0] + 1) * (hi[1] - lo[1] + 1) * (hi[2] - lo[2] + 1);
+		}
+		if(inserts <= scale_axis_cells_per_sphere * nv)
+			break;
+		grid.cell *= 2.;
+	}
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		long long lo[3], hi[3];
+		grid.Range(centers[i], radii[i], lo, hi);
+		for(long long x = lo[0]; x <= hi[0]; x ++)
+			for(long long y = lo[1]; y <= hi[1]; y ++)
+				for(long long z = lo[2]; z <= hi[2]; z ++)
+					grid.cells[ScaleAxisGrid::Key(x, y, z)].push_back(i);
+	}
+
+	// 0 kept, 1 inside one neighbour, 2 inside the union
+	std::vector<unsigned char> covered(nv, 0);
+	std::vector<unsigned> target(nv);
+	std::vector<unsigned long long> pairs(nv, 0);
+
+#pragma omp parallel for schedule(dynamic, 64)
+	for(int ii = 0; ii < (int)nv; ii ++)
+	{
+		unsigned i = (unsigned)ii;
+		target[i] = i;
+
+		std::vector<unsigned> near;
+		long long lo[3], hi[3];
+		grid.Range(centers[i], radii[i], lo, hi);
+		for(long long x = lo[0]; x <= hi[0]; x ++)
+			for(long long y = lo[1]; y <= hi[1]; y ++)
+				for(long long z = lo[2]; z <= hi[2]; z ++)
+				{
+					std::unordered_map<unsigned long long, std::vector<unsigned> >::const_iterator it = grid.cells.find(ScaleAxisGrid::Key(x, y, z));
+					if(it != grid.cells.end())
+						near.insert(near.end(), it->second.begin(), it->second.end());
+				}
+		std::sort(near.begin(), near.end());
+		near.erase(std::unique(near.begin(), near.end()), near.end());
+
+		// neighbours whose inflated ball overlaps this one
+		std::vector<unsigned> overlap;
+		for(size_t k = 0; k < near.size(); k ++)
+		{
+			unsigned j = near[k];
+			if(j != i && (centers[i] - centers[j]).Length() < radii[i] + radii[j])
+				overlap.push_back(j);
+		}
+		pairs[i] = overlap.size();
+		if(overlap.empty())
+			continue;
+
+		double best_depth = -1e300;
+		unsigned best = i;
+		bool single = false;
+		for(size_t k = 0; k < overlap.size(); k ++)
+		{
+			unsigned j = overlap[k];
+			double d = (centers[i] - centers[j]).Length();
+			if(d + radii[i] < radii[j] - tolerance)
+				single = true;
+			if(radii[j] - d > best_depth)
+			{
+				best_depth = radii[j] - d;
+				best = j;
+			}
+		}
+
+		// Without a single cover, the neighbours that contain the center have to
+		// cover the boundary sphere: every circle where it meets one of them is
+		// covered by the others. Each segment from the center to a covered boundary
+		// point then lies in one ball, so the interior is covered too. Neighbours
+		// that miss the center are left out, a shell of them covers the boundary
+		// around a hollow.
+		bool inside = single;
+		if(!single && radii[i] > 0.)
+		{
+			std::vector<Vector3d> cap_centers;
+			std::vector<double> cap_radii;
+			for(size_t k = 0; k < overlap.size(); k ++)
+			{
+				unsigned j = overlap[k];
+				double r = radii[j] - tolerance;
+				double d = (centers[i] - centers[j]).Length();
+				if(r > 0. && d < r && d + r > radii[i])
+				{
+					cap_centers.push_back(centers[j]);
+					cap_radii.push_back(r);
+				}
+			}
+			inside = !cap_centers.empty();
+			std::vector<Vector3d> others_centers;
+			std::vector<double> others_radii;
+			std::vector<ScaleAxisArc> arcs;
+			for(size_t k = 0; k < cap_centers.size() && inside; k ++)
+			{
+				Vector3d n = cap_centers[k] - centers[i];
+				double d = n.Normalize();
+				double a = (d * d + radii[i] * radii[i] - cap_radii[k] * cap_radii[k]) / (2. * d);
+				double rho = sqrt(std::max(0., radii[i] * radii[i] - a * a));
+				Vector3d u, v;
+				Vector3d::GenerateComplementBasis(u, v, n);
+				others_centers.clear();
+				others_radii.clear();
+				for(size_t l = 0; l < cap_centers.size(); l ++)
+					if(l != k)
+					{
+						others_centers.push_back(cap_centers[l]);
+						others_radii.push_back(cap_radii[l]);
+					}
+				inside = CircleCovered(centers[i] + a * n, rho, u, v, others_centers, others_radii, arcs);
+			}
+		}
+		if(inside)
+		{
+			covered[i] = single ? 1 : 2;
+			target[i] = best;
+		}
+	}
+
+	// the covered spheres form trees hanging off kept spheres, or cycles where
+	// spheres cover each other, a cycle keeps its largest sphere
+	std::vector<unsigned> parent(nv);
+	for(unsigned i = 0; i < nv; i ++)
+		parent[i] = i;
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		stats.candidate_pairs += pairs[i];
+		if(covered[i] == 1)
+			stats.covered_single ++;
+		else if(covered[i] == 2)
+			stats.covered_union ++;
+		if(covered[i])
+		{
+			unsigned a = FindRoot(parent, i), b = FindRoot(parent, target[i]);
+			if(a != b)
+				parent[a] = b;
+		}
+	}
+	std::vector<unsigned> rep(nv, nv);
+	for(unsigned i = 0; i < nv; i ++)
+		if(!covered[i])
+			rep[FindRoot(parent, i)] = i;
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		unsigned root = FindRoot(parent, i);
+		if(rep[root] == nv || (covered[rep[root]] && radii[i] > radii[rep[root]]))
+			rep[root] = i;
+	}
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		unsigned r = rep[i];
+		if(r != nv && covered[r])
+		{
+			covered[r] = 0;
+			stats.restored ++;
+		}
+	}
+
+	// kept spheres in their original order and radius
+	std::vector<unsigned> new_id(nv, nv);
+	unsigned kept = 0;
+	for(unsigned i = 0; i < nv; i ++)
+		if(!covered[i])
+		{
+			new_id[i] = kept ++;
+			pruned.spheres.insert(pruned.spheres.end(), ma.spheres.begin() + 4 * i, ma.spheres.begin() + 4 * i + 4);
+		}
+	std::vector<unsigned> map(nv);
+	for(unsigned i = 0; i < nv; i ++)
+		map[i] = new_id[rep[FindRoot(parent, i)]];
+
+	std::vector<ScaleAxisElementKey> faces;
+	for(unsigned i = 0; i < ma.NumFaces(); i ++)
+	{
+		ScaleAxisElementKey key;
+		for(int k = 0; k < 3; k ++)
+			key.v[k] = map[ma.faces[3 * i + k]];
+		if(key.v[0] == key.v[1] || key.v[1] == key.v[2] || key.v[0] == key.v[2])
+			continue;
+		std::sort(key.v, key.v + 3);
+		key.index = i;
+		faces.push_back(key);
+	}
+	UniqueElements(faces);
+	for(size_t i = 0; i < faces.size(); i ++)
+		for(int k = 0; k < 3; k ++)
+			pruned.faces.push_back(map[ma.faces[3 * faces[i].index + k]]);
+
+	// the .ma reader expects the edges of every face, merging may have created new ones
+	std::vector<ScaleAxisElementKey> edges;
+	for(unsigned i = 0; i < ma.NumEdges() + 3 * (unsigned)faces.size(); i ++)
+	{
+		unsigned a, b;
+		if(i < ma.NumEdges())
+		{
+			a = map[ma.edges[2 * i]];
+			b = map[ma.edges[2 * i + 1]];
+		}
+		else
+		{
+			unsigned f = (i - ma.NumEdges()) / 3, k = (i - ma.NumEdges()) % 3;
+			a = faces[f].v[k];
+			b = faces[f].v[(k + 1) % 3];
+		}
+		if(a == b)
+			continue;
+		ScaleAxisElementKey key;
+		key.v[0] = std::min(a, b);
+		key.v[1] = std::max(a, b);
+		key.v[2] = 0;
+		key.index = i;
+		edges.push_back(key);
+	}
+	UniqueElements(edges);
+	for(size_t i = 0; i < edges.size(); i ++)
+	{
+		pruned.edges.push_back(edges[i].v[0]);
+		pruned.edges.push_back(edges[i].v[1]);
+	}
+}
@@ -0,0 +1,34 @@
+#ifndef _SCALEAXIS_H
+#define _SCALEAXIS_H
+
+#include "MedialChunks.h"
+
+// counts of the last ScaleAxisPrune
+class ScaleAxisStats
+{
+public:
+	unsigned covered_single;	// inside one inflated neighbour
+	unsigned covered_union;		// inside the union of inflated neighbours
+	unsigned restored;			// kept to represent a cycle of covered spheres
+	unsigned long long candidate_pairs;
+
+public:
+	ScaleAxisStats() : covered_single(0), covered_union(0), restored(0), candidate_pairs(0) {}
+	unsigned Removed() const { return covered_single + covered_union - restored; }
+};
+
+// Scale axis style pruning of a raw medial axis.
+// Every sphere is inflated by scale, spheres whose inflated ball lies strictly
+// inside the union of the other inflated balls are removed, the others keep
+// their original radius. The union test is conservative: a sphere is covered
+// when one neighbour contains it, or when the neighbours containing its center
+// cover its boundary sphere, every circle where it meets one of them covered by
+// the others. A sphere inside the union of neighbours that miss its center, as
+// inside a shell, is kept.
+// A removed sphere is merged into the neighbour that covers its center deepest,
+// edges and faces are re-extracted through that merge, degenerate and duplicate
+// elements are dropped. Neighbours are found on a uniform grid and the tests
+// run in parallel, the result does not depend on the number of threads.
+void ScaleAxisPrune(const MedialMeshData & ma, double scale, MedialMeshData & pruned, ScaleAxisStats & stats);
+
+#endif // _SCALEAXIS_H
@@ -1,5 +1,7 @@
 #include "SlabMesh.h"
 #include <omp.h>
+#include <iomanip>
+#include "SpatialOrder.h"
 
 void SlabMesh::AdjustStorage()
 {
@@ -26,9 +28,27 @@ void SlabMesh::AdjustStorage()
 		if(faces[i].first)
 			newf[i] = count ++;
 
-	std::vector<Bool_SlabVertexPointer> new_vertices;
-	std::vector<Bool_SlabEdgePointer> new_edges;
-	std::vector<Bool_SlabFacePointer> new_faces;
+	RemapStorage(newv, newe, newf);
+}
+
+// renumber the valid elements, element i moves to slot newv[i] / newe[i] / newf[i],
+// the invalid ones are dropped
+void SlabMesh::RemapStorage(const std::vector<unsigned> & newv, const std::vector<unsigned> & newe, const std::vector<unsigned> & newf)
+{
+	unsigned nv = 0, ne = 0, nf = 0;
+	for(unsigned i = 0; i < vertices.size(); i ++)
+		if(vertices[i].first)
+			nv ++;
+	for(unsigned i = 0; i < edges.size(); i ++)
+		if(edges[i].first)
+			ne ++;
+	for(unsigned i = 0; i < faces.size(); i ++)
+		if(faces[i].first)
+			nf ++;
+
+	std::vector<Bool_SlabVertexPointer> new_vertices(nv);
+	std::vector<Bool_SlabEdgePointer> new_edges(ne);
+	std::vector<Bool_SlabFacePointer> new_faces(nf);
 
 	for(unsigned i = 0; i < vertices.size(); i ++)
 		if(vertices[i].first)
@@ -47,53 +67,127 @@ void SlabMesh::AdjustStorage()
 
 			bvp.second->edges_ = neweset;
 			bvp.second->faces_ = newfset;
-			new_vertices.push_back(bvp);
+			std::set<unsigned> newbset;
+			for(std::set<unsigned>::iterator si = bvp.second->boundary_edge_vec.begin();
+				si != bvp.second->boundary_edge_vec.end(); si ++)
+				newbset.insert(newe[*si]);
+			bvp.second->boundary_edge_vec = newbset;
+			bvp.second->index = newv[i];
+			new_vertices[newv[i]] = bvp;
 		}
 
-		for(unsigned i = 0; i < edges.size(); i ++)
-			if(edges[i].first)
-			{
-				Bool_SlabEdgePointer bep;
-				bep = edges[i];
-				std::pair<unsigned,unsigned> newvpair;
-				std::set<unsigned> newfset;
+	for(unsigned i = 0; i < edges.size(); i ++)
+		if(edges[i].first)
+		{
+			Bool_SlabEdgePointer bep;
+			bep = edges[i];
+			std::pair<unsigned,unsigned> newvpair;
+			std::set<unsigned> newfset;
 
-				newvpair.first = newv[bep.second->vertices_.first];
-				newvpair.second = newv[bep.second->vertices_.second];
+			newvpair.first = newv[bep.second->vertices_.first];
+			newvpair.second = newv[bep.second->vertices_.second];
 
-				for(std::set<unsigned>::iterator si = bep.second->faces_.begin();
-					si != bep.second->faces_.end(); si ++)
-					newfset.insert(newf[*si]);
+			for(std::set<unsigned>::iterator si = bep.second->faces_.begin();
+				si != bep.second->faces_.end(); si ++)
+				newfset.insert(newf[*si]);
 
-				bep.second->vertices_ = newvpair;
-				bep.second->faces_ = newfset;
-				new_edges.push_back(bep);
-			}
+			bep.second->vertices_ = newvpair;
+			bep.second->faces_ = newfset;
+			bep.second->index = newe[i];
+			new_edges[newe[i]] = bep;
+		}
 
-			for(unsigned i = 0; i < faces.size(); i ++)
-				if(faces[i].first)
-				{
-					Bool_SlabFacePointer bfp;
-					bfp = faces[i];
-					std::set<unsigned> newvset;
-					std::set<unsigned> neweset;
-
-					for(std::set<unsigned>::iterator si = bfp.second->vertices_.begin();
-						si != bfp.second->vertices_.end(); si ++)
-						newvset.insert(newv[*si]);
-
-					for(std::set<unsigned>::iterator si = bfp.second->edges_.begin();
-						si != bfp.second->edges_.end(); si ++)
-						neweset.insert(newe[*si]);
-
-					bfp.second->vertices_ = newvset;
-					bfp.second->edges_ = neweset;
-					new_faces.push_back(bfp);
-				}
+	for(unsigned i = 0; i < faces.size(); i ++)
+		if(faces[i].first)
+		{
+			Bool_SlabFacePointer bfp;
+			bfp = faces[i];
+			std::set<unsigned> newvset;
+			std::set<unsigned> neweset;
+
+			for(std::set<unsigned>::iterator si = bfp.second->vertices_.begin();
+				si != bfp.second->vertices_.end(); si ++)
+				newvset.insert(newv[*si]);
+
+			for(std::set<unsigned>::iterator si = bfp.second->edges_.begin();
+				si != bfp.second->edges_.end(); si ++)
+				neweset.insert(newe[*si]);
 
-				vertices = new_vertices;
-				edges = new_edges;
-				faces = new_faces;			
+			bfp.second->vertices_ = newvset;
+			bfp.second->edges_ = neweset;
+			bfp.second->index = newf[i];
+			new_faces[newf[i]] = bfp;
+		}
+
+	vertices = new_vertices;
+	edges = new_edges;
+	faces = new_faces;
+
+	std::set<unsigned> new_boundary_vertexes;
+	for(std::set<unsigned>::iterator si = boundary_vertexes.begin(); si != boundary_vertexes.end(); si ++)
+		new_boundary_vertexes.insert(newv[*si]);
+	boundary_vertexes = new_boundary_vertexes;
+}
+
+// renumber the vertices along a Morton curve of their centers, then the edges
+// and faces by their smallest new vertex id, so that elements close in space
+// are close in memory
+void SlabMesh::SpatialReorder()
+{
+	std::vector<unsigned> vid;
+	std::vector<Wm4::Vector3d> centers;
+	for(unsigned i = 0; i < vertices.size(); i ++)
+		if(vertices[i].first)
+		{
+			vid.push_back(i);
+			centers.push_back(vertices[i].second->sphere.center);
+		}
+
+	std::vector<unsigned> order;
+	MortonOrder(centers, order);
+
+	std::vector<unsigned> newv(vertices.size(), 0);
+	for(unsigned i = 0; i < order.size(); i ++)
+		newv[vid[order[i]]] = i;
+
+	// key = (smallest vertex, second smallest vertex)
+	std::vector<unsigned> eid;
+	std::vector<unsigned long long> ekeys;
+	for(unsigned i = 0; i < edges.size(); i ++)
+		if(edges[i].first)
+		{
+			unsigned a = newv[edges[i].second->vertices_.first];
+			unsigned b = newv[edges[i].second->vertices_.second];
+			eid.push_back(i);
+			ekeys.push_back(((unsigned long long)std::min(a, b) << 32) | std::max(a, b));
+		}
+	RadixSortIndices(ekeys, order);
+	std::vector<unsigned> newe(edges.size(), 0);
+	for(unsigned i = 0; i < order.size(); i ++)
+		newe[eid[order[i]]] = i;
+
+	std::vector<unsigned> fid;
+	std::vector<unsigned long long> fkeys;
+	for(unsigned i = 0; i < faces.size(); i ++)
+		if(faces[i].first)
+		{
+			std::vector<unsigned> fv;
+			for(std::set<unsigned>::iterator si = faces[i].second->vertices_.begin();
+				si != faces[i].second->vertices_.end(); si ++)
+				fv.push_back(newv[*si]);
+			std::sort(fv.begin(), fv.end());
+			unsigned long long key = (unsigned long long)(fv.empty() ? 0 : fv[0]) << 32;
+			if(fv.size() > 1)
+				key |= fv[1];
+			fid.push_back(i);
+			fkeys.push_back(key);
+		}
+	RadixSortIndices(fkeys, order);
+	std::vector<unsigned> newf(faces.size(), 0);
+	for(unsigned i = 0; i < order.size(); i ++)
+		newf[fid[order[i]]] = i;
+
+	RemapStorage(newv, newe, newf);
 }
 
 bool SlabMesh::ValidVertex(unsigned vid){
@@ -421,6 +515,147 @@ unsigned SlabMesh::EdgeIncidentFaceCount(unsigned eid)
 	return (unsigned)edges[eid].second->faces_.size();
 }
 
+void SlabMesh::LogUndo(unsigned char type, unsigned owner, unsigned id, bool flag)
+{
+	if(collapse_open)
+		undo_log.push_back(SlabUndoRecord(type, owner, id, flag));
+}
+
+void SlabMesh::BeginCollapse()
+{
+	collapse_open = true;
+	undo_log.clear();
+	collapse_saved_vertices = (unsigned)vertices.size();
+	collapse_saved_edges = (unsigned)edges.size();
+	collapse_saved_faces = (unsigned)faces.size();
+	collapse_num_vertices = numVertices;
+	collapse_num_edges = numEdges;
+	collapse_num_faces = numFaces;
+}
+
+void SlabMesh::CommitCollapse()
+{
+	for(unsigned i = 0; i < undo_log.size(); i ++)
+	{
+		const SlabUndoRecord & r = undo_log[i];
+		if(r.type == SlabUndoRecord::VERTEX_RETIRE)
+			delete vertices[r.owner].second;
+		else if(r.type == SlabUndoRecord::EDGE_RETIRE)
+			delete edges[r.owner].second;
+		else if(r.type == SlabUndoRecord::FACE_RETIRE)
+			delete faces[r.owner].second;
+	}
+	undo_log.clear();
+	collapse_open = false;
+}
+
+void SlabMesh::RollbackCollapse()
+{
+	// the records of the elements created in the collapse are skipped, the
+	// elements themselves are dropped below
+	for(unsigned i = (unsigned)undo_log.size(); i -- > 0; )
+	{
+		const SlabUndoRecord & r = undo_log[i];
+		switch(r.type)
+		{
+		case SlabUndoRecord::VERTEX_EDGE_ADD:
+			if(r.owner < collapse_saved_vertices)
+				vertices[r.owner].second->edges_.erase(r.id);
+			break;
+		case SlabUndoRecord::VERTEX_EDGE_REMOVE:
+			if(r.owner < collapse_saved_vertices)
+				vertices[r.owner].second->edges_.insert(r.id);
+			break;
+		case SlabUndoRecord::VERTEX_FACE_ADD:
+			if(r.owner < collapse_saved_vertices)
+				vertices[r.owner].second->faces_.erase(r.id);
+			break;
+		case SlabUndoRecord::VERTEX_FACE_REMOVE:
+			if(r.owner < collapse_saved_vertices)
+				vertices[r.owner].second->faces_.insert(r.id);
+			break;
+		case SlabUndoRecord::EDGE_FACE_ADD:
+			if(r.owner < collapse_saved_edges)
+				edges[r.owner].second->faces_.erase(r.id);
+			break;
+		case SlabUndoRecord::EDGE_FACE_REMOVE:
+			if(r.owner < collapse_saved_edges)
+				edges[r.owner].second->faces_.insert(r.id);
+			break;
+		case SlabUndoRecord::BOUNDARY_EDGE_REMOVE:
+			if(r.owner < collapse_saved_vertices)
+				vertices[r.owner].second->boundary_edge_vec.insert(r.id);
+			break;
+		case SlabUndoRecord::FAKE_BOUNDARY_SET:
+			if(r.owner < collapse_saved_vertices)
+				vertices[r.owner].second->fake_boundary_vertex = r.flag;
+			break;
+		case SlabUndoRecord::VERTEX_RETIRE:
+			if(r.owner < collapse_saved_vertices)
+				vertices[r.owner].first = true;
+			break;
+		case SlabUndoRecord::EDGE_RETIRE:
+			if(r.owner < collapse_saved_edges)
+				edges[r.owner].first = true;
+			break;
+		case SlabUndoRecord::FACE_RETIRE:
+			if(r.owner < collapse_saved_faces)
+				faces[r.owner].first = true;
+			break;
+		}
+	}
+
+	for(unsigned i = collapse_saved_vertices; i < vertices.size(); i ++)
+		delete vertices[i].second;
+	for(unsigned i = collapse_saved_edges; i < edges.size(); i ++)
+		delete edges[i].second;
+	for(unsigned i = collapse_saved_faces; i < faces.size(); i ++)
+		delete faces[i].second;
+	vertices.resize(collapse_saved_vertices);
+	edges.resize(collapse_saved_edges);
+	faces.resize(collapse_saved_faces);
+	numVertices = collapse_num_vertices;
+	numEdges = collapse_num_edges;
+	numFaces = collapse_num_faces;
+
+	undo_log.clear();
+	collapse_open = false;
+	collapse_rollbacks ++;
+}
+
+// Same test as Contractible(vid_src1, vid_src2, v_tgt), on the faces the open
+// merge of vid_src1 and vid_src2 has retired. Their vertex sets and the spheres
+// of the source vertices are still intact.
+bool SlabMesh::CollapseKeepsOrientation(unsigned vid_src1, unsigned vid_src2, const Vector3d & v_tgt)
+{
+	for(unsigned i = 0; i < undo_log.size(); i ++)
+	{
+		const SlabUndoRecord & r = undo_log[i];
+		if(r.type != SlabUndoRecord::FACE_RETIRE || r.owner >= collapse_saved_faces)
+			continue;
+
+		SlabFace * face = faces[r.owner].second;
+		bool has1 = face->HasVertex(vid_src1);
+		bool has2 = face->HasVertex(vid_src2);
+		if(has1 == has2)
+			continue;
+		unsigned vid_src = has1 ? vid_src1 : vid_src2;
+
+		Vector3d pp[3], pa[3];
+		unsigned count = 0;
+		for(std::set<unsigned>::iterator si = face->vertices_.begin(); si != face->vertices_.end(); si ++)
+		{
+			pp[count] = vertices[*si].second->sphere.center;
+			pa[count++] = (*si != vid_src) ? vertices[*si].second->sphere.center : v_tgt;
+		}
+		Vector3d pnorm = TriangleNormal(pp[0],pp[1],pp[2]);
+		Vector3d anorm = TriangleNormal(pa[0],pa[1],pa[2]);
+		if(pnorm.Dot(anorm) < 0)
+			return false;
+	}
+	return true;
+}
+
 void SlabMesh::DeleteFace(unsigned fid)
 {
 	if(!faces[fid].first)
@@ -428,13 +663,18 @@ void SlabMesh::DeleteFace(unsigned fid)
 
 	for(std::set<unsigned>::iterator si = faces[fid].second->vertices_.begin();
 		si != faces[fid].second->vertices_.end(); si ++)
-		vertices[*si].second->faces_.erase(fid);
+		if(vertices[*si].second->faces_.erase(fid))
+			LogUndo(SlabUndoRecord::VERTEX_FACE_REMOVE, *si, fid);
 
 	for(std::set<unsigned>::iterator si = faces[fid].second->edges_.begin();
 		si != faces[fid].second->edges_.end(); si ++)
-		edges[*si].second->faces_.erase(fid);
+		if(edges[*si].second->faces_.erase(fid))
+			LogUndo(SlabUndoRecord::EDGE_FACE_REMOVE, *si, fid);
 
-	delete faces[fid].second;
+	if(collapse_open)
+		LogUndo(SlabUndoRecord::FACE_RETIRE, fid);
+	else
+		delete faces[fid].second;
 	faces[fid].first = false;
 	numFaces --;
 }
@@ -449,22 +689,30 @@ void SlabMesh::DeleteEdge(unsigned eid)
 	{
 		if(vertices[edges[eid].second->vertices_.first].first)
 		{
-			vertices[edges[eid].second->vertices_.first].second->boundary_edge_vec.erase(eid);
+			if(vertices[edges[eid].second->vertices_.first].second->boundary_edge_vec.erase(eid))
+				LogUndo(SlabUndoRecord::BOUNDARY_EDGE_REMOVE, edges[eid].second->vertices_.first, eid);
+			LogUndo(SlabUndoRecord::FAKE_BOUNDARY_SET, edges[eid].second->vertices_.first, 0,
+				vertices[edges[eid].second->vertices_.first].second->fake_boundary_vertex);
 			vertices[edges[eid].second->vertices_.first].second->fake_boundary_vertex = 
 				vertices[edges[eid].second->vertices_.first].second->boundary_edge_vec.size() > 0 ? true : false;
 		}
 		if(vertices[edges[eid].second->vertices_.second].first)
 		{	
-			vertices[edges[eid].second->vertices_.second].second->boundary_edge_vec.erase(eid);
+			if(vertices[edges[eid].second->vertices_.second].second->boundary_edge_vec.erase(eid))
+				LogUndo(SlabUndoRecord::BOUNDARY_EDGE_REMOVE, edges[eid].second->vertices_.second, eid);
+			LogUndo(SlabUndoRecord::FAKE_BOUNDARY_SET, edges[eid].second->vertices_.second, 0,
+				vertices[edges[eid].second->vertices_.second].second->fake_boundary_vertex);
 			vertices[edges[eid].second->vertices_.second].second->fake_boundary_vertex = 
 				vertices[edges[eid].second->vertices_.second].second->boundary_edge_vec.size() > 0 ? true : false;
 		}
 	}
 
 	if(vertices[edges[eid].second->vertices_.first].first)
-		vertices[edges[eid].second->vertices_.first].second->edges_.erase(eid);
+		if(vertices[edges[eid].second->vertices_.first].second->edges_.erase(eid))
+			LogUndo(SlabUndoRecord::VERTEX_EDGE_REMOVE, edges[eid].second->vertices_.first, eid);
 	if(vertices[edges[eid].second->vertices_.second].first)
-		vertices[edges[eid].second->vertices_.second].second->edges_.erase(eid);
+		if(vertices[edges[eid].second->vertices_.second].second->edges_.erase(eid))
+			LogUndo(SlabUndoRecord::VERTEX_EDGE_REMOVE, edges[eid].second->vertices_.second, eid);
 	std::set<unsigned> faces_del;
 	for(std::set<unsigned>::iterator si = edges[eid].second->faces_.begin();
 		si != edges[eid].second->faces_.end(); si ++)
@@ -472,7 +720,10 @@ void SlabMesh::DeleteEdge(unsigned eid)
 	for(std::set<unsigned>::iterator si = faces_del.begin(); si != faces_del.end(); si ++)
 		DeleteFace(*si);
 
-	delete edges[eid].second;
+	if(collapse_open)
+		LogUndo(SlabUndoRecord::EDGE_RETIRE, eid);
+	else
+		delete edges[eid].second;
 	edges[eid].first = false;
 	numEdges --;
 }
@@ -498,7 +749,10 @@ void SlabMesh::DeleteVertex(unsigned vid)
 	for(std::set<unsigned>::iterator si = faces_del.begin(); si != faces_del.end(); si ++)
 		DeleteFace(*si);
 
-	delete vertices[vid].second;
+	if(collapse_open)
+		LogUndo(SlabUndoRecord::VERTEX_RETIRE, vid);
+	else
+		delete vertices[vid].second;
 	vertices[vid].first = false;
 	numVertices --;
 }
@@ -530,6 +784,8 @@ void SlabMesh::InsertEdge(unsigned vid0, unsigned vid1, unsigned & eid)
 	vertices[vid0].second->edges_.insert((unsigned)edges.size());
 	vertices[vid1].second->edges_.insert((unsigned)edges.size());
 	eid = (unsigned)edges.size();
+	LogUndo(SlabUndoRecord::VERTEX_EDGE_ADD, vid0, eid);
+	LogUndo(SlabUndoRecord::VERTEX_EDGE_ADD, vid1, eid);
 	bep.second->index = eid;
 	edges.push_back(bep);
 	ComputeEdgeCone(eid);
@@ -579,6 +835,11 @@ void SlabMesh::InsertFace(std::set<unsigned> vset)
 	edges[eid[0]].second->faces_.insert(faces.size());
 	edges[eid[1]].second->faces_.insert(faces.size());
 	edges[eid[2]].second->faces_.insert(faces.size());
+	for(unsigned i = 0; i < 3; i ++)
+	{
+		LogUndo(SlabUndoRecord::VERTEX_FACE_ADD, vid[i], (unsigned)faces.size());
+		LogUndo(SlabUndoRecord::EDGE_FACE_ADD, eid[i], (unsigned)faces.size());
+	}
 	faces.push_back(bfp);
 	UpdateCentroid((unsigned)faces.size()-1);
 	UpdateNormal((unsigned)faces.size()-1);
@@ -895,6 +1156,7 @@ void SlabMesh::InsertSavedPoint(unsigned vid)
 			vertices[vid_tgt].second->saved_vertex = true;
 			vertices[vid_tgt].second->sphere = vertices[vid].second->sphere;
 			vertices[vid_tgt].second->bplist = vertices[vid].second->bplist;
+			vertices[vid_tgt].second->bpsamples = vertices[vid].second->bpsamples;
 
 			vertices[vid_tgt].second->slab_A = vertices[vid].second->slab_A;
 			vertices[vid_tgt].second->slab_b = vertices[vid].second->slab_b;
@@ -928,7 +1190,7 @@ void SlabMesh::InsertSavedPoint(unsigned vid)
 }
 
 // жǷηת
-bool SlabMesh::Contractible(unsigned vid_src1, unsigned vid_src2, Vector3d &v_tgt)
+bool SlabMesh::Contractible(unsigned vid_src1, unsigned vid_src2, const Vector3d &v_tgt)
 {
 	if( !vertices[vid_src1].first || !vertices[vid_src2].first )
 		return false;
@@ -1007,11 +1269,19 @@ bool SlabMesh::MinCostBoundaryEdgeCollapse(unsigned & eid)
 	Wm4::Vector4d b = edges[eid].second->slab_b;
 	double c = edges[eid].second->slab_c;
 	Sphere sphere = edges[eid].second->sphere;
+	unsigned former_edge_number = edges.size();
+	unsigned vid_tgt;
 
+	// the merge is done first and checked on its result, the source vertices stay
+	// readable until the collapse is committed
 	if (prevent_inversion == true)
 	{
-		if (!Contractible(v1, v2, sphere.center))
+		BeginCollapse();
+		if (!MergeVertices(v1, v2, vid_tgt) || !CollapseKeepsOrientation(v1, v2, sphere.center))
+		{
+			RollbackCollapse();
 			return false;
+		}
 	}
 
 
@@ -1020,14 +1290,26 @@ bool SlabMesh::MinCostBoundaryEdgeCollapse(unsigned & eid)
 		temp_bplist.insert(*it);
 	for (set<unsigned>::iterator it = vertices[v2].second->bplist.begin(); it != vertices[v2].second->bplist.end(); it++)
 		temp_bplist.insert(*it);	
+	// the lists are spliced once the merge succeeded, a failed merge leaves both intact
+	BoundarySampleList samples1 = vertices[v1].second->bpsamples;
+	BoundarySampleList samples2 = vertices[v2].second->bpsamples;
 
 	unsigned temp_related_face = vertices[v1].second->related_face + vertices[v2].second->related_face;
 	double temp_mean_squre_error = edges[eid].second->collapse_cost < 0 ? 0 : edges[eid].second->collapse_cost / temp_related_face;
 	max_mean_squre_error = max(temp_mean_squre_error, max_mean_squre_error);
 
-	unsigned former_edge_number = edges.size();
-	unsigned vid_tgt;
-	if(MergeVertices(v1, v2, vid_tgt)){
+	double collapse_cost = edges[eid].second->collapse_cost;
+	bool merged = true;
+	if (prevent_inversion == true)
+		CommitCollapse();
+	else
+		merged = MergeVertices(v1, v2, vid_tgt);
+	if(merged){
+		if(collapse_trace != NULL)
+		{
+			double center[3] = {sphere.center[0], sphere.center[1], sphere.center[2]};
+			collapse_trace->Add(v1, v2, vid_tgt, center, sphere.radius, collapse_cost);
+		}
 		vertices[vid_tgt].second->slab_A = A;
 		vertices[vid_tgt].second->slab_b = b;
 		vertices[vid_tgt].second->slab_c = c;
@@ -1035,6 +1317,15 @@ bool SlabMesh::MinCostBoundaryEdgeCollapse(unsigned & eid)
 		vertices[vid_tgt].second->related_face = temp_related_face;
 		vertices[vid_tgt].second->mean_square_error = temp_mean_squre_error;
 		vertices[vid_tgt].second->bplist = temp_bplist;
+		if (bplist_limit > 0)
+		{
+			// the representatives of both, the complete list is needed for the distances below
+			BoundarySampleList temp_samples = JoinBoundarySamples(samples1, samples2);
+			vertices[vid_tgt].second->bpsamples = temp_samples;
+			ReduceBoundarySamples(vid_tgt);
+			if (compute_hausdorff)
+				CollectBoundarySamples(temp_samples, temp_bplist);
+		}
 
 		switch(boundary_compute_scale)
 		{
@@ -1094,13 +1385,13 @@ bool SlabMesh::MinCostBoundaryEdgeCollapse(unsigned & eid)
 
 		if (compute_hausdorff == true)
 		{
-			double temp_sum_haus_dis = meanhausdorff_distance * pmesh->pVertexList.size();
+			double temp_sum_haus_dis = meanhausdorff_distance * InputNumVertices();
 			for (set<unsigned>::iterator it = temp_bplist.begin(); it != temp_bplist.end(); it++)
 			{
 				unsigned temp_ind = *it;
-				Vector3d bou_ver(pmesh->pVertexList[temp_ind]->point()[0], pmesh->pVertexList[temp_ind]->point()[1], pmesh->pVertexList[temp_ind]->point()[2]);
+				Vector3d bou_ver(InputVertex(temp_ind));
 
-				temp_sum_haus_dis -= pmesh->pVertexList[temp_ind]->slab_hausdorff_dist;
+				temp_sum_haus_dis -= InputHausdorffDist(temp_ind);
 
 				double min_dis = DBL_MAX;
 				unsigned min_index = -1;
@@ -1124,24 +1415,24 @@ bool SlabMesh::MinCostBoundaryEdgeCollapse(unsigned & eid)
 					min_dis = min(temp_near_dis, min_dis);
 
 					maxhausdorff_distance = max(maxhausdorff_distance, min_dis);
-					pmesh->pVertexList[temp_ind]->slab_hansdorff_index = min_index;
-					pmesh->pVertexList[temp_ind]->slab_hausdorff_dist = min_dis;
+					InputHausdorffIndex(temp_ind) = min_index;
+					InputHausdorffDist(temp_ind) = min_dis;
 
 					temp_sum_haus_dis += min_dis;
 				}
 				else
 				{
-					pmesh->pVertexList[temp_ind]->slab_hansdorff_index = vid_tgt;
+					InputHausdorffIndex(temp_ind) = vid_tgt;
 					double temp_len = abs((vertices[vid_tgt].second->sphere.center - bou_ver).Length() - vertices[vid_tgt].second->sphere.radius);
 					if (temp_len >= 0)
 					{
-						pmesh->pVertexList[temp_ind]->slab_hausdorff_dist = temp_len;
+						InputHausdorffDist(temp_ind) = temp_len;
 						maxhausdorff_distance = max(maxhausdorff_distance,temp_len);
 						temp_sum_haus_dis += temp_len;
 					}
 				}
 			}
-			meanhausdorff_distance = temp_sum_haus_dis / pmesh->pVertexList.size();
+			meanhausdorff_distance = temp_sum_haus_dis / InputNumVertices();
 		}
 
 		for (std::set<unsigned>::iterator si = vertices[vid_tgt].second->edges_.begin(); si != vertices[vid_tgt].second->edges_.end(); si ++)
@@ -1191,11 +1482,27 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 	if (!edges[eid].second->topo_contractable)
 		return false;
 
+	bool on_plane = SymmetryConstrained(v1, v2, sphere.center);
+	if (on_plane)
+		sphere.center -= (symmetry_normal.Dot(sphere.center) - symmetry_offset) * symmetry_normal;
+
+	unsigned edge_faces = (unsigned)edges[eid].second->faces_.size();
+	unsigned vid_tgt;
+
 	// ˷תĴʽ
+	// the merge is done first and checked on its result, the source vertices and
+	// the edge stay readable until the collapse is committed
 	if (prevent_inversion == true)
 	{
+		BeginCollapse();
+		if (!MergeVertices(v1, v2, vid_tgt))
+		{
+			RollbackCollapse();
+			return false;
+		}
+
 		// תʱѡȡûתķʽкϲ
-		if (!Contractible(v1, v2, sphere.center))
+		if (!CollapseKeepsOrientation(v1, v2, sphere.center))
 		{
 			Wm4::Vector4d lamdar;
 			double coll_cost = 0.0;
@@ -1205,23 +1512,29 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 			Sphere *min_sphere = new Sphere[3];
 			Vector4d min_vertex;
 			int min_index = 0;
-			if (Contractible(v1, v2, vertices[v1].second->sphere.center))
+			Sphere fallback[3];
+			fallback[0] = vertices[v1].second->sphere;
+			fallback[1] = vertices[v2].second->sphere;
+			fallback[2] = (vertices[v1].second->sphere + vertices[v2].second->sphere) * 0.5;
+			for (int i = 0; i < 3; i++)
+				ProjectOntoSymmetryPlane(v1, v2, fallback[i]);
+			if (CollapseKeepsOrientation(v1, v2, fallback[0].center))
 			{
-				min_sphere[count] = vertices[v1].second->sphere;
+				min_sphere[count] = fallback[0];
 				min_vertex = Vector4d(min_sphere[count].center.X(), min_sphere[count].center.Y(), min_sphere[count].center.Z(), min_sphere[count].radius);
 				collapse_costs[count] = 0.5 * (min_vertex * A).Dot(min_vertex) - b.Dot(min_vertex) + c;
 				count++;
 			}
-			if (Contractible(v1, v2, vertices[v2].second->sphere.center))
+			if (CollapseKeepsOrientation(v1, v2, fallback[1].center))
 			{
-				min_sphere[count] = vertices[v2].second->sphere;
+				min_sphere[count] = fallback[1];
 				min_vertex = Vector4d(min_sphere[count].center.X(), min_sphere[count].center.Y(), min_sphere[count].center.Z(), min_sphere[count].radius);
 				collapse_costs[count] = 0.5 * (min_vertex * A).Dot(min_vertex) - b.Dot(min_vertex) + c;
 				count++;
 			}
-			if (Contractible(v1, v2, (vertices[v1].second->sphere.center + vertices[v2].second->sphere.center) / 2.0))
+			if (CollapseKeepsOrientation(v1, v2, fallback[2].center))
 			{
-				min_sphere[count] = (vertices[v1].second->sphere + vertices[v2].second->sphere) * 0.5;
+				min_sphere[count] = fallback[2];
 				min_vertex = Vector4d(min_sphere[count].center.X(), min_sphere[count].center.Y(), min_sphere[count].center.Z(), min_sphere[count].radius);
 				collapse_costs[count] = 0.5 * (min_vertex * A).Dot(min_vertex) - b.Dot(min_vertex) + c;
 				count++;
@@ -1246,6 +1559,7 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 				coll_cost += 1e9;
 			delete [] collapse_costs;
 			delete [] min_sphere;
+			RollbackCollapse();
 
 			edges[eid].second->qem_error = coll_cost;
 			//coll_cost = (coll_cost + k) * edges[eid].second->hyperbolic_weight * edges[eid].second->hyperbolic_weight 
@@ -1253,6 +1567,8 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 			//	* edges[eid].second->hyperbolic_weight	* edges[eid].second->hyperbolic_weight;
 
 			coll_cost = (coll_cost + k) * edges[eid].second->hyperbolic_weight * edges[eid].second->hyperbolic_weight;
+			if (edge_faces == 0)
+				coll_cost += face_removal_penalty;
 
 			edges[eid].second->collapse_cost = coll_cost;
 
@@ -1266,7 +1582,7 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 	}
 
 	// Ǳ߽߽м򻯻ڲ߽м
-	if (edges[eid].second->faces_.size() <= 1)
+	if (edge_faces <= 1)
 		simplified_boundary_edges++;
 	else
 		simplified_inside_edges++;
@@ -1278,20 +1594,33 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 	}
 
 	set<unsigned> temp_bplist;
+	BoundarySampleList samples1, samples2;
 	if (compute_hausdorff)
 	{
 		for (set<unsigned>::iterator it = vertices[v1].second->bplist.begin(); it != vertices[v1].second->bplist.end(); it++)
 			temp_bplist.insert(*it);
 		for (set<unsigned>::iterator it = vertices[v2].second->bplist.begin(); it != vertices[v2].second->bplist.end(); it++)
 			temp_bplist.insert(*it);
+		samples1 = vertices[v1].second->bpsamples;
+		samples2 = vertices[v2].second->bpsamples;
 	}
 
 	unsigned temp_related_face = vertices[v1].second->related_face + vertices[v2].second->related_face;
 	double temp_mean_squre_error = edges[eid].second->collapse_cost < 0 ? 0 : edges[eid].second->collapse_cost / temp_related_face;
 	max_mean_squre_error = max(temp_mean_squre_error, max_mean_squre_error);
 
-	unsigned vid_tgt;
-	if(MergeVertices(v1, v2, vid_tgt)){  
+	double collapse_cost = edges[eid].second->collapse_cost;
+	bool merged = true;
+	if (prevent_inversion == true)
+		CommitCollapse();
+	else
+		merged = MergeVertices(v1, v2, vid_tgt);
+	if(merged){
+		if(collapse_trace != NULL)
+		{
+			double center[3] = {sphere.center[0], sphere.center[1], sphere.center[2]};
+			collapse_trace->Add(v1, v2, vid_tgt, center, sphere.radius, collapse_cost);
+		}
 		vertices[vid_tgt].second->slab_A = A;
 		vertices[vid_tgt].second->slab_b = b;
 		vertices[vid_tgt].second->slab_c = c;
@@ -1299,6 +1628,7 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 		vertices[vid_tgt].second->related_face = temp_related_face;
 		vertices[vid_tgt].second->mean_square_error = temp_mean_squre_error;
 		vertices[vid_tgt].second->hyperbolic_weight = hyperbolic_weight;
+		vertices[vid_tgt].second->on_symmetry_plane = on_plane;
 
 		// Ϣ
 		InitialTopologyProperty(vid_tgt);
@@ -1313,16 +1643,18 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 			edge_collapses_queue.push(EdgeInfo(*si, edges[*si].second->collapse_cost));
 		}
 
-		if (compute_hausdorff)
+		if (compute_hausdorff && bplist_limit > 0)
+			ReassignBoundarySamples(vid_tgt, JoinBoundarySamples(samples1, samples2), temp_bplist);
+		else if (compute_hausdorff)
 		{
-			double temp_sum_haus_dis = meanhausdorff_distance * pmesh->pVertexList.size();
+			double temp_sum_haus_dis = meanhausdorff_distance * InputNumVertices();
 			for (set<unsigned>::iterator it = temp_bplist.begin(); it != temp_bplist.end(); it++)
 			{
 				unsigned temp_ind = *it;
-				Vector3d bou_ver(pmesh->pVertexList[temp_ind]->point()[0], pmesh->pVertexList[temp_ind]->point()[1], pmesh->pVertexList[temp_ind]->point()[2]);
-				bou_ver /= pmesh->bb_diagonal_length;
+				Vector3d bou_ver(InputVertex(temp_ind));
+				bou_ver /= InputDiagonal();
 
-				temp_sum_haus_dis -= pmesh->pVertexList[temp_ind]->slab_hausdorff_dist;
+				temp_sum_haus_dis -= InputHausdorffDist(temp_ind);
 
 				double min_dis = DBL_MAX;
 				unsigned min_index = -1;
@@ -1347,30 +1679,47 @@ bool SlabMesh::MinCostEdgeCollapse(unsigned & eid){
 
 					vertices[min_index].second->bplist.insert(temp_ind);
 					maxhausdorff_distance = max(maxhausdorff_distance, min_dis);
-					pmesh->pVertexList[temp_ind]->slab_hansdorff_index = min_index;
-					pmesh->pVertexList[temp_ind]->slab_hausdorff_dist = min_dis;
+					InputHausdorffIndex(temp_ind) = min_index;
+					InputHausdorffDist(temp_ind) = min_dis;
 
 					temp_sum_haus_dis += min_dis;
 				}
 				else
 				{
-					pmesh->pVertexList[temp_ind]->slab_hansdorff_index = vid_tgt;
+					InputHausdorffIndex(temp_ind) = vid_tgt;
 					double temp_len = abs((vertices[vid_tgt].second->sphere.center - bou_ver).Length() - vertices[vid_tgt].second->sphere.radius);
 					if (temp_len >= 0)
 					{
-						pmesh->pVertexList[temp_ind]->slab_hausdorff_dist = temp_len;
+						InputHausdorffDist(temp_ind) = temp_len;
 						maxhausdorff_distance = max(maxhausdorff_distance,temp_len);
 						temp_sum_haus_dis += temp_len;
 					}
 				}
 			}
-			meanhausdorff_distance = temp_sum_haus_dis / pmesh->pVertexList.size();
+			meanhausdorff_distance = temp_sum_haus_dis / InputNumVertices();
 		}
 	}
 
 	return true;
 }
 
+bool SlabMesh::ReplayCollapse(const CollapseRecord & rec)
+{
+	if(rec.v1 >= vertices.size() || rec.v2 >= vertices.size()
+		|| !vertices[rec.v1].first || !vertices[rec.v2].first)
+		return false;
+
+	unsigned vid_tgt;
+	if(!MergeVertices(rec.v1, rec.v2, vid_tgt))
+		return false;
+
+	vertices[vid_tgt].second->sphere.center = Wm4::Vector3d(rec.center[0], rec.center[1], rec.center[2]);
+	vertices[vid_tgt].second->sphere.radius = rec.radius;
+
+	// the merge has to create the same vertex as in the recorded run
+	return vid_tgt == rec.vid;
+}
+
 void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 	if (!edges[eid].first)
 		return ;
@@ -1378,6 +1727,8 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 	unsigned v1, v2;
 	v1 = edges[eid].second->vertices_.first;
 	v2 = edges[eid].second->vertices_.second; 
+	// curve skeleton mode, the edges without faces wait until the faces are gone
+	double penalty = edges[eid].second->faces_.empty() ? face_removal_penalty : 0.0;
 
 	double weight = vertices[v1].second->hyperbolic_weight + vertices[v2].second->hyperbolic_weight;
 
@@ -1469,7 +1820,7 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 
 		min_index = collapse_costs[min_index] > collapse_costs[2] ? 2 : min_index;
 
-		edges[eid].second->collapse_cost = collapse_costs[min_index];
+		edges[eid].second->collapse_cost = collapse_costs[min_index] + penalty;
 		edges[eid].second->sphere.center = min_sphere[min_index].center;
 		edges[eid].second->sphere.radius = min_sphere[min_index].radius;
 
@@ -1490,9 +1841,18 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 			if (inverse_A_matrix != Matrix4d())
 			{
 				lamdar = inverse_A_matrix * edges[eid].second->slab_b;
+				if (SymmetryConstrained(v1, v2, Vector3d(lamdar.X(), lamdar.Y(), lamdar.Z())))
+				{
+					// minimum of the quadric on the mirror plane
+					Vector4d n(symmetry_normal.X(), symmetry_normal.Y(), symmetry_normal.Z(), 0.0);
+					Vector4d An = inverse_A_matrix * n;
+					if (n.Dot(An) > 0.0)
+						lamdar += ((symmetry_offset - n.Dot(lamdar)) / n.Dot(An)) * An;
+				}
 				if (lamdar.W() < 0)
 				{
 					Sphere mid_sphere = (vertices[v1].second->sphere + vertices[v2].second->sphere) * 0.5;
+					ProjectOntoSymmetryPlane(v1, v2, mid_sphere);
 					lamdar = Vector4d(mid_sphere.center.X(), mid_sphere.center.Y(), mid_sphere.center.Z(), mid_sphere.radius);
 				}
 			}
@@ -1500,6 +1860,7 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 			{
 				// it's now calculate as the middle of the spheres
 				Sphere mid_sphere = (vertices[v1].second->sphere + vertices[v2].second->sphere) * 0.5;
+				ProjectOntoSymmetryPlane(v1, v2, mid_sphere);
 				lamdar = Vector4d(mid_sphere.center.X(), mid_sphere.center.Y(), mid_sphere.center.Z(), mid_sphere.radius);
 			}
 		}
@@ -1515,14 +1876,17 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 			int min_index = 0;
 
 			min_sphere[0] = vertices[v1].second->sphere;
+			ProjectOntoSymmetryPlane(v1, v2, min_sphere[0]);
 			min_vertex = Vector4d(min_sphere[0].center.X(), min_sphere[0].center.Y(), min_sphere[0].center.Z(), min_sphere[0].radius);
 			collapse_costs[0] = 0.5 * (min_vertex * edges[eid].second->slab_A).Dot(min_vertex) 
 				- edges[eid].second->slab_b.Dot(min_vertex) + edges[eid].second->slab_c;
 			min_sphere[1] = vertices[v2].second->sphere;
+			ProjectOntoSymmetryPlane(v1, v2, min_sphere[1]);
 			min_vertex = Vector4d(min_sphere[1].center.X(), min_sphere[1].center.Y(), min_sphere[1].center.Z(), min_sphere[1].radius);
 			collapse_costs[1] = 0.5 * (min_vertex * edges[eid].second->slab_A).Dot(min_vertex) 
 				- edges[eid].second->slab_b.Dot(min_vertex) + edges[eid].second->slab_c;
 			min_sphere[2] = (vertices[v1].second->sphere + vertices[v2].second->sphere) * 0.5;
+			ProjectOntoSymmetryPlane(v1, v2, min_sphere[2]);
 			min_vertex = Vector4d(min_sphere[2].center.X(), min_sphere[2].center.Y(), min_sphere[2].center.Z(), min_sphere[2].radius);
 			collapse_costs[2] = 0.5 * (min_vertex * edges[eid].second->slab_A).Dot(min_vertex) 
 				- edges[eid].second->slab_b.Dot(min_vertex) + edges[eid].second->slab_c;
@@ -1558,7 +1922,7 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 				break;
 			}
 
-			edges[eid].second->collapse_cost = coll_cost;
+			edges[eid].second->collapse_cost = coll_cost + penalty;
 			edges[eid].second->sphere.center = min_sphere[min_index].center;
 			edges[eid].second->sphere.radius = min_sphere[min_index].radius;
 
@@ -1577,25 +1941,31 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 		Sphere *min_sphere = new Sphere[3];
 		Vector4d min_vertex;
 		int min_index = 0;
-		if (!Contractible(v1, v2, vertices[v1].second->sphere.center))
+		Sphere fallback[3];
+		fallback[0] = vertices[v1].second->sphere;
+		fallback[1] = vertices[v2].second->sphere;
+		fallback[2] = (vertices[v1].second->sphere + vertices[v2].second->sphere) * 0.5;
+		for (int i = 0; i < 3; i++)
+			ProjectOntoSymmetryPlane(v1, v2, fallback[i]);
+		if (!Contractible(v1, v2, fallback[0].center))
 		{
-			min_sphere[count] = vertices[v1].second->sphere;
+			min_sphere[count] = fallback[0];
 			min_vertex = Vector4d(min_sphere[count].center.X(), min_sphere[count].center.Y(), min_sphere[count].center.Z(), min_sphere[count].radius);
 			collapse_costs[count] = 0.5 * (min_vertex * edges[eid].second->slab_A).Dot(min_vertex) 
 				- edges[eid].second->slab_b.Dot(min_vertex) + edges[eid].second->slab_c;
 			count++;
 		}
-		if (!Contractible(v1, v2, vertices[v2].second->sphere.center))
+		if (!Contractible(v1, v2, fallback[1].center))
 		{
-			min_sphere[count] = vertices[v2].second->sphere;
+			min_sphere[count] = fallback[1];
 			min_vertex = Vector4d(min_sphere[count].center.X(), min_sphere[count].center.Y(), min_sphere[count].center.Z(), min_sphere[count].radius);
 			collapse_costs[count] = 0.5 * (min_vertex * edges[eid].second->slab_A).Dot(min_vertex) 
 				- edges[eid].second->slab_b.Dot(min_vertex) + edges[eid].second->slab_c;
 			count++;
 		}
-		if (!Contractible(v1, v2, (vertices[v1].second->sphere.center + vertices[v2].second->sphere.center) / 2.0))
+		if (!Contractible(v1, v2, fallback[2].center))
 		{
-			min_sphere[count] = (vertices[v1].second->sphere + vertices[v2].second->sphere) * 0.5;
+			min_sphere[count] = fallback[2];
 			min_vertex = Vector4d(min_sphere[count].center.X(), min_sphere[count].center.Y(), min_sphere[count].center.Z(), min_sphere[count].radius);
 			collapse_costs[count] = 0.5 * (min_vertex * edges[eid].second->slab_A).Dot(min_vertex) 
 				- edges[eid].second->slab_b.Dot(min_vertex) + edges[eid].second->slab_c;
@@ -1657,7 +2027,7 @@ void SlabMesh::EvaluateEdgeCollapseCost(unsigned eid){
 		break; 
 	}
 
-	edges[eid].second->collapse_cost = coll_cost;
+	edges[eid].second->collapse_cost = coll_cost + penalty;
 	edges[eid].second->sphere.center = Wm4::Vector3d(lamdar.X(), lamdar.Y(), lamdar.Z());
 	edges[eid].second->sphere.radius = lamdar.W();
 }
@@ -1727,43 +2097,7 @@ void SlabMesh::EvaluateEdgeHausdorffCost(unsigned eid)
 		lamdar = Vector4d(mid_sphere.center.X(), mid_sphere.center.Y(), mid_sphere.center.Z(), mid_sphere.radius);
 	}
 
-	set<unsigned> temp_bplist;
-	for (set<unsigned>::iterator it = vertices[v1].second->bplist.begin(); it != vertices[v1].second->bplist.end(); it++)
-		temp_bplist.insert(*it);
-	for (set<unsigned>::iterator it = vertices[v2].second->bplist.begin(); it != vertices[v2].second->bplist.end(); it++)
-		temp_bplist.insert(*it);
-
-	double max_hausdorff = 0;
-	for (set<unsigned>::iterator it = temp_bplist.begin(); it != temp_bplist.end(); it++)
-	{
-		unsigned temp_ind = *it;
-		Vector3d bou_ver(pmesh->pVertexList[temp_ind]->point()[0], pmesh->pVertexList[temp_ind]->point()[1], pmesh->pVertexList[temp_ind]->point()[2]);
-
-		//double min_dis = DBL_MIN;
-		//unsigned min_index = -1;
-		//for (unsigned j = 0; j < vertices.size(); j++)
-		//{
-		//	if (vertices[j].first && (j != v1 && j != v2))
-		//	{
-		//		Sphere ma_ver = vertices[j].second->sphere;
-		//		double temp_length = abs((bou_ver - ma_ver.center).Length() - ma_ver.radius);
-		//		if (temp_length >= 0 && temp_length < min_dis)
-		//		{
-		//			min_dis = temp_length;
-		//			min_index = j;
-		//		}
-		//	}
-		//}
-
-		//double temp_near_dis = NearestPoint(bou_ver, min_index);
-		//min_dis = min(temp_near_dis, min_dis);
-
-		// СǷɵĵ
-		double temp_length = abs((bou_ver - Wm4::Vector3d(lamdar.X(), lamdar.Y(), lamdar.Z())).Length() - lamdar.W());
-		//min_dis = max(temp_length, min_dis);
-
-		max_hausdorff = max(temp_length, max_hausdorff);
-	}
+	double max_hausdorff = BoundarySampleCost(v1, v2, lamdar);
 	//set<unsigned> neighbors_v, tdneighbors_v;
 	//GetNeighborVertices(v1, neighbors_v);
 	//GetNeighborVertices(v2, tdneighbors_v);
@@ -1884,24 +2218,7 @@ void SlabMesh::ReEvaluateEdgeHausdorffCost(unsigned eid)
 		lamdar = Vector4d(mid_sphere.center.X(), mid_sphere.center.Y(), mid_sphere.center.Z(), mid_sphere.radius);
 	}
 
-	set<unsigned> temp_bplist;
-	for (set<unsigned>::iterator it = vertices[v[0]].second->bplist.begin(); it != vertices[v[0]].second->bplist.end(); it++)
-		temp_bplist.insert(*it);
-	for (set<unsigned>::iterator it = vertices[v[1]].second->bplist.begin(); it != vertices[v[1]].second->bplist.end(); it++)
-		temp_bplist.insert(*it);
-
-	double max_hausdorff = 0;
-	for (set<unsigned>::iterator it = temp_bplist.begin(); it != temp_bplist.end(); it++)
-	{
-		unsigned temp_ind = *it;
-		Vector3d bou_ver(pmesh->pVertexList[temp_ind]->point()[0], pmesh->pVertexList[temp_ind]->point()[1], pmesh->pVertexList[temp_ind]->point()[2]);
-
-		// СǷɵĵ
-		double temp_length = abs((bou_ver - Wm4::Vector3d(lamdar.X(), lamdar.Y(), lamdar.Z())).Length() - lamdar.W());
-		//min_dis = max(temp_length, min_dis);
-
-		max_hausdorff = max(temp_length, max_hausdorff);
-	}
+	double max_hausdorff = BoundarySampleCost(v[0], v[1], lamdar);
 
 	coll_cost = max_hausdorff;
 
@@ -1953,7 +2270,11 @@ void SlabMesh::Simplify(int threshold){
 			if(edges[eid].first && ValidVertex(edges[eid].second->vertices_.first) && ValidVertex(edges[eid].second->vertices_.second))
 			{
 				if (MinCostBoundaryEdgeCollapse(eid)) 
-					deleteSphereNum ++;    
+				{
+					deleteSphereNum ++;
+					if (validate_interval > 0 && !ValidationCheckpoint(false))
+						break;
+				}
 			} 
 		} 
 	}else
@@ -1966,13 +2287,26 @@ void SlabMesh::Simplify(int threshold){
 			//if (sqrt(max_mean_squre_error) / pmesh->bb_diagonal_length >= end_multi)
 			//	break;
 
+			if (skeleton_capsules > 0 && numFaces == 0 && numEdges <= skeleton_capsules)
+				break;
+
 			EdgeInfo topEdge = edge_collapses_queue.top();
 			edge_collapses_queue.pop(); 
 			unsigned eid = topEdge.edge_num;
 			if(edges[eid].first && ValidVertex(edges[eid].second->vertices_.first) && ValidVertex(edges[eid].second->vertices_.second))
 			{
+				double error = topEdge.collapse_cost - (edges[eid].second->faces_.empty() ? face_removal_penalty : 0.0);
+				if (error > max_collapse_cost)
+				{
+					edge_collapses_queue.push(topEdge);
+					break;
+				}
 				if(MinCostEdgeCollapse(eid))
-					deleteSphereNum ++;  
+				{
+					deleteSphereNum ++;
+					if (validate_interval > 0 && !ValidationCheckpoint(false))
+						break;
+				}
 			}
 
 			//if (maxhausdorff_distance / pmesh->bb_diagonal_length >= start_multi)
@@ -1982,21 +2316,419 @@ void SlabMesh::Simplify(int threshold){
 			//	GetSavedPointNumber();
 		}
 	}
+
+	if (validate_interval > 0 && validation_report.Valid())
+		ValidationCheckpoint(true);
+}
+
+void SlabMesh::LoadMA(std::istream & mastream, double scale)
+{
+	int nv, ne, nf;
+	mastream >> nv >> ne >> nf;
+
+	numVertices = 0;
+	numEdges = 0;
+	numFaces = 0;
+
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		char ch;
+		double x,y,z,r;
+		mastream >> ch >> x >> y >> z >> r;
+
+		Bool_SlabVertexPointer bsvp2;
+		bsvp2.first = true;
+		bsvp2.second = new SlabVertex;
+		(*bsvp2.second).sphere.center[0] = x / scale;
+		(*bsvp2.second).sphere.center[1] = y / scale;
+		(*bsvp2.second).sphere.center[2] = z / scale;
+		(*bsvp2.second).sphere.radius = r / scale;
+		(*bsvp2.second).index = vertices.size();
+		vertices.push_back(bsvp2);
+		numVertices ++;
+	}
+
+	for(unsigned i = 0; i < ne; i ++)
+	{
+		char ch;
+		unsigned ver[2];
+		mastream >> ch;
+		mastream >> ver[0];
+		mastream >> ver[1];
+
+		Bool_SlabEdgePointer bsep2;
+		bsep2.first = true;
+		bsep2.second = new SlabEdge;
+		(*bsep2.second).vertices_.first = ver[0];
+		(*bsep2.second).vertices_.second = ver[1];
+		(*vertices[(*bsep2.second).vertices_.first].second).edges_.insert(edges.size());
+		(*vertices[(*bsep2.second).vertices_.second].second).edges_.insert(edges.size());
+		(*bsep2.second).index = edges.size();
+		edges.push_back(bsep2);
+		numEdges ++;
+	}
+
+	for(unsigned i = 0; i < nf; i ++)
+	{
+		char ch;
+		unsigned vid[3];
+		unsigned eid[3];
+		mastream >> ch >> vid[0] >> vid[1] >> vid[2];
+
+		Bool_SlabFacePointer bsfp2;
+		bsfp2.first = true;
+		bsfp2.second = new SlabFace;
+		(*bsfp2.second).vertices_.insert(vid[0]);
+		(*bsfp2.second).vertices_.insert(vid[1]);
+		(*bsfp2.second).vertices_.insert(vid[2]);
+		if(Edge(vid[0],vid[1],eid[0]))
+			(*bsfp2.second).edges_.insert(eid[0]);
+		if(Edge(vid[0],vid[2],eid[1]))
+			(*bsfp2.second).edges_.insert(eid[1]);
+		if(Edge(vid[1],vid[2],eid[2]))
+			(*bsfp2.second).edges_.insert(eid[2]);
+		(*bsfp2.second).index = faces.size();
+		vertices[vid[0]].second->faces_.insert(faces.size());
+		vertices[vid[1]].second->faces_.insert(faces.size());
+		vertices[vid[2]].second->faces_.insert(faces.size());
+		edges[eid[0]].second->faces_.insert(faces.size());
+		edges[eid[1]].second->faces_.insert(faces.size());
+		edges[eid[2]].second->faces_.insert(faces.size());
+		faces.push_back(bsfp2);
+		numFaces++;
+	}
+
+	iniNumVertices = numVertices;
+	iniNumEdges = numEdges;
+	iniNumFaces = numFaces;
+
+	CleanIsolatedVertices();
+	computebb();
+	ComputeFacesCentroid();
+	ComputeFacesNormal();
+	ComputeVerticesNormal();
+	ComputeEdgesCone();
+	ComputeFacesSimpleTriangles();
+	DistinguishVertexType();
+}
+
+void SlabMesh::InitialQuadrics()
+{
+	// handle each face
+	for(unsigned i = 0; i < vertices.size(); i++)
+	{ 
+		if(!vertices[i].first)
+			continue;
+
+		SlabVertex sv = *vertices[i].second;
+		std::set<unsigned> fset = sv.faces_;
+		Vector4d C1(sv.sphere.center.X(), sv.sphere.center.Y(), sv.sphere.center.Z(), sv.sphere.radius);
+
+		for (set<unsigned>::iterator si = fset.begin(); si != fset.end(); si++)
+		{
+			SlabFace sf = *faces[*si].second;
+
+			if (sf.valid_st == false || sf.st[0].normal == Vector3d(0., 0., 0.) || 
+				sf.st[1].normal == Vector3d(0., 0., 0.))
+				continue;
+
+			Vector4d normal1(sf.st[0].normal.X(), sf.st[0].normal.Y(), sf.st[0].normal.Z(), 1.0);
+			Vector4d normal2(sf.st[1].normal.X(), sf.st[1].normal.Y(), sf.st[1].normal.Z(), 1.0);
+
+			// compute the matrix of A
+			Matrix4d temp_A1, temp_A2;
+			temp_A1.MakeTensorProduct(normal1, normal1);
+			temp_A2.MakeTensorProduct(normal2, normal2);
+			temp_A1 *= 2.0;
+			temp_A2 *= 2.0;
+
+			// compute the matrix of b
+			double normal_mul_point1 = normal1.Dot(C1);
+			double normal_mul_point2 = normal2.Dot(C1);
+			Wm4::Vector4d temp_b1 = normal1 * 2 * normal_mul_point1;
+			Wm4::Vector4d temp_b2 = normal2 * 2 * normal_mul_point2;
+
+			//compute c
+			double temp_c1 = normal_mul_point1 * normal_mul_point1;
+			double temp_c2 = normal_mul_point2 * normal_mul_point2;
+
+			vertices[i].second->slab_A += temp_A1;
+			vertices[i].second->slab_A += temp_A2;
+			vertices[i].second->slab_b += temp_b1;
+			vertices[i].second->slab_b += temp_b2;
+			vertices[i].second->slab_c += temp_c1;
+			vertices[i].second->slab_c += temp_c2;
+
+			vertices[i].second->related_face += 2;
+		}
+	}
+
+	switch(preserve_boundary_method)
+	{
+	case 1 :
+		PreservBoundaryMethodOne();
+		break;
+	case 2 :
+		//PreservBoundaryMethodTwo();
+		break;
+	case 3 :
+		PreservBoundaryMethodThree();
+		break;
+	default:
+		PreservBoundaryMethodFour();
+		break;
+	}
 }
 
 void SlabMesh::initCollapseQueue(){
 
-	// first initial the edges with fake boundary edge.
+	// the costs without the skeleton penalty first, it is relative to the largest
+	// of them; the collapses without a valid sphere (1e9 added) are left out
+	face_removal_penalty = 0.;
+	double max_cost = 0.;
 	for (int i = 0; i < numEdges; i++)
 	{ 
 		if (edges[i].first)
 		{
 			EvaluateEdgeCollapseCost(i);
+			if (edges[i].second->collapse_cost < 1e9)
+				max_cost = max(max_cost, edges[i].second->collapse_cost);
+		}
+	}
+	if (skeleton_penalty > 0.)
+		face_removal_penalty = skeleton_penalty * (max_cost > 0. ? max_cost : 1.);
+
+	// first initial the edges with fake boundary edge.
+	for (int i = 0; i < numEdges; i++)
+	{ 
+		if (edges[i].first)
+		{
+			if (edges[i].second->faces_.empty())
+				edges[i].second->collapse_cost += face_removal_penalty;
 			edge_collapses_queue.push(EdgeInfo(i, edges[i].second->collapse_cost));
 		}
 	}
 }
 
+// farthest point sampling of the points, keeps limit of them and returns the
+// largest distance of a dropped point to the kept ones
+static double FarthestPointSamples(const std::vector<unsigned> & ids, const std::vector<Vector3d> & points, unsigned limit, std::set<unsigned> & kept)
+{
+	kept.clear();
+	std::vector<double> dist(ids.size(), DBL_MAX);
+	size_t next = 0;
+	for (unsigned k = 0; k < limit && k < ids.size(); k++)
+	{
+		kept.insert(ids[next]);
+		double far_dist = -1.;
+		for (size_t i = 0; i < ids.size(); i++)
+		{
+			dist[i] = min(dist[i], (points[i] - points[next]).Length());
+			if (dist[i] > far_dist)
+			{
+				far_dist = dist[i];
+				next = i;
+			}
+		}
+	}
+	double radius = 0.;
+	for (size_t i = 0; i < ids.size(); i++)
+		radius = max(radius, dist[i]);
+	return radius;
+}
+
+static double SampleListCost(const SlabMesh & mesh, const BoundarySampleList & list, const Vector3d & center, double radius)
+{
+	double cost = 0.;
+	for (unsigned i = list.head; i != bplist_end; i = mesh.bplist_next[i])
+		cost = max(cost, abs((mesh.InputVertex(i) - center).Length() - radius));
+	return cost;
+}
+
+void SlabMesh::LimitBoundarySamples()
+{
+	if (bplist_limit == 0)
+		return;
+	bplist_next.assign(InputNumVertices(), bplist_end);
+	for (unsigned i = 0; i < vertices.size(); i++)
+	{
+		if (!vertices[i].first)
+			continue;
+		BoundarySampleList & list = vertices[i].second->bpsamples;
+		list = BoundarySampleList();
+		for (set<unsigned>::iterator si = vertices[i].second->bplist.begin(); si != vertices[i].second->bplist.end(); si++)
+			AppendBoundarySample(list, *si);
+		RebuildBoundarySamples(i);
+	}
+}
+
+// the dropped representatives are within the sampling radius of the kept ones,
+// so the cover of the complete list grows by at most that radius
+void SlabMesh::ReduceBoundarySamples(unsigned vid)
+{
+	std::set<unsigned> & bplist = vertices[vid].second->bplist;
+	if (bplist_limit == 0 || bplist.size() <= bplist_limit)
+		return;
+	std::vector<unsigned> ids(bplist.begin(), bplist.end());
+	std::vector<Vector3d> points(ids.size());
+	for (size_t i = 0; i < ids.size(); i++)
+		points[i] = InputVertex(ids[i]);
+	std::set<unsigned> kept;
+	vertices[vid].second->bpsamples.cover += FarthestPointSamples(ids, points, bplist_limit, kept);
+	bplist.swap(kept);
+}
+
+void SlabMesh::RebuildBoundarySamples(unsigned vid)
+{
+	BoundarySampleList & list = vertices[vid].second->bpsamples;
+	std::vector<unsigned> ids;
+	std::vector<Vector3d> points;
+	ids.reserve(list.count);
+	points.reserve(list.count);
+	for (unsigned i = list.head; i != bplist_end; i = bplist_next[i])
+	{
+		ids.push_back(i);
+		points.push_back(InputVertex(i));
+	}
+	list.cover = FarthestPointSamples(ids, points, bplist_limit, vertices[vid].second->bplist);
+}
+
+void SlabMesh::AppendBoundarySample(BoundarySampleList & list, unsigned sample)
+{
+	bplist_next[sample] = bplist_end;
+	if (list.tail == bplist_end)
+		list.head = sample;
+	else
+		bplist_next[list.tail] = sample;
+	list.tail = sample;
+	list.count++;
+}
+
+BoundarySampleList SlabMesh::JoinBoundarySamples(const BoundarySampleList & a, const BoundarySampleList & b)
+{
+	BoundarySampleList list;
+	list.cover = max(a.cover, b.cover);
+	list.count = a.count + b.count;
+	list.head = a.count > 0 ? a.head : b.head;
+	list.tail = b.count > 0 ? b.tail : a.tail;
+	if (a.count > 0 && b.count > 0)
+		bplist_next[a.tail] = b.head;
+	return list;
+}
+
+void SlabMesh::CollectBoundarySamples(const BoundarySampleList & list, std::set<unsigned> & samples)
+{
+	for (unsigned i = list.head; i != bplist_end; i = bplist_next[i])
+		samples.insert(i);
+}
+
+// Only vid_tgt and its neighbours are candidates, the other vertices did not move.
+// The samples stay in the spliced list unless a neighbour is closer, only those
+// are relinked. A moved representative invalidates the cover of the rest.
+void SlabMesh::ReassignBoundarySamples(unsigned vid_tgt, const BoundarySampleList & samples, const std::set<unsigned> & representatives)
+{
+	std::set<unsigned> neighbors;
+	GetNeighborVertices(vid_tgt, neighbors);
+	std::vector<unsigned> candidates(1, vid_tgt);
+	candidates.insert(candidates.end(), neighbors.begin(), neighbors.end());
+
+	BoundarySampleList & kept = vertices[vid_tgt].second->bpsamples;
+	std::set<unsigned> & bplist = vertices[vid_tgt].second->bplist;
+	kept = BoundarySampleList();
+	kept.cover = samples.cover;
+	bplist = representatives;
+
+	double temp_sum_haus_dis = meanhausdorff_distance * InputNumVertices();
+	std::set<unsigned> grown_vertices;
+	bool lost_representative = false;
+	for (unsigned s = samples.head, next; s != bplist_end; s = next)
+	{
+		next = bplist_next[s];
+		Vector3d bou_ver(InputVertex(s));
+		bou_ver /= InputDiagonal();
+
+		double min_dis = DBL_MAX;
+		unsigned owner = vid_tgt;
+		for (size_t j = 0; j < candidates.size(); j++)
+		{
+			const Sphere & ma_ver = vertices[candidates[j]].second->sphere;
+			double temp_length = abs((bou_ver - ma_ver.center).Length() - ma_ver.radius);
+			if (temp_length < min_dis)
+			{
+				min_dis = temp_length;
+				owner = candidates[j];
+			}
+		}
+		min_dis = min(NearestPoint(bou_ver, owner), min_dis);
+
+		temp_sum_haus_dis += min_dis - InputHausdorffDist(s);
+		maxhausdorff_distance = max(maxhausdorff_distance, min_dis);
+		InputHausdorffIndex(s) = owner;
+		InputHausdorffDist(s) = min_dis;
+
+		if (owner == vid_tgt)
+		{
+			AppendBoundarySample(kept, s);
+			continue;
+		}
+		AppendBoundarySample(vertices[owner].second->bpsamples, s);
+		vertices[owner].second->bplist.insert(s);
+		grown_vertices.insert(owner);
+		if (bplist.erase(s) > 0)
+			lost_representative = true;
+	}
+	meanhausdorff_distance = temp_sum_haus_dis / InputNumVertices();
+
+	if (lost_representative)
+		RebuildBoundarySamples(vid_tgt);
+	else
+		ReduceBoundarySamples(vid_tgt);
+	for (std::set<unsigned>::iterator si = grown_vertices.begin(); si != grown_vertices.end(); si++)
+		ReduceBoundarySamples(*si);
+}
+
+// a sample within cover of a representative p is at most cover farther from the
+// sphere than p, the representatives themselves give the lower bound
+double SlabMesh::BoundarySampleCost(unsigned v1, unsigned v2, const Wm4::Vector4d & lamdar)
+{
+	Vector3d center(lamdar.X(), lamdar.Y(), lamdar.Z());
+	unsigned v[2] = {v1, v2};
+	double lower = 0., upper = 0.;
+	for (unsigned k = 0; k < 2; k++)
+	{
+		std::set<unsigned> & bplist = vertices[v[k]].second->bplist;
+		double cost = 0.;
+		for (set<unsigned>::iterator it = bplist.begin(); it != bplist.end(); it++)
+			cost = max(cost, abs((InputVertex(*it) - center).Length() - lamdar.W()));
+		lower = max(lower, cost);
+		if (!bplist.empty())
+			upper = max(upper, cost + vertices[v[k]].second->bpsamples.cover);
+	}
+	if (bplist_limit == 0)
+		return lower;
+
+	if (upper - lower > bplist_tolerance * lower)
+	{
+		// inconclusive, tighten the representatives for the next evaluations
+		RebuildBoundarySamples(v1);
+		RebuildBoundarySamples(v2);
+		bplist_exact_costs++;
+		return max(SampleListCost(*this, vertices[v1].second->bpsamples, center, lamdar.W()),
+			SampleListCost(*this, vertices[v2].second->bpsamples, center, lamdar.W()));
+	}
+
+	bplist_bound_costs++;
+	if (bplist_check)
+	{
+		double exact = max(SampleListCost(*this, vertices[v1].second->bpsamples, center, lamdar.W()),
+			SampleListCost(*this, vertices[v2].second->bpsamples, center, lamdar.W()));
+		bplist_checked_costs++;
+		bplist_max_cost_error = max(bplist_max_cost_error, upper - exact);
+		bplist_sum_cost_error += upper - exact;
+	}
+	return upper;
+}
+
 void SlabMesh::initBoundaryCollapseQueue()
 {
 	for (int i = 0; i < edges.size(); i ++)
@@ -2686,6 +3418,43 @@ void SlabMesh::PreservBoundaryMethodFour()
 	} 
 }
 
+unsigned SlabMesh::SetSymmetryPlane(const Vector3d & normal, double offset, double band)
+{
+	symmetry_plane_set = true;
+	symmetry_normal = normal;
+	symmetry_offset = offset;
+
+	unsigned count = 0;
+	for (unsigned i = 0; i < vertices.size(); i++)
+	{
+		if (!vertices[i].first)
+			continue;
+		Sphere & sphere = vertices[i].second->sphere;
+		double d = normal.Dot(sphere.center) - offset;
+		vertices[i].second->on_symmetry_plane = fabs(d) <= band;
+		if (vertices[i].second->on_symmetry_plane)
+		{
+			sphere.center -= d * normal;
+			count++;
+		}
+	}
+	return count;
+}
+
+bool SlabMesh::SymmetryConstrained(unsigned v1, unsigned v2, const Vector3d & center) const
+{
+	if (!symmetry_plane_set)
+		return false;
+	return vertices[v1].second->on_symmetry_plane || vertices[v2].second->on_symmetry_plane
+		|| symmetry_normal.Dot(center) < symmetry_offset;
+}
+
+void SlabMesh::ProjectOntoSymmetryPlane(unsigned v1, unsigned v2, Sphere & sphere) const
+{
+	if (SymmetryConstrained(v1, v2, sphere.center))
+		sphere.center -= (symmetry_normal.Dot(sphere.center) - symmetry_offset) * symmetry_normal;
+}
+
 void SlabMesh::clear()
 {
 	for (unsigned i = 0; i < vertices.size(); i++)
@@ -2827,7 +3596,7 @@ double SlabMesh::EvaluateVertexDistanceErrorEnvelope(Vector4d & lamdar, set<unsi
 	double maxerror(0.0);
 	for(set<unsigned>::iterator si = bplist.begin(); si != bplist.end(); si ++)
 	{
-		Vector3d p(pmesh->pVertexList[*si]->point()[0], pmesh->pVertexList[*si]->point()[1], pmesh->pVertexList[*si]->point()[2]);
+		Vector3d p(InputVertex(*si));
 		double tempdist;
 		Vector3d tempfp;
 
@@ -2915,13 +3684,21 @@ void SlabMesh::Export(std::string fname){
 	fname += "___f_";
 	fname += std::to_string(static_cast<long long>(numFaces));
 
-	AdjustStorage();
-
 	std::string maname = fname;
 	maname += ".ma";
 
 	std::ofstream fout(maname);
 
+	Export(fout);
+	fout.close();
+}
+
+void SlabMesh::Export(std::ostream & fout){
+	if(spatial_order_export)
+		SpatialReorder();
+	else
+		AdjustStorage();
+
 	//	GraphVertexIterator gvi,gvi_end;
 
 	fout << numVertices << " " << numEdges << " " << numFaces << std::endl;
@@ -2930,7 +3707,7 @@ void SlabMesh::Export(std::string fname){
 
 	for(unsigned i = 0; i < vertices.size(); i ++)
 		//fout << "v " << vertices[i].second->sphere.center << " " << vertices[i].second->sphere.radius << std::endl;
-		fout << "v " << setiosflags(ios::fixed) << setprecision(15) << (vertices[i].second->sphere.center * pmesh->bb_diagonal_length) << " " << (vertices[i].second->sphere.radius * pmesh->bb_diagonal_length) << std::endl;
+		fout << "v " << setiosflags(ios::fixed) << setprecision(15) << (vertices[i].second->sphere.center * InputDiagonal()) << " " << (vertices[i].second->sphere.radius * InputDiagonal()) << std::endl;
 
 	for(unsigned i = 0; i < edges.size(); i ++)
 		fout << "e " << edges[i].second->vertices_.first << " " << edges[i].second->vertices_.second << std::endl;
@@ -2942,7 +3719,6 @@ void SlabMesh::Export(std::string fname){
 			fout << " " << *si;
 		fout << std::endl;
 	}
-	fout.close();
 }
 
 
@@ -2,6 +2,7 @@
 #define _SLABMESH_H
 
 #include "PrimMesh.h"
+#include "CollapseTrace.h"
 
 class SlabPrim
 {
@@ -20,6 +21,41 @@ public:
 	SlabPrim() : slab_c(0.0), add_c(0.0), hyperbolic_weight(0.0){}
 };
 
+// end of a boundary sample list
+const unsigned bplist_end = 0xffffffffu;
+
+// complete boundary sample list of a vertex in bounded mode, linked through
+// SlabMesh::bplist_next, every sample in it is within cover of the bplist
+class BoundarySampleList
+{
+public:
+	unsigned head;
+	unsigned tail;
+	unsigned count;
+	double cover;
+
+public:
+	BoundarySampleList() : head(bplist_end), tail(bplist_end), count(0), cover(0.) {}
+};
+
+// result of SlabMesh::ValidateInvariants, messages keeps the first violations
+class SlabInvariantReport
+{
+public:
+	unsigned long long elements_checked;
+	unsigned long long violations;
+	std::vector<std::string> messages;
+
+public:
+	SlabInvariantReport() : elements_checked(0), violations(0) {}
+	bool Valid() const { return violations == 0; }
+};
+
+// default of SlabMesh::validate_interval, set by debug and CI builds
+#ifndef QMAT_SLAB_VALIDATE_INTERVAL
+#define QMAT_SLAB_VALIDATE_INTERVAL 0
+#endif
+
 class SlabVertex : public PrimVertex, public SlabPrim
 {
 public:
@@ -27,6 +63,10 @@ public:
 	bool is_non_manifold;
 	bool is_disk;
 	bool is_boundary;
+	bool on_symmetry_plane;
+	BoundarySampleList bpsamples;
+
+	SlabVertex() : on_symmetry_plane(false) {}
 };
 
 class SlabEdge : public PrimEdge, public SlabPrim
@@ -37,6 +77,34 @@ class SlabFace : public PrimFace, public SlabPrim
 {
 };
 
+// one change of an open collapse to an element that existed before it
+class SlabUndoRecord
+{
+public:
+	enum Type
+	{
+		VERTEX_EDGE_ADD,
+		VERTEX_EDGE_REMOVE,
+		VERTEX_FACE_ADD,
+		VERTEX_FACE_REMOVE,
+		EDGE_FACE_ADD,
+		EDGE_FACE_REMOVE,
+		BOUNDARY_EDGE_REMOVE,
+		FAKE_BOUNDARY_SET,	// flag is the previous fake_boundary_vertex
+		VERTEX_RETIRE,
+		EDGE_RETIRE,
+		FACE_RETIRE
+	};
+
+	unsigned char type;
+	bool flag;
+	unsigned owner;
+	unsigned id;
+
+public:
+	SlabUndoRecord(unsigned char t, unsigned o, unsigned i, bool f) : type(t), flag(f), owner(o), id(i) {}
+};
+
 typedef std::pair<bool, SlabVertex*> Bool_SlabVertexPointer;
 typedef std::pair<bool, SlabEdge*> Bool_SlabEdgePointer;
 typedef std::pair<bool, SlabFace*> Bool_SlabFacePointer;
@@ -86,8 +154,26 @@ public:
 
 	double bound_weight;
 
+public:
+	SlabMesh() : spatial_order_export(false), collapse_trace(NULL),
+		bplist_limit(0), bplist_tolerance(0.05), bplist_check(false), bplist_bound_costs(0),
+		bplist_exact_costs(0), bplist_checked_costs(0), bplist_max_cost_error(0.), bplist_sum_cost_error(0.),
+		collapse_open(false), collapse_rollbacks(0), skeleton_penalty(0.), face_removal_penalty(0.), skeleton_capsules(0),
+		max_collapse_cost(DBL_MAX), symmetry_plane_set(false), symmetry_offset(0.),
+		validate_interval(QMAT_SLAB_VALIDATE_INTERVAL), validation_runs(0), collapses_since_validation(0) {}
+
 public:
 	void AdjustStorage();
+	void RemapStorage(const std::vector<unsigned> & newv, const std::vector<unsigned> & newe, const std::vector<unsigned> & newf);
+	void SpatialReorder();
+
+	// renumber along the Morton curve instead of compacting in index order on export
+	bool spatial_order_export;
+
+	// when set, every collapse done by Simplify is appended to the trace
+	CollapseTrace * collapse_trace;
+	// reapply a recorded collapse, topology and sphere only, no cost evaluation
+	bool ReplayCollapse(const CollapseRecord & rec);
 
 public:
 	bool ValidVertex(unsigned vid);
@@ -103,7 +189,7 @@ public:
 	void GetLinkedEdges(unsigned eid, std::set<unsigned> & neighboredges);
 	void GetAdjacentFaces(unsigned fid, std::set<unsigned> & neighborfaces);
 	bool Contractible(unsigned vid_src, unsigned vid_tgt);
-	bool Contractible(unsigned vid_src1, unsigned vid_src2, Vector3d &v_tgt);
+	bool Contractible(unsigned vid_src1, unsigned vid_src2, const Vector3d &v_tgt);
 	bool MergeVertices(unsigned vid_src1, unsigned vid_src2, unsigned &vid_tgt);
 
 	unsigned VertexIncidentEdgeCount(unsigned vid);
@@ -128,6 +214,12 @@ public:
 	void ComputeFaceSimpleTriangles(unsigned fid);
 	void ComputeFacesSimpleTriangles();
 
+public:
+	// read a .ma stream, centers and radii divided by scale
+	void LoadMA(std::istream & mastream, double scale);
+	// slab quadrics of the vertices and the boundary preservation, before initCollapseQueue
+	void InitialQuadrics();
+
 public:
 	void initBoundaryCollapseQueue();
 	void initCollapseQueue();
@@ -139,6 +231,89 @@ public:
 	void EvaluateEdgeHausdorffCost(unsigned eid);
 	void ReEvaluateEdgeHausdorffCost(unsigned eid);
 
+	// Bounded boundary samples. With bplist_limit > 0 the bplist of a vertex keeps
+	// at most that many representatives, chosen by farthest point sampling, and
+	// bpsamples.cover bounds the distance of the other samples to them. The
+	// complete lists stay as linked lists over the input samples, so merging two
+	// vertices is a splice. A Hausdorff cost is bounded from the representatives,
+	// the upper bound is used when it is within bplist_tolerance of the lower one,
+	// otherwise the complete lists are walked and the representatives rebuilt.
+	unsigned bplist_limit;
+	double bplist_tolerance;
+	bool bplist_check;	// also evaluate every bounded cost on the complete lists
+	unsigned long long bplist_bound_costs;
+	unsigned long long bplist_exact_costs;
+	unsigned long long bplist_checked_costs;
+	double bplist_max_cost_error;
+	double bplist_sum_cost_error;
+	std::vector<unsigned> bplist_next;
+	// build the complete lists from the filled bplists and reduce them
+	void LimitBoundarySamples();
+	void ReduceBoundarySamples(unsigned vid);
+	void RebuildBoundarySamples(unsigned vid);
+	void AppendBoundarySample(BoundarySampleList & list, unsigned sample);
+	BoundarySampleList JoinBoundarySamples(const BoundarySampleList & a, const BoundarySampleList & b);
+	void CollectBoundarySamples(const BoundarySampleList & list, std::set<unsigned> & samples);
+	// Hausdorff update of an interior collapse in bounded mode, samples is the
+	// splice of the lists of the merged vertices and representatives their union
+	void ReassignBoundarySamples(unsigned vid_tgt, const BoundarySampleList & samples, const std::set<unsigned> & representatives);
+	// max of | |p - c| - r | over the boundary samples p of both vertices
+	double BoundarySampleCost(unsigned v1, unsigned v2, const Wm4::Vector4d & lamdar);
+
+	// Speculative collapses. While a collapse is open the changes of the existing
+	// elements are logged and deleted elements are only retired, they keep their
+	// data until the commit. With prevent_inversion a merge is built once, checked
+	// on the retired faces and rolled back when it folds one.
+	bool collapse_open;
+	unsigned collapse_rollbacks;
+	std::vector<SlabUndoRecord> undo_log;
+	unsigned collapse_saved_vertices, collapse_saved_edges, collapse_saved_faces;
+	unsigned collapse_num_vertices, collapse_num_edges, collapse_num_faces;
+	void BeginCollapse();
+	void CommitCollapse();
+	void RollbackCollapse();
+	void LogUndo(unsigned char type, unsigned owner, unsigned id = 0, bool flag = false);
+	bool CollapseKeepsOrientation(unsigned vid_src1, unsigned vid_src2, const Vector3d & v_tgt);
+
+	// Curve skeleton mode. face_removal_penalty is added to the cost of every edge
+	// without faces, so the faces collapse first and the mesh is driven toward a
+	// graph of cones. initCollapseQueue sets it to skeleton_penalty times the
+	// largest initial collapse cost, whatever the scale of the costs. Simplify
+	// stops once no face is left and at most skeleton_capsules edges remain, and
+	// in any mode when the cheapest collapse costs more than max_collapse_cost,
+	// not counting the penalty.
+	double skeleton_penalty;
+	double face_removal_penalty;
+	unsigned skeleton_capsules;
+	double max_collapse_cost;
+
+	// Simplification of one half of a mirror symmetric mesh. A collapse that
+	// touches a vertex on the plane stands for the mirrored pair of collapses of
+	// the full mesh, its sphere is kept on the plane; so is a sphere that would
+	// cross to the other side. SetSymmetryPlane snaps the vertices within band
+	// onto the plane and returns their number, call it before LoadSlabMesh.
+	bool symmetry_plane_set;
+	Vector3d symmetry_normal;
+	double symmetry_offset;
+	unsigned SetSymmetryPlane(const Vector3d & normal, double offset, double band);
+	bool SymmetryConstrained(unsigned v1, unsigned v2, const Vector3d & center) const;
+	// the fallback spheres of a constrained collapse are costed on the plane
+	void ProjectOntoSymmetryPlane(unsigned v1, unsigned v2, Sphere & sphere) const;
+
+	// Consistency checks for changes to the topology code. ValidateInvariants
+	// checks the adjacency in both directions, the element counts, duplicate
+	// edges and faces, finite spheres and the ownership of the boundary samples;
+	// the element passes run in parallel. With validate_interval > 0 Simplify
+	// validates after that many collapses. A check visits every live element, so
+	// intervals well below a tenth of the element count dominate the run time. It
+	// stops at the first violation and leaves it in validation_report.
+	unsigned validate_interval;
+	unsigned validation_runs;
+	unsigned collapses_since_validation;
+	SlabInvariantReport validation_report;
+	bool ValidateInvariants(SlabInvariantReport & report) const;
+	bool ValidationCheckpoint(bool force);
+
 public: 
 	void DistinguishVertexType();
 	unsigned GetSavedPointNumber();
@@ -146,6 +321,15 @@ public:
 	void InsertSavedPoint(unsigned vid);
 	double NearestPoint(Vector3d point, unsigned vid);
 
+public:
+	// input surface samples, defined in SlabMeshInput.cpp so that the
+	// simplifier compiles without the CGAL headers of Mesh.h
+	unsigned InputNumVertices() const;
+	Vector3d InputVertex(unsigned i) const;
+	double InputDiagonal() const;
+	double & InputHausdorffDist(unsigned i);
+	unsigned & InputHausdorffIndex(unsigned i);
+
 public:
 	void PreservBoundaryMethodOne();
 	void PreservBoundaryMethodTwo();
@@ -161,6 +345,7 @@ public:
 
 	void ExportSimplifyResult();
 	void Export(string fname);
+	void Export(std::ostream & fout);
 
 public:
 	void clear();
@@ -0,0 +1,27 @@
+#include "SlabMesh.h"
+#include "Mesh.h"
+
+unsigned SlabMesh::InputNumVertices() const
+{
+	return (unsigned)pmesh->pVertexList.size();
+}
+
+Vector3d SlabMesh::InputVertex(unsigned i) const
+{
+	return to_wm4(pmesh->pVertexList[i]->point());
+}
+
+double SlabMesh::InputDiagonal() const
+{
+	return pmesh->bb_diagonal_length;
+}
+
+double & SlabMesh::InputHausdorffDist(unsigned i)
+{
+	return pmesh->pVertexList[i]->slab_hausdorff_dist;
+}
+
+unsigned & SlabMesh::InputHausdorffIndex(unsigned i)
+{
+	return pmesh->pVertexList[i]->slab_hansdorff_index;
+}
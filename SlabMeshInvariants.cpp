@@ -0,0 +1,232 @@
+#include "SlabMesh.h"
+
+#include <sstream>
+
+// messages kept in a report
+static const size_t slab_invariant_messages = 16;
+
+// violations of one pass, merged into the report in element order
+class SlabInvariantLog
+{
+public:
+	unsigned long long violations;
+	std::vector<std::pair<unsigned, std::string> > messages;
+
+public:
+	SlabInvariantLog() : violations(0) {}
+
+	void Add(unsigned order, const std::string & message)
+	{
+		violations ++;
+		if (messages.size() < slab_invariant_messages)
+			messages.push_back(std::make_pair(order, message));
+	}
+};
+
+static std::string SlabMessage(const char * element, unsigned id, const std::string & what)
+{
+	std::ostringstream out;
+	out << element << " " << id << ": " << what;
+	return out.str();
+}
+
+static bool SlabFinite(double x)
+{
+	return x == x && x - x == 0.0;
+}
+
+bool SlabMesh::ValidateInvariants(SlabInvariantReport & report) const
+{
+	report = SlabInvariantReport();
+	SlabInvariantLog log;
+	unsigned nv = (unsigned)vertices.size(), ne = (unsigned)edges.size(), nf = (unsigned)faces.size();
+	unsigned live_vertices = 0, live_edges = 0, live_faces = 0;
+
+	if (collapse_open)
+		log.Add(0, "a collapse is still open");
+
+#pragma omp parallel
+	{
+		SlabInvariantLog local;
+		unsigned lv = 0, le = 0, lf = 0;
+
+#pragma omp for schedule(dynamic, 1024) nowait
+		for (int i = 0; i < (int)nv; i++)
+		{
+			if (!vertices[i].first)
+				continue;
+			lv++;
+			const SlabVertex * v = vertices[i].second;
+			if (v == NULL)
+			{
+				local.Add(i, SlabMessage("vertex", i, "live without data"));
+				continue;
+			}
+			const Sphere & s = v->sphere;
+			if (!SlabFinite(s.center[0]) || !SlabFinite(s.center[1]) || !SlabFinite(s.center[2]) || !SlabFinite(s.radius) || s.radius < 0.0)
+				local.Add(i, SlabMessage("vertex", i, "sphere is not finite or has a negative radius"));
+			for (std::set<unsigned>::const_iterator it = v->edges_.begin(); it != v->edges_.end(); ++it)
+				if (*it >= ne || !edges[*it].first)
+					local.Add(i, SlabMessage("vertex", i, "lists a dead edge"));
+				else if (edges[*it].second->vertices_.first != (unsigned)i && edges[*it].second->vertices_.second != (unsigned)i)
+					local.Add(i, SlabMessage("vertex", i, "lists an edge that does not end at it"));
+			for (std::set<unsigned>::const_iterator it = v->faces_.begin(); it != v->faces_.end(); ++it)
+				if (*it >= nf || !faces[*it].first)
+					local.Add(i, SlabMessage("vertex", i, "lists a dead face"));
+				else if (faces[*it].second->vertices_.count(i) == 0)
+					local.Add(i, SlabMessage("vertex", i, "lists a face that does not contain it"));
+		}
+
+#pragma omp for schedule(dynamic, 1024) nowait
+		for (int i = 0; i < (int)ne; i++)
+		{
+			if (!edges[i].first)
+				continue;
+			le++;
+			const SlabEdge * e = edges[i].second;
+			if (e == NULL)
+			{
+				local.Add(nv + i, SlabMessage("edge", i, "live without data"));
+				continue;
+			}
+			unsigned a = e->vertices_.first, b = e->vertices_.second;
+			if (a == b)
+				local.Add(nv + i, SlabMessage("edge", i, "is a loop"));
+			if (a >= nv || b >= nv || !vertices[a].first || !vertices[b].first)
+			{
+				local.Add(nv + i, SlabMessage("edge", i, "ends at a dead vertex"));
+				continue;
+			}
+			if (vertices[a].second->edges_.count(i) == 0 || vertices[b].second->edges_.count(i) == 0)
+				local.Add(nv + i, SlabMessage("edge", i, "is missing from the edge list of a vertex"));
+			for (std::set<unsigned>::const_iterator it = e->faces_.begin(); it != e->faces_.end(); ++it)
+				if (*it >= nf || !faces[*it].first)
+					local.Add(nv + i, SlabMessage("edge", i, "lists a dead face"));
+				else if (faces[*it].second->edges_.count(i) == 0 || faces[*it].second->vertices_.count(a) == 0
+					|| faces[*it].second->vertices_.count(b) == 0)
+					local.Add(nv + i, SlabMessage("edge", i, "lists a face that is not bounded by it"));
+		}
+
+#pragma omp for schedule(dynamic, 1024) nowait
+		for (int i = 0; i < (int)nf; i++)
+		{
+			if (!faces[i].first)
+				continue;
+			lf++;
+			const SlabFace * f = faces[i].second;
+			if (f == NULL)
+			{
+				local.Add(nv + ne + i, SlabMessage("face", i, "live without data"));
+				continue;
+			}
+			if (f->vertices_.size() != 3 || f->edges_.size() != 3)
+				local.Add(nv + ne + i, SlabMessage("face", i, "does not have three vertices and three edges"));
+			for (std::set<unsigned>::const_iterator it = f->vertices_.begin(); it != f->vertices_.end(); ++it)
+				if (*it >= nv || !vertices[*it].first)
+					local.Add(nv + ne + i, SlabMessage("face", i, "uses a dead vertex"));
+				else if (vertices[*it].second->faces_.count(i) == 0)
+					local.Add(nv + ne + i, SlabMessage("face", i, "is missing from the face list of a vertex"));
+			for (std::set<unsigned>::const_iterator it = f->edges_.begin(); it != f->edges_.end(); ++it)
+				if (*it >= ne || !edges[*it].first)
+					local.Add(nv + ne + i, SlabMessage("face", i, "uses a dead edge"));
+				else if (edges[*it].second->faces_.count(i) == 0)
+					local.Add(nv + ne + i, SlabMessage("face", i, "is missing from the face list of an edge"));
+		}
+
+#pragma omp critical
+		{
+			log.violations += local.violations;
+			log.messages.insert(log.messages.end(), local.messages.begin(), local.messages.end());
+			live_vertices += lv;
+			live_edges += le;
+			live_faces += lf;
+		}
+	}
+
+	if (live_vertices != numVertices || live_edges != numEdges || live_faces != numFaces)
+	{
+		std::ostringstream out;
+		out << "counts " << numVertices << "/" << numEdges << "/" << numFaces << " but "
+			<< live_vertices << "/" << live_edges << "/" << live_faces << " live elements";
+		log.Add(0, out.str());
+	}
+
+	// one edge per vertex pair and one face per vertex triple
+	std::vector<std::pair<std::pair<unsigned, unsigned>, unsigned> > pairs;
+	pairs.reserve(live_edges);
+	for (unsigned i = 0; i < ne; i++)
+		if (edges[i].first && edges[i].second != NULL)
+			pairs.push_back(std::make_pair(std::make_pair(std::min(edges[i].second->vertices_.first, edges[i].second->vertices_.second),
+				std::max(edges[i].second->vertices_.first, edges[i].second->vertices_.second)), i));
+	std::sort(pairs.begin(), pairs.end());
+	for (size_t k = 1; k < pairs.size(); k++)
+		if (pairs[k].first == pairs[k - 1].first)
+			log.Add(nv + pairs[k].second, SlabMessage("edge", pairs[k].second, "duplicates another edge"));
+	std::vector<std::pair<std::vector<unsigned>, unsigned> > triples;
+	triples.reserve(live_faces);
+	for (unsigned i = 0; i < nf; i++)
+		if (faces[i].first && faces[i].second != NULL)
+			triples.push_back(std::make_pair(std::vector<unsigned>(faces[i].second->vertices_.begin(), faces[i].second->vertices_.end()), i));
+	std::sort(triples.begin(), triples.end());
+	for (size_t k = 1; k < triples.size(); k++)
+		if (triples[k].first == triples[k - 1].first)
+			log.Add(nv + ne + triples[k].second, SlabMessage("face", triples[k].second, "duplicates another face"));
+
+	// every sample belongs to one vertex, in bounded mode the complete lists hold
+	// each sample once and contain the representatives
+	if (pmesh != NULL && (compute_hausdorff || bplist_limit > 0))
+	{
+		unsigned ns = InputNumVertices();
+		std::vector<unsigned> owner(ns, bplist_end), list_owner(ns, bplist_end);
+		for (unsigned i = 0; i < nv; i++)
+		{
+			if (!vertices[i].first || vertices[i].second == NULL)
+				continue;
+			const SlabVertex * v = vertices[i].second;
+			for (std::set<unsigned>::const_iterator it = v->bplist.begin(); it != v->bplist.end(); ++it)
+				if (*it >= ns)
+					log.Add(i, SlabMessage("vertex", i, "lists a sample that does not exist"));
+				else if (owner[*it] != bplist_end)
+					log.Add(i, SlabMessage("vertex", i, "lists a sample of another vertex"));
+				else
+					owner[*it] = i;
+			if (bplist_limit == 0)
+				continue;
+
+			unsigned count = 0, last = bplist_end;
+			for (unsigned s = v->bpsamples.head; s != bplist_end; s = bplist_next[s])
+			{
+				if (s >= ns || s >= bplist_next.size() || list_owner[s] != bplist_end)
+				{
+					log.Add(i, SlabMessage("vertex", i, "sample list is broken or shared"));
+					break;
+				}
+				list_owner[s] = i;
+				last = s;
+				count++;
+			}
+			if (count != v->bpsamples.count || last != v->bpsamples.tail)
+				log.Add(i, SlabMessage("vertex", i, "sample list does not match its count or tail"));
+			for (std::set<unsigned>::const_iterator it = v->bplist.begin(); it != v->bplist.end(); ++it)
+				if (*it < ns && list_owner[*it] != i)
+					log.Add(i, SlabMessage("vertex", i, "representative is not in its sample list"));
+		}
+	}
+
+	std::sort(log.messages.begin(), log.messages.end());
+	report.elements_checked = (unsigned long long)live_vertices + live_edges + live_faces;
+	report.violations = log.violations;
+	for (size_t k = 0; k < log.messages.size() && k < slab_invariant_messages; k++)
+		report.messages.push_back(log.messages[k].second);
+	return report.Valid();
+}
+
+bool SlabMesh::ValidationCheckpoint(bool force)
+{
+	collapses_since_validation++;
+	if (!force && collapses_since_validation < validate_interval)
+		return true;
+	collapses_since_validation = 0;
+	validation_runs++;
+	return ValidateInvariants(validation_report);
+}
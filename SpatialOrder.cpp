@@ -0,0 +1,127 @@
+#include "SpatialOrder.h"
+
+#include <algorithm>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// spread the lower 21 bits of v so that there are two zero bits between each
+static inline unsigned long long SplitBy3(unsigned long long v)
+{
+	v &= 0x1fffffULL;
+	v = (v | v << 32) & 0x1f00000000ffffULL;
+	v = (v | v << 16) & 0x1f0000ff0000ffULL;
+	v = (v | v << 8) & 0x100f00f00f00f00fULL;
+	v = (v | v << 4) & 0x10c30c30c30c30c3ULL;
+	v = (v | v << 2) & 0x1249249249249249ULL;
+	return v;
+}
+
+unsigned long long MortonCode(const Wm4::Vector3d & p, const double mn[3], const double mx[3])
+{
+	unsigned long long c[3];
+	for(int d = 0; d < 3; d ++)
+	{
+		double ext = mx[d] - mn[d];
+		double t = ext > 0 ? (p[d] - mn[d]) / ext : 0.;
+		t = std::min(std::max(t, 0.), 1.);
+		c[d] = (unsigned long long)(t * 2097151.);
+	}
+	return SplitBy3(c[0]) | (SplitBy3(c[1]) << 1) | (SplitBy3(c[2]) << 2);
+}
+
+void RadixSortIndices(const std::vector<unsigned long long> & keys, std::vector<unsigned> & order)
+{
+	int n = (int)keys.size();
+	order.resize(n);
+	for(int i = 0; i < n; i ++)
+		order[i] = i;
+	if(n < 2)
+		return;
+
+	unsigned long long diff = 0;
+	for(int i = 1; i < n; i ++)
+		diff |= keys[i] ^ keys[0];
+
+	int nthreads = 1;
+#ifdef _OPENMP
+	nthreads = omp_get_max_threads();
+#endif
+
+	std::vector<unsigned> tmp(n);
+	std::vector<unsigned> hist(256 * nthreads);
+
+	// 8 bits per pass, the passes over bits that are equal in every key are skipped
+	for(int shift = 0; shift < 64; shift += 8)
+	{
+		if(((diff >> shift) & 0xff) == 0)
+			continue;
+
+		std::fill(hist.begin(), hist.end(), 0);
+
+		// every slice is contiguous and scattered in slice order, which keeps the sort stable
+#pragma omp parallel num_threads(nthreads)
+		{
+			int t = 0, nt = 1;
+#ifdef _OPENMP
+			t = omp_get_thread_num();
+			nt = omp_get_num_threads();
+#endif
+			// the runtime may hand out fewer threads than requested
+			for(int s = t; s < nthreads; s += nt)
+			{
+				int begin = (int)((long long)n * s / nthreads);
+				int end = (int)((long long)n * (s + 1) / nthreads);
+				unsigned * h = &hist[256 * s];
+				for(int i = begin; i < end; i ++)
+					h[(keys[order[i]] >> shift) & 0xff] ++;
+			}
+
+#pragma omp barrier
+#pragma omp single
+			{
+				unsigned sum = 0;
+				for(int b = 0; b < 256; b ++)
+					for(int k = 0; k < nthreads; k ++)
+					{
+						unsigned c = hist[256 * k + b];
+						hist[256 * k + b] = sum;
+						sum += c;
+					}
+			}
+
+			for(int s = t; s < nthreads; s += nt)
+			{
+				int begin = (int)((long long)n * s / nthreads);
+				int end = (int)((long long)n * (s + 1) / nthreads);
+				unsigned * h = &hist[256 * s];
+				for(int i = begin; i < end; i ++)
+					tmp[h[(keys[order[i]] >> shift) & 0xff] ++] = order[i];
+			}
+		}
+
+		order.swap(tmp);
+	}
+}
+
+void MortonOrder(const std::vector<Wm4::Vector3d> & points, std::vector<unsigned> & order)
+{
+	int n = (int)points.size();
+
+	double mn[3] = {1e20, 1e20, 1e20};
+	double mx[3] = {-1e20, -1e20, -1e20};
+	for(int i = 0; i < n; i ++)
+		for(int d = 0; d < 3; d ++)
+		{
+			mn[d] = std::min(mn[d], points[i][d]);
+			mx[d] = std::max(mx[d], points[i][d]);
+		}
+
+	std::vector<unsigned long long> keys(n);
+#pragma omp parallel for
+	for(int i = 0; i < n; i ++)
+		keys[i] = MortonCode(points[i], mn, mx);
+
+	RadixSortIndices(keys, order);
+}
@@ -0,0 +1,21 @@
+#ifndef _SPATIALORDER_H
+#define _SPATIALORDER_H
+
+#include <vector>
+
+#include "LinearAlgebra/Wm4Vector.h"
+
+// spatial renumbering helpers for the medial meshes
+// elements are sorted along a Morton (Z-order) curve so that neighbours in
+// space end up close in the element arrays
+
+// 63-bit Morton code of p, 21 bits per axis inside the box [mn, mx]
+unsigned long long MortonCode(const Wm4::Vector3d & p, const double mn[3], const double mx[3]);
+
+// stable LSD radix sort, order receives the indices of keys in ascending key order
+void RadixSortIndices(const std::vector<unsigned long long> & keys, std::vector<unsigned> & order);
+
+// order receives the indices of points along the Morton curve of their bounding box
+void MortonOrder(const std::vector<Wm4::Vector3d> & points, std::vector<unsigned> & order);
+
+#endif // _SPATIALORDER_H
@@ -0,0 +1,416 @@
+#include "Symmetry.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <set>
+
+// at most this many mirrored samples are tested per candidate plane
+static const unsigned symmetry_max_samples = 20000;
+// samples tested between two checks for an early rejection
+static const unsigned symmetry_sample_block = 1024;
+static const unsigned symmetry_no_vertex = 0xffffffffu;
+
+void SymmetryPlane::Reflect(const double p[3], double q[3]) const
+{
+	double d = Distance(p);
+	for(int k = 0; k < 3; k ++)
+		q[k] = p[k] - 2. * d * normal[k];
+}
+
+// triangles of the surface in uniform cells, a triangle is listed in every cell
+// its bounding box overlaps
+class SymmetryGrid
+{
+public:
+	double origin[3];
+	double cell;
+	unsigned dims[3];
+	std::vector<std::pair<unsigned, unsigned> > entries;	// cell, triangle, sorted
+
+	unsigned Coordinate(double x, int k) const
+	{
+		double c = floor((x - origin[k]) / cell);
+		if(c < 0.)
+			return 0;
+		if(c >= dims[k])
+			return dims[k] - 1;
+		return (unsigned)c;
+	}
+
+	unsigned Cell(unsigned x, unsigned y, unsigned z) const { return (z * dims[1] + y) * dims[0] + x; }
+};
+
+static void FanTriangles(const IndexedMesh & mesh, std::vector<unsigned> & triangles)
+{
+	triangles.clear();
+	for(unsigned f = 0; f < mesh.NumFaces(); f ++)
+	{
+		const unsigned * idx = &mesh.face_index[mesh.face_offset[f]];
+		for(unsigned k = 1; k + 1 < mesh.FaceDegree(f); k ++)
+		{
+			Vector3d e = (mesh.Position(idx[k]) - mesh.Position(idx[0])).Cross(mesh.Position(idx[k + 1]) - mesh.Position(idx[0]));
+			// ProjectOntoTriangle needs a normal
+			if(e.Length() == 0.)
+				continue;
+			triangles.push_back(idx[0]);
+			triangles.push_back(idx[k]);
+			triangles.push_back(idx[k + 1]);
+		}
+	}
+}
+
+// distance of p to the surface when it is below limit, limit otherwise
+static double SurfaceDistance(const IndexedMesh & mesh, const std::vector<unsigned> & triangles,
+							  const SymmetryGrid & grid, const Vector3d & p, double limit)
+{
+	unsigned lo[3], hi[3];
+	for(int k = 0; k < 3; k ++)
+	{
+		lo[k] = grid.Coordinate(p[k] - limit, k);
+		hi[k] = grid.Coordinate(p[k] + limit, k);
+	}
+	double best = limit;
+	for(unsigned z = lo[2]; z <= hi[2]; z ++)
+		for(unsigned y = lo[1]; y <= hi[1]; y ++)
+			for(unsigned x = lo[0]; x <= hi[0]; x ++)
+			{
+				unsigned c = grid.Cell(x, y, z);
+				std::vector<std::pair<unsigned, unsigned> >::const_iterator it =
+					std::lower_bound(grid.entries.begin(), grid.entries.end(), std::make_pair(c, 0u));
+				for(; it != grid.entries.end() && it->first == c; ++ it)
+				{
+					const unsigned * t = &triangles[3 * it->second];
+					Vector3d fp;
+					double dist;
+					ProjectOntoTriangle(p, mesh.Position(t[0]), mesh.Position(t[1]), mesh.Position(t[2]), fp, dist);
+					if(dist < best)
+						best = dist;
+				}
+			}
+	return best;
+}
+
+bool DetectReflectiveSymmetry(const IndexedMesh & mesh, double tolerance, SymmetryPlane & plane)
+{
+	plane = SymmetryPlane();
+	unsigned nv = mesh.NumVertices();
+	if(nv == 0)
+		return false;
+
+	std::vector<unsigned> triangles;
+	FanTriangles(mesh, triangles);
+	unsigned nt = (unsigned)triangles.size() / 3;
+	if(nt == 0)
+		return false;
+
+	double mn[3], mx[3];
+	for(int k = 0; k < 3; k ++)
+		mn[k] = mx[k] = mesh.positions[k];
+	for(unsigned i = 1; i < nv; i ++)
+		for(int k = 0; k < 3; k ++)
+		{
+			mn[k] = std::min(mn[k], mesh.positions[3 * i + k]);
+			mx[k] = std::max(mx[k], mesh.positions[3 * i + k]);
+		}
+	double diagonal = (Vector3d(mx[0], mx[1], mx[2]) - Vector3d(mn[0], mn[1], mn[2])).Length();
+	if(diagonal == 0.)
+		return false;
+	double limit = tolerance * diagonal;
+
+	std::vector<unsigned> faces(mesh.NumFaces());
+	for(unsigned f = 0; f < mesh.NumFaces(); f ++)
+		faces[f] = f;
+	double area;
+	Vector3d centroid;
+	Matrix3d covariance;
+	mesh.SurfaceMoments(faces, area, centroid, covariance);
+	if(area == 0.)
+		return false;
+
+	Matrix3d rot, diag;
+	covariance.EigenDecomposition(rot, diag);
+	std::vector<Vector3d> normals;
+	for(int k = 0; k < 3; k ++)
+		normals.push_back(rot.GetColumn(k));
+	// the principal axes are arbitrary when moments coincide (cubes, cylinders),
+	// the coordinate planes cover the usual modelling frame there
+	for(int k = 0; k < 3; k ++)
+	{
+		Vector3d axis(0., 0., 0.);
+		axis[k] = 1.;
+		bool known = false;
+		for(size_t i = 0; i < normals.size(); i ++)
+			if(fabs(normals[i].Dot(axis)) > 1. - 1e-9)
+				known = true;
+		if(!known)
+			normals.push_back(axis);
+	}
+
+	// grid cells no smaller than the search radius
+	SymmetryGrid grid;
+	grid.cell = std::max(std::max(limit, diagonal / 256.), diagonal / (2. * cbrt((double)nt)));
+	for(int k = 0; k < 3; k ++)
+	{
+		grid.origin[k] = mn[k];
+		grid.dims[k] = (unsigned)((mx[k] - mn[k]) / grid.cell) + 1;
+	}
+	for(unsigned t = 0; t < nt; t ++)
+	{
+		unsigned lo[3], hi[3];
+		for(int k = 0; k < 3; k ++)
+		{
+			double a = mesh.positions[3 * triangles[3 * t] + k];
+			double b = mesh.positions[3 * triangles[3 * t + 1] + k];
+			double c = mesh.positions[3 * triangles[3 * t + 2] + k];
+			lo[k] = grid.Coordinate(std::min(a, std::min(b, c)), k);
+			hi[k] = grid.Coordinate(std::max(a, std::max(b, c)), k);
+		}
+		for(unsigned z = lo[2]; z <= hi[2]; z ++)
+			for(unsigned y = lo[1]; y <= hi[1]; y ++)
+				for(unsigned x = lo[0]; x <= hi[0]; x ++)
+					grid.entries.push_back(std::make_pair(grid.Cell(x, y, z), t));
+	}
+	std::sort(grid.entries.begin(), grid.entries.end());
+
+	// vertices and face centroids, thinned out evenly
+	std::vector<Vector3d> samples;
+	unsigned nf = mesh.NumFaces();
+	unsigned stride = (nv + nf) / symmetry_max_samples + 1;
+	for(unsigned i = 0; i < nv; i += stride)
+		samples.push_back(mesh.Position(i));
+	for(unsigned f = 0; f < nf; f += stride)
+	{
+		Vector3d c(0., 0., 0.);
+		for(unsigned k = mesh.face_offset[f]; k < mesh.face_offset[f + 1]; k ++)
+			c += mesh.Position(mesh.face_index[k]);
+		samples.push_back(c / (double)mesh.FaceDegree(f));
+	}
+
+	bool found = false;
+	std::vector<double> dist(samples.size());
+	for(size_t i = 0; i < normals.size(); i ++)
+	{
+		SymmetryPlane candidate;
+		Vector3d n = normals[i];
+		n.Normalize();
+		// same orientation for the same plane
+		int major = 0;
+		for(int k = 1; k < 3; k ++)
+			if(fabs(n[k]) > fabs(n[major]))
+				major = k;
+		if(n[major] < 0.)
+			n = -n;
+		for(int k = 0; k < 3; k ++)
+			candidate.normal[k] = n[k];
+		candidate.offset = n.Dot(centroid);
+		plane.candidates_tested ++;
+
+		bool rejected = false;
+		for(size_t begin = 0; begin < samples.size() && !rejected; begin += symmetry_sample_block)
+		{
+			int end = (int)std::min(samples.size(), begin + symmetry_sample_block);
+#pragma omp parallel for
+			for(int s = (int)begin; s < end; s ++)
+			{
+				double q[3];
+				candidate.Reflect(&samples[s][0], q);
+				dist[s] = SurfaceDistance(mesh, triangles, grid, Vector3d(q[0], q[1], q[2]), limit);
+			}
+			for(int s = (int)begin; s < end; s ++)
+			{
+				if(dist[s] >= limit)
+					rejected = true;
+				candidate.deviation = std::max(candidate.deviation, dist[s]);
+			}
+		}
+		if(rejected || (found && candidate.deviation >= plane.deviation))
+			continue;
+		candidate.candidates_tested = plane.candidates_tested;
+		plane = candidate;
+		found = true;
+	}
+	return found;
+}
+
+static unsigned long long SymmetryEdgeKey(unsigned a, unsigned b)
+{
+	if(a > b)
+		std::swap(a, b);
+	return (unsigned long long)a << 32 | b;
+}
+
+// -1, 0, 1 for below, within and above the band
+static int SymmetrySide(const MedialMeshData & ma, unsigned v, const SymmetryPlane & plane, double band)
+{
+	double d = plane.Distance(&ma.spheres[4 * v]);
+	if(fabs(d) <= band)
+		return 0;
+	return d > 0. ? 1 : -1;
+}
+
+// vertex where the segment a b crosses the plane, a and b on opposite sides,
+// created once per segment
+static unsigned CutVertex(const MedialMeshData & ma, const SymmetryPlane & plane, unsigned a, unsigned b,
+						  std::map<unsigned long long, unsigned> & cuts, MedialMeshData & half, SymmetryClipStats & stats)
+{
+	unsigned long long key = SymmetryEdgeKey(a, b);
+	std::map<unsigned long long, unsigned>::iterator it = cuts.find(key);
+	if(it != cuts.end())
+		return it->second;
+	if(a > b)
+		std::swap(a, b);
+	const double * sa = &ma.spheres[4 * a];
+	const double * sb = &ma.spheres[4 * b];
+	double da = plane.Distance(sa), db = plane.Distance(sb);
+	double t = da / (da - db);
+	double c[4];
+	for(int k = 0; k < 4; k ++)
+		c[k] = sa[k] + t * (sb[k] - sa[k]);
+	double d = plane.Distance(c);
+	for(int k = 0; k < 3; k ++)
+		c[k] -= d * plane.normal[k];
+	unsigned v = half.NumVertices();
+	half.spheres.insert(half.spheres.end(), c, c + 4);
+	cuts[key] = v;
+	stats.cut_vertices ++;
+	stats.on_plane ++;
+	return v;
+}
+
+void ClipToHalf(const MedialMeshData & ma, const SymmetryPlane & plane, double band,
+				MedialMeshData & half, SymmetryClipStats & stats)
+{
+	half.clear();
+	stats = SymmetryClipStats();
+	unsigned nv = ma.NumVertices();
+
+	std::vector<int> side(nv);
+	std::vector<unsigned> map(nv, symmetry_no_vertex);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		side[i] = SymmetrySide(ma, i, plane, band);
+		if(side[i] < 0)
+		{
+			stats.dropped ++;
+			continue;
+		}
+		const double * s = &ma.spheres[4 * i];
+		double c[4] = { s[0], s[1], s[2], s[3] };
+		if(side[i] == 0)
+		{
+			double d = plane.Distance(s);
+			for(int k = 0; k < 3; k ++)
+				c[k] -= d * plane.normal[k];
+			stats.snapped ++;
+			stats.on_plane ++;
+		}
+		map[i] = half.NumVertices();
+		half.spheres.insert(half.spheres.end(), c, c + 4);
+	}
+
+	std::map<unsigned long long, unsigned> cuts;
+
+	std::set<unsigned long long> edge_keys;
+	for(unsigned e = 0; e < ma.NumEdges(); e ++)
+	{
+		unsigned a = ma.edges[2 * e], b = ma.edges[2 * e + 1];
+		if(side[a] < 0 && side[b] < 0)
+			continue;
+		unsigned u, w;
+		if(side[a] >= 0 && side[b] >= 0)
+		{
+			u = map[a];
+			w = map[b];
+		}
+		else if(side[a] > 0 || side[b] > 0)
+		{
+			u = map[side[a] > 0 ? a : b];
+			w = CutVertex(ma, plane, a, b, cuts, half, stats);
+		}
+		else
+			continue;	// from the plane to the other side, the mirror of a kept edge
+		if(edge_keys.insert(SymmetryEdgeKey(u, w)).second)
+		{
+			half.edges.push_back(u);
+			half.edges.push_back(w);
+		}
+	}
+
+	std::set<std::vector<unsigned> > face_keys;
+	for(unsigned f = 0; f < ma.NumFaces(); f ++)
+	{
+		const unsigned * t = &ma.faces[3 * f];
+		bool positive = side[t[0]] > 0 || side[t[1]] > 0 || side[t[2]] > 0;
+		bool negative = side[t[0]] < 0 || side[t[1]] < 0 || side[t[2]] < 0;
+		if(negative && !positive)
+			continue;
+		// clipped polygon, three or four vertices
+		std::vector<unsigned> poly;
+		for(int k = 0; k < 3; k ++)
+		{
+			unsigned a = t[k], b = t[(k + 1) % 3];
+			if(side[a] >= 0)
+				poly.push_back(map[a]);
+			if(side[a] * side[b] < 0)
+				poly.push_back(CutVertex(ma, plane, a, b, cuts, half, stats));
+		}
+		for(size_t k = 1; k + 1 < poly.size(); k ++)
+		{
+			unsigned tri[3] = { poly[0], poly[k], poly[k + 1] };
+			if(tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2])
+				continue;
+			std::vector<unsigned> key(tri, tri + 3);
+			std::sort(key.begin(), key.end());
+			if(!face_keys.insert(key).second)
+				continue;
+			half.faces.insert(half.faces.end(), tri, tri + 3);
+			for(int j = 0; j < 3; j ++)
+				if(edge_keys.insert(SymmetryEdgeKey(tri[j], tri[(j + 1) % 3])).second)
+				{
+					half.edges.push_back(tri[j]);
+					half.edges.push_back(tri[(j + 1) % 3]);
+				}
+		}
+	}
+}
+
+void MirrorHalf(const MedialMeshData & half, const SymmetryPlane & plane, double band, MedialMeshData & full)
+{
+	full = half;
+	unsigned nv = half.NumVertices();
+	std::vector<unsigned> mirror(nv);
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		const double * s = &half.spheres[4 * i];
+		if(fabs(plane.Distance(s)) <= band)
+		{
+			mirror[i] = i;
+			continue;
+		}
+		double q[3];
+		plane.Reflect(s, q);
+		mirror[i] = full.NumVertices();
+		full.spheres.insert(full.spheres.end(), q, q + 3);
+		full.spheres.push_back(s[3]);
+	}
+	for(unsigned e = 0; e < half.NumEdges(); e ++)
+	{
+		unsigned a = half.edges[2 * e], b = half.edges[2 * e + 1];
+		if(mirror[a] == a && mirror[b] == b)
+			continue;
+		full.edges.push_back(mirror[a]);
+		full.edges.push_back(mirror[b]);
+	}
+	for(unsigned f = 0; f < half.NumFaces(); f ++)
+	{
+		const unsigned * t = &half.faces[3 * f];
+		if(mirror[t[0]] == t[0] && mirror[t[1]] == t[1] && mirror[t[2]] == t[2])
+			continue;
+		// reflection flips the orientation
+		full.faces.push_back(mirror[t[0]]);
+		full.faces.push_back(mirror[t[2]]);
+		full.faces.push_back(mirror[t[1]]);
+	}
+}
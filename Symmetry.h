@@ -0,0 +1,55 @@
+#ifndef _SYMMETRY_H
+#define _SYMMETRY_H
+
+#include "IndexedMesh.h"
+#include "MedialChunks.h"
+
+// mirror plane normal . x = offset, the normal has unit length
+class SymmetryPlane
+{
+public:
+	double normal[3];
+	double offset;
+	double deviation;	// largest distance of a mirrored sample to the surface
+	unsigned candidates_tested;
+
+public:
+	SymmetryPlane() : offset(0.), deviation(0.), candidates_tested(0) { normal[0] = 1.; normal[1] = normal[2] = 0.; }
+
+	double Distance(const double p[3]) const { return normal[0] * p[0] + normal[1] * p[1] + normal[2] * p[2] - offset; }
+	void Reflect(const double p[3], double q[3]) const;
+};
+
+// Planar reflective symmetry of the input surface.
+// The candidates are the three principal planes of the area weighted surface
+// moments and the coordinate planes through the centroid. A candidate is
+// verified by mirroring the vertices and face centroids and measuring their
+// distance to the surface on a triangle grid; it is accepted when no sample is
+// farther than tolerance * bounding box diagonal. Of the accepted candidates
+// the one with the smallest deviation wins. False when none is accepted.
+bool DetectReflectiveSymmetry(const IndexedMesh & mesh, double tolerance, SymmetryPlane & plane);
+
+// counts of the last ClipToHalf
+class SymmetryClipStats
+{
+public:
+	unsigned snapped;		// spheres within the band, moved onto the plane
+	unsigned cut_vertices;	// spheres interpolated where an edge crosses the plane
+	unsigned dropped;		// spheres on the negative side
+	unsigned on_plane;		// vertices of the half that lie on the plane
+
+public:
+	SymmetryClipStats() : snapped(0), cut_vertices(0), dropped(0), on_plane(0) {}
+};
+
+// Keeps the part of a medial mesh on the positive side of the plane. Sphere
+// centers closer than band are snapped onto it, cones and slabs that cross it
+// are cut there, the sphere of a cut vertex is interpolated along the edge.
+void ClipToHalf(const MedialMeshData & ma, const SymmetryPlane & plane, double band,
+				MedialMeshData & half, SymmetryClipStats & stats);
+
+// Half plus its mirror image, vertices within band of the plane are shared,
+// elements lying in the plane are stored once.
+void MirrorHalf(const MedialMeshData & half, const SymmetryPlane & plane, double band, MedialMeshData & full);
+
+#endif // _SYMMETRY_H
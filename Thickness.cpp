@@ -0,0 +1,223 @@
+#include "Thickness.h"
+#include "EnvelopeExport.h"
+#include "MedialProximity.h"
+#include "GeometryObjects/GeometryObjects.h"
+
+#include <fstream>
+#include <iomanip>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+// element distance to p and the interpolated radius where its envelope is closest
+static double ElementDistance(const MedialPrimitiveTree & tree, unsigned e, const Vector3d & p, double & radius)
+{
+	Vector3d c[3];
+	double r[3];
+	tree.Element(e, c, r);
+	if(tree.elements[e].type == MedialElement::SPHERE)
+	{
+		radius = r[0];
+		return (p - c[0]).Length() - r[0];
+	}
+	if(tree.elements[e].type == MedialElement::CONE)
+		return ConeDistance(p, c[0], r[0], c[1], r[1], radius);
+	return SlabDistance(p, c, r, radius);
+}
+
+// collects the elements within tolerance of the closest one found so far
+static void ThicknessSearch(const MedialPrimitiveTree & tree, unsigned node, const double p[3], double tolerance, double & best,
+							std::vector<std::pair<double, std::pair<double, unsigned> > > & found)
+{
+	const MedialPrimitiveTree::Node & n = tree.nodes[node];
+	if(n.LowerBound(p) > best + tolerance)
+		return;
+	if(n.child == 0)
+	{
+		Vector3d q(p[0], p[1], p[2]);
+		for(unsigned i = n.first; i < n.first + n.count; i ++)
+		{
+			double radius;
+			double d = ElementDistance(tree, i, q, radius);
+			if(d <= best + tolerance)
+				found.push_back(std::make_pair(d, std::make_pair(radius, tree.elements[i].type)));
+			best = std::min(best, d);
+		}
+		return;
+	}
+
+	// the nearer child first, it usually tightens the bound for the other one
+	unsigned a = n.child, b = n.child + 1;
+	if(tree.nodes[b].LowerBound(p) < tree.nodes[a].LowerBound(p))
+		std::swap(a, b);
+	ThicknessSearch(tree, a, p, tolerance, best, found);
+	ThicknessSearch(tree, b, p, tolerance, best, found);
+}
+
+// closest envelope distance, and the largest radius within tolerance of it
+static bool ThicknessQuery(const MedialPrimitiveTree & tree, const double p[3], double tolerance, double & radius, unsigned & type)
+{
+	if(tree.nodes.empty())
+		return false;
+	std::vector<std::pair<double, std::pair<double, unsigned> > > found;
+	double best = DBL_MAX;
+	ThicknessSearch(tree, 0, p, tolerance, best, found);
+	radius = -1.;
+	type = ThicknessReport::NONE;
+	for(size_t i = 0; i < found.size(); i ++)
+		if(found[i].first <= best + tolerance && found[i].second.first > radius)
+		{
+			radius = found[i].second.first;
+			type = found[i].second.second;
+		}
+	return type != ThicknessReport::NONE;
+}
+
+bool ThicknessReport::Save(const std::string & filename, std::string & error) const
+{
+	std::ofstream out(filename.c_str());
+	if(!out)
+	{
+		error = "Could not open file " + filename;
+		return false;
+	}
+
+	static const char * primitive_names[4] = {"none", "sphere", "cone", "slab"};
+	out << std::setprecision(9);
+	out << "# thickness report, 2r of the covering medial sphere" << std::endl;
+	out << "vertices " << vertex_thickness.size() << " uncovered " << uncovered << std::endl;
+	out << "thickness min " << min_thickness << " max " << max_thickness << " mean " << mean_thickness << std::endl;
+	out << "histogram " << histogram.size() << " bin_width " << bin_width << std::endl;
+	for(size_t k = 0; k < histogram.size(); k ++)
+		out << "bin " << k * bin_width << " " << (k + 1) * bin_width << " " << histogram[k] << std::endl;
+	out << "threshold " << threshold << " regions " << regions.size() << std::endl;
+	for(size_t k = 0; k < regions.size(); k ++)
+		out << "region " << k << " " << regions[k].vertices << " " << regions[k].min_thickness << " "
+			<< regions[k].thinnest_vertex << " " << regions[k].center[0] << " " << regions[k].center[1] << " "
+			<< regions[k].center[2] << std::endl;
+	for(size_t i = 0; i < vertex_thickness.size(); i ++)
+		out << "v " << vertex_thickness[i] << " " << primitive_names[vertex_primitive[i] & 3] << std::endl;
+
+	if(!out)
+	{
+		error = "Could not write file " + filename;
+		return false;
+	}
+	return true;
+}
+
+static bool RegionThinner(const ThicknessRegion & a, const ThicknessRegion & b)
+{
+	return a.min_thickness < b.min_thickness || (a.min_thickness == b.min_thickness && a.thinnest_vertex < b.thinnest_vertex);
+}
+
+void ComputeThickness(const MedialMeshData & ma, const IndexedMesh & mesh, double tolerance,
+					  double threshold, unsigned bins, ThicknessReport & report)
+{
+	report = ThicknessReport();
+	report.threshold = threshold;
+	unsigned nv = mesh.NumVertices();
+	report.vertex_thickness.assign(nv, -1.);
+	report.vertex_primitive.assign(nv, ThicknessReport::NONE);
+
+	MedialPrimitiveTree tree;
+	tree.Build(ma);
+#pragma omp parallel for schedule(dynamic, 256)
+	for(int i = 0; i < (int)nv; i ++)
+	{
+		double radius;
+		unsigned type;
+		if(ThicknessQuery(tree, &mesh.positions[3 * i], tolerance, radius, type))
+		{
+			report.vertex_thickness[i] = 2. * radius;
+			report.vertex_primitive[i] = (unsigned char)type;
+		}
+	}
+
+	// summary and histogram
+	unsigned covered = 0;
+	double sum = 0.;
+	report.min_thickness = DBL_MAX;
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		double t = report.vertex_thickness[i];
+		if(t < 0.)
+		{
+			report.uncovered ++;
+			continue;
+		}
+		covered ++;
+		sum += t;
+		report.min_thickness = std::min(report.min_thickness, t);
+		report.max_thickness = std::max(report.max_thickness, t);
+	}
+	if(covered == 0)
+		report.min_thickness = 0.;
+	else
+		report.mean_thickness = sum / covered;
+	if(bins > 0 && report.max_thickness > 0.)
+	{
+		report.bin_width = report.max_thickness / bins;
+		report.histogram.assign(bins, 0);
+		for(unsigned i = 0; i < nv; i ++)
+			if(report.vertex_thickness[i] >= 0.)
+				report.histogram[std::min(bins - 1, (unsigned)(report.vertex_thickness[i] / report.bin_width))] ++;
+	}
+
+	// regions, flood fill over the one-rings
+	report.vertex_region.assign(nv, thickness_no_region);
+	if(threshold <= 0. || mesh.vv_offset.size() != nv + 1)
+		return;
+	std::vector<unsigned> stack;
+	for(unsigned i = 0; i < nv; i ++)
+	{
+		double t = report.vertex_thickness[i];
+		if(t < 0. || t >= threshold || report.vertex_region[i] != thickness_no_region)
+			continue;
+		ThicknessRegion region;
+		region.vertices = 0;
+		region.min_thickness = DBL_MAX;
+		region.thinnest_vertex = i;
+		region.center[0] = region.center[1] = region.center[2] = 0.;
+		unsigned id = (unsigned)report.regions.size();
+		report.vertex_region[i] = id;
+		stack.push_back(i);
+		while(!stack.empty())
+		{
+			unsigned v = stack.back();
+			stack.pop_back();
+			region.vertices ++;
+			for(int k = 0; k < 3; k ++)
+				region.center[k] += mesh.positions[3 * v + k];
+			if(report.vertex_thickness[v] < region.min_thickness)
+			{
+				region.min_thickness = report.vertex_thickness[v];
+				region.thinnest_vertex = v;
+			}
+			for(unsigned j = mesh.vv_offset[v]; j < mesh.vv_offset[v + 1]; j ++)
+			{
+				unsigned w = mesh.vv_index[j];
+				double tw = report.vertex_thickness[w];
+				if(tw >= 0. && tw < threshold && report.vertex_region[w] == thickness_no_region)
+				{
+					report.vertex_region[w] = id;
+					stack.push_back(w);
+				}
+			}
+		}
+		for(int k = 0; k < 3; k ++)
+			region.center[k] /= region.vertices;
+		report.regions.push_back(region);
+	}
+
+	// renumber thinnest first
+	std::vector<ThicknessRegion> sorted = report.regions;
+	std::sort(sorted.begin(), sorted.end(), RegionThinner);
+	std::vector<unsigned> rank(report.regions.size());
+	for(unsigned k = 0; k < sorted.size(); k ++)
+		rank[report.vertex_region[sorted[k].thinnest_vertex]] = k;
+	for(unsigned i = 0; i < nv; i ++)
+		if(report.vertex_region[i] != thickness_no_region)
+			report.vertex_region[i] = rank[report.vertex_region[i]];
+	report.regions.swap(sorted);
+}
@@ -0,0 +1,61 @@
+#ifndef _THICKNESS_H
+#define _THICKNESS_H
+
+#include <string>
+#include <vector>
+#include "IndexedMesh.h"
+#include "MedialChunks.h"
+
+// connected vertices of the surface thinner than the threshold
+class ThicknessRegion
+{
+public:
+	unsigned vertices;
+	double min_thickness;
+	unsigned thinnest_vertex;
+	double center[3];	// mean of its vertices
+};
+
+// Wall thickness of the surface read off the medial mesh. A vertex gets the
+// diameter of the medial sphere touching it: every sphere, cone and slab whose
+// envelope passes within tolerance of the closest one covers the vertex, the
+// interpolated sphere of each is taken where its envelope is closest, and the
+// largest of them wins. Smaller touching spheres belong to convex edges and
+// corners, where the medial axis runs into the surface; the largest one is the
+// ball of the opposite wall, like the inward normal ray of a ray cast.
+class ThicknessReport
+{
+public:
+	// the MedialElement types
+	enum Primitive { NONE = 0, SPHERE = 1, CONE = 2, SLAB = 3 };
+
+	std::vector<double> vertex_thickness;	// per vertex, negative when uncovered
+	std::vector<unsigned char> vertex_primitive;
+	double min_thickness;
+	double max_thickness;
+	double mean_thickness;
+	unsigned uncovered;
+
+	double bin_width;
+	std::vector<unsigned> histogram;		// [k * bin_width, (k + 1) * bin_width)
+
+	double threshold;
+	std::vector<unsigned> vertex_region;	// per vertex, thickness_no_region above the threshold
+	std::vector<ThicknessRegion> regions;	// thinnest first
+
+public:
+	ThicknessReport() : min_thickness(0.), max_thickness(0.), mean_thickness(0.), uncovered(0), bin_width(0.), threshold(0.) {}
+
+	// text: summary, histogram, regions, then one line per vertex
+	bool Save(const std::string & filename, std::string & error) const;
+};
+
+const unsigned thickness_no_region = 0xffffffffu;
+
+// the per vertex queries run in parallel on a bounding volume hierarchy of the
+// medial elements; the regions need the vertex adjacency of the mesh,
+// threshold <= 0 finds none
+void ComputeThickness(const MedialMeshData & ma, const IndexedMesh & mesh, double tolerance,
+					  double threshold, unsigned bins, ThicknessReport & report);
+
+#endif // _THICKNESS_H
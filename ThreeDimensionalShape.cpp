@@ -2,7 +2,16 @@
 
 // Note: QString include removed - was unused and prevents CLI build without Qt
 
-void ThreeDimensionalShape::ComputeInputNMM()
+Vector3d ThreeDimensionalShape::DelaunaySample(Vertex_handle_t vh) const
+{
+	Vector3d p = to_wm4(vh->point());
+	unsigned id = vh->info().id;
+	if(3 * id + 2 < input.dt_offset.size())
+		p -= Vector3d(input.dt_offset[3 * id], input.dt_offset[3 * id + 1], input.dt_offset[3 * id + 2]);
+	return p;
+}
+
+void ThreeDimensionalShape::ComputeInputNMM(std::ostream * maout)
 {
 	input_nmm.numVertices = 0;
 	input_nmm.numEdges = 0;
@@ -31,8 +40,13 @@ void ThreeDimensionalShape::ComputeInputNMM()
 	len[3] = sqrt(len[0]*len[0]+len[1]*len[1]+len[2]*len[2]);
 	input_nmm.diameter = len[3];
 
+	input_nmm.BoundaryPoints.clear();
+	input_nmm.BoundaryPoints.reserve(pt->number_of_vertices());
 	for(Finite_vertices_iterator_t fvi = pt->finite_vertices_begin(); fvi != pt->finite_vertices_end(); fvi ++)
-		input_nmm.BoundaryPoints.push_back(SamplePoint(fvi->point()[0], fvi->point()[1], fvi->point()[2]));
+	{
+		Vector3d p = DelaunaySample(fvi);
+		input_nmm.BoundaryPoints.push_back(p[0], p[1], p[2]);
+	}
 
 	int mas_vertex_count(0);
 	//
@@ -55,6 +69,14 @@ void ThreeDimensionalShape::ComputeInputNMM()
 		for(unsigned k = 0; k < 4; k ++)
 			(*bvp.second).bplist.insert(fci->vertex(k)->info().id);
 		(*bvp.second).sphere.radius = pt->TetCircumRadius(pt->tetrahedron(fci));
+		// with perturbed samples the ball touches the nearest original one
+		if(!input.dt_offset.empty())
+		{
+			double radius = DBL_MAX;
+			for(unsigned k = 0; k < 4; k ++)
+				radius = std::min(radius, ((*bvp.second).sphere.center - DelaunaySample(fci->vertex(k))).Length());
+			(*bvp.second).sphere.radius = radius;
+		}
 		//(*bvp.second).sphere.radius = fci->info().dist_center_to_boundary; // make sure that all the spheres are inside the domain
 		//bvp.second->sphere.center = bvp.second->sphere.center;
 		//bvp.second->sphere.radius = bvp.second->sphere.radius;
@@ -214,7 +236,10 @@ void ThreeDimensionalShape::ComputeInputNMM()
 			//slab_mesh.numFaces++;
 		}
 	}
-	input_nmm.Export(input_nmm.meshname);
+	if(maout)
+		input_nmm.Export(*maout);
+	else
+		input_nmm.Export(input_nmm.meshname);
 	
 	input_nmm.numVertices = 0;
 	input_nmm.numEdges = 0;
@@ -232,166 +257,12 @@ void ThreeDimensionalShape::ComputeInputNMM()
 
 void ThreeDimensionalShape::LoadInputNMM(std::string fname){
 	std::ifstream mastream(fname.c_str());
-	NonManifoldMesh newinputnmm;
-	newinputnmm.numVertices = 0;
-	newinputnmm.numEdges = 0;
-	newinputnmm.numFaces = 0;
-	int nv, ne, nf;
-	mastream >> nv >> ne >> nf;
-
-	// slab mesh
-	slab_mesh.numVertices = 0;
-	slab_mesh.numEdges = 0;
-	slab_mesh.numFaces = 0;
+	LoadInputNMM(mastream);
+}
 
-	double len[4];
-	len[0] = input.m_max[0] - input.m_min[0];
-	len[1] = input.m_max[1] - input.m_min[1];
-	len[2] = input.m_max[2] - input.m_min[2];
-	len[3] = sqrt(len[0]*len[0]+len[1]*len[1]+len[2]*len[2]);
-	newinputnmm.diameter = len[3];
+void ThreeDimensionalShape::LoadInputNMM(std::istream & mastream){
 	slab_mesh.bound_weight = 0.1; 
-
-	for(unsigned i = 0; i < input.pVertexList.size(); i ++)
-		newinputnmm.BoundaryPoints.push_back(SamplePoint(
-		input.pVertexList[i]->point()[0],
-		input.pVertexList[i]->point()[1],
-		input.pVertexList[i]->point()[2]
-	));
-
-	for(unsigned i = 0; i < nv; i ++)
-	{
-		char ch;
-		double x,y,z,r;
-		mastream >> ch >> x >> y >> z >> r;
-
-		//Bool_VertexPointer bvp;
-		//bvp.first = true;
-		//bvp.second = new NonManifoldMesh_Vertex;
-		//(*bvp.second).sphere.center[0] = x / input.bb_diagonal_length;
-		//(*bvp.second).sphere.center[1] = y / input.bb_diagonal_length;
-		//(*bvp.second).sphere.center[2] = z / input.bb_diagonal_length;
-		//(*bvp.second).sphere.radius = r / input.bb_diagonal_length;
-		//newinputnmm.vertices.push_back(bvp);
-		//newinputnmm.numVertices ++;
-
-		// handle the slab mesh
-		Bool_SlabVertexPointer bsvp2;
-		bsvp2.first = true;
-		bsvp2.second = new SlabVertex;
-		(*bsvp2.second).sphere.center[0] = x / input.bb_diagonal_length;
-		(*bsvp2.second).sphere.center[1] = y / input.bb_diagonal_length;
-		(*bsvp2.second).sphere.center[2] = z / input.bb_diagonal_length;
-		(*bsvp2.second).sphere.radius = r / input.bb_diagonal_length;
-		(*bsvp2.second).index = slab_mesh.vertices.size();
-		slab_mesh.vertices.push_back(bsvp2);
-		slab_mesh.numVertices ++;
-	}
-
-	for(unsigned i = 0; i < ne; i ++)
-	{
-		char ch;
-		unsigned ver[2];
-		mastream >> ch;
-		mastream >> ver[0];
-		mastream >> ver[1];
-
-		//Bool_EdgePointer bep;
-		//bep.first = true;
-		//bep.second = new NonManifoldMesh_Edge;
-		//(*bep.second).vertices_.first = ver[0];
-		//(*bep.second).vertices_.second = ver[1];
-		//(*newinputnmm.vertices[(*bep.second).vertices_.first].second).edges_.insert(newinputnmm.edges.size());
-		//(*newinputnmm.vertices[(*bep.second).vertices_.second].second).edges_.insert(newinputnmm.edges.size());
-		//newinputnmm.edges.push_back(bep);
-		//newinputnmm.numEdges ++;
-
-		// handle the slab mesh
-		Bool_SlabEdgePointer bsep2;
-		bsep2.first = true;
-		bsep2.second = new SlabEdge;
-		(*bsep2.second).vertices_.first = ver[0];
-		(*bsep2.second).vertices_.second = ver[1];
-		(*slab_mesh.vertices[(*bsep2.second).vertices_.first].second).edges_.insert(slab_mesh.edges.size());
-		(*slab_mesh.vertices[(*bsep2.second).vertices_.second].second).edges_.insert(slab_mesh.edges.size());
-		(*bsep2.second).index = slab_mesh.edges.size();
-		slab_mesh.edges.push_back(bsep2);
-		slab_mesh.numEdges ++;
-	}
-
-	for(unsigned i = 0; i < nf; i ++)
-	{
-		char ch;
-		unsigned vid[3];
-		unsigned eid[3];
-		mastream >> ch >> vid[0] >> vid[1] >> vid[2];
-
-		//Bool_FacePointer bfp;
-		//bfp.first = true;
-		//bfp.second = new NonManifoldMesh_Face;
-		//(*bfp.second).vertices_.insert(vid[0]);
-		//(*bfp.second).vertices_.insert(vid[1]);
-		//(*bfp.second).vertices_.insert(vid[2]);
-		//if(newinputnmm.Edge(vid[0],vid[1],eid[0]))
-		//	(*bfp.second).edges_.insert(eid[0]);
-		//if(newinputnmm.Edge(vid[0],vid[2],eid[1]))
-		//	(*bfp.second).edges_.insert(eid[1]);
-		//if(newinputnmm.Edge(vid[1],vid[2],eid[2]))
-		//	(*bfp.second).edges_.insert(eid[2]);
-		//newinputnmm.vertices[vid[0]].second->faces_.insert(newinputnmm.faces.size());
-		//newinputnmm.vertices[vid[1]].second->faces_.insert(newinputnmm.faces.size());
-		//newinputnmm.vertices[vid[2]].second->faces_.insert(newinputnmm.faces.size());
-		//newinputnmm.edges[eid[0]].second->faces_.insert(newinputnmm.faces.size());
-		//newinputnmm.edges[eid[1]].second->faces_.insert(newinputnmm.faces.size());
-		//newinputnmm.edges[eid[2]].second->faces_.insert(newinputnmm.faces.size());
-		//newinputnmm.faces.push_back(bfp);
-		//newinputnmm.numFaces ++;
-
-		// handle the slab mesh	
-		Bool_SlabFacePointer bsfp2;
-		bsfp2.first = true;
-		bsfp2.second = new SlabFace;
-		(*bsfp2.second).vertices_.insert(vid[0]);
-		(*bsfp2.second).vertices_.insert(vid[1]);
-		(*bsfp2.second).vertices_.insert(vid[2]);
-		if(slab_mesh.Edge(vid[0],vid[1],eid[0]))
-			(*bsfp2.second).edges_.insert(eid[0]);
-		if(slab_mesh.Edge(vid[0],vid[2],eid[1]))
-			(*bsfp2.second).edges_.insert(eid[1]);
-		if(slab_mesh.Edge(vid[1],vid[2],eid[2]))
-			(*bsfp2.second).edges_.insert(eid[2]);
-		(*bsfp2.second).index = slab_mesh.faces.size();
-		slab_mesh.vertices[vid[0]].second->faces_.insert(slab_mesh.faces.size());
-		//slab_mesh.vertices[vid[0]].second->related_face += 2;
-		slab_mesh.vertices[vid[1]].second->faces_.insert(slab_mesh.faces.size());
-		//slab_mesh.vertices[vid[1]].second->related_face += 2;
-		slab_mesh.vertices[vid[2]].second->faces_.insert(slab_mesh.faces.size());
-		//slab_mesh.vertices[vid[2]].second->related_face += 2;
-		slab_mesh.edges[eid[0]].second->faces_.insert(slab_mesh.faces.size());
-		slab_mesh.edges[eid[1]].second->faces_.insert(slab_mesh.faces.size());
-		slab_mesh.edges[eid[2]].second->faces_.insert(slab_mesh.faces.size());
-		slab_mesh.faces.push_back(bsfp2);
-		slab_mesh.numFaces++;
-	}
-
-	//newinputnmm.ComputeFacesNormal();
-	//newinputnmm.ComputeFacesCentroid();
-	//newinputnmm.ComputeFacesSimpleTriangles();
-	//newinputnmm.ComputeEdgesCone();
-	//input_nmm = newinputnmm;
-
-	slab_mesh.iniNumVertices = slab_mesh.numVertices;
-	slab_mesh.iniNumEdges = slab_mesh.numEdges;
-	slab_mesh.iniNumFaces = slab_mesh.numFaces;
-
-	slab_mesh.CleanIsolatedVertices();
-	slab_mesh.computebb();
-	slab_mesh.ComputeFacesCentroid();
-	slab_mesh.ComputeFacesNormal();
-	slab_mesh.ComputeVerticesNormal();
-	slab_mesh.ComputeEdgesCone();
-	slab_mesh.ComputeFacesSimpleTriangles();
-	slab_mesh.DistinguishVertexType();
+	slab_mesh.LoadMA(mastream, input.bb_diagonal_length);
 }
 
 long ThreeDimensionalShape::LoadSlabMesh()
@@ -449,71 +320,7 @@ long ThreeDimensionalShape::LoadSlabMesh()
 
 void ThreeDimensionalShape::InitialSlabMesh()
 {
-	// handle each face
-	for(unsigned i = 0; i < slab_mesh.vertices.size(); i++)
-	{ 
-		if(!slab_mesh.vertices[i].first)
-			continue;
-
-		SlabVertex sv = *slab_mesh.vertices[i].second;
-		std::set<unsigned> fset = sv.faces_;
-		Vector4d C1(sv.sphere.center.X(), sv.sphere.center.Y(), sv.sphere.center.Z(), sv.sphere.radius);
-
-		for (set<unsigned>::iterator si = fset.begin(); si != fset.end(); si++)
-		{
-			SlabFace sf = *slab_mesh.faces[*si].second;
-
-			if (sf.valid_st == false || sf.st[0].normal == Vector3d(0., 0., 0.) || 
-				sf.st[1].normal == Vector3d(0., 0., 0.))
-				continue;
-
-			Vector4d normal1(sf.st[0].normal.X(), sf.st[0].normal.Y(), sf.st[0].normal.Z(), 1.0);
-			Vector4d normal2(sf.st[1].normal.X(), sf.st[1].normal.Y(), sf.st[1].normal.Z(), 1.0);
-
-			// compute the matrix of A
-			Matrix4d temp_A1, temp_A2;
-			temp_A1.MakeTensorProduct(normal1, normal1);
-			temp_A2.MakeTensorProduct(normal2, normal2);
-			temp_A1 *= 2.0;
-			temp_A2 *= 2.0;
-
-			// compute the matrix of b
-			double normal_mul_point1 = normal1.Dot(C1);
-			double normal_mul_point2 = normal2.Dot(C1);
-			Wm4::Vector4d temp_b1 = normal1 * 2 * normal_mul_point1;
-			Wm4::Vector4d temp_b2 = normal2 * 2 * normal_mul_point2;
-
-			//compute c
-			double temp_c1 = normal_mul_point1 * normal_mul_point1;
-			double temp_c2 = normal_mul_point2 * normal_mul_point2;
-
-			slab_mesh.vertices[i].second->slab_A += temp_A1;
-			slab_mesh.vertices[i].second->slab_A += temp_A2;
-			slab_mesh.vertices[i].second->slab_b += temp_b1;
-			slab_mesh.vertices[i].second->slab_b += temp_b2;
-			slab_mesh.vertices[i].second->slab_c += temp_c1;
-			slab_mesh.vertices[i].second->slab_c += temp_c2;
-
-			slab_mesh.vertices[i].second->related_face += 2;
-		}
-	}
-
-	switch(slab_mesh.preserve_boundary_method)
-	{
-	case 1 :
-		slab_mesh.PreservBoundaryMethodOne();
-		break;
-	case 2 :
-		//slab_mesh.PreservBoundaryMethodTwo();
-		break;
-	case 3 :
-		slab_mesh.PreservBoundaryMethodThree();
-		break;
-	default:
-		slab_mesh.PreservBoundaryMethodFour();
-		break;
-	}
-
+	slab_mesh.InitialQuadrics();
 }
 
 double ThreeDimensionalShape::NearestPoint(Vector3d point, unsigned vid)
@@ -669,6 +476,7 @@ void ThreeDimensionalShape::ComputeHausdorffDistance()
 	slab_mesh.meanhausdorff_distance = sumhausdorff_distance / input.pVertexList.size();
 	//ma_qem_mesh.initialhausdorff_distance = ma_qem_mesh.maxhausdorff_distance;
 	slab_mesh.initialhausdorff_distance = slab_mesh.maxhausdorff_distance;
+	slab_mesh.LimitBoundarySamples();
 }
 
 void ThreeDimensionalShape::PruningSlabMesh()
@@ -10,10 +10,14 @@ class ThreeDimensionalShape
 public:
 	ThreeDimensionalShape() : slab_initial(false) {}
 
-	void ComputeInputNMM();
+	// the raw ma is written to maout, or next to input_nmm.meshname without it
+	void ComputeInputNMM(std::ostream * maout = NULL);
+	// position of a Delaunay vertex without the offset of input.dt_offset
+	Vector3d DelaunaySample(Vertex_handle_t vh) const;
 	
 	// load the user simplified ma
 	void LoadInputNMM(std::string fname);
+	void LoadInputNMM(std::istream & mastream);
 
 	long LoadSlabMesh();
 
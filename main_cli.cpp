@@ -9,34 +9,168 @@
  *   .obj  - Wavefront OBJ format
  *
  * Usage:
- *   qmat_cli <input.off|input.obj> [options]
+ *   qmat_cli <input.off|input.obj|-> [options]
+ *
+ * With - the mesh is read from stdin. The MA between the steps then stays in memory and the final MA
+ * goes to stdout, the log to stderr, unless --output or --ma-output say otherwise.
  *
  * Options:
  *   --simplify <N>     Simplify to N vertices (default: no simplification)
  *   --k <value>        K factor for slab initialization (default: 0.00001)
- *   --output <prefix>  Output file prefix (default: input filename without extension)
+ *   --output <prefix>  Output file prefix (default: input filename without extension, "stdin" for -)
+ *   --ma-output <file> Write only the final MA, to file or - for stdout, the intermediate MAs stay in memory
+ *   --format <f>       Input format, off or obj (default: the extension, off for stdin)
+ *   --labeling <mode>  Inside/outside labeling of Delaunay cells: exact or powercrust (default: exact)
+ *   --scale-axis <s>   Prune the raw MA before simplification: drop spheres whose s-times inflated ball
+ *                      lies inside the other inflated balls, written as <prefix>_sat.ma (s >= 1)
+ *   --symmetry         Detect a mirror plane of the mesh, simplify the MA of one half with its spheres
+ *                      kept on the plane, then mirror the result
+ *   --symmetry-tolerance <t>  Mirror plane tolerance relative to the bounding box diagonal (default: 0.001)
+ *   --instances <file> Split the mesh into components, compute the MA once per set of congruent ones and
+ *                      write the instance transforms to file
+ *   --instance-tolerance <t>  Congruence tolerance relative to the bounding box diagonal (default: 1e-6)
+ *   --perturb          Jitter degenerate (cospherical, grid aligned) samples before the Delaunay triangulation
+ *   --perturb-magnitude <m>  Largest jitter per coordinate relative to the bounding box diagonal (default: 1e-6)
+ *   --perturb-seed <n> Seed of the jitter, the same seed gives the same MA (default: 1)
+ *   --no-reorder       Keep the .ma element order instead of renumbering along a Morton curve
+ *   --reorder-export   Renumber the simplified MA along a Morton curve before export
+ *   --trace <file>     Record the collapse sequence of the simplification (see qmat_replay)
+ *   --prevent-inversion  Reject collapses that flip a face, merges are undone when they do
+ *   --hyperbolic-weight <w>  Hyperbolic weight of the edge costs: 0 (none), 1, 2 or 3 (default: 3)
+ *   --boundary-method <m>  Boundary preservation: 0 (method four), 1 or 3 (default: 0)
+ *   --threads <N>      Threads of the parallel passes (default: all cores)
+ *   --validate <N>     Check the slab mesh invariants every N collapses, exit with code 5 on a violation
+ *   --skeleton <N>     Curve skeleton mode: collapse the faces first, stop at N capsules (edges) without faces
+ *   --skeleton-penalty <p>  Cost added to the collapse of an edge without faces in skeleton mode, relative
+ *                      to the largest initial collapse cost (default: 2)
+ *   --max-cost <c>     Stop simplifying when the cheapest collapse costs more than c
+ *   --hausdorff        Assign the surface samples to the MA and track the Hausdorff distance while simplifying
+ *   --samples-per-vertex <K>  Keep at most K representative boundary samples per MA vertex (implies --hausdorff)
+ *   --check-samples    Evaluate bounded sample costs on the complete lists too and report the error
+ *   --chunks           Also write every exported .ma as a spatially chunked .qmc file
+ *   --lfs              Write the local feature size at the input vertices, the distance to the raw MA
+ *                      and the exterior medial vertices (<prefix>.lfs)
+ *   --lfs-grid <N>     Also sample it on a grid of N cells along the longest side (implies --lfs)
+ *   --envelope <file>  Write the envelope of the final MA as a triangle mesh (.off or .ply)
+ *   --envelope-error <e>  Envelope tessellation error relative to the bounding box diagonal (default: 0.001)
+ *   --collision <file> Write the final MA as convex pieces for a physics engine (.qcp, binary)
+ *   --check-collision  Test the convex pieces against the envelope, within the envelope error
+ *   --capsules <file>  Write the final MA as capsules on a shared joint graph (text)
+ *   --thickness-report <file>  Write the wall thickness at every input vertex, measured on the final MA
+ *   --thickness-threshold <t>  Also report the connected regions thinner than t (model units)
+ *   --log-level <l>    Least severe message written: debug, info, warn or error (default: info)
+ *   --log-format <f>   text or json (one JSON object per line) (default: text)
+ *   --log-file <file>  Write the log to a file instead of stdout/stderr
+ *   --preflight        Check the mesh and predict the job size and run time, then exit;
+ *                      without --cost-model the predictions come from uncalibrated defaults
+ *   --cost-model <f>   key=value file overriding the preflight cost model coefficients
+ *   --max-cells <N>    Refuse the job if more than N Delaunay cells are predicted
+ *   --max-memory <MB>  Refuse the job if the predicted peak memory exceeds MB
+ *   --autotune         Choose the labeling, weights, boundary method, cost mode, order and threads (and
+ *                      the target under --error-budget) on a decimated copy, then run the job with them
+ *   --time-budget <s>  Autotune for the most accurate settings predicted to finish in s seconds
+ *   --error-budget <e> Autotune for the fastest settings within the surface deviation e, relative to the
+ *                      bounding box diagonal
+ *   --autotune-sample <N>  Vertices of the decimated copy (default: 4000)
+ *   --autotune-profile <file>  Where --autotune writes the chosen settings (default: <prefix>.tune)
+ *   --profile <file>   Apply the settings of an autotune profile, --simplify wins over its target
  *   --help             Show this help message
  *
+ * Exit codes:
+ *   0  success
+ *   1  invalid arguments, unreadable input or a failed stage
+ *   2  refused by --max-cells or --max-memory
+ *   5  --validate found a violated slab mesh invariant
+ *
  * Examples:
  *   qmat_cli model.off
  *   qmat_cli model.obj
  *   qmat_cli model.obj --simplify 500 --k 0.0001 --output result
+ *   cat model.off | qmat_cli - --simplify 500 > result.ma
+ *   qmat_cli model.off --symmetry --simplify 500 --validate 1000
+ *   qmat_cli model.off --autotune --time-budget 60
  */
 
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <cstring>
 #include <ctime>
+#include <algorithm>
+#include <chrono>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "ThreeDimensionalShape.h"
 #include "ObjLoader.h"
+#include "Preflight.h"
+#include "MedialChunks.h"
+#include "EnvelopeExport.h"
+#include "ScaleAxis.h"
+#include "CollisionProxy.h"
+#include "Symmetry.h"
+#include "Congruence.h"
+#include "Perturbation.h"
+#include "FeatureSize.h"
+#include "Thickness.h"
+#include "Autotune.h"
+#include "Logger.h"
 
 // Simple command line argument parsing
 struct CLIOptions {
     std::string inputFile;
     std::string outputPrefix;
+    std::string maOutput;     // empty writes every MA next to the output prefix
+    std::string inputFormat;  // empty takes the extension
     int simplifyTarget = -1;  // -1 means no simplification
     double k = 0.00001;
+    CELLLABELING labeling = EXACT_QUERY;
+    double scaleAxis = -1;  // -1 means no pruning
+    bool symmetry = false;
+    double symmetryTolerance = 0.001;
+    std::string instanceFile;
+    double instanceTolerance = 1e-6;
+    bool perturb = false;
+    double perturbMagnitude = 1e-6;
+    unsigned perturbSeed = 1;
+    bool reorder = true;
+    bool reorderExport = false;
+    std::string traceFile;
+    bool preventInversion = false;
+    int hyperbolicWeightType = 3;
+    int boundaryMethod = 0;     // 0 is PreservBoundaryMethodFour
+    int threads = 0;            // 0 keeps the OpenMP default
+    int validateInterval = 0;   // 0 keeps the default of the build
+    int skeletonCapsules = -1;  // -1 means no skeleton mode
+    double skeletonPenalty = 2.;  // relative to the largest initial collapse cost
+    double maxCost = -1;        // -1 means no cost bound
+    bool hausdorff = false;
+    unsigned samplesPerVertex = 0;  // 0 keeps all samples
+    bool checkSamples = false;
+    bool chunks = false;
+    bool featureSize = false;
+    int featureSizeGrid = 0;  // 0 means vertices only
+    std::string envelopeFile;
+    double envelopeError = 0.001;
+    std::string collisionFile;
+    bool checkCollision = false;
+    std::string capsulesFile;
+    std::string thicknessFile;
+    double thicknessThreshold = -1;  // -1 means no thin regions
+    LogLevel logLevel = LOG_INFO;
+    bool logJson = false;
+    std::string logFile;
+    bool preflight = false;
+    std::string costModelFile;
+    double maxCells = -1;   // -1 means no limit
+    double maxMemoryMB = -1;
+    bool autotune = false;
+    double timeBudget = -1;     // seconds, -1 means none
+    double errorBudget = -1;    // relative to the bounding box diagonal, -1 means none
+    int autotuneSample = 4000;
+    std::string autotuneProfile;  // empty writes <prefix>.tune
+    std::string profileFile;
     bool showHelp = false;
     bool valid = true;
     std::string errorMessage;
@@ -46,15 +180,68 @@ void printUsage(const char* programName) {
     std::cout << "QMAT Command Line Interface\n"
               << "Compute medial axis and optionally simplify.\n\n"
               << "Usage:\n"
-              << "  " << programName << " <input.off|input.obj> [options]\n\n"
+              << "  " << programName << " <input.off|input.obj|-> [options]\n\n"
               << "Supported formats:\n"
               << "  .off               Object File Format\n"
-              << "  .obj               Wavefront OBJ format\n\n"
+              << "  .obj               Wavefront OBJ format\n"
+              << "  -                  stdin, the final MA goes to stdout and the log to stderr\n\n"
               << "Options:\n"
               << "  --simplify <N>     Simplify to N vertices (default: no simplification)\n"
               << "  --k <value>        K factor for slab initialization (default: 0.00001)\n"
               << "  --output <prefix>  Output file prefix (default: input filename)\n"
+              << "  --ma-output <file> Write only the final MA, to a file or - for stdout\n"
+              << "  --format <f>       Input format: off or obj (default: the extension, off for stdin)\n"
+              << "  --labeling <mode>  Cell labeling: exact or powercrust (default: exact)\n"
+              << "  --scale-axis <s>   Prune spheres covered by the s-times inflated neighbours before simplifying\n"
+              << "  --symmetry         Detect a mirror plane, simplify one half of the MA and mirror it\n"
+              << "  --symmetry-tolerance <t> Mirror plane tolerance relative to the bounding box diagonal (default: 0.001)\n"
+              << "  --instances <file> Compute the MA once per set of congruent components and write the copies\n"
+              << "  --instance-tolerance <t> Congruence tolerance relative to the bounding box diagonal (default: 1e-6)\n"
+              << "  --perturb          Jitter degenerate (cospherical, grid aligned) samples before the Delaunay triangulation\n"
+              << "  --perturb-magnitude <m> Largest jitter per coordinate relative to the bounding box diagonal (default: 1e-6)\n"
+              << "  --perturb-seed <n> Seed of the jitter (default: 1)\n"
+              << "  --no-reorder       Keep the .ma element order for simplification\n"
+              << "  --reorder-export   Renumber the simplified MA spatially before export\n"
+              << "  --trace <file>     Record the collapses of the simplification for qmat_replay\n"
+              << "  --prevent-inversion Reject collapses that flip a face of the MA\n"
+              << "  --hyperbolic-weight <w> Hyperbolic weight of the edge costs: 0 (none) to 3 (default: 3)\n"
+              << "  --boundary-method <m> Boundary preservation method: 0 (method four), 1 or 3 (default: 0)\n"
+              << "  --threads <N>      Number of threads of the parallel passes (default: all cores)\n"
+              << "  --validate <N>     Check the slab mesh invariants every N collapses\n"
+              << "  --skeleton <N>     Collapse toward a curve skeleton of at most N capsules\n"
+              << "  --skeleton-penalty <p> Extra cost of collapsing an edge without faces, times the largest initial cost (default: 2)\n"
+              << "  --max-cost <c>     Stop simplifying when the cheapest collapse costs more than c\n"
+              << "  --hausdorff        Track the Hausdorff distance to the surface samples while simplifying\n"
+              << "  --samples-per-vertex <K> Keep at most K boundary samples per MA vertex (implies --hausdorff)\n"
+              << "  --check-samples    Report the cost error of the bounded samples against the complete lists\n"
+              << "  --chunks           Also write the exported MA as chunked .qmc for region queries\n"
+              << "  --lfs              Write the local feature size at the input vertices from the inner and outer MA (.lfs)\n"
+              << "  --lfs-grid <N>     Also sample it on a grid of N cells along the longest side (implies --lfs)\n"
+              << "  --envelope <file>  Write the envelope of the final MA as triangles (.off or .ply)\n"
+              << "  --envelope-error <e> Envelope error relative to the bounding box diagonal (default: 0.001)\n"
+              << "  --collision <file> Write the final MA as convex pieces for physics engines (.qcp)\n"
+              << "  --check-collision  Test the convex pieces against the envelope of the final MA\n"
+              << "  --capsules <file>  Write the final MA as capsules on a shared joint graph\n"
+              << "  --thickness-report <file> Write the wall thickness of every input vertex from the final MA\n"
+              << "  --thickness-threshold <t> Report the connected regions thinner than t (model units)\n"
+              << "  --log-level <l>    Log level: debug, info, warn or error (default: info)\n"
+              << "  --log-format <f>   Log format: text or json lines (default: text)\n"
+              << "  --log-file <file>  Write the log to a file instead of stdout/stderr\n"
+              << "  --preflight        Check the mesh and predict size, memory and time, then exit\n"
+              << "                     (uncalibrated defaults unless --cost-model is given)\n"
+              << "  --cost-model <f>   Preflight cost model file (key=value lines)\n"
+              << "  --max-cells <N>    Refuse jobs predicted to exceed N Delaunay cells\n"
+              << "  --max-memory <MB>  Refuse jobs predicted to exceed MB of peak memory\n"
+              << "  --autotune         Choose the settings above on a decimated copy, then run the job with them\n"
+              << "  --time-budget <s>  Autotune for the most accurate settings predicted to finish in s seconds\n"
+              << "  --error-budget <e> Autotune for the fastest settings within the surface deviation e, relative\n"
+              << "                     to the bounding box diagonal; without --simplify the target is tuned too\n"
+              << "  --autotune-sample <N> Vertices of the decimated copy (default: 4000)\n"
+              << "  --autotune-profile <file> Where --autotune writes the chosen settings (default: <prefix>.tune)\n"
+              << "  --profile <file>   Apply the settings of an autotune profile, --simplify wins over its target\n"
               << "  --help             Show this help message\n\n"
+              << "Exit codes:\n"
+              << "  1 error, 2 refused by --max-cells or --max-memory, 5 --validate invariant violation\n\n"
               << "Examples:\n"
               << "  " << programName << " model.off\n"
               << "  " << programName << " model.obj\n"
@@ -111,17 +298,549 @@ CLIOptions parseArguments(int argc, char* argv[]) {
                 }
             } catch (...) {
                 options.valid = false;
-                options.errorMessage = "Invalid value for --k.";
+                options.errorMessage = "Invalid value for --k.";
+                return options;
+            }
+        }
+        else if (arg == "--output") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--output requires a value.";
+                return options;
+            }
+            options.outputPrefix = argv[++i];
+        }
+        else if (arg == "--ma-output") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--ma-output requires a value.";
+                return options;
+            }
+            options.maOutput = argv[++i];
+        }
+        else if (arg == "--format") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--format requires a value.";
+                return options;
+            }
+            options.inputFormat = argv[++i];
+            if (options.inputFormat != "off" && options.inputFormat != "obj") {
+                options.valid = false;
+                options.errorMessage = "Invalid format: " + options.inputFormat + " (use off or obj)";
+                return options;
+            }
+        }
+        else if (arg == "--labeling") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--labeling requires a value.";
+                return options;
+            }
+            std::string mode = argv[++i];
+            if (mode == "exact") {
+                options.labeling = EXACT_QUERY;
+            } else if (mode == "powercrust") {
+                options.labeling = POWERCRUST;
+            } else {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --labeling: " + mode;
+                return options;
+            }
+        }
+        else if (arg == "--scale-axis") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--scale-axis requires a value.";
+                return options;
+            }
+            try {
+                options.scaleAxis = std::stod(argv[++i]);
+                if (!(options.scaleAxis >= 1)) {
+                    options.valid = false;
+                    options.errorMessage = "--scale-axis value must be at least 1.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --scale-axis.";
+                return options;
+            }
+        }
+        else if (arg == "--symmetry") {
+            options.symmetry = true;
+        }
+        else if (arg == "--symmetry-tolerance") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--symmetry-tolerance requires a value.";
+                return options;
+            }
+            try {
+                options.symmetryTolerance = std::stod(argv[++i]);
+                if (!(options.symmetryTolerance > 0)) {
+                    options.valid = false;
+                    options.errorMessage = "--symmetry-tolerance value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --symmetry-tolerance.";
+                return options;
+            }
+            options.symmetry = true;
+        }
+        else if (arg == "--instances") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--instances requires a value.";
+                return options;
+            }
+            options.instanceFile = argv[++i];
+        }
+        else if (arg == "--instance-tolerance") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--instance-tolerance requires a value.";
+                return options;
+            }
+            try {
+                options.instanceTolerance = std::stod(argv[++i]);
+                if (!(options.instanceTolerance > 0)) {
+                    options.valid = false;
+                    options.errorMessage = "--instance-tolerance value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --instance-tolerance.";
+                return options;
+            }
+        }
+        else if (arg == "--perturb") {
+            options.perturb = true;
+        }
+        else if (arg == "--perturb-magnitude") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--perturb-magnitude requires a value.";
+                return options;
+            }
+            try {
+                options.perturbMagnitude = std::stod(argv[++i]);
+                if (!(options.perturbMagnitude > 0)) {
+                    options.valid = false;
+                    options.errorMessage = "--perturb-magnitude value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --perturb-magnitude.";
+                return options;
+            }
+            options.perturb = true;
+        }
+        else if (arg == "--perturb-seed") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--perturb-seed requires a value.";
+                return options;
+            }
+            try {
+                int seed = std::stoi(argv[++i]);
+                if (seed < 0) {
+                    options.valid = false;
+                    options.errorMessage = "--perturb-seed value must not be negative.";
+                    return options;
+                }
+                options.perturbSeed = (unsigned)seed;
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --perturb-seed.";
+                return options;
+            }
+            options.perturb = true;
+        }
+        else if (arg == "--no-reorder") {
+            options.reorder = false;
+        }
+        else if (arg == "--reorder-export") {
+            options.reorderExport = true;
+        }
+        else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--trace requires a value.";
+                return options;
+            }
+            options.traceFile = argv[++i];
+        }
+        else if (arg == "--prevent-inversion") {
+            options.preventInversion = true;
+        }
+        else if (arg == "--hyperbolic-weight" || arg == "--boundary-method" || arg == "--threads") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = arg + " requires a value.";
+                return options;
+            }
+            try {
+                int value = std::stoi(argv[++i]);
+                if (arg == "--hyperbolic-weight" && (value < 0 || value > 3)) {
+                    options.valid = false;
+                    options.errorMessage = "--hyperbolic-weight value must be 0 to 3.";
+                    return options;
+                }
+                if (arg == "--boundary-method" && value != 0 && value != 1 && value != 3) {
+                    options.valid = false;
+                    options.errorMessage = "--boundary-method value must be 0, 1 or 3.";
+                    return options;
+                }
+                if (arg == "--threads" && value <= 0) {
+                    options.valid = false;
+                    options.errorMessage = "--threads value must be positive.";
+                    return options;
+                }
+                if (arg == "--hyperbolic-weight")
+                    options.hyperbolicWeightType = value;
+                else if (arg == "--boundary-method")
+                    options.boundaryMethod = value;
+                else
+                    options.threads = value;
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for " + arg + ".";
+                return options;
+            }
+        }
+        else if (arg == "--validate") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--validate requires a value.";
+                return options;
+            }
+            try {
+                options.validateInterval = std::stoi(argv[++i]);
+                if (options.validateInterval <= 0) {
+                    options.valid = false;
+                    options.errorMessage = "--validate value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --validate.";
+                return options;
+            }
+        }
+        else if (arg == "--skeleton") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--skeleton requires a value.";
+                return options;
+            }
+            try {
+                options.skeletonCapsules = std::stoi(argv[++i]);
+                if (options.skeletonCapsules <= 0) {
+                    options.valid = false;
+                    options.errorMessage = "--skeleton value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --skeleton.";
+                return options;
+            }
+        }
+        else if (arg == "--skeleton-penalty") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--skeleton-penalty requires a value.";
+                return options;
+            }
+            try {
+                options.skeletonPenalty = std::stod(argv[++i]);
+                if (options.skeletonPenalty < 0) {
+                    options.valid = false;
+                    options.errorMessage = "--skeleton-penalty value must not be negative.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --skeleton-penalty.";
+                return options;
+            }
+        }
+        else if (arg == "--max-cost") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--max-cost requires a value.";
+                return options;
+            }
+            try {
+                options.maxCost = std::stod(argv[++i]);
+                if (options.maxCost < 0) {
+                    options.valid = false;
+                    options.errorMessage = "--max-cost value must not be negative.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --max-cost.";
+                return options;
+            }
+        }
+        else if (arg == "--hausdorff") {
+            options.hausdorff = true;
+        }
+        else if (arg == "--samples-per-vertex") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--samples-per-vertex requires a value.";
+                return options;
+            }
+            try {
+                int samples = std::stoi(argv[++i]);
+                if (samples <= 0) {
+                    options.valid = false;
+                    options.errorMessage = "--samples-per-vertex value must be positive.";
+                    return options;
+                }
+                options.samplesPerVertex = (unsigned)samples;
+                options.hausdorff = true;
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --samples-per-vertex.";
+                return options;
+            }
+        }
+        else if (arg == "--check-samples") {
+            options.checkSamples = true;
+        }
+        else if (arg == "--chunks") {
+            options.chunks = true;
+        }
+        else if (arg == "--lfs") {
+            options.featureSize = true;
+        }
+        else if (arg == "--lfs-grid") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--lfs-grid requires a value.";
+                return options;
+            }
+            try {
+                options.featureSizeGrid = std::stoi(argv[++i]);
+                if (options.featureSizeGrid <= 0) {
+                    options.valid = false;
+                    options.errorMessage = "--lfs-grid value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --lfs-grid.";
+                return options;
+            }
+            options.featureSize = true;
+        }
+        else if (arg == "--envelope") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--envelope requires a value.";
+                return options;
+            }
+            options.envelopeFile = argv[++i];
+            size_t dotPos = options.envelopeFile.rfind('.');
+            std::string ext = dotPos == std::string::npos ? "" : options.envelopeFile.substr(dotPos);
+            if (ext != ".off" && ext != ".OFF" && ext != ".ply" && ext != ".PLY") {
+                options.valid = false;
+                options.errorMessage = "--envelope file must end in .off or .ply.";
+                return options;
+            }
+        }
+        else if (arg == "--envelope-error") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--envelope-error requires a value.";
+                return options;
+            }
+            try {
+                options.envelopeError = std::stod(argv[++i]);
+                if (options.envelopeError <= 0) {
+                    options.valid = false;
+                    options.errorMessage = "--envelope-error value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --envelope-error.";
+                return options;
+            }
+        }
+        else if (arg == "--collision") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--collision requires a value.";
+                return options;
+            }
+            options.collisionFile = argv[++i];
+        }
+        else if (arg == "--check-collision") {
+            options.checkCollision = true;
+        }
+        else if (arg == "--capsules") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--capsules requires a value.";
+                return options;
+            }
+            options.capsulesFile = argv[++i];
+        }
+        else if (arg == "--thickness-report") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--thickness-report requires a value.";
+                return options;
+            }
+            options.thicknessFile = argv[++i];
+        }
+        else if (arg == "--thickness-threshold") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--thickness-threshold requires a value.";
+                return options;
+            }
+            try {
+                options.thicknessThreshold = std::stod(argv[++i]);
+                if (!(options.thicknessThreshold > 0)) {
+                    options.valid = false;
+                    options.errorMessage = "--thickness-threshold value must be positive.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --thickness-threshold.";
+                return options;
+            }
+        }
+        else if (arg == "--log-level") {
+            if (i + 1 >= argc || !Logger::ParseLevel(argv[i + 1], options.logLevel)) {
+                options.valid = false;
+                options.errorMessage = "--log-level must be debug, info, warn or error.";
+                return options;
+            }
+            i++;
+        }
+        else if (arg == "--log-format") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format != "text" && format != "json") {
+                options.valid = false;
+                options.errorMessage = "--log-format must be text or json.";
+                return options;
+            }
+            options.logJson = format == "json";
+        }
+        else if (arg == "--log-file") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--log-file requires a value.";
+                return options;
+            }
+            options.logFile = argv[++i];
+        }
+        else if (arg == "--preflight") {
+            options.preflight = true;
+        }
+        else if (arg == "--cost-model") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--cost-model requires a value.";
+                return options;
+            }
+            options.costModelFile = argv[++i];
+        }
+        else if (arg == "--max-cells" || arg == "--max-memory") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = arg + " requires a value.";
+                return options;
+            }
+            try {
+                double value = std::stod(argv[++i]);
+                if (value <= 0) {
+                    options.valid = false;
+                    options.errorMessage = arg + " value must be positive.";
+                    return options;
+                }
+                if (arg == "--max-cells")
+                    options.maxCells = value;
+                else
+                    options.maxMemoryMB = value;
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for " + arg + ".";
+                return options;
+            }
+        }
+        else if (arg == "--autotune") {
+            options.autotune = true;
+        }
+        else if (arg == "--time-budget" || arg == "--error-budget") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = arg + " requires a value.";
+                return options;
+            }
+            try {
+                double value = std::stod(argv[++i]);
+                if (!(value > 0)) {
+                    options.valid = false;
+                    options.errorMessage = arg + " value must be positive.";
+                    return options;
+                }
+                if (arg == "--time-budget")
+                    options.timeBudget = value;
+                else
+                    options.errorBudget = value;
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for " + arg + ".";
+                return options;
+            }
+        }
+        else if (arg == "--autotune-sample") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--autotune-sample requires a value.";
+                return options;
+            }
+            try {
+                options.autotuneSample = std::stoi(argv[++i]);
+                if (options.autotuneSample < 100) {
+                    options.valid = false;
+                    options.errorMessage = "--autotune-sample value must be at least 100.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --autotune-sample.";
+                return options;
+            }
+        }
+        else if (arg == "--autotune-profile") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--autotune-profile requires a value.";
                 return options;
             }
+            options.autotuneProfile = argv[++i];
         }
-        else if (arg == "--output") {
+        else if (arg == "--profile") {
             if (i + 1 >= argc) {
                 options.valid = false;
-                options.errorMessage = "--output requires a value.";
+                options.errorMessage = "--profile requires a value.";
                 return options;
             }
-            options.outputPrefix = argv[++i];
+            options.profileFile = argv[++i];
         }
         else if (arg[0] == '-') {
             options.valid = false;
@@ -129,7 +848,7 @@ CLIOptions parseArguments(int argc, char* argv[]) {
             return options;
         }
         else {
-            // Positional argument - input file
+            // Positional argument - input file, - is stdin
             if (options.inputFile.empty()) {
                 options.inputFile = arg;
             } else {
@@ -146,6 +865,40 @@ CLIOptions parseArguments(int argc, char* argv[]) {
         return options;
     }
 
+    // Skeleton mode simplifies, the vertex target is only a floor
+    if (options.skeletonCapsules > 0 && options.simplifyTarget <= 0)
+        options.simplifyTarget = 1;
+
+    if (options.checkCollision && options.collisionFile.empty()) {
+        options.valid = false;
+        options.errorMessage = "--check-collision requires --collision.";
+        return options;
+    }
+
+    if (options.autotune && !options.profileFile.empty()) {
+        options.valid = false;
+        options.errorMessage = "--autotune and --profile exclude each other.";
+        return options;
+    }
+    if (options.autotune && options.timeBudget <= 0 && options.errorBudget <= 0) {
+        options.valid = false;
+        options.errorMessage = "--autotune requires --time-budget or --error-budget.";
+        return options;
+    }
+    // only an error budget bounds how far the target may go
+    if (options.autotune && options.simplifyTarget <= 0 && options.errorBudget <= 0) {
+        options.valid = false;
+        options.errorMessage = "--autotune without --simplify requires --error-budget.";
+        return options;
+    }
+
+    // Without an output prefix a stdin run is a filter, the final MA goes to stdout
+    if (options.inputFile == "-" && options.outputPrefix.empty()) {
+        options.outputPrefix = "stdin";
+        if (options.maOutput.empty())
+            options.maOutput = "-";
+    }
+
     // Set default output prefix from input filename
     if (options.outputPrefix.empty()) {
         options.outputPrefix = options.inputFile;
@@ -158,15 +911,660 @@ CLIOptions parseArguments(int argc, char* argv[]) {
             }
         }
     }
+    if (options.autotune && options.autotuneProfile.empty())
+        options.autotuneProfile = options.outputPrefix + ".tune";
 
     return options;
 }
 
+// Slab mesh settings of the simplification (same as GUI initialize())
+void setupSlabMesh(ThreeDimensionalShape& shape, const CLIOptions& options) {
+    shape.slab_mesh.pmesh = &shape.input;
+    shape.slab_mesh.type = 1;
+    shape.slab_mesh.k = options.k;
+    shape.slab_mesh.bound_weight = 1.0;
+
+    shape.slab_mesh.preserve_boundary_method = options.boundaryMethod;
+    shape.slab_mesh.hyperbolic_weight_type = options.hyperbolicWeightType;
+    shape.slab_mesh.compute_hausdorff = false;
+    shape.slab_mesh.boundary_compute_scale = 0;
+    shape.slab_mesh.prevent_inversion = options.preventInversion;
+    if (options.skeletonCapsules > 0) {
+        shape.slab_mesh.skeleton_penalty = options.skeletonPenalty;
+        shape.slab_mesh.skeleton_capsules = options.skeletonCapsules;
+    }
+    if (options.maxCost >= 0)
+        shape.slab_mesh.max_collapse_cost = options.maxCost;
+    if (options.validateInterval > 0)
+        shape.slab_mesh.validate_interval = options.validateInterval;
+
+    shape.slab_mesh.bplist_limit = options.samplesPerVertex;
+    shape.slab_mesh.bplist_check = options.checkSamples;
+}
+
+// An MA passed between the steps of the run. It is a file next to the output
+// prefix, or with --ma-output only text in memory, file still names the chunks.
+struct StageMA {
+    std::string file;
+    std::string data;
+    bool inMemory = false;
+};
+
+bool loadStage(const StageMA& stage, MedialMeshData& ma, std::string& error) {
+    if (!stage.inMemory)
+        return ma.LoadMA(stage.file, error);
+    std::istringstream in(stage.data);
+    return ma.LoadMA(in, error);
+}
+
+void loadStageSlab(ThreeDimensionalShape& shape, const StageMA& stage) {
+    if (!stage.inMemory) {
+        shape.LoadInputNMM(stage.file);
+        return;
+    }
+    std::istringstream in(stage.data);
+    shape.LoadInputNMM(in);
+}
+
+// The final MA of a --ma-output run, the only MA that leaves the process
+bool writeFinalMA(const StageMA& stage, const std::string& path) {
+    if (path == "-") {
+        std::cout.write(stage.data.data(), stage.data.size());
+        std::cout.flush();
+        if (!std::cout) {
+            QMAT_LOG_ERROR("export") << "Error: could not write the MA to stdout";
+            return false;
+        }
+        QMAT_LOG_INFO("export").Field("bytes", (unsigned long long)stage.data.size()) << "  Final MA written to stdout";
+        return true;
+    }
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out.write(stage.data.data(), stage.data.size());
+    out.close();
+    if (!out) {
+        QMAT_LOG_ERROR("export") << "Error: could not write " << path;
+        return false;
+    }
+    QMAT_LOG_INFO("export").Field("file", path) << "  Final MA written to: " << path;
+    return true;
+}
+
+// The slab mesh is in units of the bounding box diagonal, the .ma in input units.
+// Returns the number of vertices on the plane.
+unsigned applySymmetryPlane(ThreeDimensionalShape& shape, const SymmetryPlane& plane,
+                            const IndexedMesh& indexedMesh, const CLIOptions& options) {
+    double diagonal = indexedMesh.bb_diagonal_length;
+    return shape.slab_mesh.SetSymmetryPlane(Wm4::Vector3d(plane.normal[0], plane.normal[1], plane.normal[2]),
+                                            plane.offset / diagonal, options.symmetryTolerance);
+}
+
+// Convert an exported .ma into a chunked .qmc next to it, going through the
+// file keeps the chunks identical to what the .ma writer produced
+bool writeChunks(const StageMA& maFile) {
+    MedialMeshData ma;
+    std::string error;
+    std::string chunkFile = maFile.file.substr(0, maFile.file.size() - 3) + ".qmc";
+    if (!loadStage(maFile, ma, error) || !WriteMedialChunks(ma, chunkFile, 4096, error)) {
+        QMAT_LOG_ERROR("chunks") << "Error writing chunks: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("chunks").Field("file", chunkFile) << "  Chunked MA written to: " << chunkFile;
+    return true;
+}
+
+// Distance of the surface vertices (and grid points) to the raw MA and the
+// exterior medial vertices of the Delaunay triangulation, written next to it
+bool writeFeatureSize(const StageMA& maFile, MPMesh& input, const IndexedMesh& mesh, const CLIOptions& options) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("lfs") << "Error writing feature size: " << error;
+        return false;
+    }
+
+    QMAT_LOG_INFO("lfs") << "Computing local feature size...";
+    clock_t startTime = clock();
+    std::vector<double> exterior;
+    input.ExteriorMedialVertices(exterior);
+    QMAT_LOG_INFO("lfs").Field("inner", ma.NumVertices()).Field("exterior", (unsigned long long)(exterior.size() / 3))
+        << "  " << ma.NumVertices() << " inner and " << exterior.size() / 3 << " exterior medial vertices";
+    FeatureSizeField field;
+    ComputeFeatureSize(ma, exterior, mesh, (unsigned)options.featureSizeGrid, field);
+    long lfsTime = clock() - startTime;
+    QMAT_LOG_INFO("lfs").Field("time_ms", lfsTime) << "  Feature size time: " << lfsTime << " ms";
+
+    std::string lfsFile = options.outputPrefix + ".lfs";
+    if (!field.Save(lfsFile, error)) {
+        QMAT_LOG_ERROR("lfs") << "Error writing feature size: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("lfs").Field("file", lfsFile).Field("vertices", (unsigned)field.vertex_lfs.size())
+        .Field("grid_points", (unsigned long long)field.grid_lfs.size())
+        << "  Feature size of " << field.vertex_lfs.size() << " vertices and " << field.grid_lfs.size()
+        << " grid points written to: " << lfsFile;
+    return true;
+}
+
+// Wall thickness of the input vertices from the medial spheres covering them
+bool writeThickness(const StageMA& maFile, const IndexedMesh& mesh, const CLIOptions& options) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("thickness") << "Error writing thickness report: " << error;
+        return false;
+    }
+
+    QMAT_LOG_INFO("thickness") << "Measuring wall thickness from " << maFile.file << "...";
+    clock_t startTime = clock();
+    ThicknessReport report;
+    ComputeThickness(ma, mesh, 0.001 * mesh.bb_diagonal_length, options.thicknessThreshold, 20, report);
+    long thicknessTime = clock() - startTime;
+    QMAT_LOG_INFO("thickness").Field("time_ms", thicknessTime) << "  Thickness time: " << thicknessTime << " ms";
+    QMAT_LOG_INFO("thickness").Field("min", report.min_thickness).Field("max", report.max_thickness)
+        .Field("mean", report.mean_thickness).Field("uncovered", report.uncovered)
+        << "  Thickness " << report.min_thickness << " to " << report.max_thickness
+        << ", mean " << report.mean_thickness << ", " << report.uncovered << " vertices uncovered";
+    if (options.thicknessThreshold > 0) {
+        QMAT_LOG_INFO("thickness").Field("threshold", options.thicknessThreshold).Field("regions", (unsigned)report.regions.size())
+            << "  " << report.regions.size() << " regions thinner than " << options.thicknessThreshold;
+    }
+
+    if (!report.Save(options.thicknessFile, error)) {
+        QMAT_LOG_ERROR("thickness") << "Error writing thickness report: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("thickness").Field("file", options.thicknessFile) << "  Thickness report written to: " << options.thicknessFile;
+    return true;
+}
+
+// Tessellate the envelope of an exported .ma, like writeChunks it goes through
+// the file so the raw and the simplified MA take the same path
+bool writeEnvelope(const StageMA& maFile, const CLIOptions& options) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("envelope") << "Error writing envelope: " << error;
+        return false;
+    }
+
+    QMAT_LOG_INFO("envelope") << "Tessellating envelope of " << maFile.file << "...";
+    clock_t startTime = clock();
+    EnvelopeMesh envelope;
+    double maxError = options.envelopeError * MedialBoundingDiagonal(ma);
+    BuildEnvelope(ma, maxError, envelope);
+    long envelopeTime = clock() - startTime;
+    QMAT_LOG_INFO("envelope").Field("time_ms", envelopeTime) << "  Envelope time: " << envelopeTime << " ms";
+    QMAT_LOG_INFO("envelope").Field("tessellated", envelope.triangles_tessellated)
+        .Field("clipped", envelope.triangles_clipped).Field("welded", envelope.vertices_welded)
+        << "  " << envelope.triangles_tessellated << " triangles tessellated, "
+        << envelope.triangles_clipped << " clipped as interior, "
+        << envelope.vertices_welded << " vertices welded";
+
+    if (!envelope.Save(options.envelopeFile, error)) {
+        QMAT_LOG_ERROR("envelope") << "Error writing envelope: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("envelope").Field("vertices", envelope.NumVertices()).Field("triangles", envelope.NumTriangles())
+        .Field("file", options.envelopeFile)
+        << "  Envelope (" << envelope.NumVertices() << " vertices, " << envelope.NumTriangles()
+        << " triangles) written to: " << options.envelopeFile;
+    return true;
+}
+
+// Split the final MA into convex pieces, optionally checked against its envelope
+bool writeCollision(const StageMA& maFile, const CLIOptions& options) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("collision") << "Error writing collision proxy: " << error;
+        return false;
+    }
+
+    QMAT_LOG_INFO("collision") << "Building collision proxy of " << maFile.file << "...";
+    clock_t startTime = clock();
+    CollisionProxy proxy;
+    BuildCollisionProxy(ma, proxy);
+    long proxyTime = clock() - startTime;
+    QMAT_LOG_INFO("collision").Field("time_ms", proxyTime) << "  Collision proxy time: " << proxyTime << " ms";
+    QMAT_LOG_INFO("collision").Field("pieces", proxy.NumPieces()).Field("points", proxy.NumPoints())
+        .Field("merged", proxy.points_merged).Field("spheres_in_cones", proxy.spheres_in_cones)
+        .Field("degenerate_slabs", proxy.slabs_degenerate)
+        << "  " << proxy.NumPieces() << " convex pieces, " << proxy.NumPoints() << " support points ("
+        << proxy.points_merged << " merged), " << proxy.spheres_in_cones << " spheres inside cones, "
+        << proxy.slabs_degenerate << " degenerate slabs";
+
+    if (options.checkCollision) {
+        startTime = clock();
+        EnvelopeMesh envelope;
+        double maxError = options.envelopeError * MedialBoundingDiagonal(ma);
+        BuildEnvelope(ma, maxError, envelope);
+        ProxyContainment containment;
+        bool contained = CheckProxyContainment(ma, proxy, envelope, maxError, containment);
+        long checkTime = clock() - startTime;
+        QMAT_LOG_INFO("collision").Field("time_ms", checkTime) << "  Containment check time: " << checkTime << " ms";
+        QMAT_LOG_INFO("collision").Field("points_checked", containment.points_checked)
+            .Field("points_outside", containment.points_outside).Field("max_outside", containment.max_outside)
+            .Field("samples_checked", containment.samples_checked)
+            .Field("samples_uncovered", containment.samples_uncovered).Field("max_uncovered", containment.max_uncovered)
+            << "  " << containment.points_outside << " of " << containment.points_checked
+            << " support points outside the envelope (max " << containment.max_outside << "), "
+            << containment.samples_uncovered << " of " << containment.samples_checked
+            << " envelope vertices uncovered (max " << containment.max_uncovered << ")";
+        if (!contained) {
+            QMAT_LOG_WARN("collision") << "  Collision proxy differs from the envelope by more than " << maxError;
+        }
+    }
+
+    if (!proxy.Save(options.collisionFile, error)) {
+        QMAT_LOG_ERROR("collision") << "Error writing collision proxy: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("collision").Field("file", options.collisionFile)
+        << "  Collision proxy written to: " << options.collisionFile;
+    return true;
+}
+
+// Write the final MA as capsules, meant for the result of --skeleton
+bool writeCapsules(const StageMA& maFile, const CLIOptions& options) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("capsules") << "Error writing capsules: " << error;
+        return false;
+    }
+
+    CapsuleSkeleton skeleton;
+    BuildCapsuleSkeleton(ma, skeleton);
+    if (!skeleton.Save(options.capsulesFile, error)) {
+        QMAT_LOG_ERROR("capsules") << "Error writing capsules: " << error;
+        return false;
+    }
+    if (skeleton.slabs_dropped > 0) {
+        QMAT_LOG_WARN("capsules").Field("slabs", skeleton.slabs_dropped)
+            << "  " << skeleton.slabs_dropped << " slabs are not represented by the capsules";
+    }
+    QMAT_LOG_INFO("capsules").Field("joints", skeleton.NumJoints()).Field("capsules", skeleton.NumCapsules())
+        .Field("file", options.capsulesFile)
+        << "  Capsules (" << skeleton.NumCapsules() << " capsules, " << skeleton.NumJoints()
+        << " joints) written to: " << options.capsulesFile;
+    return true;
+}
+
+bool saveStage(const MedialMeshData& ma, StageMA& stage, std::string& error) {
+    if (!stage.inMemory)
+        return ma.SaveMA(stage.file, error);
+    std::ostringstream out;
+    bool saved = ma.SaveMA(out, error);
+    stage.data = out.str();
+    return saved;
+}
+
+// Scale axis pruning of the raw MA, the result is written next to it and
+// replaces it as the input of the simplification
+bool writeScaleAxis(const StageMA& maFile, StageMA& prunedFile, const CLIOptions& options) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("sat") << "Error pruning MA: " << error;
+        return false;
+    }
+
+    QMAT_LOG_INFO("sat") << "Pruning MA with scale " << options.scaleAxis << "...";
+    clock_t startTime = clock();
+    MedialMeshData pruned;
+    ScaleAxisStats stats;
+    ScaleAxisPrune(ma, options.scaleAxis, pruned, stats);
+    long pruneTime = clock() - startTime;
+    QMAT_LOG_INFO("sat").Field("time_ms", pruneTime) << "  Pruning time: " << pruneTime << " ms";
+    QMAT_LOG_INFO("sat").Field("covered_single", stats.covered_single).Field("covered_union", stats.covered_union)
+        .Field("restored", stats.restored).Field("candidate_pairs", stats.candidate_pairs)
+        << "  " << stats.Removed() << " spheres removed (" << stats.covered_single << " inside one neighbour, "
+        << stats.covered_union << " inside the union, " << stats.restored << " kept for cycles)";
+
+    if (!saveStage(pruned, prunedFile, error)) {
+        QMAT_LOG_ERROR("sat") << "Error pruning MA: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("sat").Field("vertices", pruned.NumVertices()).Field("edges", pruned.NumEdges())
+        .Field("faces", pruned.NumFaces()).Field("file", prunedFile.file)
+        << "  Pruned MA (" << ma.NumVertices() << " -> " << pruned.NumVertices() << " vertices, "
+        << ma.NumFaces() << " -> " << pruned.NumFaces() << " faces) "
+        << (prunedFile.inMemory ? "kept in memory" : "written to: " + prunedFile.file);
+    return true;
+}
+
+// The part of the MA on the positive side of the mirror plane, it replaces the
+// MA as the input of the simplification
+bool writeSymmetricHalf(const StageMA& maFile, StageMA& halfFile, const SymmetryPlane& plane, double band) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("symmetry") << "Error clipping MA: " << error;
+        return false;
+    }
+
+    MedialMeshData half;
+    SymmetryClipStats stats;
+    ClipToHalf(ma, plane, band, half, stats);
+    if (!saveStage(half, halfFile, error)) {
+        QMAT_LOG_ERROR("symmetry") << "Error clipping MA: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("symmetry").Field("vertices", half.NumVertices()).Field("on_plane", stats.on_plane)
+        .Field("snapped", stats.snapped).Field("cut", stats.cut_vertices).Field("file", halfFile.file)
+        << "  Half MA (" << ma.NumVertices() << " -> " << half.NumVertices() << " vertices, "
+        << stats.on_plane << " on the plane, " << stats.cut_vertices << " of them cut) "
+        << (halfFile.inMemory ? "kept in memory" : "written to: " + halfFile.file);
+    return true;
+}
+
+// The last half MA and its mirror image, the final MA of a symmetric run
+bool writeMirrored(const StageMA& halfFile, StageMA& fullFile, const SymmetryPlane& plane, double band) {
+    MedialMeshData half;
+    std::string error;
+    if (!loadStage(halfFile, half, error)) {
+        QMAT_LOG_ERROR("symmetry") << "Error mirroring MA: " << error;
+        return false;
+    }
+
+    MedialMeshData full;
+    MirrorHalf(half, plane, band, full);
+    if (!saveStage(full, fullFile, error)) {
+        QMAT_LOG_ERROR("symmetry") << "Error mirroring MA: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("symmetry").Field("vertices", full.NumVertices()).Field("edges", full.NumEdges())
+        .Field("faces", full.NumFaces()).Field("file", fullFile.file)
+        << "  Mirrored MA (" << full.NumVertices() << " vertices, " << full.NumFaces() << " faces) "
+        << (fullFile.inMemory ? "kept in memory" : "written to: " + fullFile.file);
+    return true;
+}
+
+// The final MA of the representatives placed at every copy, with the list of
+// copies and their motions
+bool writeInstanced(const StageMA& maFile, StageMA& instancedFile, const IndexedMesh& representatives,
+                    const std::vector<unsigned>& vertexClass, const CongruenceClasses& congruence,
+                    const CLIOptions& options) {
+    MedialMeshData ma;
+    std::string error;
+    if (!loadStage(maFile, ma, error)) {
+        QMAT_LOG_ERROR("instance") << "Error instancing MA: " << error;
+        return false;
+    }
+
+    MedialMeshData instanced;
+    std::vector<unsigned> firstVertex;
+    InstanceMedialMesh(ma, representatives, vertexClass, congruence, instanced, firstVertex);
+    if (!saveStage(instanced, instancedFile, error) || !congruence.Save(options.instanceFile, firstVertex, error)) {
+        QMAT_LOG_ERROR("instance") << "Error instancing MA: " << error;
+        return false;
+    }
+    QMAT_LOG_INFO("instance").Field("vertices", instanced.NumVertices()).Field("faces", instanced.NumFaces())
+        .Field("file", instancedFile.file)
+        << "  Instanced MA (" << ma.NumVertices() << " -> " << instanced.NumVertices() << " vertices) "
+        << (instancedFile.inMemory ? "kept in memory" : "written to: " + instancedFile.file);
+    QMAT_LOG_INFO("instance").Field("file", options.instanceFile)
+        << "  Copies (" << congruence.NumComponents() << " in " << congruence.NumClasses()
+        << " classes) written to: " << options.instanceFile;
+    return true;
+}
+
+// Inside/outside queries of the cell labeling, the input mesh of the shape owns them
+bool attachDomain(ThreeDimensionalShape& shape, const IndexedMesh& mesh, std::string& error) {
+    MeshDomain* domain = new MeshDomain;
+    if (!domain->Build(mesh, error)) {
+        delete domain;
+        return false;
+    }
+    shape.input.domain = domain;
+    shape.input_nmm.domain = domain;
+    return true;
+}
+
+// 0 keeps the OpenMP default
+void setThreads(int threads) {
+#ifdef _OPENMP
+    if (threads > 0)
+        omp_set_num_threads(threads);
+#else
+    (void)threads;
+#endif
+}
+
+AutotuneConfig autotuneConfigOf(const CLIOptions& options, unsigned inputVertices, int maxThreads) {
+    AutotuneConfig config;
+    config.hyperbolic_weight_type = options.hyperbolicWeightType;
+    config.preserve_boundary_method = options.boundaryMethod;
+    config.prevent_inversion = options.preventInversion;
+    config.reorder = options.reorder;
+    config.powercrust = options.labeling == POWERCRUST;
+    config.threads = options.threads > 0 ? options.threads : maxThreads;
+    if (options.simplifyTarget > 0 && inputVertices > 0)
+        config.simplify_fraction = (double)options.simplifyTarget / inputVertices;
+    return config;
+}
+
+// The target is only taken over when setTarget, an explicit --simplify stays
+void applyAutotuneConfig(CLIOptions& options, const AutotuneConfig& config, unsigned inputVertices, bool setTarget) {
+    options.hyperbolicWeightType = config.hyperbolic_weight_type;
+    options.boundaryMethod = config.preserve_boundary_method;
+    options.preventInversion = config.prevent_inversion;
+    options.reorder = config.reorder;
+    options.labeling = config.powercrust ? POWERCRUST : EXACT_QUERY;
+    options.threads = config.threads;
+    if (setTarget)
+        options.simplifyTarget = std::max(1, (int)(config.simplify_fraction * inputVertices + 0.5));
+}
+
+void logAutotuneConfig(const AutotuneConfig& config, const char* message) {
+    std::ostringstream settings;
+    for (unsigned axis = 0; axis < AUTOTUNE_AXES; axis++)
+        settings << " " << AutotuneAxisName(axis) << "=" << AutotuneAxisValue(config, axis);
+    QMAT_LOG_INFO("autotune").Field("weight", config.hyperbolic_weight_type)
+        .Field("boundary", config.preserve_boundary_method).Field("prevent_inversion", config.prevent_inversion)
+        .Field("powercrust", config.powercrust).Field("reorder", config.reorder)
+        .Field("threads", config.threads).Field("fraction", config.simplify_fraction)
+        << "  " << message << ":" << settings.str();
+}
+
+// DT, MA and simplification of a decimated copy in memory, the same steps as
+// the full run without the optional outputs
+bool runAutotunePipeline(const IndexedMesh& sample, const CLIOptions& options, AutotuneTrial& trial, std::string& error) {
+    ThreeDimensionalShape trialShape;
+    if (!BuildPolyhedron(sample, trialShape.input, error))
+        return false;
+    trialShape.input.GenerateList();
+    if (!trialShape.input.CopyAttributes(sample)) {
+        error = "Polyhedron lost vertices of the decimated copy";
+        return false;
+    }
+
+    // wall time, the thread count is one of the settings
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    trialShape.input.m_cell_labeling = options.labeling;
+    if (options.labeling == EXACT_QUERY && !attachDomain(trialShape, sample, error))
+        return false;
+    trialShape.input_nmm.pmesh = &trialShape.input;
+    trialShape.input_nmm.meshname = options.outputPrefix;
+    trialShape.input.computedt();
+    if (!trialShape.input.ambiguous_cells.empty() && sample.NumFaces() > 0) {
+        if (!attachDomain(trialShape, sample, error))
+            return false;
+        trialShape.input.ResolveAmbiguousCells();
+    }
+    std::ostringstream rawMA;
+    trialShape.ComputeInputNMM(&rawMA);
+
+    setupSlabMesh(trialShape, options);
+    std::istringstream rawIn(rawMA.str());
+    trialShape.LoadInputNMM(rawIn);
+    if (options.reorder)
+        trialShape.slab_mesh.SpatialReorder();
+    trialShape.LoadSlabMesh();
+    int currentVertices = trialShape.slab_mesh.numVertices;
+    if (options.simplifyTarget < currentVertices) {
+        trialShape.slab_mesh.CleanIsolatedVertices();
+        trialShape.slab_mesh.Simplify(currentVertices - options.simplifyTarget);
+    }
+    trial.vertices = sample.NumVertices();
+    trial.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // the error is not part of the time
+    std::ostringstream simplified;
+    trialShape.slab_mesh.Export(simplified);
+    std::istringstream simplifiedIn(simplified.str());
+    MedialMeshData ma;
+    if (!ma.LoadMA(simplifiedIn, error))
+        return false;
+    trial.error = MedialSurfaceDeviation(ma, sample);
+    return true;
+}
+
+// One trial with the settings of config, the pipeline only logs warnings and errors
+bool runAutotuneTrial(const IndexedMesh& sample, const CLIOptions& options, const AutotuneConfig& config,
+                      AutotuneTrial& trial) {
+    CLIOptions trialOptions = options;
+    applyAutotuneConfig(trialOptions, config, sample.NumVertices(), true);
+    setThreads(trialOptions.threads);
+
+    Logger::Instance().SetLevel(std::max(options.logLevel, LOG_WARN));
+    std::string error;
+    bool done = runAutotunePipeline(sample, trialOptions, trial, error);
+    Logger::Instance().SetLevel(options.logLevel);
+    if (!done) {
+        QMAT_LOG_WARN("autotune") << "  Trial failed: " << error;
+    }
+    return done;
+}
+
+void decimateForAutotune(const IndexedMesh& mesh, unsigned vertices, IndexedMesh& copy) {
+    DecimateMesh(mesh, vertices, copy);
+    copy.BuildAdjacency();
+    copy.computebb();
+    copy.GenerateRandomColor();
+    copy.compute_normals();
+}
+
+// Coordinate descent over the settings: each one in turn is varied on the larger
+// copy with the others fixed, and the best prediction under the budget is kept.
+// The target goes first, to the smallest one within the budget. When the given
+// settings fail on the copy, finer and then coarser copies are tried; when they
+// fail on all of them the job runs untuned.
+bool runAutotune(const IndexedMesh& mesh, CLIOptions& options, int maxThreads, AutotuneProfile& profile) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned n = mesh.NumVertices();
+    bool tuneTarget = options.simplifyTarget <= 0;
+    AutotuneBudget budget;
+    budget.time_ms = options.timeBudget > 0 ? options.timeBudget * 1000. : 0.;
+    budget.error = options.errorBudget > 0 ? options.errorBudget : 0.;
+
+    // the smaller copy only fits the exponent of the time model
+    AutotuneConfig best = autotuneConfigOf(options, n, maxThreads);
+    AutotuneModel model;
+    AutotuneTrial bestTrial, smallTrial;
+    unsigned trials = 0;
+    IndexedMesh copies[2];
+    const double cellScales[] = {1., 2., 0.5, 0.25};
+    bool usable = false;
+    unsigned lastVertices = 0;
+    for (int i = 0; i < 4 && !usable; i++) {
+        unsigned vertices = std::max(64u, (unsigned)(options.autotuneSample * cellScales[i]));
+        decimateForAutotune(mesh, vertices, copies[1]);
+        if (copies[1].NumVertices() == lastVertices)
+            continue;
+        lastVertices = copies[1].NumVertices();
+        usable = runAutotuneTrial(copies[1], options, best, bestTrial);
+        if (!usable) {
+            QMAT_LOG_WARN("autotune").Field("vertices", copies[1].NumVertices())
+                << "Warning: the given settings fail on the copy with " << copies[1].NumVertices()
+                << " vertices, retrying with another cell size";
+        }
+    }
+    if (!usable) {
+        QMAT_LOG_WARN("autotune") << "Warning: the given settings fail on every decimated copy, "
+                                  << "running the job with them untuned and without a profile";
+        logAutotuneConfig(best, "Untuned settings");
+        return true;
+    }
+    trials++;
+    decimateForAutotune(mesh, copies[1].NumVertices() / 2, copies[0]);
+    QMAT_LOG_INFO("autotune").Field("small", copies[0].NumVertices()).Field("large", copies[1].NumVertices())
+        << "  Decimated copies with " << copies[0].NumVertices() << " and " << copies[1].NumVertices() << " vertices";
+    if (copies[0].NumVertices() < copies[1].NumVertices() && runAutotuneTrial(copies[0], options, best, smallTrial)) {
+        trials++;
+        model.Fit(smallTrial, bestTrial);
+    }
+    double bestTime = model.PredictTime(bestTrial, n);
+    double bestError = bestTrial.error;
+    QMAT_LOG_INFO("autotune").Field("exponent", model.exponent)
+        << "  Time model: t ~ n^" << model.exponent << " from " << smallTrial.time_ms << " ms and "
+        << bestTrial.time_ms << " ms";
+    QMAT_LOG_INFO("autotune").Field("predicted_ms", bestTime).Field("error", bestError)
+        << "  Given settings: " << (long long)bestTime << " ms, error " << bestError;
+
+    for (unsigned axis = 0; axis < AUTOTUNE_AXES; axis++) {
+        if (axis == AUTOTUNE_TARGET && !tuneTarget)
+            continue;
+        std::vector<AutotuneConfig> variants;
+        AutotuneVariants(best, axis, maxThreads, variants);
+        for (size_t i = 0; i < variants.size(); i++) {
+            AutotuneTrial trial;
+            if (!runAutotuneTrial(copies[1], options, variants[i], trial))
+                continue;
+            trials++;
+            double time = model.PredictTime(trial, n);
+            QMAT_LOG_DEBUG("autotune").Field("setting", AutotuneAxisName(axis))
+                .Field("value", AutotuneAxisValue(variants[i], axis)).Field("predicted_ms", time).Field("error", trial.error)
+                << "  " << AutotuneAxisName(axis) << "=" << AutotuneAxisValue(variants[i], axis) << ": "
+                << (long long)time << " ms, error " << trial.error;
+
+            bool better;
+            if (axis == AUTOTUNE_TARGET) {
+                bool fits = budget.Fits(time, trial.error);
+                if (budget.Fits(bestTime, bestError))
+                    better = fits && variants[i].simplify_fraction < best.simplify_fraction;
+                else
+                    better = fits || budget.Overshoot(time, trial.error) < budget.Overshoot(bestTime, bestError);
+            } else {
+                better = AutotuneBetter(time, trial.error, bestTime, bestError, budget);
+            }
+            if (better) {
+                best = variants[i];
+                bestTime = time;
+                bestError = trial.error;
+            }
+        }
+    }
+    long long tuneTime = (long long)std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    QMAT_LOG_INFO("autotune").Field("trials", trials).Field("time_ms", tuneTime)
+        << "  " << trials << " trials in " << tuneTime << " ms";
+    if (!budget.Fits(bestTime, bestError)) {
+        QMAT_LOG_WARN("autotune") << "Warning: no settings are predicted to fit the budget, taking the closest";
+    }
+
+    profile.config = best;
+    profile.input_vertices = n;
+    profile.predicted_time_ms = bestTime;
+    profile.predicted_error = bestError;
+    profile.exponent = model.exponent;
+    profile.trials = trials;
+    std::string error;
+    if (!profile.Save(options.autotuneProfile, error)) {
+        QMAT_LOG_ERROR("autotune") << "Error writing profile: " << error;
+        return false;
+    }
+    applyAutotuneConfig(options, best, n, tuneTarget);
+    setThreads(options.threads);
+    logAutotuneConfig(best, "Chosen settings");
+    QMAT_LOG_INFO("autotune").Field("predicted_ms", bestTime).Field("error", bestError).Field("target", options.simplifyTarget)
+        .Field("file", options.autotuneProfile)
+        << "  Predicted " << (long long)bestTime << " ms, error " << bestError << ", target " << options.simplifyTarget
+        << " vertices, profile written to: " << options.autotuneProfile;
+    return true;
+}
+
 int main(int argc, char* argv[]) {
 
-    std::cout << "argc = " << argc << "\n";
-    for (int i = 0; i < argc; ++i)
-        std::cout << "argv[" << i << "] = [" << argv[i] << "]\n";
     // Parse command line arguments
     CLIOptions options = parseArguments(argc, argv);
 
@@ -176,146 +1574,473 @@ int main(int argc, char* argv[]) {
     }
 
     if (!options.valid) {
-        std::cerr << "Error: " << options.errorMessage << std::endl;
-        std::cerr << "Use --help for usage information." << std::endl;
+        QMAT_LOG_ERROR("cli") << "Error: " << options.errorMessage;
+        QMAT_LOG_ERROR("cli") << "Use --help for usage information.";
+        return 1;
+    }
+
+    // stdin and stdout carry the mesh and the MA in a pipeline
+    if (options.inputFile == "-" || options.maOutput == "-")
+        std::ios::sync_with_stdio(false);
+
+    Logger& logger = Logger::Instance();
+    if (options.maOutput == "-")
+        logger.UseStderr();
+    logger.SetLevel(options.logLevel);
+    logger.SetFormat(options.logJson ? Logger::JSON : Logger::TEXT);
+    std::string logError;
+    if (!options.logFile.empty() && !logger.SetFile(options.logFile, logError)) {
+        QMAT_LOG_ERROR("cli") << "Error: " << logError;
         return 1;
     }
+    for (int i = 0; i < argc; ++i)
+        QMAT_LOG_DEBUG("cli") << "argv[" << i << "] = [" << argv[i] << "]";
+
+    // the autotuner tries fractions of the cores present
+    int maxThreads = 1;
+#ifdef _OPENMP
+    maxThreads = omp_get_max_threads();
+#endif
+    setThreads(options.threads);
 
-    std::cout << "QMAT CLI - Medial Axis Computation" << std::endl;
-    std::cout << "===================================" << std::endl;
-    std::cout << "Input file: " << options.inputFile << std::endl;
-    std::cout << "Output prefix: " << options.outputPrefix << std::endl;
-    std::cout << "K value: " << options.k << std::endl;
+    QMAT_LOG_INFO("cli") << "QMAT CLI - Medial Axis Computation";
+    QMAT_LOG_INFO("cli") << "===================================";
+    QMAT_LOG_INFO("cli").Field("input", options.inputFile) << "Input file: " << options.inputFile;
+    QMAT_LOG_INFO("cli").Field("output", options.outputPrefix) << "Output prefix: " << options.outputPrefix;
+    if (!options.maOutput.empty()) {
+        QMAT_LOG_INFO("cli").Field("ma_output", options.maOutput)
+            << "MA output: " << (options.maOutput == "-" ? "stdout" : options.maOutput);
+    }
+    QMAT_LOG_INFO("cli").Field("k", options.k) << "K value: " << options.k;
     if (options.simplifyTarget > 0) {
-        std::cout << "Simplify target: " << options.simplifyTarget << " vertices" << std::endl;
+        QMAT_LOG_INFO("cli").Field("target", options.simplifyTarget)
+            << "Simplify target: " << options.simplifyTarget << " vertices";
+    }
+    if (options.skeletonCapsules > 0) {
+        QMAT_LOG_INFO("cli").Field("capsules", options.skeletonCapsules)
+            << "Skeleton target: " << options.skeletonCapsules << " capsules";
     }
-    std::cout << std::endl;
 
     // Create ThreeDimensionalShape object
     ThreeDimensionalShape shape;
 
     // Step 1: Load the mesh file (OFF or OBJ)
-    std::cout << "Loading mesh from " << options.inputFile << "..." << std::endl;
+    QMAT_LOG_INFO("load") << "Loading mesh from " << (options.inputFile == "-" ? "stdin" : options.inputFile) << "...";
     long startTime = clock();
+    long loadStartTime = startTime;
+
+    // Parse the file once into a flat indexed mesh, the per-element passes run
+    // on its arrays and both polyhedra below are built from it
+    IndexedMesh indexedMesh;
+    std::string loadError;
+    std::string format = options.inputFormat;
+    if (format.empty())
+        format = options.inputFile == "-" ? "off" : GetFileExtension(options.inputFile);
+    if (format != "obj" && format != "off") {
+        QMAT_LOG_ERROR("load") << "Error: Unsupported file format. Use .off or .obj files.";
+        return 1;
+    }
+    bool loaded;
+    if (options.inputFile == "-") {
+        loaded = LoadMeshStream(std::cin, format, indexedMesh, loadError);
+    } else if (options.inputFormat.empty()) {
+        loaded = LoadMeshFile(options.inputFile, indexedMesh, loadError);
+    } else {
+        std::ifstream in(options.inputFile.c_str());
+        loadError = "Could not open file " + options.inputFile;
+        loaded = in && LoadMeshStream(in, format, indexedMesh, loadError);
+    }
+    if (!loaded) {
+        QMAT_LOG_ERROR("load") << "Error loading mesh file: " << loadError;
+        return 1;
+    }
+    // the load time leaves out the preflight and the congruence search
+    long parseTime = clock() - loadStartTime;
 
-    bool loadSuccess = false;
-    if (IsObjFile(options.inputFile)) {
-        // Load OBJ file using tinyobjloader
-        std::string objError;
-        loadSuccess = LoadObjFile(options.inputFile, shape.input, objError);
-        if (!loadSuccess) {
-            std::cerr << "Error loading OBJ file: " << objError << std::endl;
+    // Step 1a: Preflight, check the mesh and predict the job before any heavy work
+    if (options.preflight || options.maxCells > 0 || options.maxMemoryMB > 0) {
+        PreflightCostModel model;
+        if (!options.costModelFile.empty() && !model.Load(options.costModelFile, loadError)) {
+            QMAT_LOG_ERROR("preflight") << "Error: " << loadError;
             return 1;
         }
-    } else if (IsOffFile(options.inputFile)) {
-        // Load OFF file using CGAL
-        std::ifstream stream(options.inputFile.c_str());
-        if (!stream) {
-            std::cerr << "Error: Could not open file " << options.inputFile << std::endl;
-            return 1;
+        PreflightReport report;
+        RunPreflight(indexedMesh, model, options.labeling == POWERCRUST, options.simplifyTarget, 2000, report);
+        if (options.preflight) {
+            // the report is the output of the run, not a log message
+            Logger::Instance().Flush();
+            report.Print(std::cout);
+            std::cout.flush();
         }
-        stream >> shape.input;
-        stream.close();
-        loadSuccess = true;
-    } else {
-        std::cerr << "Error: Unsupported file format. Use .off or .obj files." << std::endl;
-        return 1;
+
+        bool refused = false;
+        const char* calibration = model.source.empty() ? " (uncalibrated default cost model)" : "";
+        if (options.maxCells > 0 && report.dt_cells.estimate > options.maxCells) {
+            QMAT_LOG_ERROR("preflight").Field("predicted_cells", report.dt_cells.estimate)
+                << "Refused: predicted " << (long long)report.dt_cells.estimate
+                << " Delaunay cells exceed the limit of " << (long long)options.maxCells << calibration;
+            refused = true;
+        }
+        if (options.maxMemoryMB > 0 && report.peak_memory_mb.estimate > options.maxMemoryMB) {
+            QMAT_LOG_ERROR("preflight").Field("predicted_memory_mb", report.peak_memory_mb.estimate)
+                << "Refused: predicted " << (long long)report.peak_memory_mb.estimate
+                << " MB peak memory exceeds the limit of " << (long long)options.maxMemoryMB << " MB" << calibration;
+            refused = true;
+        }
+        if (refused)
+            return 2;
+        if (options.preflight)
+            return 0;
+    }
+
+    // Step 1b: Congruent components, the pipeline sees one representative per class
+    CongruenceClasses congruence;
+    std::vector<unsigned> vertexClass;
+    if (!options.instanceFile.empty()) {
+        QMAT_LOG_INFO("instance") << "Finding congruent components...";
+        startTime = clock();
+        FindCongruentComponents(indexedMesh, options.instanceTolerance, congruence);
+        IndexedMesh representatives;
+        ExtractRepresentatives(indexedMesh, congruence, representatives, vertexClass);
+        long congruenceTime = clock() - startTime;
+        QMAT_LOG_INFO("instance").Field("time_ms", congruenceTime) << "  Congruence time: " << congruenceTime << " ms";
+        QMAT_LOG_INFO("instance").Field("components", congruence.NumComponents()).Field("classes", congruence.NumClasses())
+            .Field("vertices", representatives.NumVertices())
+            << "  " << congruence.NumComponents() << " components in " << congruence.NumClasses()
+            << " congruence classes, " << indexedMesh.NumVertices() << " -> " << representatives.NumVertices() << " vertices";
+        // the vertex budget is spent on the representatives in proportion
+        if (options.simplifyTarget > 0 && indexedMesh.NumVertices() > 0) {
+            options.simplifyTarget = std::max(1, (int)((double)options.simplifyTarget * representatives.NumVertices()
+                                                       / indexedMesh.NumVertices() + 0.5));
+            QMAT_LOG_INFO("instance").Field("target", options.simplifyTarget)
+                << "  Simplification target of the representatives: " << options.simplifyTarget;
+        }
+        indexedMesh = std::move(representatives);
     }
 
     // Compute mesh properties
-    shape.input.computebb();
+    loadStartTime = clock();
+    indexedMesh.BuildAdjacency();
+    indexedMesh.computebb();
+    indexedMesh.GenerateRandomColor();
+    indexedMesh.compute_normals();
+
+    if (!BuildPolyhedron(indexedMesh, shape.input, loadError)) {
+        QMAT_LOG_ERROR("load") << "Error building mesh: " << loadError;
+        return 1;
+    }
     shape.input.GenerateList();
-    shape.input.GenerateRandomColor();
-    shape.input.compute_normals();
+    if (!shape.input.CopyAttributes(indexedMesh)) {
+        QMAT_LOG_ERROR("load") << "Error building mesh: the polyhedron lost vertices of the input";
+        return 1;
+    }
 
-    long loadTime = clock() - startTime;
-    std::cout << "  Loaded mesh with " << shape.input.size_of_vertices() << " vertices, "
-              << shape.input.size_of_facets() << " faces" << std::endl;
-    std::cout << "  Load time: " << loadTime << " ms" << std::endl;
+    long loadTime = parseTime + (clock() - loadStartTime);
+    QMAT_LOG_INFO("load").Field("vertices", (unsigned long long)shape.input.size_of_vertices())
+        .Field("faces", (unsigned long long)shape.input.size_of_facets())
+        << "  Loaded mesh with " << shape.input.size_of_vertices() << " vertices, "
+        << shape.input.size_of_facets() << " faces";
+    QMAT_LOG_INFO("load").Field("time_ms", loadTime) << "  Load time: " << loadTime << " ms";
 
-    // Step 2: Create CGAL mesh domain for inside/outside queries
-    std::cout << "Creating mesh domain..." << std::endl;
-    Polyhedron pol;
-    if (IsObjFile(options.inputFile)) {
-        // Load OBJ file for mesh domain
-        std::string objError;
-        if (!LoadObjFile(options.inputFile, pol, objError)) {
-            std::cerr << "Error loading OBJ file for mesh domain: " << objError << std::endl;
+    // Step 1c: Mirror plane of the input, the MA is simplified on one half
+    SymmetryPlane plane;
+    bool symmetric = false;
+    double symmetryBand = options.symmetryTolerance * indexedMesh.bb_diagonal_length;
+    if (options.symmetry) {
+        QMAT_LOG_INFO("symmetry") << "Detecting reflective symmetry...";
+        startTime = clock();
+        symmetric = DetectReflectiveSymmetry(indexedMesh, options.symmetryTolerance, plane);
+        long symmetryTime = clock() - startTime;
+        QMAT_LOG_INFO("symmetry").Field("time_ms", symmetryTime) << "  Detection time: " << symmetryTime << " ms";
+        if (symmetric) {
+            QMAT_LOG_INFO("symmetry").Field("nx", plane.normal[0]).Field("ny", plane.normal[1])
+                .Field("nz", plane.normal[2]).Field("offset", plane.offset).Field("deviation", plane.deviation)
+                << "  Mirror plane (" << plane.normal[0] << ", " << plane.normal[1] << ", " << plane.normal[2]
+                << ") . x = " << plane.offset << ", deviation " << plane.deviation;
+        } else {
+            QMAT_LOG_WARN("symmetry").Field("candidates", plane.candidates_tested)
+                << "Warning: none of " << plane.candidates_tested
+                << " candidate planes is a mirror plane, processing the whole MA";
+        }
+    }
+
+    // Step 1d: Degenerate samples are jittered for the Delaunay triangulation only,
+    // the surface, the domain and the reported distances keep the original positions
+    if (options.perturb) {
+        QMAT_LOG_INFO("perturb") << "Detecting degenerate samples...";
+        startTime = clock();
+        std::vector<char> degenerate;
+        DegeneracyStats stats;
+        DetectDegenerateVertices(indexedMesh, 1e-6, degenerate, stats);
+        PerturbDegenerateVertices(indexedMesh, degenerate, options.perturbMagnitude, options.perturbSeed,
+                                  shape.input.dt_offset, stats);
+        long perturbTime = clock() - startTime;
+        QMAT_LOG_INFO("perturb").Field("time_ms", perturbTime) << "  Detection time: " << perturbTime << " ms";
+        QMAT_LOG_INFO("perturb").Field("degenerate", stats.degenerate).Field("coincident", stats.coincident)
+            .Field("cospherical", stats.cospherical).Field("cocircular", stats.cocircular)
+            .Field("max_displacement", stats.max_displacement)
+            << "  Perturbed " << stats.perturbed << " of " << indexedMesh.NumVertices() << " samples ("
+            << stats.cospherical << " cospherical, " << stats.cocircular << " cocircular, "
+            << stats.coincident << " coincident), largest displacement " << stats.max_displacement;
+        if (stats.perturbed == 0)
+            shape.input.dt_offset.clear();
+    }
+
+    // Step 1e: Settings from a profile or tuned on a decimated copy, before any of them is used
+    if (!options.profileFile.empty()) {
+        AutotuneProfile profile;
+        if (!profile.Load(options.profileFile, loadError)) {
+            QMAT_LOG_ERROR("autotune") << "Error: " << loadError;
             return 1;
         }
-    } else {
-        // Load OFF file for mesh domain
-        std::ifstream streamPol(options.inputFile.c_str());
-        streamPol >> pol;
-        streamPol.close();
+        applyAutotuneConfig(options, profile.config, indexedMesh.NumVertices(), options.simplifyTarget <= 0);
+        setThreads(options.threads);
+        QMAT_LOG_INFO("autotune").Field("file", options.profileFile) << "Settings of profile " << options.profileFile;
+        logAutotuneConfig(profile.config, "Profile settings");
+    } else if (options.autotune) {
+        QMAT_LOG_INFO("autotune").Field("time_budget_s", options.timeBudget).Field("error_budget", options.errorBudget)
+            << "Autotuning on a decimated copy...";
+        AutotuneProfile profile;
+        if (!runAutotune(indexedMesh, options, maxThreads, profile))
+            return 1;
     }
 
-    Mesh_domain* domain = new Mesh_domain(pol);
-    shape.input.domain = domain;
-    shape.input_nmm.domain = domain;
+    // Step 2: Create CGAL mesh domain for inside/outside queries
+    // With power crust labeling the domain is only built if some cells stay ambiguous
+    shape.input.m_cell_labeling = options.labeling;
+    if (options.labeling == EXACT_QUERY) {
+        QMAT_LOG_INFO("domain") << "Creating mesh domain...";
+        if (!attachDomain(shape, indexedMesh, loadError)) {
+            QMAT_LOG_ERROR("domain") << "Error building mesh domain: " << loadError;
+            return 1;
+        }
+    }
     shape.input_nmm.pmesh = &shape.input;
     shape.input_nmm.meshname = options.outputPrefix;
 
     // Step 3: Compute Delaunay Triangulation and Medial Axis
-    std::cout << "Computing Delaunay Triangulation..." << std::endl;
+    QMAT_LOG_INFO("dt") << "Computing Delaunay Triangulation...";
     startTime = clock();
     shape.input.computedt();
+    if (!shape.input.ambiguous_cells.empty() && indexedMesh.NumFaces() > 0) {
+        QMAT_LOG_INFO("domain") << "Creating mesh domain for ambiguous cells...";
+        if (!attachDomain(shape, indexedMesh, loadError)) {
+            QMAT_LOG_ERROR("domain") << "Error building mesh domain: " << loadError;
+            return 1;
+        }
+        unsigned resolved = shape.input.ResolveAmbiguousCells();
+        QMAT_LOG_INFO("dt").Field("resolved", resolved) << "  Resolved " << resolved << " ambiguous cells by exact queries";
+    }
     long dtTime = clock() - startTime;
-    std::cout << "  DT computation time: " << dtTime << " ms" << std::endl;
+    QMAT_LOG_INFO("dt").Field("time_ms", dtTime) << "  DT computation time: " << dtTime << " ms";
 
-    std::cout << "Computing Medial Axis..." << std::endl;
+    QMAT_LOG_INFO("ma") << "Computing Medial Axis...";
     startTime = clock();
-    shape.ComputeInputNMM();
+    // the envelope is built from the last MA written
+    StageMA finalMaFile;
+    finalMaFile.file = options.outputPrefix + ".ma";
+    finalMaFile.inMemory = !options.maOutput.empty();
+    if (finalMaFile.inMemory) {
+        std::ostringstream out;
+        shape.ComputeInputNMM(&out);
+        finalMaFile.data = out.str();
+    } else {
+        shape.ComputeInputNMM();
+    }
     long maTime = clock() - startTime;
-    std::cout << "  MA computation time: " << maTime << " ms" << std::endl;
-    std::cout << "  Raw MA exported to: " << options.outputPrefix << ".ma" << std::endl;
+    QMAT_LOG_INFO("ma").Field("time_ms", maTime) << "  MA computation time: " << maTime << " ms";
+    QMAT_LOG_INFO("ma").Field("vertices", shape.num_vor_v).Field("edges", shape.num_vor_e).Field("faces", shape.num_vor_f)
+        << "  Raw MA with " << shape.num_vor_v << " vertices, " << shape.num_vor_e << " edges, "
+        << shape.num_vor_f << " faces";
+    if (finalMaFile.inMemory) {
+        QMAT_LOG_INFO("ma").Field("bytes", (unsigned long long)finalMaFile.data.size())
+            << "  Raw MA kept in memory (" << finalMaFile.data.size() << " bytes)";
+    } else {
+        QMAT_LOG_INFO("ma").Field("file", finalMaFile.file) << "  Raw MA exported to: " << finalMaFile.file;
+    }
+    if (options.chunks && !writeChunks(finalMaFile))
+        return 1;
+    if (options.featureSize) {
+        if (!options.instanceFile.empty()) {
+            QMAT_LOG_WARN("lfs") << "Warning: with --instances the feature size covers the representatives only";
+        }
+        if (!writeFeatureSize(finalMaFile, shape.input, indexedMesh, options))
+            return 1;
+    }
+
+    // Step 3b: Scale axis pruning, the simplification starts from the pruned MA
+    if (options.scaleAxis > 0) {
+        StageMA prunedFile;
+        prunedFile.file = options.outputPrefix + "_sat.ma";
+        prunedFile.inMemory = finalMaFile.inMemory;
+        if (!writeScaleAxis(finalMaFile, prunedFile, options))
+            return 1;
+        if (options.chunks && !writeChunks(prunedFile))
+            return 1;
+        finalMaFile = std::move(prunedFile);
+    }
+
+    // Step 3c: Only the half on the positive side of the mirror plane is simplified
+    if (symmetric) {
+        StageMA halfFile;
+        halfFile.file = options.outputPrefix + "_half.ma";
+        halfFile.inMemory = finalMaFile.inMemory;
+        if (!writeSymmetricHalf(finalMaFile, halfFile, plane, symmetryBand))
+            return 1;
+        finalMaFile = std::move(halfFile);
+    }
 
     // Step 4: If simplification requested, load into slab mesh and simplify
     if (options.simplifyTarget > 0) {
-        std::cout << std::endl << "Loading MA for simplification..." << std::endl;
+        QMAT_LOG_INFO("slab") << "Loading MA for simplification...";
 
         // Setup slab mesh
-        shape.slab_mesh.pmesh = &shape.input;
-        shape.slab_mesh.type = 1;
-        shape.slab_mesh.k = options.k;
-        shape.slab_mesh.bound_weight = 1.0;
+        setupSlabMesh(shape, options);
+
+        // Load the MA we just exported into the slab mesh
+        const StageMA& maFile = finalMaFile;
+        loadStageSlab(shape, maFile);
 
-        // Initialize slab mesh settings (same as GUI initialize())
-        shape.slab_mesh.preserve_boundary_method = 0;
-        shape.slab_mesh.hyperbolic_weight_type = 3;
-        shape.slab_mesh.compute_hausdorff = false;
-        shape.slab_mesh.boundary_compute_scale = 0;
-        shape.slab_mesh.prevent_inversion = false;
+        QMAT_LOG_INFO("slab").Field("vertices", shape.slab_mesh.numVertices)
+            << "  Loaded slab mesh with " << shape.slab_mesh.numVertices << " vertices";
 
-        // Load the MA file we just exported into the slab mesh
-        std::string maFile =  options.outputPrefix + ".ma";
-        shape.LoadInputNMM(maFile);
+        // The .ma order follows the DT cell iteration, which is spatially random
+        if (options.reorder) {
+            startTime = clock();
+            shape.slab_mesh.SpatialReorder();
+            long reorderTime = clock() - startTime;
+            QMAT_LOG_INFO("slab").Field("reorder_ms", reorderTime) << "  Spatial reorder time: " << reorderTime << " ms";
+        }
 
-        std::cout << "  Loaded slab mesh with " << shape.slab_mesh.numVertices << " vertices" << std::endl;
+        // The vertices on the plane are shared by both halves
+        int target = options.simplifyTarget;
+        if (symmetric) {
+            unsigned planeVertices = applySymmetryPlane(shape, plane, indexedMesh, options);
+            target = (options.simplifyTarget + (int)planeVertices + 1) / 2;
+            QMAT_LOG_INFO("symmetry").Field("on_plane", planeVertices).Field("half_target", target)
+                << "  " << planeVertices << " vertices on the mirror plane, simplifying the half to " << target;
+        }
+        shape.slab_mesh.spatial_order_export = options.reorderExport;
 
         // Initialize slab mesh for simplification
-        std::cout << "Initializing slab mesh..." << std::endl;
+        QMAT_LOG_INFO("slab") << "Initializing slab mesh...";
         startTime = clock();
         long initTime = shape.LoadSlabMesh();
-        std::cout << "  Initialization time: " << initTime << " ms" << std::endl;
+        QMAT_LOG_INFO("slab").Field("time_ms", initTime) << "  Initialization time: " << initTime << " ms";
+        if (options.skeletonCapsules > 0) {
+            QMAT_LOG_INFO("slab").Field("penalty", shape.slab_mesh.face_removal_penalty)
+                << "  Skeleton penalty: " << shape.slab_mesh.face_removal_penalty;
+        }
+
+        if (options.hausdorff) {
+            QMAT_LOG_INFO("hausdorff") << "Assigning surface samples to the MA...";
+            startTime = clock();
+            shape.ComputeHausdorffDistance();
+            shape.slab_mesh.compute_hausdorff = true;
+            long samplesTime = clock() - startTime;
+            QMAT_LOG_INFO("hausdorff").Field("time_ms", samplesTime) << "  Sample assignment time: " << samplesTime << " ms";
+            QMAT_LOG_INFO("hausdorff").Field("max", shape.slab_mesh.maxhausdorff_distance)
+                .Field("mean", shape.slab_mesh.meanhausdorff_distance)
+                << "  Initial Hausdorff distance: " << shape.slab_mesh.maxhausdorff_distance
+                << " (mean " << shape.slab_mesh.meanhausdorff_distance << ", relative to the diagonal)";
+        }
 
         // Simplify
         int currentVertices = shape.slab_mesh.numVertices;
-        if (options.simplifyTarget >= currentVertices) {
-            std::cout << "Warning: Target vertex count (" << options.simplifyTarget
-                      << ") >= current count (" << currentVertices << "). Skipping simplification." << std::endl;
+        if (target >= currentVertices) {
+            QMAT_LOG_WARN("simplify") << "Warning: Target vertex count (" << target
+                << ") >= current count (" << currentVertices << "). Skipping simplification.";
         } else {
-            int reductionCount = currentVertices - options.simplifyTarget;
-            std::cout << "Simplifying from " << currentVertices << " to " << options.simplifyTarget
-                      << " vertices (removing " << reductionCount << ")..." << std::endl;
+            int reductionCount = currentVertices - target;
+            QMAT_LOG_INFO("simplify").Field("from", currentVertices).Field("to", target)
+                << "Simplifying from " << currentVertices << " to " << target
+                << " vertices (removing " << reductionCount << ")...";
+
+            // The trace refers to vertex ids, qmat_replay has to repeat the reorder
+            CollapseTrace trace;
+            if (!options.traceFile.empty()) {
+                trace.flags = options.reorder ? CollapseTrace::SPATIAL_ORDER : 0;
+                shape.slab_mesh.collapse_trace = &trace;
+            }
 
             startTime = clock();
             shape.slab_mesh.CleanIsolatedVertices();
             shape.slab_mesh.Simplify(reductionCount);
             long simplifyTime = clock() - startTime;
+            shape.slab_mesh.collapse_trace = NULL;
+
+            QMAT_LOG_INFO("simplify").Field("time_ms", simplifyTime) << "  Simplification time: " << simplifyTime << " ms";
+            if (simplifyTime > 0) {
+                long long throughput = (long long)reductionCount * CLOCKS_PER_SEC / simplifyTime;
+                QMAT_LOG_INFO("simplify").Field("collapses_per_s", throughput)
+                    << "  Throughput: " << throughput
+                    << " collapses/s" << (options.reorder ? " (Morton order)" : " (file order)");
+            }
+            if (shape.slab_mesh.validate_interval > 0) {
+                const SlabInvariantReport& report = shape.slab_mesh.validation_report;
+                if (!report.Valid()) {
+                    QMAT_LOG_ERROR("validate").Field("violations", report.violations)
+                        << "Error: slab mesh invariants violated (" << report.violations << " violations)";
+                    for (size_t i = 0; i < report.messages.size(); i++)
+                        QMAT_LOG_ERROR("validate") << "  " << report.messages[i];
+                    return 5;
+                }
+                QMAT_LOG_INFO("validate").Field("runs", shape.slab_mesh.validation_runs)
+                    .Field("interval", shape.slab_mesh.validate_interval)
+                    .Field("elements", report.elements_checked)
+                    << "  Slab mesh invariants hold (" << shape.slab_mesh.validation_runs << " checks, every "
+                    << shape.slab_mesh.validate_interval << " collapses)";
+            }
+            QMAT_LOG_INFO("simplify").Field("vertices", shape.slab_mesh.numVertices)
+                << "  Final vertex count: " << shape.slab_mesh.numVertices;
+            if (options.skeletonCapsules > 0) {
+                QMAT_LOG_INFO("simplify").Field("edges", shape.slab_mesh.numEdges).Field("faces", shape.slab_mesh.numFaces)
+                    << "  Skeleton: " << shape.slab_mesh.numEdges << " edges, " << shape.slab_mesh.numFaces << " faces left";
+            }
+            if (options.preventInversion) {
+                QMAT_LOG_INFO("simplify").Field("rollbacks", shape.slab_mesh.collapse_rollbacks)
+                    << "  Inverting collapses rolled back: " << shape.slab_mesh.collapse_rollbacks;
+            }
+
+            if (options.hausdorff) {
+                unsigned long long kept = 0, samples = 0;
+                for (unsigned i = 0; i < shape.slab_mesh.vertices.size(); i++) {
+                    if (!shape.slab_mesh.vertices[i].first)
+                        continue;
+                    kept += shape.slab_mesh.vertices[i].second->bplist.size();
+                    samples += options.samplesPerVertex > 0 ? shape.slab_mesh.vertices[i].second->bpsamples.count
+                                                            : shape.slab_mesh.vertices[i].second->bplist.size();
+                }
+                QMAT_LOG_INFO("hausdorff").Field("max", shape.slab_mesh.maxhausdorff_distance)
+                    .Field("mean", shape.slab_mesh.meanhausdorff_distance)
+                    << "  Hausdorff distance: " << shape.slab_mesh.maxhausdorff_distance
+                    << " (mean " << shape.slab_mesh.meanhausdorff_distance << ")";
+                QMAT_LOG_INFO("hausdorff").Field("samples", samples).Field("representatives", kept)
+                    << "  Boundary samples: " << kept << " kept in the vertex lists for " << samples << " samples";
+            }
+            if (options.samplesPerVertex > 0) {
+                QMAT_LOG_INFO("hausdorff").Field("bound_costs", shape.slab_mesh.bplist_bound_costs)
+                    .Field("exact_costs", shape.slab_mesh.bplist_exact_costs)
+                    << "  Sample costs: " << shape.slab_mesh.bplist_bound_costs << " from bounds, "
+                    << shape.slab_mesh.bplist_exact_costs << " on the complete lists";
+                if (options.checkSamples && shape.slab_mesh.bplist_checked_costs > 0) {
+                    double meanError = shape.slab_mesh.bplist_sum_cost_error / shape.slab_mesh.bplist_checked_costs;
+                    QMAT_LOG_INFO("hausdorff").Field("checked", shape.slab_mesh.bplist_checked_costs)
+                        .Field("max_error", shape.slab_mesh.bplist_max_cost_error).Field("mean_error", meanError)
+                        << "  Bounded cost error: max " << shape.slab_mesh.bplist_max_cost_error
+                        << ", mean " << meanError << " over " << shape.slab_mesh.bplist_checked_costs << " costs";
+                }
+            }
 
-            std::cout << "  Simplification time: " << simplifyTime << " ms" << std::endl;
-            std::cout << "  Final vertex count: " << shape.slab_mesh.numVertices << std::endl;
+            if (!options.traceFile.empty()) {
+                if (!trace.Save(options.traceFile, loadError)) {
+                    QMAT_LOG_ERROR("simplify") << "Error: " << loadError;
+                    return 1;
+                }
+                QMAT_LOG_INFO("simplify").Field("file", options.traceFile)
+                    << "  Collapse trace (" << trace.records.size() << " collapses) written to: "
+                    << options.traceFile;
+            }
 
             // Compute final mesh properties
             shape.slab_mesh.ComputeFacesNormal();
@@ -324,13 +2049,73 @@ int main(int argc, char* argv[]) {
             shape.slab_mesh.ComputeFacesSimpleTriangles();
 
             // Export simplified mesh
-            std::cout << "Exporting simplified MA..." << std::endl;
-            shape.slab_mesh.Export(options.outputPrefix);
-            std::cout << "  Simplified MA exported with prefix: " << options.outputPrefix << std::endl;
+            QMAT_LOG_INFO("export") << "Exporting simplified MA...";
+            if (finalMaFile.inMemory) {
+                std::ostringstream out;
+                shape.slab_mesh.Export(out);
+                finalMaFile.data = out.str();
+                QMAT_LOG_INFO("export").Field("bytes", (unsigned long long)finalMaFile.data.size())
+                    << "  Simplified MA kept in memory (" << finalMaFile.data.size() << " bytes)";
+            } else {
+                shape.slab_mesh.Export(options.outputPrefix);
+                QMAT_LOG_INFO("export") << "  Simplified MA exported with prefix: " << options.outputPrefix;
+            }
+            // same name as SlabMesh::Export
+            finalMaFile.file = options.outputPrefix
+                + "___v_" + std::to_string(static_cast<long long>(shape.slab_mesh.numVertices))
+                + "___e_" + std::to_string(static_cast<long long>(shape.slab_mesh.numEdges))
+                + "___f_" + std::to_string(static_cast<long long>(shape.slab_mesh.numFaces)) + ".ma";
+            if (options.chunks && !writeChunks(finalMaFile))
+                return 1;
+        }
+    }
+
+    // Step 5: The half and its mirror image make the final MA
+    if (symmetric) {
+        StageMA fullFile;
+        fullFile.file = options.outputPrefix + "_symmetric.ma";
+        fullFile.inMemory = finalMaFile.inMemory;
+        if (!writeMirrored(finalMaFile, fullFile, plane, symmetryBand))
+            return 1;
+        if (options.chunks && !writeChunks(fullFile))
+            return 1;
+        finalMaFile = std::move(fullFile);
+    }
+
+    // The report is taken before instancing, the surface is the representatives then
+    if (!options.thicknessFile.empty()) {
+        if (!options.instanceFile.empty()) {
+            QMAT_LOG_WARN("thickness") << "Warning: with --instances the thickness report covers the representatives only";
         }
+        if (!writeThickness(finalMaFile, indexedMesh, options))
+            return 1;
+    }
+
+    // Step 6: Every copy gets the MA of its class
+    if (!options.instanceFile.empty()) {
+        StageMA instancedFile;
+        instancedFile.file = options.outputPrefix + "_instanced.ma";
+        instancedFile.inMemory = finalMaFile.inMemory;
+        if (!writeInstanced(finalMaFile, instancedFile, indexedMesh, vertexClass, congruence, options))
+            return 1;
+        if (options.chunks && !writeChunks(instancedFile))
+            return 1;
+        finalMaFile = std::move(instancedFile);
     }
 
-    std::cout << std::endl << "Done!" << std::endl;
+    if (!options.envelopeFile.empty() && !writeEnvelope(finalMaFile, options))
+        return 1;
+
+    if (!options.collisionFile.empty() && !writeCollision(finalMaFile, options))
+        return 1;
+
+    if (!options.capsulesFile.empty() && !writeCapsules(finalMaFile, options))
+        return 1;
+
+    if (!options.maOutput.empty() && !writeFinalMA(finalMaFile, options.maOutput))
+        return 1;
+
+    QMAT_LOG_INFO("cli") << "Done!";
 
     return 0;
 }
@@ -69,13 +69,10 @@ void MedialAxisSimplification3D::openmeshfile()
 			//pThreeDimensionalShape->input.compute_normals();		// normal of vertex and triangle
 			//pThreeDimensionalShape->input.compute_sphere_matrix();  // compute the related matrix
 
-			std::ifstream streampol(  filename.toLatin1() );
-			Polyhedron pol;
-			streampol >> pol;
-
 			// set the non manifold mesh
-			Mesh_domain * pdom;
-			pdom = new Mesh_domain(pol);
+			MeshDomain * pdom = new MeshDomain;
+			std::string domain_error;
+			pdom->LoadOFF(filename.toLatin1().constData(), domain_error);
 			pThreeDimensionalShape->input.domain = pdom;
 
 			// Computing DT and MA 
@@ -146,14 +143,6 @@ void MedialAxisSimplification3D::openmeshfile2(){
 			pThreeDimensionalShape->input.GenerateRandomColor();	// color of vertex and triangle
 			pThreeDimensionalShape->input.compute_normals();		// normal of vertex and triangle
 			pThreeDimensionalShape->input_nmm.meshname = filename.toLocal8Bit().constData();
-
-			std::ifstream streampol(  filename.toLatin1() );
-			Polyhedron pol;
-			streampol >> pol;
-
-			// set the non manifold mesh
-			Mesh_domain * pdom;
-			pdom = new Mesh_domain(pol);			
 			suc = true;
 		}
 		if(suc)
@@ -512,13 +501,11 @@ void MedialAxisSimplification3D::computeMA(){
 	// filename
 	//filename = filename.substr(0, filename.find('.'))+".off";
 	filename = m_offFileName.toLatin1();
-	std::ifstream streampol(  filename );
-	Polyhedron pol;
-	streampol >> pol;
 
 	// set the non manifold mesh
-	Mesh_domain * pdom;
-	pdom = new Mesh_domain(pol);
+	MeshDomain * pdom = new MeshDomain;
+	std::string domain_error;
+	pdom->LoadOFF(filename, domain_error);
 	m_pThreeDimensionalShape->input.domain = pdom;
 	m_pThreeDimensionalShape->input_nmm.domain = pdom;
 	m_pThreeDimensionalShape->input_nmm.pmesh = &(m_pThreeDimensionalShape->input);
@@ -0,0 +1,264 @@
+/**
+ * QMAT collapse trace replay
+ *
+ * Reapplies a collapse trace recorded by qmat_cli --trace to the raw medial axis
+ * it was recorded on. Only the topology updates of the collapses are run (vertex
+ * merge, edge and face insertion, vertex deletion), there is no cost evaluation
+ * and no queue work, so the timing isolates the mesh mutation cost.
+ *
+ * Usage:
+ *   qmat_replay <input.off|input.obj> <raw.ma> <trace> [options]
+ *
+ * Options:
+ *   --count <N>        Replay only the first N collapses (default: all)
+ *   --output <prefix>  Export the replayed MA with this prefix
+ *   --log-level <l>    Least severe message written: debug, info, warn or error (default: info)
+ *   --log-format <f>   text or json (one JSON object per line) (default: text)
+ *   --log-file <file>  Write the log to a file instead of stdout/stderr
+ *   --help             Show this help message
+ *
+ * The input mesh is the one the .ma was computed from, it is needed to scale
+ * the spheres the same way as qmat_cli. Every replayed collapse must create the
+ * same vertex id as in the recorded run, the first divergence is reported and
+ * the tool exits with code 3.
+ */
+
+#include <iostream>
+#include <string>
+#include <ctime>
+#include "ThreeDimensionalShape.h"
+#include "ObjLoader.h"
+#include "CollapseTrace.h"
+#include "Logger.h"
+
+struct ReplayOptions {
+    std::string inputFile;
+    std::string maFile;
+    std::string traceFile;
+    std::string outputPrefix;
+    long long count = -1;  // -1 means the whole trace
+    LogLevel logLevel = LOG_INFO;
+    bool logJson = false;
+    std::string logFile;
+    bool showHelp = false;
+    bool valid = true;
+    std::string errorMessage;
+};
+
+void printUsage(const char* programName) {
+    std::cout << "QMAT collapse trace replay\n"
+              << "Reapply a recorded collapse sequence without cost evaluation.\n\n"
+              << "Usage:\n"
+              << "  " << programName << " <input.off|input.obj> <raw.ma> <trace> [options]\n\n"
+              << "Options:\n"
+              << "  --count <N>        Replay only the first N collapses (default: all)\n"
+              << "  --output <prefix>  Export the replayed MA with this prefix\n"
+              << "  --log-level <l>    Log level: debug, info, warn or error (default: info)\n"
+              << "  --log-format <f>   Log format: text or json lines (default: text)\n"
+              << "  --log-file <file>  Write the log to a file instead of stdout/stderr\n"
+              << "  --help             Show this help message\n\n"
+              << "Example:\n"
+              << "  qmat_cli model.off --simplify 500 --trace model.trace\n"
+              << "  " << programName << " model.off model.ma model.trace --count 1000 --output partial\n";
+}
+
+ReplayOptions parseArguments(int argc, char* argv[]) {
+    ReplayOptions options;
+    int positional = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+
+        if (arg == "--help" || arg == "-h") {
+            options.showHelp = true;
+            return options;
+        }
+        else if (arg == "--count") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--count requires a value.";
+                return options;
+            }
+            try {
+                options.count = std::stoll(argv[++i]);
+                if (options.count < 0) {
+                    options.valid = false;
+                    options.errorMessage = "--count value must not be negative.";
+                    return options;
+                }
+            } catch (...) {
+                options.valid = false;
+                options.errorMessage = "Invalid value for --count.";
+                return options;
+            }
+        }
+        else if (arg == "--output") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--output requires a value.";
+                return options;
+            }
+            options.outputPrefix = argv[++i];
+        }
+        else if (arg == "--log-level") {
+            if (i + 1 >= argc || !Logger::ParseLevel(argv[i + 1], options.logLevel)) {
+                options.valid = false;
+                options.errorMessage = "--log-level must be debug, info, warn or error.";
+                return options;
+            }
+            i++;
+        }
+        else if (arg == "--log-format") {
+            std::string format = i + 1 < argc ? argv[++i] : "";
+            if (format != "text" && format != "json") {
+                options.valid = false;
+                options.errorMessage = "--log-format must be text or json.";
+                return options;
+            }
+            options.logJson = format == "json";
+        }
+        else if (arg == "--log-file") {
+            if (i + 1 >= argc) {
+                options.valid = false;
+                options.errorMessage = "--log-file requires a value.";
+                return options;
+            }
+            options.logFile = argv[++i];
+        }
+        else if (arg[0] == '-') {
+            options.valid = false;
+            options.errorMessage = "Unknown option: " + arg;
+            return options;
+        }
+        else {
+            if (positional == 0)
+                options.inputFile = arg;
+            else if (positional == 1)
+                options.maFile = arg;
+            else if (positional == 2)
+                options.traceFile = arg;
+            else {
+                options.valid = false;
+                options.errorMessage = "Too many positional arguments.";
+                return options;
+            }
+            positional++;
+        }
+    }
+
+    if (positional < 3) {
+        options.valid = false;
+        options.errorMessage = "Input mesh, .ma file and trace file are required.";
+    }
+
+    return options;
+}
+
+int main(int argc, char* argv[]) {
+    ReplayOptions options = parseArguments(argc, argv);
+
+    if (options.showHelp) {
+        printUsage(argv[0]);
+        return 0;
+    }
+
+    if (!options.valid) {
+        QMAT_LOG_ERROR("cli") << "Error: " << options.errorMessage;
+        QMAT_LOG_ERROR("cli") << "Use --help for usage information.";
+        return 1;
+    }
+
+    Logger& logger = Logger::Instance();
+    logger.SetLevel(options.logLevel);
+    logger.SetFormat(options.logJson ? Logger::JSON : Logger::TEXT);
+    std::string error;
+    if (!options.logFile.empty() && !logger.SetFile(options.logFile, error)) {
+        QMAT_LOG_ERROR("cli") << "Error: " << error;
+        return 1;
+    }
+
+    CollapseTrace trace;
+    if (!trace.Load(options.traceFile, error)) {
+        QMAT_LOG_ERROR("replay") << "Error: " << error;
+        return 1;
+    }
+    size_t count = trace.records.size();
+    if (options.count >= 0 && (size_t)options.count < count)
+        count = (size_t)options.count;
+    QMAT_LOG_INFO("replay").Field("collapses", (unsigned long long)trace.records.size())
+        .Field("replaying", (unsigned long long)count)
+        << "Trace: " << trace.records.size() << " collapses, replaying " << count;
+
+    // The input mesh provides the scale and the boundary samples of the slab mesh
+    ThreeDimensionalShape shape;
+    IndexedMesh indexedMesh;
+    if (!LoadMeshFile(options.inputFile, indexedMesh, error)) {
+        QMAT_LOG_ERROR("load") << "Error loading mesh file: " << error;
+        return 1;
+    }
+    indexedMesh.BuildAdjacency();
+    indexedMesh.computebb();
+    if (!BuildPolyhedron(indexedMesh, shape.input, error)) {
+        QMAT_LOG_ERROR("load") << "Error building mesh: " << error;
+        return 1;
+    }
+    shape.input.GenerateList();
+    if (!shape.input.CopyAttributes(indexedMesh)) {
+        QMAT_LOG_ERROR("load") << "Error building mesh: the polyhedron lost vertices of the input";
+        return 1;
+    }
+
+    // Same slab mesh setup as the recorded qmat_cli run
+    shape.input_nmm.pmesh = &shape.input;
+    shape.slab_mesh.pmesh = &shape.input;
+    shape.slab_mesh.type = 1;
+    shape.slab_mesh.preserve_boundary_method = 0;
+    shape.slab_mesh.hyperbolic_weight_type = 3;
+    shape.slab_mesh.compute_hausdorff = false;
+    shape.slab_mesh.boundary_compute_scale = 0;
+    shape.slab_mesh.prevent_inversion = false;
+
+    shape.LoadInputNMM(options.maFile);
+    if (trace.flags & CollapseTrace::SPATIAL_ORDER)
+        shape.slab_mesh.SpatialReorder();
+    shape.slab_mesh.CleanIsolatedVertices();
+    QMAT_LOG_INFO("replay").Field("vertices", shape.slab_mesh.numVertices)
+        << "Loaded slab mesh with " << shape.slab_mesh.numVertices << " vertices";
+
+    long startTime = clock();
+    size_t replayed = 0;
+    for (; replayed < count; replayed++) {
+        if (!shape.slab_mesh.ReplayCollapse(trace.records[replayed]))
+            break;
+    }
+    long replayTime = clock() - startTime;
+
+    QMAT_LOG_INFO("replay").Field("time_ms", replayTime) << "  Replay time: " << replayTime << " ms";
+    if (replayTime > 0) {
+        long long throughput = (long long)replayed * CLOCKS_PER_SEC / replayTime;
+        QMAT_LOG_INFO("replay").Field("collapses_per_s", throughput) << "  Throughput: " << throughput << " collapses/s";
+    }
+    QMAT_LOG_INFO("replay").Field("vertices", shape.slab_mesh.numVertices)
+        << "  Final vertex count: " << shape.slab_mesh.numVertices;
+
+    if (replayed < count) {
+        const CollapseRecord& rec = trace.records[replayed];
+        QMAT_LOG_ERROR("replay").Field("collapse", (unsigned long long)replayed).Field("v1", rec.v1).Field("v2", rec.v2)
+            .Field("vid", rec.vid)
+            << "Diverged at collapse " << replayed << ": merging " << rec.v1 << " and " << rec.v2
+            << " did not create vertex " << rec.vid;
+        return 3;
+    }
+
+    if (!options.outputPrefix.empty()) {
+        shape.slab_mesh.ComputeFacesNormal();
+        shape.slab_mesh.ComputeVerticesNormal();
+        shape.slab_mesh.ComputeEdgesCone();
+        shape.slab_mesh.ComputeFacesSimpleTriangles();
+        shape.slab_mesh.Export(options.outputPrefix);
+        QMAT_LOG_INFO("export").Field("prefix", options.outputPrefix)
+            << "Replayed MA exported with prefix: " << options.outputPrefix;
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+// CollapseTrace save/load and SlabMesh::ReplayCollapse on a patch of a real MA
+// (tests/data/patch.ma), run by ctest with the path of the patch as argument
+#include "SlabMesh.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// The simplifier reads the input surface only for the Hausdorff costs, which
+// stay off here. These replace SlabMeshInput.cpp, which needs the CGAL mesh.
+static double no_hausdorff_dist = 0.;
+static unsigned no_hausdorff_index = 0;
+unsigned SlabMesh::InputNumVertices() const { return 0; }
+Vector3d SlabMesh::InputVertex(unsigned) const { return Vector3d(0., 0., 0.); }
+double SlabMesh::InputDiagonal() const { return 1.; }
+double & SlabMesh::InputHausdorffDist(unsigned) { return no_hausdorff_dist; }
+unsigned & SlabMesh::InputHausdorffIndex(unsigned) { return no_hausdorff_index; }
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string & name, const std::string & what)
+{
+	if(condition)
+		return;
+	std::cerr << "FAIL " << name << ": " << what << std::endl;
+	failures++;
+}
+
+// the slab mesh setup of qmat_cli with its default options
+static bool LoadPatch(const std::string & filename, SlabMesh & mesh)
+{
+	std::ifstream in(filename.c_str());
+	if(!in)
+		return false;
+	mesh.pmesh = NULL;
+	mesh.type = 1;
+	mesh.k = 0.00001;
+	mesh.preserve_boundary_method = 0;
+	mesh.hyperbolic_weight_type = 3;
+	mesh.compute_hausdorff = false;
+	mesh.boundary_compute_scale = 0;
+	mesh.prevent_inversion = false;
+	mesh.bound_weight = 0.1;
+	mesh.LoadMA(in, 1.);
+	return mesh.numVertices > 0;
+}
+
+static void Simplify(const std::string & filename, unsigned target, CollapseTrace & trace, SlabMesh & mesh)
+{
+	LoadPatch(filename, mesh);
+	mesh.clear();
+	mesh.InitialQuadrics();
+	mesh.initCollapseQueue();
+	mesh.collapse_trace = &trace;
+	mesh.CleanIsolatedVertices();
+	mesh.Simplify(mesh.numVertices - target);
+	mesh.collapse_trace = NULL;
+}
+
+static bool SameSpheres(const SlabMesh & a, const SlabMesh & b)
+{
+	if(a.vertices.size() != b.vertices.size())
+		return false;
+	for(unsigned i = 0; i < a.vertices.size(); i ++)
+	{
+		if(a.vertices[i].first != b.vertices[i].first)
+			return false;
+		if(!a.vertices[i].first)
+			continue;
+		const Sphere & sa = a.vertices[i].second->sphere;
+		const Sphere & sb = b.vertices[i].second->sphere;
+		if(sa.center != sb.center || sa.radius != sb.radius)
+			return false;
+	}
+	return true;
+}
+
+static void WriteBytes(const std::string & filename, const std::string & bytes)
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	out.write(bytes.data(), bytes.size());
+}
+
+static std::string ReadBytes(const std::string & filename)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void CheckRejected(const std::string & name, const std::string & filename, const std::string & bytes)
+{
+	WriteBytes(filename, bytes);
+	CollapseTrace trace;
+	std::string error;
+	bool loaded = trace.Load(filename, error);
+	Check(!loaded, name, "loaded an invalid trace");
+	Check(!error.empty(), name, "no error message");
+	Check(trace.records.empty(), name, "records left after a failed load");
+}
+
+int main(int argc, char ** argv)
+{
+	if(argc < 2)
+	{
+		std::cerr << "usage: test_collapse_trace <patch.ma>" << std::endl;
+		return 1;
+	}
+	const std::string patch = argv[1];
+	const std::string trace_file = "test_collapse_trace.trace";
+
+	SlabMesh simplified;
+	CollapseTrace recorded;
+	recorded.flags = 0;
+	Simplify(patch, 100, recorded, simplified);
+	Check(simplified.numVertices == 100, "simplify", "wrong vertex count");
+	Check(recorded.records.size() == 300, "simplify", "wrong number of records");
+
+	std::string error;
+	Check(recorded.Save(trace_file, error), "save", error);
+	CollapseTrace loaded;
+	Check(loaded.Load(trace_file, error), "load", error);
+	Check(loaded.flags == recorded.flags, "load", "flags differ");
+	Check(loaded.FirstDifference(recorded) == -1, "load", "records differ after the round trip");
+
+	SlabMesh replayed;
+	LoadPatch(patch, replayed);
+	replayed.CleanIsolatedVertices();
+	size_t count = 0;
+	while(count < loaded.records.size() && replayed.ReplayCollapse(loaded.records[count]))
+		count ++;
+	Check(count == loaded.records.size(), "replay", "diverged");
+	Check(replayed.numVertices == simplified.numVertices, "replay", "wrong vertex count");
+	Check(SameSpheres(replayed, simplified), "replay", "spheres differ from the simplification");
+
+	// header of 8 + 4 + 4 bytes, then 52 bytes per record
+	std::string bytes = ReadBytes(trace_file);
+	Check(bytes.size() == 16 + 52 * recorded.records.size(), "format", "unexpected file size");
+	if(bytes.size() > 16 + 52)
+	{
+		CheckRejected("truncated record", trace_file, bytes.substr(0, bytes.size() - 20));
+		CheckRejected("missing records", trace_file, bytes.substr(0, 16 + 52));
+		std::string huge = bytes.substr(0, 16 + 52);
+		const unsigned count_max = 0xffffffffu;
+		memcpy(&huge[12], &count_max, sizeof(unsigned));
+		CheckRejected("huge count", trace_file, huge);
+		std::string magic = bytes;
+		magic[0] = 'X';
+		CheckRejected("wrong magic", trace_file, magic);
+	}
+	CheckRejected("empty file", trace_file, "");
+	std::remove(trace_file.c_str());
+
+	if(failures == 0)
+		std::cout << "Collapse trace tests passed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
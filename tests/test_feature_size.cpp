@@ -0,0 +1,108 @@
+// ComputeFeatureSize against the analytic local feature size of a torus, run by
+// ctest. The inner MA of a torus is its core circle, the outer one its axis, so
+// a surface point at distance rho from the axis has the feature size
+// min(r, rho); around the hole the axis is closer than the core circle.
+#include "FeatureSize.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string & name, const std::string & what)
+{
+	if(condition)
+		return;
+	std::fprintf(stderr, "FAIL %s: %s\n", name.c_str(), what.c_str());
+	failures++;
+}
+
+static const double R = .5, r = .3;
+
+// distance of p to the medial axis of the torus
+static double AnalyticLfs(const double p[3])
+{
+	double rho = sqrt(p[0] * p[0] + p[1] * p[1]);
+	double core = sqrt((rho - R) * (rho - R) + p[2] * p[2]);
+	return std::min(core, rho);
+}
+
+static double MaxError(const FeatureSizeField & field, const IndexedMesh & mesh, double & grid_error)
+{
+	double error = 0.;
+	for(unsigned i = 0; i < mesh.NumVertices(); i ++)
+		error = std::max(error, fabs(field.vertex_lfs[i] - AnalyticLfs(&mesh.positions[3 * i])));
+	grid_error = 0.;
+	for(unsigned z = 0; z < field.grid[2]; z ++)
+		for(unsigned y = 0; y < field.grid[1]; y ++)
+			for(unsigned x = 0; x < field.grid[0]; x ++)
+			{
+				double p[3] = {field.origin[0] + x * field.spacing, field.origin[1] + y * field.spacing, field.origin[2] + z * field.spacing};
+				size_t g = ((size_t)z * field.grid[1] + y) * field.grid[0] + x;
+				grid_error = std::max(grid_error, fabs(field.grid_lfs[g] - AnalyticLfs(p)));
+			}
+	return error;
+}
+
+int main()
+{
+	// surface samples, the inner equator at rho = 0.2 is closer to the axis than to the core
+	IndexedMesh mesh;
+	const unsigned nu = 96, nv = 48;
+	for(unsigned j = 0; j < nv; j ++)
+	{
+		double t = 2. * M_PI * j / nv;
+		for(unsigned i = 0; i < nu; i ++)
+		{
+			double u = 2. * M_PI * i / nu;
+			mesh.AddVertex((R + r * cos(t)) * cos(u), (R + r * cos(t)) * sin(u), r * sin(t));
+		}
+	}
+	mesh.computebb();
+
+	// the core circle as spheres of radius r and the axis as exterior vertices, 1e-3 apart
+	MedialMeshData ma;
+	const unsigned core_samples = (unsigned)(2. * M_PI * R / 1e-3);
+	for(unsigned i = 0; i < core_samples; i ++)
+	{
+		double u = 2. * M_PI * i / core_samples;
+		ma.spheres.push_back(R * cos(u));
+		ma.spheres.push_back(R * sin(u));
+		ma.spheres.push_back(0.);
+		ma.spheres.push_back(r);
+	}
+	std::vector<double> axis;
+	for(int i = -1000; i <= 1000; i ++)
+	{
+		axis.push_back(0.);
+		axis.push_back(0.);
+		axis.push_back(i * 1e-3);
+	}
+
+	FeatureSizeField field;
+	ComputeFeatureSize(ma, axis, mesh, 32, field);
+	Check(field.vertex_lfs.size() == mesh.NumVertices(), "torus", "wrong vertex count");
+	Check(field.grid_lfs.size() == (size_t)field.grid[0] * field.grid[1] * field.grid[2] && !field.grid_lfs.empty(),
+		  "torus", "wrong grid size");
+	double grid_error;
+	double vertex_error = MaxError(field, mesh, grid_error);
+	std::printf("torus with axis:    vertex error %.6f  grid error %.6f\n", vertex_error, grid_error);
+	// within the spacing of the medial samples
+	Check(vertex_error < 1e-3, "torus", "vertex feature size differs from min(r, rho)");
+	Check(grid_error < 1e-3, "torus", "grid feature size differs from the distance to the MA");
+
+	// the core circle alone misses the hole, by up to r - (R - r) at the inner equator
+	std::vector<double> none;
+	ComputeFeatureSize(ma, none, mesh, 0, field);
+	Check(field.grid_lfs.empty(), "inner only", "grid without a resolution");
+	vertex_error = MaxError(field, mesh, grid_error);
+	std::printf("torus without axis: vertex error %.6f\n", vertex_error);
+	Check(fabs(vertex_error - (r - (R - r))) < 1e-3, "inner only", "unexpected error at the inner equator");
+
+	if(failures == 0)
+		std::printf("Feature size matches the torus\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+// IndexedMesh::LoadOFF on the header forms found in the wild, run by ctest
+#include "IndexedMesh.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string & name, const std::string & what)
+{
+	if(condition)
+		return;
+	std::cerr << "FAIL " << name << ": " << what << std::endl;
+	failures++;
+}
+
+// a tetrahedron after the given header lines
+static void CheckLoads(const std::string & name, const std::string & header)
+{
+	std::istringstream in(header +
+		"0 0 0\n1 0 0\n0 1 0\n0 0 1\n"
+		"3 0 2 1\n3 0 1 3\n3 0 3 2\n3 1 2 3\n");
+	IndexedMesh mesh;
+	std::string error;
+	bool loaded = mesh.LoadOFF(in, error);
+	Check(loaded, name, "not loaded: " + error);
+	if(!loaded)
+		return;
+	Check(mesh.NumVertices() == 4, name, "wrong vertex count");
+	Check(mesh.NumFaces() == 4, name, "wrong face count");
+	Check(mesh.Position(3).Z() == 1., name, "wrong last vertex");
+}
+
+static void CheckRejects(const std::string & name, const std::string & text)
+{
+	std::istringstream in(text);
+	IndexedMesh mesh;
+	std::string error;
+	Check(!mesh.LoadOFF(in, error), name, "loaded an invalid file");
+	Check(!error.empty(), name, "no error message");
+}
+
+int main()
+{
+	CheckLoads("counts on the next line", "OFF\n4 4 6\n");
+	CheckLoads("counts on the next line without edges", "OFF\n4 4\n");
+	CheckLoads("counts on the header line", "OFF 4 4 6\n");
+	CheckLoads("counts on the header line without edges", "OFF 4 4\n");
+	CheckLoads("comments and blank lines", "# tetrahedron\nOFF # header\n\n4 4 0 # counts\n");
+	CheckLoads("trailing blanks after the keyword", "OFF \r\n4 4 6\r\n");
+
+	CheckRejects("missing header", "4 4 6\n");
+	CheckRejects("missing counts", "OFF\n");
+	CheckRejects("one count on the header line", "OFF 4\n4 6\n");
+	CheckRejects("truncated vertex list", "OFF 4 4 6\n0 0 0\n");
+	CheckRejects("face index out of range", "OFF 3 1\n0 0 0\n1 0 0\n0 1 0\n3 0 1 3\n");
+
+	if(failures == 0)
+		std::cout << "IndexedMesh OFF tests passed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+// MedialChunks .ma -> .qmc -> .ma round trip and region queries on a patch of a
+// real MA (tests/data/patch.ma), run by ctest with the path of the patch as argument
+#include "MedialChunks.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <string>
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string & name, const std::string & what)
+{
+	if(condition)
+		return;
+	std::cerr << "FAIL " << name << ": " << what << std::endl;
+	failures++;
+}
+
+static std::string ReadBytes(const std::string & filename)
+{
+	std::ifstream in(filename.c_str(), std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void WriteBytes(const std::string & filename, const std::string & bytes)
+{
+	std::ofstream out(filename.c_str(), std::ios::binary);
+	out.write(bytes.data(), bytes.size());
+}
+
+static std::string MAText(const MedialMeshData & ma)
+{
+	std::ostringstream out;
+	std::string error;
+	ma.SaveMA(out, error);
+	return out.str();
+}
+
+static bool SphereHitsBox(const MedialMeshData & ma, unsigned i, const double mn[3], const double mx[3])
+{
+	for(int d = 0; d < 3; d ++)
+		if(ma.spheres[4 * i + d] + ma.spheres[4 * i + 3] < mn[d] || ma.spheres[4 * i + d] - ma.spheres[4 * i + 3] > mx[d])
+			return false;
+	return true;
+}
+
+// every local element is the global one, a clipped region holds exactly the
+// elements touching a sphere in the box, an unclipped one at least those
+static void CheckRegion(const std::string & name, const MedialMeshData & ma, const MedialChunkRegion & region,
+						const double mn[3], const double mx[3], bool clip)
+{
+	const MedialMeshData & m = region.mesh;
+	Check(region.vertex_ids.size() == m.NumVertices() && region.edge_ids.size() == m.NumEdges()
+		  && region.face_ids.size() == m.NumFaces(), name, "id arrays do not match the mesh");
+	if(failures > 0)
+		return;
+
+	std::set<unsigned> vertices, edges, faces;
+	bool same = true;
+	for(unsigned i = 0; i < m.NumVertices(); i ++)
+	{
+		vertices.insert(region.vertex_ids[i]);
+		for(int k = 0; k < 4; k ++)
+			same = same && m.spheres[4 * i + k] == ma.spheres[4 * region.vertex_ids[i] + k];
+	}
+	for(unsigned i = 0; i < m.NumEdges(); i ++)
+	{
+		edges.insert(region.edge_ids[i]);
+		for(int k = 0; k < 2; k ++)
+			same = same && region.vertex_ids[m.edges[2 * i + k]] == ma.edges[2 * region.edge_ids[i] + k];
+	}
+	for(unsigned i = 0; i < m.NumFaces(); i ++)
+	{
+		faces.insert(region.face_ids[i]);
+		for(int k = 0; k < 3; k ++)
+			same = same && region.vertex_ids[m.faces[3 * i + k]] == ma.faces[3 * region.face_ids[i] + k];
+	}
+	Check(same, name, "elements differ from the global ones");
+	Check(vertices.size() == m.NumVertices() && edges.size() == m.NumEdges() && faces.size() == m.NumFaces(),
+		  name, "duplicate elements");
+
+	// brute force over the whole mesh
+	std::set<unsigned> expect_vertices, expect_edges, expect_faces;
+	std::set<unsigned> hit;
+	for(unsigned i = 0; i < ma.NumVertices(); i ++)
+		if(SphereHitsBox(ma, i, mn, mx))
+		{
+			hit.insert(i);
+			expect_vertices.insert(i);
+		}
+	for(unsigned i = 0; i < ma.NumEdges(); i ++)
+		if(hit.count(ma.edges[2 * i]) || hit.count(ma.edges[2 * i + 1]))
+		{
+			expect_edges.insert(i);
+			for(int k = 0; k < 2; k ++)
+				expect_vertices.insert(ma.edges[2 * i + k]);
+		}
+	for(unsigned i = 0; i < ma.NumFaces(); i ++)
+		if(hit.count(ma.faces[3 * i]) || hit.count(ma.faces[3 * i + 1]) || hit.count(ma.faces[3 * i + 2]))
+		{
+			expect_faces.insert(i);
+			for(int k = 0; k < 3; k ++)
+				expect_vertices.insert(ma.faces[3 * i + k]);
+		}
+	Check(!hit.empty(), name, "no sphere in the query box");
+	if(clip)
+	{
+		Check(vertices == expect_vertices, name, "clipped vertices differ from brute force");
+		Check(edges == expect_edges, name, "clipped edges differ from brute force");
+		Check(faces == expect_faces, name, "clipped faces differ from brute force");
+	}
+	else
+	{
+		bool covers = true;
+		for(std::set<unsigned>::const_iterator it = expect_edges.begin(); it != expect_edges.end(); it ++)
+			covers = covers && edges.count(*it);
+		for(std::set<unsigned>::const_iterator it = expect_faces.begin(); it != expect_faces.end(); it ++)
+			covers = covers && faces.count(*it);
+		for(std::set<unsigned>::const_iterator it = hit.begin(); it != hit.end(); it ++)
+			covers = covers && vertices.count(*it);
+		Check(covers, name, "bricks miss elements touching the query box");
+	}
+}
+
+int main(int argc, char ** argv)
+{
+	if(argc < 2)
+	{
+		std::cerr << "usage: test_medial_chunks <patch.ma>" << std::endl;
+		return 1;
+	}
+	const std::string patch = argv[1];
+	const std::string chunk_file = "test_medial_chunks.qmc";
+	const std::string ma_file = "test_medial_chunks.ma";
+
+	MedialMeshData ma;
+	std::string error;
+	Check(ma.LoadMA(patch, error), "load", error);
+	Check(ma.NumVertices() == 400 && ma.NumEdges() == 1096 && ma.NumFaces() == 696, "load", "wrong element counts");
+
+	// a few vertices per brick, so that elements cross bricks and need ghosts
+	Check(WriteMedialChunks(ma, chunk_file, 16, error), "write", error);
+	MedialChunkReader reader;
+	Check(reader.Open(chunk_file, error), "open", error);
+	Check(reader.num_vertices == ma.NumVertices() && reader.num_edges == ma.NumEdges()
+		  && reader.num_faces == ma.NumFaces(), "open", "wrong header counts");
+	Check(reader.bricks.size() > 8, "open", "too few bricks");
+	unsigned ghosts = 0;
+	for(size_t b = 0; b < reader.bricks.size(); b ++)
+		ghosts += reader.bricks[b].num_ghosts;
+	Check(ghosts > 0, "open", "no ghost vertices");
+
+	// .ma -> .qmc -> .ma
+	MedialMeshData back;
+	Check(reader.LoadAll(back, error), "round trip", error);
+	Check(back.spheres == ma.spheres && back.edges == ma.edges && back.faces == ma.faces, "round trip", "mesh differs");
+	Check(back.SaveMA(ma_file, error), "round trip", error);
+	Check(ReadBytes(ma_file) == MAText(ma), "round trip", ".ma written back differs");
+
+	// a box around the middle of the patch, a thin slab through it and a small box
+	// in one corner; the spheres are large next to the patch, so only the corner
+	// box leaves out bricks
+	double mid[3];
+	for(int d = 0; d < 3; d ++)
+		mid[d] = .5 * (reader.box_min[d] + reader.box_max[d]);
+	double ext[3] = {.1 * (reader.box_max[0] - reader.box_min[0]), .1 * (reader.box_max[1] - reader.box_min[1]),
+					 .1 * (reader.box_max[2] - reader.box_min[2])};
+	double boxes[3][6] = {
+		{mid[0] - ext[0], mid[1] - ext[1], mid[2] - ext[2], mid[0] + ext[0], mid[1] + ext[1], mid[2] + ext[2]},
+		{reader.box_min[0], reader.box_min[1], mid[2] - .1 * ext[2], reader.box_max[0], reader.box_max[1], mid[2] + .1 * ext[2]},
+		{reader.box_min[0], reader.box_min[1], reader.box_min[2],
+		 reader.box_min[0] + .5 * ext[0], reader.box_min[1] + .5 * ext[1], reader.box_min[2] + .5 * ext[2]}};
+	const char * names[3] = {"middle", "slab", "corner"};
+	for(int q = 0; q < 3; q ++)
+	{
+		MedialChunkRegion region;
+		Check(reader.LoadRegion(boxes[q], boxes[q] + 3, false, region, error), names[q], error);
+		Check(region.bricks_loaded > 0, names[q], "no bricks loaded");
+		Check(region.bricks_loaded < reader.bricks.size() || q != 2, names[q], "all bricks loaded");
+		CheckRegion(std::string(names[q]) + " bricks", ma, region, boxes[q], boxes[q] + 3, false);
+		Check(reader.LoadRegion(boxes[q], boxes[q] + 3, true, region, error), names[q], error);
+		CheckRegion(std::string(names[q]) + " clipped", ma, region, boxes[q], boxes[q] + 3, true);
+	}
+
+	// far outside the patch
+	double far_min[3] = {reader.box_max[0] + 1., reader.box_max[1] + 1., reader.box_max[2] + 1.};
+	double far_max[3] = {far_min[0] + 1., far_min[1] + 1., far_min[2] + 1.};
+	MedialChunkRegion empty;
+	Check(reader.LoadRegion(far_min, far_max, true, empty, error), "outside", error);
+	Check(empty.bricks_loaded == 0 && empty.mesh.NumVertices() == 0, "outside", "elements loaded");
+
+	// a damaged file is rejected instead of read past its end
+	std::string bytes = ReadBytes(chunk_file);
+	std::string magic = bytes;
+	magic[0] = 'X';
+	WriteBytes(chunk_file, magic);
+	MedialChunkReader bad;
+	Check(!bad.Open(chunk_file, error), "wrong magic", "opened");
+	WriteBytes(chunk_file, bytes.substr(0, 80));
+	Check(!bad.Open(chunk_file, error), "truncated directory", "opened");
+	std::remove(chunk_file.c_str());
+	std::remove(ma_file.c_str());
+
+	if(failures == 0)
+		std::cout << "Medial chunk tests passed" << std::endl;
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+// POWERCRUST cell labeling against EXACT_QUERY on a convex (ellipsoid) and a
+// concave (torus) sampled surface, run by ctest. Every sample of a convex
+// surface lies on the hull, so seeding hull cells as outside loses the interior.
+#include "Mesh.h"
+#include "MeshDomain.h"
+#include "ObjLoader.h"
+#include "Perturbation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string & name, const std::string & what)
+{
+	if(condition)
+		return;
+	std::fprintf(stderr, "FAIL %s: %s\n", name.c_str(), what.c_str());
+	failures++;
+}
+
+static void AddTriangle(IndexedMesh & mesh, unsigned a, unsigned b, unsigned c)
+{
+	const unsigned idx[3] = {a, b, c};
+	mesh.AddFace(idx, 3);
+}
+
+// nu samples per ring, nv - 1 rings and the two poles
+static void Ellipsoid(unsigned nu, unsigned nv, double a, double b, double c, IndexedMesh & mesh)
+{
+	for(unsigned j = 1; j < nv; j ++)
+	{
+		double t = M_PI * j / nv;
+		for(unsigned i = 0; i < nu; i ++)
+		{
+			double u = 2. * M_PI * i / nu;
+			mesh.AddVertex(a * sin(t) * cos(u), b * sin(t) * sin(u), c * cos(t));
+		}
+	}
+	unsigned north = (nv - 1) * nu, south = north + 1;
+	mesh.AddVertex(0., 0., c);
+	mesh.AddVertex(0., 0., -c);
+	for(unsigned i = 0; i < nu; i ++)
+	{
+		unsigned i1 = (i + 1) % nu;
+		AddTriangle(mesh, north, i, i1);
+		AddTriangle(mesh, south, (nv - 2) * nu + i1, (nv - 2) * nu + i);
+		for(unsigned j = 0; j + 2 < nv; j ++)
+		{
+			AddTriangle(mesh, j * nu + i, (j + 1) * nu + i, (j + 1) * nu + i1);
+			AddTriangle(mesh, j * nu + i, (j + 1) * nu + i1, j * nu + i1);
+		}
+	}
+}
+
+static void Torus(unsigned nu, unsigned nv, double R, double r, IndexedMesh & mesh)
+{
+	for(unsigned j = 0; j < nv; j ++)
+	{
+		double t = 2. * M_PI * j / nv;
+		for(unsigned i = 0; i < nu; i ++)
+		{
+			double u = 2. * M_PI * i / nu;
+			mesh.AddVertex((R + r * cos(t)) * cos(u), (R + r * cos(t)) * sin(u), r * sin(t));
+		}
+	}
+	for(unsigned j = 0; j < nv; j ++)
+		for(unsigned i = 0; i < nu; i ++)
+		{
+			unsigned j1 = (j + 1) % nv, i1 = (i + 1) % nu;
+			AddTriangle(mesh, j * nu + i, j * nu + i1, j1 * nu + i1);
+			AddTriangle(mesh, j * nu + i, j1 * nu + i1, j1 * nu + i);
+		}
+}
+
+// the four sample ids of a cell identify it across two triangulations of the same points
+typedef std::vector<int> CellKey;
+
+static void Labels(MPMesh & mesh, std::map<CellKey, bool> & inside)
+{
+	inside.clear();
+	for(Finite_cells_iterator_t fci = mesh.dt.finite_cells_begin(); fci != mesh.dt.finite_cells_end(); fci ++)
+	{
+		CellKey key(4);
+		for(int k = 0; k < 4; k ++)
+			key[k] = fci->vertex(k)->info().id;
+		std::sort(key.begin(), key.end());
+		inside[key] = fci->info().inside;
+	}
+}
+
+static unsigned Mismatches(const std::map<CellKey, bool> & a, const std::map<CellKey, bool> & b, unsigned & inside)
+{
+	unsigned count = 0;
+	inside = 0;
+	for(std::map<CellKey, bool>::const_iterator it = a.begin(); it != a.end(); it ++)
+	{
+		std::map<CellKey, bool>::const_iterator jt = b.find(it->first);
+		if(jt == b.end() || jt->second != it->second)
+			count ++;
+		if(jt != b.end() && jt->second)
+			inside ++;
+	}
+	return count;
+}
+
+static void Compare(const std::string & name, const IndexedMesh & surface)
+{
+	MPMesh mesh;
+	std::string error;
+	bool built = BuildPolyhedron(surface, mesh, error);
+	Check(built, name, "polyhedron not built: " + error);
+	if(!built)
+		return;
+	mesh.GenerateList();
+	Check(mesh.CopyAttributes(surface), name, "polyhedron lost vertices");
+
+	// the samples are cospherical along the rings, jitter all of them as --perturb does
+	std::vector<char> degenerate(surface.NumVertices(), 1);
+	DegeneracyStats stats;
+	PerturbDegenerateVertices(surface, degenerate, 1e-6, 1, mesh.dt_offset, stats);
+
+	MeshDomain * domain = new MeshDomain;
+	built = domain->Build(surface, error);
+	Check(built, name, "domain not built: " + error);
+	if(!built)
+	{
+		delete domain;
+		return;
+	}
+	mesh.domain = domain;
+
+	std::map<CellKey, bool> exact, flood, resolved;
+	mesh.m_cell_labeling = EXACT_QUERY;
+	mesh.computedt();
+	Labels(mesh, exact);
+
+	// flood alone, then with the ambiguous cells queried as qmat_cli does
+	mesh.domain = NULL;
+	mesh.m_cell_labeling = POWERCRUST;
+	mesh.computedt();
+	mesh.domain = domain;
+	Labels(mesh, flood);
+	unsigned ambiguous = (unsigned)mesh.ambiguous_cells.size();
+	mesh.ResolveAmbiguousCells();
+	Labels(mesh, resolved);
+
+	unsigned exact_inside = 0, flood_inside = 0, resolved_inside = 0;
+	Mismatches(exact, exact, exact_inside);
+	unsigned flood_diff = Mismatches(exact, flood, flood_inside);
+	unsigned resolved_diff = Mismatches(exact, resolved, resolved_inside);
+	unsigned cells = (unsigned)exact.size();
+
+	std::printf("%-10s %6u cells  exact inside %6u  flood inside %6u differ %5u (%u ambiguous)  resolved differ %u\n",
+				name.c_str(), cells, exact_inside, flood_inside, flood_diff, ambiguous, resolved_diff);
+
+	Check(flood.size() == exact.size(), name, "different triangulations");
+	Check(exact_inside > cells / 2, name, "exact query labels too few cells inside");
+	Check(flood_diff <= ambiguous + cells / 200, name, "flood disagrees outside of the ambiguous cells");
+	Check(resolved_diff <= cells / 200, name, "more than 0.5% of the cells differ from EXACT_QUERY");
+}
+
+int main()
+{
+	IndexedMesh ellipsoid;
+	Ellipsoid(48, 24, 1., .7, .5, ellipsoid);
+	ellipsoid.computebb();
+	Compare("ellipsoid", ellipsoid);
+
+	IndexedMesh torus;
+	Torus(64, 24, 1., .35, torus);
+	torus.computebb();
+	Compare("torus", torus);
+
+	if(failures == 0)
+		std::printf("Power crust labels match the exact queries\n");
+	return failures == 0 ? 0 : 1;
+}
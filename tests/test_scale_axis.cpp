@@ -0,0 +1,74 @@
+// ScaleAxisPrune cover tests on a few hand made sphere sets, run by ctest
+#include "ScaleAxis.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string & name, const std::string & what)
+{
+	if(condition)
+		return;
+	std::fprintf(stderr, "FAIL %s: %s\n", name.c_str(), what.c_str());
+	failures++;
+}
+
+static void AddSphere(MedialMeshData & ma, double x, double y, double z, double r)
+{
+	ma.spheres.push_back(x);
+	ma.spheres.push_back(y);
+	ma.spheres.push_back(z);
+	ma.spheres.push_back(r);
+}
+
+static bool HasSphere(const MedialMeshData & ma, double x, double y, double z, double r)
+{
+	for(unsigned i = 0; i < ma.NumVertices(); i ++)
+		if(ma.spheres[4 * i] == x && ma.spheres[4 * i + 1] == y && ma.spheres[4 * i + 2] == z && ma.spheres[4 * i + 3] == r)
+			return true;
+	return false;
+}
+
+int main()
+{
+	// The unit sphere is enclosed by 40 spheres of radius 0.5 on its boundary,
+	// spread on a Fibonacci spiral. They cover its boundary sphere but leave a
+	// hollow of radius 0.5 around its center, so it is not inside their union.
+	MedialMeshData shell;
+	AddSphere(shell, 0., 0., 0., 1.);
+	const unsigned n = 40;
+	const double golden = M_PI * (3. - sqrt(5.));
+	for(unsigned i = 0; i < n; i ++)
+	{
+		double z = 1. - (2. * i + 1.) / n;
+		double rho = sqrt(1. - z * z);
+		AddSphere(shell, rho * cos(golden * i), rho * sin(golden * i), z, .5);
+	}
+	MedialMeshData pruned;
+	ScaleAxisStats stats;
+	ScaleAxisPrune(shell, 1., pruned, stats);
+	Check(HasSphere(pruned, 0., 0., 0., 1.), "shell", "the enclosed sphere was removed");
+	Check(stats.Removed() == 0, "shell", "spheres removed");
+	Check(pruned.NumVertices() == shell.NumVertices(), "shell", "wrong sphere count");
+
+	// A sphere inside the union of two neighbours that both contain its center,
+	// and a sphere inside a single neighbour; the three neighbours are kept.
+	MedialMeshData covered;
+	AddSphere(covered, 0., 0., 0., .5);
+	AddSphere(covered, -.4, 0., 0., .75);
+	AddSphere(covered, .4, 0., 0., .75);
+	AddSphere(covered, 3., 0., 0., .2);
+	AddSphere(covered, 3.1, 0., 0., 1.);
+	ScaleAxisPrune(covered, 1., pruned, stats);
+	Check(stats.covered_union == 1, "covered", "not one sphere inside the union");
+	Check(stats.covered_single == 1, "covered", "not one sphere inside a neighbour");
+	Check(pruned.NumVertices() == 3, "covered", "wrong sphere count");
+	Check(!HasSphere(pruned, 0., 0., 0., .5), "covered", "the sphere inside the union was kept");
+	Check(!HasSphere(pruned, 3., 0., 0., .2), "covered", "the sphere inside a neighbour was kept");
+
+	if(failures == 0)
+		std::printf("Scale axis tests passed\n");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+// ComputeThickness against ray casting on the envelopes of a few medial meshes,
+// run by ctest. The reference marches the inward normal ray of every 7th
+// envelope vertex through the exact distance field of the medial elements until
+// it leaves the solid. The table printed per shape is the comparison itself.
+#include "Thickness.h"
+#include "EnvelopeExport.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using Wm4::Vector3d;
+
+static int failures = 0;
+
+static void Check(bool condition, const std::string & name, const std::string & what)
+{
+	if(condition)
+		return;
+	std::fprintf(stderr, "FAIL %s: %s\n", name.c_str(), what.c_str());
+	failures++;
+}
+
+static void AddSphere(MedialMeshData & ma, double x, double y, double z, double r)
+{
+	ma.spheres.push_back(x);
+	ma.spheres.push_back(y);
+	ma.spheres.push_back(z);
+	ma.spheres.push_back(r);
+}
+
+static Vector3d Center(const MedialMeshData & ma, unsigned i)
+{
+	return Vector3d(ma.spheres[4 * i], ma.spheres[4 * i + 1], ma.spheres[4 * i + 2]);
+}
+
+// signed distance to the envelope, negative inside
+static double EnvelopeDistance(const MedialMeshData & ma, const Vector3d & p)
+{
+	double d = 1e30;
+	for(unsigned i = 0; i < ma.NumVertices(); i ++)
+		d = std::min(d, (p - Center(ma, i)).Length() - ma.spheres[4 * i + 3]);
+	for(unsigned e = 0; e < ma.NumEdges(); e ++)
+	{
+		unsigned a = ma.edges[2 * e], b = ma.edges[2 * e + 1];
+		d = std::min(d, ConeDistance(p, Center(ma, a), ma.spheres[4 * a + 3], Center(ma, b), ma.spheres[4 * b + 3]));
+	}
+	for(unsigned f = 0; f < ma.NumFaces(); f ++)
+	{
+		Vector3d c[3];
+		double r[3];
+		for(int k = 0; k < 3; k ++)
+		{
+			c[k] = Center(ma, ma.faces[3 * f + k]);
+			r[k] = ma.spheres[4 * ma.faces[3 * f + k] + 3];
+		}
+		d = std::min(d, SlabDistance(p, c, r));
+	}
+	return d;
+}
+
+// length of the inward normal ray from p until it leaves the solid, negative on a miss
+static double RayThickness(const MedialMeshData & ma, Vector3d p)
+{
+	const double h = 1e-6;
+	Vector3d n(EnvelopeDistance(ma, p + Vector3d(h, 0., 0.)) - EnvelopeDistance(ma, p - Vector3d(h, 0., 0.)),
+			   EnvelopeDistance(ma, p + Vector3d(0., h, 0.)) - EnvelopeDistance(ma, p - Vector3d(0., h, 0.)),
+			   EnvelopeDistance(ma, p + Vector3d(0., 0., h)) - EnvelopeDistance(ma, p - Vector3d(0., 0., h)));
+	n.Normalize();
+	p -= EnvelopeDistance(ma, p) * n;
+	double t = 1e-5;
+	for(int i = 0; i < 100000; i ++)
+	{
+		double d = EnvelopeDistance(ma, p - t * n);
+		if(d >= 0.)
+			return t;
+		t += std::max(-d, 1e-5);
+	}
+	return -1.;
+}
+
+// Outliers are expected at rounded ends and rims, where the inward ray measures
+// the length of the part instead of the wall; the bulk has to agree.
+static void Compare(const std::string & name, const MedialMeshData & ma, double expect_min, double expect_max)
+{
+	EnvelopeMesh envelope;
+	BuildEnvelope(ma, 0.002, envelope);
+	IndexedMesh mesh;
+	for(unsigned i = 0; i < envelope.vertices.size() / 3; i ++)
+		mesh.AddVertex(envelope.vertices[3 * i], envelope.vertices[3 * i + 1], envelope.vertices[3 * i + 2]);
+	for(unsigned f = 0; f < envelope.triangles.size() / 3; f ++)
+		mesh.AddFace(&envelope.triangles[3 * f], 3);
+	mesh.BuildAdjacency();
+	mesh.computebb();
+	mesh.compute_normals();
+
+	ThicknessReport report;
+	ComputeThickness(ma, mesh, 1e-3 * mesh.bb_diagonal_length, 0.15, 10, report);
+
+	std::vector<double> relative;
+	unsigned misses = 0;
+	for(unsigned i = 0; i < mesh.NumVertices(); i += 7)
+	{
+		double ray = RayThickness(ma, mesh.Position(i));
+		if(ray <= 0.)
+		{
+			misses ++;
+			continue;
+		}
+		relative.push_back(std::fabs(report.vertex_thickness[i] - ray) / ray);
+	}
+	std::sort(relative.begin(), relative.end());
+	unsigned within = 0;
+	for(size_t i = 0; i < relative.size(); i ++)
+		if(relative[i] < 0.05)
+			within ++;
+	double median = relative.empty() ? 1. : relative[relative.size() / 2];
+	double p95 = relative.empty() ? 1. : relative[relative.size() * 95 / 100];
+	double fraction = relative.empty() ? 0. : (double)within / relative.size();
+
+	std::printf("%-14s %6u vertices  thickness %.4f..%.4f mean %.4f  %4u rays: median %.4f p95 %.4f within 5%% %.3f\n",
+				name.c_str(), mesh.NumVertices(), report.min_thickness, report.max_thickness, report.mean_thickness,
+				(unsigned)relative.size(), median, p95, fraction);
+
+	Check(report.uncovered == 0, name, "uncovered vertices");
+	Check(misses == 0, name, "rays without exit");
+	Check(std::fabs(report.min_thickness - expect_min) < 1e-3 * expect_min, name, "wrong minimum thickness");
+	Check(std::fabs(report.max_thickness - expect_max) < 1e-3 * expect_max, name, "wrong maximum thickness");
+	Check(median < 0.01, name, "median difference to the rays above 1%");
+	Check(fraction > 0.75, name, "less than 75% of the vertices within 5% of the rays");
+}
+
+int main()
+{
+	MedialMeshData capsule;
+	AddSphere(capsule, 0., 0., 0., .2);
+	AddSphere(capsule, 1., 0., 0., .2);
+	capsule.edges.push_back(0);
+	capsule.edges.push_back(1);
+	Compare("capsule", capsule, .4, .4);
+
+	const unsigned quad[6] = {0, 1, 2, 0, 2, 3};
+	MedialMeshData plate;
+	AddSphere(plate, 0., 0., 0., .05);
+	AddSphere(plate, 1., 0., 0., .05);
+	AddSphere(plate, 1., 1., 0., .05);
+	AddSphere(plate, 0., 1., 0., .05);
+	plate.faces.assign(quad, quad + 6);
+	Compare("plate", plate, .1, .1);
+
+	MedialMeshData taper;
+	AddSphere(taper, 0., 0., 0., .05);
+	AddSphere(taper, 1., 0., 0., .1);
+	AddSphere(taper, 1., 1., 0., .1);
+	AddSphere(taper, 0., 1., 0., .05);
+	taper.faces.assign(quad, quad + 6);
+	Compare("taper", taper, .1, .2);
+
+	MedialMeshData mixed = plate;
+	AddSphere(mixed, 3., 0., 0., .3);
+	AddSphere(mixed, 4., 0., 0., .3);
+	mixed.edges.push_back(4);
+	mixed.edges.push_back(5);
+	Compare("plate+capsule", mixed, .1, .6);
+
+	if(failures == 0)
+		std::printf("Thickness matches the rays\n");
+	return failures == 0 ? 0 : 1;
+}